@@ -0,0 +1,173 @@
+"""Shared-backend daemon support.
+
+In daemon mode one backend serves every editor the user has open instead of
+each editor launching (and loading the model into) its own. The backend
+advertises itself through a lockfile holding its pid, HTTP port and IPC
+socket path; editors that find a live lockfile connect to it instead of
+starting another process.
+
+Editors identify themselves with a client id: the X-Texdit-Client header on
+HTTP requests, or the "client" field of the IPC hello frame. A client counts
+as attached while it has an IPC connection open or has made a request within
+the lease period. Once no clients have been attached for the idle timeout the
+daemon removes its lockfile and exits.
+"""
+import json
+import logging
+import os
+import time
+from threading import Lock, Thread
+
+logger = logging.getLogger(__name__)
+
+CLIENT_LEASE = 45.0 # Seconds; idle editors probe /health every 15 s, so a lease spans a few missed probes
+IDLE_CHECK_INTERVAL = 5.0
+
+
+def pid_alive(pid):
+    if pid <= 0:
+        return False
+    if os.name == 'nt':
+        # os.kill would terminate the process on Windows
+        import ctypes
+        PROCESS_QUERY_LIMITED_INFORMATION = 0x1000
+        STILL_ACTIVE = 259
+        kernel32 = ctypes.windll.kernel32
+        handle = kernel32.OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, False, pid)
+        if not handle:
+            return False
+        code = ctypes.c_ulong()
+        kernel32.GetExitCodeProcess(handle, ctypes.byref(code))
+        kernel32.CloseHandle(handle)
+        return code.value == STILL_ACTIVE
+    try:
+        os.kill(pid, 0)
+    except ProcessLookupError:
+        return False
+    except PermissionError:
+        return True # Alive, owned by someone else
+    return True
+
+
+def read_lock(path):
+    try:
+        with open(path, 'r', encoding='utf-8') as f:
+            return json.load(f)
+    except (OSError, ValueError):
+        return None
+
+
+def acquire_lock(path, port, ipc_socket):
+    """Create the lockfile. Returns False when another live daemon holds it."""
+    info = {"pid": os.getpid(), "port": port, "ipc_socket": ipc_socket or "", "started": time.time()}
+    for _ in range(2):
+        try:
+            fd = os.open(path, os.O_CREAT | os.O_EXCL | os.O_WRONLY, 0o600)
+        except FileExistsError:
+            holder = read_lock(path)
+            if holder and pid_alive(int(holder.get('pid', 0))):
+                logger.info(f"Backend daemon already running (pid {holder.get('pid')})")
+                return False
+            # Left behind by a daemon that crashed
+            try:
+                os.unlink(path)
+            except FileNotFoundError:
+                pass
+            continue
+        with os.fdopen(fd, 'w', encoding='utf-8') as f:
+            json.dump(info, f)
+        return True
+    return False
+
+
+def release_lock(path):
+    holder = read_lock(path)
+    if holder and holder.get('pid') == os.getpid():
+        try:
+            os.unlink(path)
+        except FileNotFoundError:
+            pass
+
+
+class ClientRegistry:
+    """Reference counts the editors using this backend"""
+
+    def __init__(self, lease=CLIENT_LEASE):
+        self.lease = lease
+        self.lock = Lock()
+        self.last_seen = {}
+        self.connections = {}
+        self.idle_since = time.monotonic()
+
+    def touch(self, client):
+        if not client:
+            return
+        with self.lock:
+            if client not in self.last_seen and client not in self.connections:
+                logger.info(f"Client attached: {client}")
+            self.last_seen[client] = time.monotonic()
+
+    def connect(self, client):
+        """An IPC connection keeps its client attached until it closes"""
+        if not client:
+            return
+        self.touch(client)
+        with self.lock:
+            self.connections[client] = self.connections.get(client, 0) + 1
+
+    def disconnect(self, client):
+        if not client:
+            return
+        with self.lock:
+            remaining = self.connections.get(client, 0) - 1
+            if remaining > 0:
+                self.connections[client] = remaining
+            else:
+                self.connections.pop(client, None)
+                # The editor closed its socket, it is not coming back
+                self.last_seen.pop(client, None)
+                logger.info(f"Client detached: {client}")
+            self.update_idle()
+
+    def count(self):
+        with self.lock:
+            self.expire()
+            return len(set(self.last_seen) | set(self.connections))
+
+    def idle_for(self):
+        """Seconds since the last client went away, 0 while any are attached"""
+        with self.lock:
+            self.expire()
+            if self.last_seen or self.connections:
+                return 0.0
+            return time.monotonic() - self.idle_since
+
+    def expire(self):
+        now = time.monotonic()
+        for client, seen in list(self.last_seen.items()):
+            if client not in self.connections and now - seen > self.lease:
+                del self.last_seen[client]
+                logger.info(f"Client lease expired: {client}")
+        self.update_idle()
+
+    def update_idle(self):
+        if self.last_seen or self.connections:
+            self.idle_since = time.monotonic()
+
+
+def start_idle_watch(clients, idle_timeout, on_idle):
+    """Call on_idle once no client has been attached for idle_timeout seconds.
+    A timeout of zero or less keeps the daemon running until it is killed."""
+    if idle_timeout <= 0:
+        return
+
+    def watch():
+        while True:
+            time.sleep(IDLE_CHECK_INTERVAL)
+            idle = clients.idle_for()
+            if idle >= idle_timeout:
+                logger.info(f"No clients for {idle:.0f}s, shutting down")
+                on_idle()
+                return
+
+    Thread(target=watch, daemon=True).start()
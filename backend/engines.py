@@ -0,0 +1,221 @@
+"""Inference engines for the seq2seq model.
+
+The same DistilBART weights can run on:
+
+    pytorch     PyTorch, fp32 (the default)
+    int8        PyTorch with the Linear layers dynamically quantised to int8
+    onnx        ONNX Runtime through optimum, fp32, with a KV-cached decoder
+    onnx-int8   the same, with the exported graphs quantised to int8
+
+Every engine returns a model with the transformers generate() API, so the
+handlers and the inference scheduler don't care which one is loaded. The
+ONNX engines export the model on first use and keep the export next to it
+(models/<name>-onnx, models/<name>-onnx-int8), so later starts only load it.
+
+The engine is picked with --engine=<name> or TEXDIT_ENGINE; if it can't be
+loaded (optimum not installed, say) the backend falls back to pytorch.
+
+The PyTorch engines map model.safetensors instead of reading it: the weights
+are views of a private mapping of the file, so backends on one machine share
+its pages and a cold start only reads the pages generation touches. A model
+that only has pytorch_model.bin is converted once, on its first load.
+"""
+import json
+import logging
+import os
+import shutil
+import struct
+import sys
+
+logger = logging.getLogger(__name__)
+
+ENGINES = ('pytorch', 'int8', 'onnx', 'onnx-int8')
+DEFAULT_ENGINE = 'pytorch'
+
+# Reported in the performance block of responses
+LABELS = {
+    'pytorch': 'PyTorch fp32',
+    'int8': 'PyTorch int8 (dynamic quantisation)',
+    'onnx': 'ONNX Runtime fp32, KV cache',
+    'onnx-int8': 'ONNX Runtime int8, KV cache',
+}
+
+
+def requested():
+    """Engine named on the command line or in the environment"""
+    name = os.environ.get('TEXDIT_ENGINE', DEFAULT_ENGINE)
+    for arg in sys.argv[1:]:
+        if arg.startswith('--engine='):
+            name = arg.split('=', 1)[1]
+    if name not in ENGINES:
+        logger.warning(f"Unknown engine '{name}', using {DEFAULT_ENGINE} (choices: {', '.join(ENGINES)})")
+        name = DEFAULT_ENGINE
+    return name
+
+
+def load(name, source, export_root=None, **kwargs):
+    """Load the model from source (a directory or hub name) for the engine.
+    Returns (model, engine actually used)."""
+    if name in ('onnx', 'onnx-int8'):
+        try:
+            return load_onnx(source, export_root, quantise=name == 'onnx-int8', **kwargs), name
+        except Exception as e:
+            logger.error(f"ONNX engine unavailable ({e}), falling back to pytorch")
+            name = DEFAULT_ENGINE
+
+    model = load_pretrained(source, **kwargs)
+    model.eval()
+    if name == 'int8':
+        import torch
+        model = torch.quantization.quantize_dynamic(model, {torch.nn.Linear}, dtype=torch.qint8)
+    return model, name
+
+
+def load_pretrained(source, **kwargs):
+    """AutoModelForSeq2SeqLM with its weights mapped from the directory's
+    model.safetensors; hub names and other checkpoints load as usual"""
+    from transformers import AutoModelForSeq2SeqLM
+
+    weights = os.path.join(source, SAFETENSORS_NAME) if os.path.isdir(source) else None
+    if weights and os.path.isfile(weights):
+        try:
+            return load_mapped(source, weights, **kwargs)
+        except Exception as e:
+            logger.warning(f"Could not map {weights} ({e}), reading it instead")
+
+    model = AutoModelForSeq2SeqLM.from_pretrained(source, **kwargs)
+    if weights and not os.path.exists(weights):
+        save_safetensors(model, weights)
+    return model
+
+
+SAFETENSORS_NAME = "model.safetensors"
+
+# safetensors dtype names
+TORCH_DTYPES = {
+    'F64': 'float64', 'F32': 'float32', 'F16': 'float16', 'BF16': 'bfloat16',
+    'I64': 'int64', 'I32': 'int32', 'I16': 'int16', 'I8': 'int8', 'U8': 'uint8', 'BOOL': 'bool',
+}
+
+
+def mmap_safetensors(path):
+    """Tensors of a safetensors file as views of one copy-on-write mapping of
+    it; nothing is read until a tensor's pages are touched"""
+    import torch
+
+    with open(path, 'rb') as f:
+        header_size = struct.unpack('<Q', f.read(8))[0]
+        header = json.loads(f.read(header_size))
+    storage = torch.UntypedStorage.from_file(path, shared=False, nbytes=os.path.getsize(path))
+    data = torch.empty(0, dtype=torch.uint8).set_(storage)
+    start = 8 + header_size
+
+    tensors = {}
+    for name, info in header.items():
+        if name == '__metadata__':
+            continue
+        begin, end = info['data_offsets']
+        dtype = getattr(torch, TORCH_DTYPES[info['dtype']])
+        tensors[name] = data[start + begin:start + end].view(dtype).reshape(info['shape'])
+    return tensors
+
+
+def load_mapped(source, weights, **kwargs):
+    """Build the model without allocating weights, then point its parameters at the mapping"""
+    import torch
+    from transformers import AutoConfig, AutoModelForSeq2SeqLM, GenerationConfig
+
+    config = AutoConfig.from_pretrained(source, **kwargs)
+    with torch.device('meta'):
+        model = AutoModelForSeq2SeqLM.from_config(config)
+    model.load_state_dict(mmap_safetensors(weights), strict=False, assign=True)
+    model.tie_weights() # The file holds shared embeddings once
+    unmapped = [name for name, tensor in list(model.named_parameters()) + list(model.named_buffers()) if tensor.is_meta]
+    if unmapped:
+        raise ValueError(f"{len(unmapped)} tensors not in the file, such as {unmapped[0]}")
+    try:
+        model.generation_config = GenerationConfig.from_pretrained(source, **kwargs)
+    except Exception:
+        pass # Older checkpoints keep their generation settings in config.json
+    logger.info(f"Mapped weights from {weights}")
+    return model
+
+
+def save_safetensors(model, path):
+    """Keep a safetensors copy of the weights next to the checkpoint so later
+    loads can map it"""
+    try:
+        from safetensors.torch import save_model
+        staging = path + ".partial"
+        save_model(model, staging)
+        os.replace(staging, path)
+        logger.info(f"Saved {path} for memory-mapped loading")
+    except Exception as e:
+        logger.warning(f"Could not write {path}: {e}")
+
+
+def memory_footprint(model):
+    """Bytes the model's weights take, mapped or not; ONNX sessions count their graph files"""
+    if hasattr(model, 'parameters'):
+        # Tied weights are the same tensor and count once
+        tensors = {id(t): t for t in list(model.parameters()) + list(model.buffers())}
+        total = sum(t.numel() * t.element_size() for t in tensors.values())
+        for module in model.modules():
+            if hasattr(module, '_packed_params') and callable(getattr(module, 'weight', None)):
+                total += module.weight().numel() # Dynamically quantised Linear, one byte per weight
+        return total
+    directory = getattr(model, 'model_save_dir', None)
+    if directory and os.path.isdir(directory):
+        return sum(entry.stat().st_size for entry in os.scandir(directory) if entry.is_file())
+    return 0
+
+
+def load_onnx(source, export_root, quantise, **kwargs):
+    from optimum.onnxruntime import ORTModelForSeq2SeqLM
+
+    export_root = export_root or os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "models")
+    base = os.path.basename(os.path.normpath(source))
+    fp32_dir = os.path.join(export_root, base + "-onnx")
+
+    if not os.path.isdir(fp32_dir):
+        logger.info(f"Exporting {source} to ONNX in {fp32_dir} (first start only)")
+        exported = ORTModelForSeq2SeqLM.from_pretrained(source, export=True, use_cache=True, **kwargs)
+        staging = fp32_dir + ".partial"
+        shutil.rmtree(staging, ignore_errors=True)
+        exported.save_pretrained(staging)
+        os.replace(staging, fp32_dir) # As in quantise_export, a crash never leaves a half-written export
+    if not quantise:
+        return ORTModelForSeq2SeqLM.from_pretrained(fp32_dir, use_cache=True)
+
+    int8_dir = os.path.join(export_root, base + "-onnx-int8")
+    if not os.path.isdir(int8_dir):
+        quantise_export(fp32_dir, int8_dir)
+    return ORTModelForSeq2SeqLM.from_pretrained(
+        int8_dir,
+        use_cache=True,
+        encoder_file_name="encoder_model_quantized.onnx",
+        decoder_file_name="decoder_model_quantized.onnx",
+        decoder_with_past_file_name="decoder_with_past_model_quantized.onnx",
+    )
+
+
+def quantise_export(fp32_dir, int8_dir):
+    """Dynamic int8 quantisation of the encoder, decoder and cached decoder graphs"""
+    from optimum.onnxruntime import ORTQuantizer
+    from optimum.onnxruntime.configuration import AutoQuantizationConfig
+
+    logger.info(f"Quantising the ONNX export to int8 in {int8_dir} (first start only)")
+    config = AutoQuantizationConfig.avx2(is_static=False, per_channel=False)
+    staging = int8_dir + ".partial"
+    shutil.rmtree(staging, ignore_errors=True)
+    for file_name in ("encoder_model.onnx", "decoder_model.onnx", "decoder_with_past_model.onnx"):
+        quantizer = ORTQuantizer.from_pretrained(fp32_dir, file_name=file_name)
+        quantizer.quantize(save_dir=staging, quantization_config=config)
+
+    # Configs and generation settings come from the fp32 export
+    for file_name in os.listdir(fp32_dir):
+        if not file_name.endswith(".onnx") and not os.path.exists(os.path.join(staging, file_name)):
+            source = os.path.join(fp32_dir, file_name)
+            if os.path.isfile(source):
+                shutil.copy(source, staging)
+    os.replace(staging, int8_dir) # An interrupted run leaves no half-written export behind
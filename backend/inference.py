@@ -0,0 +1,221 @@
+"""Inference scheduler between the request handlers and the model.
+
+Handlers submit model.generate() calls instead of running them on their own
+thread. Worker threads take requests off one queue and run compatible ones
+(same generation settings apart from their lengths) as one padded batch, so
+concurrent editors and the map-reduce segments of a long document share a
+forward pass instead of queueing behind each other at batch size 1.
+
+Within a batch every request keeps its own min/max length, deadline and
+cancellation: RowLimits works on the rows belonging to each request, ending
+a row with EOS once its request is done. A request that arrives alone is
+run exactly as the handler asked.
+
+Workers, batch size and the time a batch waits to fill are set through
+TEXDIT_INFERENCE_WORKERS, TEXDIT_MAX_BATCH and TEXDIT_BATCH_WINDOW_MS.
+"""
+import logging
+import os
+import time
+from collections import deque
+from threading import Condition, Event, Lock, Thread
+
+logger = logging.getLogger(__name__)
+
+DEFAULT_WORKERS = 1
+DEFAULT_MAX_BATCH = 8
+DEFAULT_BATCH_WINDOW_MS = 10
+
+# Per-request arguments; everything else has to match for requests to share a batch
+REQUEST_ARGUMENTS = ('input_ids', 'attention_mask', 'max_length', 'min_length', 'max_time', 'stopping_criteria')
+
+
+class GenerationRequest:
+    def __init__(self, kwargs):
+        self.input_ids = kwargs['input_ids']
+        self.attention_mask = kwargs.get('attention_mask')
+        self.max_length = kwargs.get('max_length')
+        self.min_length = kwargs.get('min_length') or 0
+        self.stoppers = list(kwargs.get('stopping_criteria') or [])
+        max_time = kwargs.get('max_time')
+        self.deadline = time.perf_counter() + max_time if max_time else None
+        self.kwargs = kwargs
+        self.settings = {k: v for k, v in kwargs.items() if k not in REQUEST_ARGUMENTS}
+        try:
+            self.key = tuple(sorted(self.settings.items()))
+            hash(self.key)
+        except TypeError:
+            self.key = object() # Settings we can't compare run on their own
+        self.submitted = time.perf_counter()
+        self.done = Event()
+        self.result = None
+        self.error = None
+
+    def stopped(self):
+        """True once the request was cancelled or ran out of time"""
+        if self.deadline is not None and time.perf_counter() > self.deadline:
+            return True
+        return any(stop(None, None) for stop in self.stoppers)
+
+
+class RowLimits:
+    """Logits processor applying each request's own length limits, deadline
+    and cancellation to its rows of a batch (num_beams rows per request).
+    Duck-typed like server.GenerationStop."""
+    def __init__(self, requests, eos_token_id):
+        self.requests = requests
+        self.eos_token_id = eos_token_id
+
+    def __call__(self, input_ids, scores):
+        length = input_ids.shape[-1]
+        rows = scores.shape[0] // len(self.requests)
+        for i, request in enumerate(self.requests):
+            block = slice(i * rows, (i + 1) * rows)
+            if (request.max_length is not None and length >= request.max_length - 1) or request.stopped():
+                # Same as ForcedEOSTokenLogitsProcessor, for these rows only
+                scores[block, :] = -float("inf")
+                scores[block, self.eos_token_id] = 0
+            elif length < request.min_length:
+                scores[block, self.eos_token_id] = -float("inf")
+        return scores
+
+
+class InferenceScheduler:
+    def __init__(self, workers=None, max_batch_size=None, batch_window_ms=None):
+        self.workers = max(1, int(workers or os.environ.get('TEXDIT_INFERENCE_WORKERS', DEFAULT_WORKERS)))
+        self.max_batch_size = max(1, int(max_batch_size or os.environ.get('TEXDIT_MAX_BATCH', DEFAULT_MAX_BATCH)))
+        window = batch_window_ms if batch_window_ms is not None else os.environ.get('TEXDIT_BATCH_WINDOW_MS', DEFAULT_BATCH_WINDOW_MS)
+        self.batch_window = max(0.0, float(window) / 1000)
+        self.model = None
+        self.threads = []
+        self.eos_token_id = None
+        self.pad_token_id = None
+        self.queue = deque()
+        self.condition = Condition()
+        self.stats_lock = Lock()
+        self.running = 0
+        self.batches = 0
+        self.requests = 0
+        self.largest_batch = 0
+        self.queue_wait = 0.0 # Moving average, seconds
+
+    def start(self, model, tokenizer):
+        """Run generations on model; the workers are started the first time"""
+        self.model = model
+        self.eos_token_id = tokenizer.eos_token_id
+        self.pad_token_id = tokenizer.pad_token_id if tokenizer.pad_token_id is not None else tokenizer.eos_token_id
+        if self.threads:
+            return
+        for i in range(self.workers):
+            self.threads.append(Thread(target=self.work, name=f"inference-{i}", daemon=True))
+            self.threads[-1].start()
+        logger.info(f"Inference scheduler: {self.workers} workers, batches of up to {self.max_batch_size}, "
+                    f"{self.batch_window * 1000:.0f} ms window")
+
+    def stop(self):
+        """Let go of the model once it is unloaded; the workers wait for the next start()"""
+        self.model = None
+
+    def generate(self, **kwargs):
+        """Blocking model.generate() through the queue; returns its output"""
+        request = GenerationRequest(kwargs)
+        with self.condition:
+            self.queue.append(request)
+            self.condition.notify()
+        request.done.wait()
+        if request.error is not None:
+            raise request.error
+        return request.result
+
+    def stats(self):
+        """Load figures for /health"""
+        with self.condition:
+            queued = len(self.queue)
+        with self.stats_lock:
+            return {
+                "workers": self.workers,
+                "max_batch_size": self.max_batch_size,
+                "queued": queued,
+                "running": self.running,
+                "batches": self.batches,
+                "requests": self.requests,
+                "mean_batch_size": round(self.requests / self.batches, 2) if self.batches else 0.0,
+                "largest_batch": self.largest_batch,
+                "queue_wait_ms": round(self.queue_wait * 1000, 1)
+            }
+
+    def next_batch(self):
+        """The oldest request plus compatible ones that arrive within the window"""
+        with self.condition:
+            while not self.queue:
+                self.condition.wait()
+            batch = [self.queue.popleft()]
+            close = time.perf_counter() + self.batch_window
+            while len(batch) < self.max_batch_size:
+                for request in list(self.queue):
+                    if request.key == batch[0].key and len(batch) < self.max_batch_size:
+                        self.queue.remove(request)
+                        batch.append(request)
+                remaining = close - time.perf_counter()
+                if len(batch) >= self.max_batch_size or remaining <= 0:
+                    break
+                self.condition.wait(remaining)
+            return batch
+
+    def work(self):
+        while True:
+            batch = self.next_batch()
+            started = time.perf_counter()
+            with self.stats_lock:
+                self.running += len(batch)
+                for request in batch:
+                    self.queue_wait = 0.9 * self.queue_wait + 0.1 * (started - request.submitted)
+            try:
+                self.run(batch)
+            except Exception as e:
+                for request in batch:
+                    if not request.done.is_set():
+                        request.error = e
+                        request.done.set()
+            finally:
+                with self.stats_lock:
+                    self.running -= len(batch)
+                    self.batches += 1
+                    self.requests += len(batch)
+                    self.largest_batch = max(self.largest_batch, len(batch))
+
+    def run(self, batch):
+        if len(batch) == 1:
+            request = batch[0]
+            request.result = self.model.generate(**request.kwargs)
+            request.done.set()
+            return
+
+        import torch
+
+        # Right-pad to the longest input; the attention mask hides the padding from the encoder
+        length = max(request.input_ids.shape[1] for request in batch)
+        input_ids = torch.full((len(batch), length), self.pad_token_id, dtype=batch[0].input_ids.dtype)
+        attention_mask = torch.zeros((len(batch), length), dtype=torch.long)
+        for i, request in enumerate(batch):
+            n = request.input_ids.shape[1]
+            input_ids[i, :n] = request.input_ids[0]
+            attention_mask[i, :n] = request.attention_mask[0] if request.attention_mask is not None else 1
+
+        lengths = [request.max_length for request in batch]
+        max_length = None if None in lengths else max(lengths)
+        with torch.no_grad():
+            outputs = self.model.generate(
+                input_ids=input_ids,
+                attention_mask=attention_mask,
+                max_length=max_length,
+                min_length=0, # RowLimits applies each request's own
+                logits_processor=[RowLimits(batch, self.eos_token_id)],
+                **batch[0].settings
+            )
+        logger.info(f"Batched generation: {len(batch)} requests, {length} input tokens, "
+                    f"{time.perf_counter() - batch[0].submitted:.2f}s")
+
+        for i, request in enumerate(batch):
+            request.result = outputs[i:i + 1]
+            request.done.set()
@@ -0,0 +1,184 @@
+"""Binary local-socket transport for the editor.
+
+Frames in both directions are length-prefixed (all integers big-endian):
+
+    u32 frame_length   bytes following this field
+    u32 request_id     echoed back on every reply frame
+    u8  kind           see FRAME_* below
+    u32 header_length
+    header             compact JSON
+    payload            raw bytes (the request text), may be empty
+
+A request header is {"endpoint": ..., "data": {...}} with the document text
+carried outside the JSON, either as UTF-8 in the payload or, for large
+documents, as "ring": [offset, length] pointing at UTF-16 text the editor
+wrote into a shared memory-mapped file announced by a hello frame. Either
+way the text is decoded exactly once and never JSON-escaped.
+
+Replies are any number of FRAME_CHUNK frames followed by one FRAME_DONE or
+FRAME_ERROR frame whose header is the usual response body; an error body
+also carries the HTTP "status" the request would have been answered with.
+
+The hello frame may also carry a "client" id; in daemon mode that editor
+stays attached to the backend for as long as its connection is open.
+"""
+import json
+import logging
+import mmap
+import os
+import socket
+import struct
+import time
+import types
+from threading import Lock, Thread
+
+logger = logging.getLogger(__name__)
+
+FRAME_HELLO = 0
+FRAME_REQUEST = 1
+FRAME_CHUNK = 2
+FRAME_DONE = 3
+FRAME_ERROR = 4
+
+PREFIX = struct.Struct('>I')
+FRAME_HEADER = struct.Struct('>IBI')
+
+MAX_FRAME_LENGTH = 64 * 1024 * 1024
+
+
+def start(path, endpoints, clients=None):
+    """Listen on a Unix domain socket at path in a background thread.
+    clients, a daemon.ClientRegistry, is told when editors connect and leave.
+    Returns False when the platform has no AF_UNIX support."""
+    if not hasattr(socket, 'AF_UNIX'):
+        return False
+
+    try:
+        os.unlink(path)
+    except FileNotFoundError:
+        pass
+
+    listener = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    listener.bind(path)
+    os.chmod(path, 0o600) # Only the editor's user may talk to the model
+    listener.listen()
+
+    def accept_loop():
+        while True:
+            conn, _ = listener.accept()
+            Thread(target=Connection(conn, endpoints, clients).serve, daemon=True).start()
+
+    Thread(target=accept_loop, daemon=True).start()
+    return True
+
+
+def read_exact(conn, length):
+    buffer = bytearray(length)
+    view = memoryview(buffer)
+    received = 0
+    while received < length:
+        count = conn.recv_into(view[received:])
+        if count == 0:
+            raise ConnectionError("connection closed")
+        received += count
+    return buffer
+
+
+class Connection:
+    def __init__(self, conn, endpoints, clients=None):
+        self.conn = conn
+        self.endpoints = endpoints
+        self.clients = clients
+        self.client = None
+        self.ring = None
+        self.ring_encoding = 'utf-16-le'
+        self.send_lock = Lock()
+
+    def serve(self):
+        try:
+            while True:
+                (length,) = PREFIX.unpack(read_exact(self.conn, PREFIX.size))
+                if length < FRAME_HEADER.size or length > MAX_FRAME_LENGTH:
+                    raise ConnectionError(f"bad frame length {length}")
+
+                frame = read_exact(self.conn, length)
+                request_id, kind, header_length = FRAME_HEADER.unpack_from(frame)
+                header_end = FRAME_HEADER.size + header_length
+                header = json.loads(bytes(frame[FRAME_HEADER.size:header_end]))
+                payload = memoryview(frame)[header_end:]
+
+                if kind == FRAME_HELLO:
+                    self.open_ring(header)
+                elif kind == FRAME_REQUEST:
+                    # Each request gets its own thread, matching the threaded HTTP server
+                    Thread(target=self.handle_request, args=(request_id, header, payload), daemon=True).start()
+        except (ConnectionError, OSError) as e:
+            logger.info(f"IPC connection closed: {e}")
+        finally:
+            self.conn.close()
+            if self.ring is not None:
+                self.ring.close()
+            if self.clients is not None and self.client:
+                self.clients.disconnect(self.client)
+
+    def open_ring(self, header):
+        if self.clients is not None and header.get('client') and not self.client:
+            self.client = header['client']
+            self.clients.connect(self.client)
+
+        with open(header['ring'], 'rb') as f:
+            self.ring = mmap.mmap(f.fileno(), header['ring_size'], access=mmap.ACCESS_READ)
+        self.ring_encoding = header.get('encoding', self.ring_encoding)
+
+    def handle_request(self, request_id, header, payload):
+        try:
+            self.dispatch(request_id, header, payload)
+        except OSError:
+            pass # Connection dropped, serve() cleans up
+        except Exception as e:
+            logger.error(f"Error occurred in IPC request {request_id}: {e}")
+            self.send(request_id, FRAME_ERROR, {"error": str(e), "status": 500})
+
+    def dispatch(self, request_id, header, payload):
+        # Keys starting with "_" are the server's own (_received, _encodings)
+        data = {key: value for key, value in header.get('data', {}).items() if not str(key).startswith('_')}
+        if 'ring' in header:
+            offset, length = header['ring']
+            data['text'] = str(memoryview(self.ring)[offset:offset + length], self.ring_encoding)
+        elif 'text_length' in header:
+            data['text'] = str(payload, 'utf-8')
+
+        # The editor's request ID (as in X-Request-ID), not the frame's
+        trace_id = header.get('request_id')
+        if trace_id:
+            logger.info(f"[{trace_id}] {header.get('endpoint')} via IPC")
+            data.setdefault('request_id', trace_id)
+        data['_received'] = time.perf_counter()
+
+        handler = self.endpoints.get(header.get('endpoint'))
+        if handler is None:
+            self.send(request_id, FRAME_ERROR, {"error": f"Unknown endpoint: {header.get('endpoint')}", "status": 404})
+            return
+
+        result = handler(data)
+        if isinstance(result, types.GeneratorType):
+            try:
+                for event in result:
+                    kind = {'chunk': FRAME_CHUNK, 'done': FRAME_DONE}.get(event.get('type'), FRAME_ERROR)
+                    self.send(request_id, kind, event)
+            finally:
+                result.close() # Stops generation if the editor went away mid-stream
+            return
+
+        body, status = result
+        if status >= 400:
+            # Error frames carry the HTTP status the editor would have seen
+            self.send(request_id, FRAME_ERROR, dict(body, status=status))
+            return
+        self.send(request_id, FRAME_DONE, body)
+
+    def send(self, request_id, kind, body):
+        header = json.dumps(body, separators=(',', ':')).encode('utf-8')
+        frame = FRAME_HEADER.pack(request_id, kind, len(header)) + header
+        with self.send_lock:
+            self.conn.sendall(PREFIX.pack(len(frame)) + frame)
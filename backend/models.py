@@ -0,0 +1,183 @@
+"""Lazily loaded models, one per feature package.
+
+Commands name the model they need; rule-based commands (keywords, tone,
+search) need none. Nothing is loaded at startup: a model is loaded the first
+time a command asks for it, and requests arriving meanwhile wait for that one
+load. The server answers /health and the rule-based commands right away.
+
+Loaded models are kept in least-recently-used order. When together they
+exceed the memory budget (TEXDIT_MODEL_MEMORY_MB), the least recently used
+ones are unloaded; a model serving a request is never evicted. Weights come
+from memory-mapped safetensors files where possible (see engines.py), so
+their pages are shared between backends and reloading an evicted model is
+cheap while the file is still in the page cache.
+
+/health reports every command's model state, which the editor uses to tell
+which commands it can offer:
+
+    unloaded    installed, loads on first use
+    loading     being loaded
+    ready       in memory
+    failed      the last load failed; retried after FAILED_RETRY seconds
+    missing     the package is not installed
+"""
+import gc
+import logging
+import os
+import time
+from contextlib import contextmanager
+from threading import Lock
+
+logger = logging.getLogger(__name__)
+
+DEFAULT_MEMORY_BUDGET_MB = 3072
+FAILED_RETRY = 60 # Seconds a failed load is reported before the next use tries again
+
+
+class ModelUnavailable(Exception):
+    """Raised when a command's model can't be loaded"""
+
+
+class Model:
+    def __init__(self, name, label, commands, load, unload=None, installed=None):
+        self.name = name
+        self.label = label
+        self.commands = tuple(commands)
+        self.load = load # Returns (value, bytes in memory)
+        self.unload = unload # Called with the value before it is dropped
+        self.installed = installed or (lambda: True)
+        self.value = None
+        self.size = 0
+        self.loading = False
+        self.error = None
+        self.failed_at = 0.0
+        self.users = 0
+        self.last_used = 0.0
+        self.load_lock = Lock() # One load at a time; requests arriving meanwhile wait for it
+
+    def state(self):
+        if self.value is not None:
+            return "ready"
+        if self.loading:
+            return "loading"
+        if self.error is not None and time.monotonic() - self.failed_at < FAILED_RETRY:
+            return "failed"
+        return "unloaded" if self.installed() else "missing"
+
+
+class ModelRegistry:
+    def __init__(self, budget_mb=None):
+        budget_mb = budget_mb or os.environ.get('TEXDIT_MODEL_MEMORY_MB', DEFAULT_MEMORY_BUDGET_MB)
+        self.budget = int(float(budget_mb) * 1024 * 1024)
+        self.models = {}
+        self.lock = Lock() # Guards users, last_used and eviction
+
+    def register(self, name, label, commands, load, unload=None, installed=None):
+        self.models[name] = Model(name, label, commands, load, unload, installed)
+
+    def acquire(self, name):
+        """The loaded model, loading it first if needed. Every acquire() must
+        be paired with a release(); in_use() does both."""
+        model = self.models[name]
+        with model.load_lock:
+            while True:
+                # Checked together with taking it, so eviction can't slip in between
+                with self.lock:
+                    value = model.value
+                    if value is not None:
+                        model.users += 1
+                        model.last_used = time.monotonic()
+                        break
+                self._load(model)
+        self._evict(keep=model)
+        return value
+
+    def release(self, name):
+        model = self.models[name]
+        with self.lock:
+            model.users -= 1
+        self._evict()
+
+    @contextmanager
+    def in_use(self, name):
+        value = self.acquire(name)
+        try:
+            yield value
+        finally:
+            self.release(name)
+
+    def _load(self, model):
+        state = model.state()
+        if state == "missing":
+            raise ModelUnavailable(f"{model.label} is not installed")
+        if state == "failed":
+            raise ModelUnavailable(f"{model.label} failed to load: {model.error}")
+
+        model.loading = True
+        start = time.perf_counter()
+        logger.info(f"Loading {model.label} for {', '.join(model.commands)}")
+        try:
+            model.value, model.size = model.load()
+            model.error = None
+        except Exception as e:
+            logger.error(f"Failed to load {model.label}: {e}")
+            model.error = str(e)
+            model.failed_at = time.monotonic()
+            raise ModelUnavailable(f"{model.label} failed to load: {e}") from e
+        finally:
+            model.loading = False
+        logger.info(f"Loaded {model.label} in {time.perf_counter() - start:.1f}s "
+                    f"({model.size / (1024 * 1024):.0f} MB)")
+
+    def _evict(self, keep=None):
+        """Unload least recently used models until the loaded ones fit the budget"""
+        with self.lock:
+            loaded = [m for m in self.models.values() if m.value is not None]
+            total = sum(m.size for m in loaded)
+            victims = []
+            for model in sorted(loaded, key=lambda m: m.last_used):
+                if total <= self.budget:
+                    break
+                if model is keep or model.users > 0:
+                    continue
+                victims.append(model)
+                total -= model.size
+            for model in victims:
+                value, model.value = model.value, None
+                logger.info(f"Evicting {model.label} ({model.size / (1024 * 1024):.0f} MB), "
+                            f"over the {self.budget // (1024 * 1024)} MB model budget")
+                if model.unload:
+                    model.unload(value)
+                model.size = 0
+        if victims:
+            gc.collect()
+
+    def model_for(self, command):
+        for model in self.models.values():
+            if command in model.commands:
+                return model
+        return None
+
+    def is_loaded(self, name):
+        return self.models[name].value is not None
+
+    def status(self):
+        """Per-model state for /health"""
+        return {
+            model.name: {
+                "label": model.label,
+                "state": model.state(),
+                "commands": list(model.commands),
+                "memory_mb": round(model.size / (1024 * 1024)),
+                **({"error": model.error} if model.state() == "failed" else {}),
+            }
+            for model in self.models.values()
+        }
+
+    def command_status(self):
+        """Model and state of every command that needs one, for /health"""
+        return {
+            command: {"model": model.name, "state": model.state()}
+            for model in self.models.values()
+            for command in model.commands
+        }
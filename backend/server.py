@@ -1,12 +1,29 @@
+import json
+
+def report_status(stage, progress, message):
+    """Print a machine-readable load status line for the editor"""
+    print("TEXDIT_STATUS " + json.dumps({"stage": stage, "progress": progress, "message": message}), flush=True)
+
+# Reported before the heavy imports so the editor knows the process is alive
+report_status("starting", 0.0, "Starting Python server...")
+
 from rapidfuzz import fuzz, process # Fuzzy search library
 import time # For speed benchmarking
+import types
+from threading import Event, Thread, Lock
 
-from flask import Flask, jsonify, request # Server framework
+from flask import Flask, g, jsonify, request, Response, stream_with_context # Server framework
 from flask_cors import CORS # Enable CORS for Qt integration
+from werkzeug.serving import WSGIRequestHandler, make_server
 
-from transformers import AutoTokenizer, AutoModelForSeq2SeqLM # Model for summarization
 import logging
 
+import ipc_server # Binary local-socket transport
+import daemon # Shared backend across editor instances
+import inference # Batches concurrent generate() calls
+import engines # PyTorch, int8 or ONNX Runtime model
+import models # Loads models on first use, evicts them under a memory budget
+
 # Set up logging
 logging.basicConfig(level=logging.INFO)
 logger = logging.getLogger(__name__)
@@ -14,30 +31,158 @@ logger = logging.getLogger(__name__)
 app = Flask(__name__)
 CORS(app)  # Enable CORS for all routes
 
-# Initialize the tokenizer and model for summarization
-# Using DistilBART-CNN for better summarization quality and length control
+# Models are loaded by the first command that needs one, see models.py.
+# DistilBART-CNN serves summarise (quality and length control) and rephrase.
 
 import os
+import sys
 local_model_path = os.path.join(os.path.dirname(__file__), "..", "models", "distilbart-cnn-12-6")
-logger.info(f"Loading DistilBART model from local directory: {local_model_path}")
-
-# Load from local model directory (packaged with the app)
-try:
-    tokenizer = AutoTokenizer.from_pretrained(local_model_path, local_files_only=True)
-    model = AutoModelForSeq2SeqLM.from_pretrained(local_model_path, local_files_only=True)
-    logger.info("Successfully loaded DistilBART model from local directory")
-except Exception as e:
-    logger.error(f"Failed to load local model: {e}")
-    # Fallback to Hugging Face if local model fails
-    model_name = "sshleifer/distilbart-cnn-12-6"
-    logger.info("Falling back to downloading from Hugging Face...")
-    tokenizer = AutoTokenizer.from_pretrained(model_name)
-    model = AutoModelForSeq2SeqLM.from_pretrained(model_name)
-    logger.info("Successfully loaded DistilBART model from Hugging Face")
-
-def fuzzy_search(query, choices, limit=10):
+hub_model_name = "sshleifer/distilbart-cnn-12-6"
+
+engine = engines.requested() # Replaced by the engine actually loaded
+
+# Non-streamed generations go through here, see inference.py
+scheduler = inference.InferenceScheduler()
+
+registry = models.ModelRegistry()
+
+def load_summarizer():
+    """Load DistilBART and warm it up with a tiny generation. Returns the
+    loaded (tokenizer, model, streamer class) and its size in bytes."""
+    global engine
+    from transformers import AutoTokenizer, TextIteratorStreamer
+    
+    # Load from local model directory (packaged with the app)
+    try:
+        logger.info(f"Loading DistilBART model from local directory: {local_model_path}")
+        tokenizer = AutoTokenizer.from_pretrained(local_model_path, local_files_only=True)
+        model, loaded_engine = engines.load(engine, local_model_path, local_files_only=True)
+        logger.info("Successfully loaded DistilBART model from local directory")
+    except Exception as e:
+        logger.error(f"Failed to load local model: {e}")
+        # Fallback to Hugging Face if local model fails
+        logger.info("Falling back to downloading from Hugging Face...")
+        tokenizer = AutoTokenizer.from_pretrained(hub_model_name)
+        model, loaded_engine = engines.load(engine, hub_model_name)
+        logger.info("Successfully loaded DistilBART model from Hugging Face")
+    
+    # The first generate() call initialises lazy state; pay for it now, not in the first command's generation
+    warmup = tokenizer("Warm up the model.", return_tensors="pt")
+    model.generate(warmup["input_ids"], max_length=8, num_beams=1)
+    
+    scheduler.start(model, tokenizer)
+    engine = loaded_engine
+    logger.info(f"Inference engine: {engines.LABELS[engine]}")
+    return types.SimpleNamespace(tokenizer=tokenizer, model=model, streamer_class=TextIteratorStreamer), \
+        engines.memory_footprint(model)
+
+def summarizer_installed():
+    """Weights are packaged, or can still be downloaded"""
+    packaged = any(os.path.exists(os.path.join(local_model_path, name))
+                   for name in (engines.SAFETENSORS_NAME, "pytorch_model.bin"))
+    return packaged or os.environ.get('HF_HUB_OFFLINE', '0') in ('0', '')
+
+registry.register("summarizer", "DistilBART summarizer", ("summarise", "rephrase"),
+                  load_summarizer, unload=lambda _: scheduler.stop(), installed=summarizer_installed)
+
+def model_unavailable(error):
+    """Error response for model endpoints whose model can't be loaded"""
+    return {"error": f"Model not available: {error}"}, 503
+
+def encode(data, tokenizer, text, max_length):
+    """Tokenise text for the model, truncated to max_length tokens. Within a
+    batch the text is tokenised once and every handler's window is cut from
+    that encoding."""
+    encodings = data.get('_encodings')
+    if encodings is None:
+        return tokenizer(text, return_tensors="pt", max_length=max_length, truncation=True, padding=True)
+    
+    import torch
+    if text not in encodings:
+        encodings[text] = tokenizer(text, return_tensors="pt")["input_ids"]
+    input_ids = encodings[text]
+    if input_ids.shape[1] > max_length:
+        # Same as truncation: keep the first tokens and the closing </s>
+        input_ids = torch.cat([input_ids[:, :max_length - 1], input_ids[:, -1:]], dim=1)
+    return {"input_ids": input_ids, "attention_mask": torch.ones_like(input_ids)}
+
+# Requests the editor gave up on, by request ID. A cancel can arrive before
+# the request it names reaches the model, so IDs are kept for CANCEL_TTL seconds.
+CANCEL_TTL = 300
+cancelled_requests = {}
+cancelled_lock = Lock()
+
+# Share of a request's deadline the model may spend generating; the rest
+# covers tokenising, decoding and sending the reply
+GENERATION_DEADLINE_SHARE = 0.8
+# Seconds; with less of the share left (e.g. after loading the model) the
+# request fails instead of generating a truncated result
+MIN_GENERATION_TIME = 0.1
+
+def cancel_request(request_id):
+    now = time.monotonic()
+    with cancelled_lock:
+        for stale in [rid for rid, at in cancelled_requests.items() if now - at > CANCEL_TTL]:
+            del cancelled_requests[stale]
+        cancelled_requests[request_id] = now
+
+def is_cancelled(request_id):
+    if not request_id:
+        return False
+    with cancelled_lock:
+        return request_id in cancelled_requests
+
+class GenerationStop:
+    """Stopping criterion that ends model.generate() at the next decoding step
+    once the request is cancelled, or abandoned by a streaming client.
+    Duck-typed, so it can be defined before transformers is imported."""
+    def __init__(self, request_id):
+        self.request_id = request_id
+        self.abandoned = Event()
+        self.triggered = False
+    
+    def __call__(self, input_ids, scores, **kwargs):
+        if self.abandoned.is_set() or is_cancelled(self.request_id):
+            self.triggered = True
+        return self.triggered
+
+def generation_limits(data):
+    """model.generate() arguments that bound the work done for a request: its
+    deadline_ms becomes max_time and GenerationStop ends it on cancel.
+    Returns (kwargs, stop)."""
+    stop = GenerationStop(data.get('request_id'))
+    limits = {"stopping_criteria": [stop]}
+    remaining = generation_time_left(data)
+    if remaining is not None:
+        limits["max_time"] = max(MIN_GENERATION_TIME, remaining)
+    return limits, stop
+
+def generation_time_left(data):
+    """Seconds of the deadline's generation share not yet spent since the
+    request arrived, or None without a deadline"""
+    deadline_ms = data.get('deadline_ms')
+    if not isinstance(deadline_ms, (int, float)) or deadline_ms <= 0:
+        return None
+    spent = time.perf_counter() - data.get('_received', time.perf_counter())
+    return deadline_ms / 1000 * GENERATION_DEADLINE_SHARE - spent
+
+def deadline_response(data):
+    """An error response if the deadline ran out before generation could start,
+    e.g. while a lazily loaded model was loading; None otherwise"""
+    remaining = generation_time_left(data)
+    if remaining is None or remaining >= MIN_GENERATION_TIME:
+        return None
+    logger.info(f"[{data.get('request_id')}] Deadline used up before generation started")
+    return {"error": "Deadline exceeded before generation started",
+            "deadline_exceeded": True}, 504
+
+def cancelled_response(data):
+    logger.info(f"[{data.get('request_id')}] Stopped, cancelled by the editor")
+    return {"error": "Request cancelled", "cancelled": True}, 499
+
+def fuzzy_search(query, choices, limit=10, score_cutoff=None):
     """Perform fuzzy search using rapidfuzz"""
-    results = process.extract(query, choices, scorer=fuzz.ratio, limit=limit)
+    results = process.extract(query, choices, scorer=fuzz.ratio, limit=limit, score_cutoff=score_cutoff)
     return results
 
 @app.route('/')
@@ -46,58 +191,89 @@ def home():
     return jsonify({
         "message": "API is running",
         "version": "1.0.0",
-        "model_loaded": model is not None,
-        "endpoints": ["/api/search", "/api/summarise"]
+        "model_loaded": registry.is_loaded("summarizer"),
+        "endpoints": ["/api/search", "/api/summarise", "/api/batch", "/api/cancel"]
     })
 
+PORT = 5000
+
+# Editors attached to this backend; only consulted in daemon mode
+DAEMON_MODE = '--daemon' in sys.argv
+clients = daemon.ClientRegistry()
+
+@app.before_request
+def track_client():
+    clients.touch(request.headers.get('X-Texdit-Client'))
+    g.request_id = request.headers.get('X-Request-ID')
+    g.request_start = time.perf_counter()
+
+@app.after_request
+def tag_request(response):
+    # Lets editors see how busy a shared backend is without polling /health
+    if request.path.startswith('/api/'):
+        load = scheduler.stats()
+        response.headers['X-Texdit-Load'] = json.dumps(
+            {key: load[key] for key in ('queued', 'running', 'workers', 'max_batch_size')}, separators=(',', ':'))
+
+    # Echo the editor's request ID so its trace and this log line can be matched
+    request_id = g.get('request_id')
+    if request_id:
+        response.headers['X-Request-ID'] = request_id
+        elapsed_ms = (time.perf_counter() - g.request_start) * 1000
+        logger.info(f"[{request_id}] {request.path} -> {response.status_code} in {elapsed_ms:.1f} ms")
+    return response
+
 @app.route('/health')
 def health():
-    """Health check endpoint for monitoring"""
+    """Health check endpoint for monitoring. The server is ready as soon as it
+    answers; "commands" tells the editor which commands' models can be used."""
     return jsonify({
+        "daemon": DAEMON_MODE,
+        "clients": clients.count(),
         "status": "ok",
         "message": "Server is healthy",
-        "model_loaded": model is not None
+        "model_loaded": registry.is_loaded("summarizer"),
+        "ready": True,
+        "models": registry.status(),
+        "commands": registry.command_status(),
+        "engine": engine,
+        "load": scheduler.stats()
     })
 
-@app.route('/api/search', methods=['POST'])
-def search():
+def handle_search(data):
     """Fuzzy search endpoint"""
     try:
-        data = request.get_json()
-
         # Validate input     
         if not data or 'query' not in data or 'choices' not in data:
-            return jsonify({
+            return {
                 "error": "Missing required fields: 'query' and 'choices'"
-            }), 400
+            }, 400
         
         query = data['query']
         choices = data['choices']
         limit = data.get('limit', 10)
+        score_cutoff = data.get('score_cutoff')
         
         # Perform fuzzy search
-        results = fuzzy_search(query, choices, limit)
+        results = fuzzy_search(query, choices, limit, score_cutoff)
         
         # Return Results
-        return jsonify({
+        return {
             "results":[x[0] for x in results]
-        })
+        }, 200
     
     except Exception as e:
         logger.error(f"Error occurred in /api/search: {str(e)}")
-        return jsonify({"error": str(e)}), 500
+        return {"error": str(e)}, 500
 
-@app.route('/api/summarise', methods=["POST"])
-def summarise():
+def handle_summarise(data):
     """Summarise endpoint"""
     try:
-        data = request.get_json()
-
         # Validate input
         if not data or 'text' not in data:
-            return jsonify({
+            return {
                 "error": "Missing required field: 'text'"
-            }), 400
+            }, 400
         
         text = data['text'].strip()
         ratio = data.get('ratio', 0.25) # Default length of summarise is 25% of original text length
@@ -106,9 +282,9 @@ def summarise():
         
         # Validate ratio
         if not isinstance(ratio, (int, float)) or ratio <= 0 or ratio > 1:
-            return jsonify({
+            return {
                 "error": "Ratio must be a number between 0 and 1"
-            }), 400
+            }, 400
         
         # Validate min/max ratios
         if not isinstance(min_ratio, (int, float)) or min_ratio <= 0 or min_ratio > 1:
@@ -119,19 +295,22 @@ def summarise():
         
         # Validate text length
         if not text:
-            return jsonify({
+            return {
                 "error": "Text cannot be empty"
-            }), 400
+            }, 400
         
         if len(text.split()) < 10:
-            return jsonify({
+            return {
                 "error": "Text must be at least 10 words long for meaningful summarization"
-            }), 400
+            }, 400
         
         if len(text) > 10000:  # Limit to prevent memory issues
-            return jsonify({
+            return {
                 "error": "Text too long. Maximum 10,000 characters allowed."
-            }), 400
+            }, 400
+        
+        if is_cancelled(data.get('request_id')):
+            return cancelled_response(data)
 
         # Calculate target summary length based on ratios
         original_word_count = len(text.split())
@@ -152,92 +331,190 @@ def summarise():
                    f"range={min_length}-{max_length} words "
                    f"({min_ratio:.1%}-{max_ratio:.1%})")
 
-        # Start timing for performance monitoring
-        start_time = time.time()
+        # Loads DistilBART if this is the first command to need it
+        try:
+            summarizer = registry.acquire("summarizer")
+        except models.ModelUnavailable as e:
+            return model_unavailable(e)
+        streaming = False
+        try:
+            # Start timing for performance monitoring
+            start_time = time.time()
 
-        # BART doesn't need task prefix like T5 - just use the text directly
-        inputs = tokenizer(text, return_tensors="pt", max_length=1024, truncation=True, padding=True)
-        
-        tokenization_time = time.time()
-        
-        # Generate summary with BART-optimized parameters (faster settings for better responsiveness)
-        summary_ids = model.generate(
-            inputs["input_ids"],
-            attention_mask=inputs["attention_mask"],  # Important for BART
-            max_length=max_length, 
-            min_length=min_length, 
-            length_penalty=1.5,       # Slightly reduced for faster generation
-            num_beams=2,              # Reduced from 4 to 2 for faster inference
-            early_stopping=True,      # Stop when EOS is reached
-            no_repeat_ngram_size=3,   # Prevent repetition
-            do_sample=False,          # Deterministic generation
-            forced_bos_token_id=tokenizer.bos_token_id  # Ensure proper start token
-        )
+            # BART doesn't need task prefix like T5 - just use the text directly
+            inputs = encode(data, summarizer.tokenizer, text, 1024)
+        
+            tokenization_time = time.time()
+        
+            # Generate summary with BART-optimized parameters (faster settings for better responsiveness)
+            generation_kwargs = dict(
+                input_ids=inputs["input_ids"],
+                attention_mask=inputs["attention_mask"],  # Important for BART
+                max_length=max_length, 
+                min_length=min_length, 
+                length_penalty=1.5,       # Slightly reduced for faster generation
+                num_beams=2,              # Reduced from 4 to 2 for faster inference
+                early_stopping=True,      # Stop when EOS is reached
+                no_repeat_ngram_size=3,   # Prevent repetition
+                do_sample=False,          # Deterministic generation
+                forced_bos_token_id=summarizer.tokenizer.bos_token_id  # Ensure proper start token
+            )
+            # acquire() may have spent the deadline loading the model
+            expired = deadline_response(data)
+            if expired:
+                return expired
+            limits, stop = generation_limits(data)
+            generation_kwargs.update(limits)
 
-        generation_time = time.time()
-        summary = tokenizer.decode(summary_ids[0], skip_special_tokens=True)
-        
-        # Clean up any remaining artifacts
-        summary = summary.strip()
-        
-        # Additional cleanup for malformed output
-        if summary.endswith(('..', '...', '....', 'and..', 'a.', 'the.', "it '", "'the.")):
-            # Find the last complete sentence
-            sentences = summary.split('.')
-            if len(sentences) > 1:
-                # Keep all complete sentences except the last incomplete one
-                summary = '.'.join(sentences[:-1]) + '.'
-        
-        # Ensure summary is not empty after cleanup
-        if not summary.strip():
-            summary = "Summary could not be generated properly. Please try again with different text."
+            if data.get('stream', False):
+                stream = stream_summary(summarizer, text, generation_kwargs, stop, start_time, tokenization_time)
+                streaming = True # Released when the streamed generation ends
+                return stream
+
+            summary_ids = scheduler.generate(**generation_kwargs)
+            if stop.triggered:
+                return cancelled_response(data)
+
+            generation_time = time.time()
+            summary = clean_summary(summarizer.tokenizer.decode(summary_ids[0], skip_special_tokens=True))
+            end_time = time.time()
+        
+            return summary_response(text, summary, start_time, tokenization_time, generation_time, end_time), 200
+        finally:
+            if not streaming:
+                registry.release("summarizer")
+    except Exception as e:
+        logger.error(f"Error occurred in /api/summarise: {str(e)}")
+        return {"error": str(e)}, 500
+
+def clean_summary(summary):
+    """Strip generation artifacts from a decoded summary"""
+    # Clean up any remaining artifacts
+    summary = summary.strip()
+    
+    # Additional cleanup for malformed output
+    if summary.endswith(('..', '...', '....', 'and..', 'a.', 'the.', "it '", "'the.")):
+        # Find the last complete sentence
+        sentences = summary.split('.')
+        if len(sentences) > 1:
+            # Keep all complete sentences except the last incomplete one
+            summary = '.'.join(sentences[:-1]) + '.'
+    
+    # Ensure summary is not empty after cleanup
+    if not summary.strip():
+        summary = "Summary could not be generated properly. Please try again with different text."
+    
+    return summary
+
+def summary_response(text, summary, start_time, tokenization_time, generation_time, end_time, extra_performance=None):
+    """Build the /api/summarise response body, including timing metrics"""
+    # Calculate timing metrics
+    total_time = end_time - start_time
+    tokenization_duration = tokenization_time - start_time
+    generation_duration = generation_time - tokenization_time
+    decoding_duration = end_time - generation_time
+    
+    logger.info(f"Performance metrics: Total={total_time:.2f}s, "
+               f"Tokenization={tokenization_duration:.2f}s, "
+               f"Generation={generation_duration:.2f}s, "
+               f"Decoding={decoding_duration:.2f}s")
+    
+    performance = {
+        "total_time": round(total_time, 2),
+        "tokenization_time": round(tokenization_duration, 2),
+        "generation_time": round(generation_duration, 2),
+        "decoding_time": round(decoding_duration, 2),
+        "engine": engines.LABELS[engine]
+    }
+    if extra_performance:
+        performance.update(extra_performance)
+    
+    return {
+        "summary": summary,
+        "original_length": len(text.split()),
+        "summary_length": len(summary.split()),
+        "compression_ratio": round(len(summary.split()) / len(text.split()), 3),
+        "performance": performance
+    }
+
+def stream_summary(summarizer, text, generation_kwargs, stop, start_time, tokenization_time):
+    """Stream a summary as events: one {"type": "chunk"} event per decoded piece,
+    then a final {"type": "done"} event carrying the regular response body.
+    Returns a generator; the transport decides how events are framed. Closing
+    it early (the client disconnected) stops the generation. The summarizer
+    is released once the generation ends."""
+    streamer = summarizer.streamer_class(summarizer.tokenizer, skip_prompt=True, skip_special_tokens=True)
+    
+    # Streamers can't follow several beams, so streamed summaries use greedy
+    # decoding. The editor only streams when asked to and doesn't cache them.
+    generation_kwargs = dict(generation_kwargs, streamer=streamer, num_beams=1, early_stopping=False)
+    
+    generation_errors = []
+    def run_generation():
+        try:
+            summarizer.model.generate(**generation_kwargs)
+        except Exception as e:
+            generation_errors.append(e)
+            streamer.end()
+        finally:
+            registry.release("summarizer")
+    
+    worker = Thread(target=run_generation, daemon=True)
+    worker.start()
+    
+    def generate():
+        pieces = []
+        first_chunk_time = None
+        try:
+            for piece in streamer:
+                if not piece:
+                    continue
+                if first_chunk_time is None:
+                    first_chunk_time = time.time()
+                pieces.append(piece)
+                yield {"type": "chunk", "text": piece}
+        except GeneratorExit:
+            stop.abandoned.set()
+            raise
+        
+        worker.join()
+        if stop.triggered:
+            yield {"type": "error", "error": "Request cancelled"}
+            return
+        if generation_errors:
+            logger.error(f"Error occurred while streaming /api/summarise: {generation_errors[0]}")
+            yield {"type": "error", "error": str(generation_errors[0])}
+            return
         
+        generation_time = time.time()
+        summary = clean_summary("".join(pieces))
         end_time = time.time()
         
-        # Calculate timing metrics
-        total_time = end_time - start_time
-        tokenization_duration = tokenization_time - start_time
-        generation_duration = generation_time - tokenization_time
-        decoding_duration = end_time - generation_time
-        
-        logger.info(f"Performance metrics: Total={total_time:.2f}s, "
-                   f"Tokenization={tokenization_duration:.2f}s, "
-                   f"Generation={generation_duration:.2f}s, "
-                   f"Decoding={decoding_duration:.2f}s")
-        
-        return jsonify({
-            "summary": summary,
-            "original_length": len(text.split()),
-            "summary_length": len(summary.split()),
-            "compression_ratio": round(len(summary.split()) / len(text.split()), 3),
-            "performance": {
-                "total_time": round(total_time, 2),
-                "tokenization_time": round(tokenization_duration, 2),
-                "generation_time": round(generation_duration, 2),
-                "decoding_time": round(decoding_duration, 2)
-            }
-        })
-    except Exception as e:
-        logger.error(f"Error occurred in /api/summarise: {str(e)}")
-        return jsonify({"error": str(e)}), 500
+        extra = {"streamed": True}
+        if first_chunk_time is not None:
+            extra["time_to_first_chunk"] = round(first_chunk_time - start_time, 2)
+        
+        body = summary_response(text, summary, start_time, tokenization_time, generation_time, end_time, extra)
+        body["type"] = "done"
+        yield body
+    
+    return generate()
 
-@app.route('/api/keywords', methods=["POST"])
-def keywords():
+def handle_keywords(data):
     """Extract keywords endpoint"""
     try:
-        data = request.get_json()
         
         if not data or 'text' not in data:
-            return jsonify({
+            return {
                 "error": "Missing required field: 'text'"
-            }), 400
+            }, 400
         
         text = data['text'].strip()
         
         if not text:
-            return jsonify({
+            return {
                 "error": "Text cannot be empty"
-            }), 400
+            }, 400
         
         # Simple keyword extraction (you can enhance this with NLP libraries)
         words = text.lower().split()
@@ -253,31 +530,29 @@ def keywords():
         # Sort by frequency and get top keywords
         top_keywords = sorted(keyword_freq.items(), key=lambda x: x[1], reverse=True)[:10]
         
-        return jsonify({
+        return {
             "keywords": [kw[0] for kw in top_keywords],
             "keyword_frequencies": dict(top_keywords)
-        })
+        }, 200
     except Exception as e:
         logger.error(f"Error occurred in /api/keywords: {str(e)}")
-        return jsonify({"error": str(e)}), 500
+        return {"error": str(e)}, 500
 
-@app.route('/api/tone', methods=["POST"])
-def tone():
+def handle_tone(data):
     """Analyze tone endpoint"""
     try:
-        data = request.get_json()
         
         if not data or 'text' not in data:
-            return jsonify({
+            return {
                 "error": "Missing required field: 'text'"
-            }), 400
+            }, 400
         
         text = data['text'].strip()
         
         if not text:
-            return jsonify({
+            return {
                 "error": "Text cannot be empty"
-            }), 400
+            }, 400
         
         # Simple tone analysis (you can enhance this with sentiment analysis libraries)
         text_lower = text.lower()
@@ -304,7 +579,7 @@ def tone():
         else:
             formality = "informal"
         
-        return jsonify({
+        return {
             "tone": tone,
             "formality": formality,
             "analysis": {
@@ -312,57 +587,214 @@ def tone():
                 "negative_indicators": negative_count,
                 "formal_indicators": formal_count
             }
-        })
+        }, 200
     except Exception as e:
         logger.error(f"Error occurred in /api/tone: {str(e)}")
-        return jsonify({"error": str(e)}), 500
+        return {"error": str(e)}, 500
 
-@app.route('/api/rephrase', methods=["POST"])
-def rephrase():
+def handle_rephrase(data):
     """Rephrase text endpoint"""
     try:
-        data = request.get_json()
         
         if not data or 'text' not in data:
-            return jsonify({
+            return {
                 "error": "Missing required field: 'text'"
-            }), 400
+            }, 400
         
         text = data['text'].strip()
         
         if not text:
-            return jsonify({
+            return {
                 "error": "Text cannot be empty"
-            }), 400
-        
-        # Use DistilBART model for paraphrasing
-        # DistilBART doesn't need a task prefix like T5
-        inputs = tokenizer(text, return_tensors="pt", max_length=512, truncation=True, padding=True)
-        
-        # Generate attention mask for BART
-        attention_mask = inputs.get('attention_mask', None)
-        
-        outputs = model.generate(
-            inputs["input_ids"],
-            attention_mask=attention_mask,
-            max_length=len(text.split()) + 50,  # Allow some expansion
-            min_length=max(5, len(text.split()) - 10),  # Don't make it too short
-            length_penalty=2.0, 
-            num_beams=4, 
-            early_stopping=True,
-            do_sample=True,
-            temperature=0.8
-        )
-        
-        rephrased = tokenizer.decode(outputs[0], skip_special_tokens=True)
-        
-        return jsonify({
-            "original": text,
-            "rephrased": rephrased
-        })
+            }, 400
+        
+        try:
+            summarizer = registry.acquire("summarizer")
+        except models.ModelUnavailable as e:
+            return model_unavailable(e)
+        try:
+            # Use DistilBART model for paraphrasing
+            # DistilBART doesn't need a task prefix like T5
+            inputs = encode(data, summarizer.tokenizer, text, 512)
+        
+            # Generate attention mask for BART
+            attention_mask = inputs.get('attention_mask', None)
+        
+            if is_cancelled(data.get('request_id')):
+                return cancelled_response(data)
+            expired = deadline_response(data)
+            if expired:
+                return expired
+            limits, stop = generation_limits(data)
+        
+            outputs = scheduler.generate(
+                input_ids=inputs["input_ids"],
+                attention_mask=attention_mask,
+                max_length=len(text.split()) + 50,  # Allow some expansion
+                min_length=max(5, len(text.split()) - 10),  # Don't make it too short
+                length_penalty=2.0, 
+                num_beams=4, 
+                early_stopping=True,
+                do_sample=True,
+                temperature=0.8,
+                **limits
+            )
+            if stop.triggered:
+                return cancelled_response(data)
+        
+            rephrased = summarizer.tokenizer.decode(outputs[0], skip_special_tokens=True)
+        
+            return {
+                "original": text,
+                "rephrased": rephrased
+            }, 200
+        finally:
+            registry.release("summarizer")
     except Exception as e:
         logger.error(f"Error occurred in /api/rephrase: {str(e)}")
-        return jsonify({"error": str(e)}), 500
+        return {"error": str(e)}, 500
+
+def handle_batch(data):
+    """Run several commands on one text. The text arrives (and is tokenised)
+    once; each entry of "requests" names an endpoint and its arguments and is
+    answered by that endpoint's handler, in order. An entry may carry its own
+    "text", which it is run on instead."""
+    if not data or 'text' not in data or not isinstance(data.get('requests'), list):
+        return {
+            "error": "Missing required fields: 'text' and 'requests'"
+        }, 400
+    
+    encodings = {} # Shared by the handlers, see encode()
+    # The deadline covers the whole batch, so later parts get what is left of it
+    shared = {key: data[key] for key in ('request_id', 'deadline_ms', '_received') if key in data}
+    results = []
+    for item in data['requests']:
+        endpoint = item.get('endpoint') if isinstance(item, dict) else None
+        handler = BATCHABLE_ENDPOINTS.get(endpoint)
+        if handler is None:
+            results.append({"status": 404, "body": {"error": f"Unknown endpoint: {endpoint}"}})
+            continue
+        
+        args = item.get('args')
+        request_data = client_fields(args if isinstance(args, dict) else {})
+        # Replayed commands may have run on another version of the text
+        text = item.get('text', data['text'])
+        request_data.update(shared, text=text, stream=False, _encodings=encodings)
+        body, status = handler(request_data)
+        results.append({"status": status, "body": body})
+    
+    logger.info(f"Batch of {len(results)} requests: " + ", ".join(str(r["status"]) for r in results))
+    return {"results": results}, 200
+
+def handle_cancel(data):
+    """Stop work on a request the editor no longer waits for. Generations
+    running for it end at their next decoding step, and it is turned away
+    if it has not started yet."""
+    request_id = (data or {}).get('request_id')
+    if not request_id:
+        return {"error": "Missing required field: 'request_id'"}, 400
+    
+    cancel_request(request_id)
+    logger.info(f"[{request_id}] Cancel requested")
+    return {"cancelled": request_id}, 200
+
+# Commands that can be part of a /api/batch request
+BATCHABLE_ENDPOINTS = {
+    '/api/summarise': handle_summarise,
+    '/api/keywords': handle_keywords,
+    '/api/tone': handle_tone,
+    '/api/rephrase': handle_rephrase,
+}
+
+# Handlers take the decoded request body and return either (body, status) or,
+# for streamed replies, a generator of event dicts. The HTTP routes and the
+# IPC listener both dispatch through this table.
+ENDPOINTS = {
+    '/api/search': handle_search,
+    '/api/summarise': handle_summarise,
+    '/api/keywords': handle_keywords,
+    '/api/tone': handle_tone,
+    '/api/rephrase': handle_rephrase,
+    '/api/batch': handle_batch,
+    '/api/cancel': handle_cancel,
+}
+
+def http_response(result):
+    """Turn a handler result into a Flask response"""
+    if isinstance(result, types.GeneratorType):
+        lines = (json.dumps(event) + "\n" for event in result)
+        return Response(stream_with_context(lines), mimetype="application/x-ndjson")
+    body, status = result
+    return jsonify(body), status
+
+def client_fields(data):
+    """The request body without "_" keys, which only the server sets (such as
+    _encodings and _received)"""
+    return {key: value for key, value in data.items() if not str(key).startswith('_')}
+
+@app.route('/api/<name>', methods=["POST"])
+def api(name):
+    """Dispatch /api/* requests to their handlers"""
+    handler = ENDPOINTS.get('/api/' + name)
+    if handler is None:
+        return jsonify({"error": f"Unknown endpoint: /api/{name}"}), 404
+    data = request.get_json(silent=True)
+    if isinstance(data, dict):
+        data = client_fields(data)
+        # Handlers find the request ID in the body, whichever transport brought it
+        if g.request_id:
+            data.setdefault('request_id', g.request_id)
+        data['_received'] = g.request_start
+    return http_response(handler(data))
+
+def shutdown_daemon(lock_path, ipc_path):
+    """Leave no lockfile or socket behind, so the next editor starts a fresh backend"""
+    daemon.release_lock(lock_path)
+    if ipc_path:
+        try:
+            os.unlink(ipc_path)
+        except OSError:
+            pass
+    logging.shutdown()
+    os._exit(0)
 
 if __name__ == '__main__':
-    app.run(debug=False, host='0.0.0.0', port=5000, use_reloader=False)
\ No newline at end of file
+    # The editor passes a socket path when it wants the binary IPC transport
+    ipc_path = os.environ.get('TEXDIT_IPC_SOCKET')
+    
+    if DAEMON_MODE:
+        # A daemon outlives the editor that started it and exits after
+        # TEXDIT_IDLE_TIMEOUT seconds without clients
+        lock_path = os.environ.get('TEXDIT_LOCKFILE') or os.path.join(os.path.dirname(__file__), "texdit-backend.lock")
+        if not daemon.acquire_lock(lock_path, PORT, ipc_path):
+            report_status("failed", 0.0, "Another backend daemon is already running")
+            sys.exit(0)
+        
+        import atexit
+        import signal
+        atexit.register(daemon.release_lock, lock_path)
+        signal.signal(signal.SIGTERM, lambda *_: shutdown_daemon(lock_path, ipc_path))
+        
+        idle_timeout = float(os.environ.get('TEXDIT_IDLE_TIMEOUT', 600))
+        daemon.start_idle_watch(clients, idle_timeout, lambda: shutdown_daemon(lock_path, ipc_path))
+        logger.info(f"Running as shared daemon (lockfile {lock_path}, idle timeout {idle_timeout:.0f}s)")
+    
+    if ipc_path:
+        if ipc_server.start(ipc_path, ENDPOINTS, clients):
+            logger.info(f"IPC transport listening on {ipc_path}")
+        else:
+            logger.info("IPC transport unavailable, serving HTTP only")
+    
+    # HTTP/1.1 keeps client connections alive between requests (the default
+    # HTTP/1.0 closes the socket after every reply) and lets streamed
+    # responses use chunked transfer encoding
+    WSGIRequestHandler.protocol_version = "HTTP/1.1"
+    
+    # make_server() binds the port before returning, so the editor's first
+    # /health probe after "ready" finds it listening instead of counting a
+    # failed connection. Nothing is loaded first: models are loaded by the
+    # first command that needs them.
+    http_server = make_server('0.0.0.0', PORT, app, threaded=True, request_handler=WSGIRequestHandler)
+    report_status("serving", 0.0, "Server listening...")
+    report_status("ready", 1.0, "Server ready, models load on first use")
+    http_server.serve_forever()
\ No newline at end of file
@@ -1,14 +1,17 @@
 """
 Single LLM Test Server
-Test implementation of TexDit with a single large language model
+Test implementation of TexDit with a single large language model.
+The model is loaded by the first request, not at startup; models switched
+away from stay loaded until the memory budget evicts them (see models.py).
 """
 
 from flask import Flask, jsonify, request
 from flask_cors import CORS
-from transformers import AutoTokenizer, AutoModelForSeq2SeqLM
 import time
 import logging
 
+import models
+
 # Set up logging
 logging.basicConfig(level=logging.INFO)
 logger = logging.getLogger(__name__)
@@ -16,49 +19,55 @@ logger = logging.getLogger(__name__)
 app = Flask(__name__)
 CORS(app)
 
-# Global variables for model
-tokenizer = None
-model = None
 model_name = "google/flan-t5-large"  # Test larger model for realistic comparison
 
-def load_single_llm():
-    """Load the single LLM for all tasks"""
-    global tokenizer, model
-    
-    logger.info(f"Loading single LLM: {model_name}")
-    start_time = time.time()
-    
-    try:
-        tokenizer = AutoTokenizer.from_pretrained(model_name)
-        model = AutoModelForSeq2SeqLM.from_pretrained(model_name)
+# List of supported models for testing
+supported_models = [
+    "google/flan-t5-base",
+    "google/flan-t5-large",
+    "google/flan-t5-small"
+]
+
+COMMANDS = ("summarise", "keywords", "tone", "rephrase")
+
+def single_llm_loader(name):
+    def load_single_llm():
+        """Load the single LLM for all tasks"""
+        from transformers import AutoTokenizer
+        import engines
+        
+        logger.info(f"Loading single LLM: {name}")
+        start_time = time.time()
+        tokenizer = AutoTokenizer.from_pretrained(name)
+        model = engines.load_pretrained(name)
+        model.eval()
         
         load_time = time.time() - start_time
         logger.info(f"✅ Single LLM loaded successfully in {load_time:.2f} seconds")
-        return True
-        
-    except Exception as e:
-        logger.error(f"❌ Failed to load single LLM: {e}")
-        return False
+        return (tokenizer, model), engines.memory_footprint(model)
+    return load_single_llm
+
+registry = models.ModelRegistry()
+for name in supported_models:
+    registry.register(name, name, COMMANDS, single_llm_loader(name))
 
 def generate_with_llm(prompt, max_length=200, min_length=10):
-    """Generate response using the single LLM"""
-    if not model or not tokenizer:
-        raise Exception("Model not loaded")
-    
-    inputs = tokenizer(prompt, return_tensors="pt", max_length=1024, truncation=True, padding=True)
-    
-    outputs = model.generate(
-        inputs["input_ids"],
-        attention_mask=inputs.get("attention_mask"),
-        max_length=max_length,
-        min_length=min_length,
-        num_beams=2,
-        early_stopping=True,
-        no_repeat_ngram_size=2,
-        pad_token_id=tokenizer.eos_token_id
-    )
-    
-    response = tokenizer.decode(outputs[0], skip_special_tokens=True)
+    """Generate response using the single LLM, loading it on first use"""
+    with registry.in_use(model_name) as (tokenizer, model):
+        inputs = tokenizer(prompt, return_tensors="pt", max_length=1024, truncation=True, padding=True)
+        
+        outputs = model.generate(
+            inputs["input_ids"],
+            attention_mask=inputs.get("attention_mask"),
+            max_length=max_length,
+            min_length=min_length,
+            num_beams=2,
+            early_stopping=True,
+            no_repeat_ngram_size=2,
+            pad_token_id=tokenizer.eos_token_id
+        )
+        
+        response = tokenizer.decode(outputs[0], skip_special_tokens=True)
     return response.strip()
 
 @app.route('/health')
@@ -67,8 +76,9 @@ def health():
     return jsonify({
         "status": "ok",
         "message": "Single LLM server is healthy",
-        "model_loaded": model is not None,
-        "model_name": model_name
+        "model_loaded": registry.is_loaded(model_name),
+        "model_name": model_name,
+        "models": registry.status()
     })
 
 @app.route('/api/summarise', methods=['POST'])
@@ -272,7 +282,7 @@ Rewritten:"""
 @app.route('/api/switch_model', methods=['POST'])
 def switch_model():
     """Switch to a different LLM for testing"""
-    global model_name, tokenizer, model
+    global model_name
     
     try:
         data = request.get_json()
@@ -282,42 +292,29 @@ def switch_model():
         
         new_model_name = data['model_name']
         
-        # List of supported models for testing
-        supported_models = [
-            "google/flan-t5-base",
-            "google/flan-t5-large",
-            "google/flan-t5-small"
-        ]
-        
         if new_model_name not in supported_models:
             return jsonify({
                 "error": f"Model not supported. Supported models: {supported_models}"
             }), 400
         
-        # Clear current model
-        model = None
-        tokenizer = None
-        model_name = new_model_name
-        
-        # Load new model
-        success = load_single_llm()
-        
-        if success:
-            return jsonify({
-                "message": f"Successfully switched to {model_name}",
-                "model_name": model_name
-            })
-        else:
+        # Load new model now; the previous one stays loaded while it fits the budget
+        try:
+            with registry.in_use(new_model_name):
+                pass
+        except models.ModelUnavailable:
             return jsonify({"error": "Failed to load new model"}), 500
+        
+        model_name = new_model_name
+        return jsonify({
+            "message": f"Successfully switched to {model_name}",
+            "model_name": model_name
+        })
             
     except Exception as e:
         logger.error(f"Error switching model: {str(e)}")
         return jsonify({"error": str(e)}), 500
 
 if __name__ == '__main__':
-    # Load the model at startup
-    if load_single_llm():
-        logger.info("🚀 Starting Single LLM Test Server...")
-        app.run(debug=False, host='0.0.0.0', port=5001, use_reloader=False)
-    else:
-        logger.error("❌ Failed to start server - model loading failed")
+    # Serve right away; the model is loaded by the first request that needs it
+    logger.info("🚀 Starting Single LLM Test Server...")
+    app.run(debug=False, host='0.0.0.0', port=5001, use_reloader=False)
@@ -0,0 +1,87 @@
+#include "backenddaemon.h"
+#include <QCoreApplication>
+#include <QStandardPaths>
+#include <QDir>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QDebug>
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#else
+#include <signal.h>
+#include <errno.h>
+#endif
+
+const int BackendDaemon::DEFAULT_IDLE_TIMEOUT = 600; // 10 minutes
+
+QString BackendDaemon::runtimeDirectory()
+{
+    QString dir = QStandardPaths::writableLocation(QStandardPaths::RuntimeLocation);
+    if (dir.isEmpty()) {
+        dir = QDir::tempPath();
+    }
+    return dir;
+}
+
+QString BackendDaemon::lockFilePath()
+{
+    return runtimeDirectory() + "/texdit-backend.lock";
+}
+
+QString BackendDaemon::socketPath()
+{
+    return runtimeDirectory() + "/texdit-backend.sock";
+}
+
+QString BackendDaemon::logFilePath()
+{
+    return runtimeDirectory() + "/texdit-backend.log";
+}
+
+QString BackendDaemon::clientId()
+{
+    return QString("texdit-%1").arg(QCoreApplication::applicationPid());
+}
+
+bool BackendDaemon::readLock(Lock& lock)
+{
+    QFile file(lockFilePath());
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QJsonObject info = QJsonDocument::fromJson(file.readAll()).object();
+    lock.pid = qint64(info.value("pid").toDouble());
+    lock.port = info.value("port").toInt();
+    lock.ipcSocket = info.value("ipc_socket").toString();
+
+    if (!isProcessAlive(lock.pid)) {
+        // The daemon removes its lockfile on exit; this one was left by a crash
+        qDebug() << "BackendDaemon: Ignoring stale lockfile for pid" << lock.pid;
+        return false;
+    }
+    return true;
+}
+
+bool BackendDaemon::isProcessAlive(qint64 pid)
+{
+    if (pid <= 0) {
+        return false;
+    }
+
+#ifdef Q_OS_WIN
+    HANDLE process = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, DWORD(pid));
+    if (!process) {
+        return false;
+    }
+    DWORD exitCode = 0;
+    bool alive = GetExitCodeProcess(process, &exitCode) && exitCode == STILL_ACTIVE;
+    CloseHandle(process);
+    return alive;
+#else
+    // Signal 0 only checks that the process exists
+    return ::kill(pid_t(pid), 0) == 0 || errno == EPERM;
+#endif
+}
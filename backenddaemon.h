@@ -0,0 +1,32 @@
+#ifndef BACKENDDAEMON_H
+#define BACKENDDAEMON_H
+
+#include <QString>
+
+// Discovery of the shared backend daemon. A daemon advertises itself with a
+// lockfile in the user's runtime directory; editors that find a live one use
+// it instead of launching their own backend. Each editor process identifies
+// itself with clientId() so the daemon can count who is still attached.
+class BackendDaemon
+{
+public:
+    struct Lock {
+        qint64 pid = 0;
+        int port = 0;
+        QString ipcSocket; // Empty when the daemon only serves HTTP
+    };
+
+    static QString runtimeDirectory();
+    static QString lockFilePath();
+    static QString socketPath();
+    static QString logFilePath();
+    static QString clientId();
+
+    // True if the lockfile exists and the process holding it is still running
+    static bool readLock(Lock& lock);
+    static bool isProcessAlive(qint64 pid);
+
+    static const int DEFAULT_IDLE_TIMEOUT; // Seconds the daemon lingers after the last editor exits
+};
+
+#endif // BACKENDDAEMON_H
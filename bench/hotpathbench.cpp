@@ -0,0 +1,388 @@
+// Microbenchmarks for the interactive hot paths: suggestions and command
+// validation run on every keystroke, response formatting on every result,
+// token counting whenever typing pauses.
+//
+// Each path has a timing benchmark (QBENCHMARK) and an *Allocations twin over
+// the same data that reports heap allocations per call as the result, e.g.
+//   texdit_microbench formatServerResponseAllocations
+//   texdit_microbench -o results.csv,csv
+//
+// On glibc malloc/calloc/realloc are interposed, so Qt's string and container
+// storage is counted; elsewhere only operator new is, which misses most of it.
+
+#include "commandmanager.h"
+#include "servermanager.h"
+#include "commandRegistry.h"
+
+#include <QtTest>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QLoggingCategory>
+#include <cstdlib>
+#include <new>
+
+namespace {
+thread_local quint64 threadAllocations = 0;
+
+quint64 allocationCount()
+{
+    return threadAllocations;
+}
+}
+
+#if defined(__GLIBC__) && !defined(__SANITIZE_ADDRESS__)
+extern "C" {
+void* __libc_malloc(std::size_t size);
+void* __libc_calloc(std::size_t count, std::size_t size);
+void* __libc_realloc(void* pointer, std::size_t size);
+
+void* malloc(std::size_t size) noexcept
+{
+    ++threadAllocations;
+    return __libc_malloc(size);
+}
+
+void* calloc(std::size_t count, std::size_t size) noexcept
+{
+    ++threadAllocations;
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* pointer, std::size_t size) noexcept
+{
+    ++threadAllocations;
+    return __libc_realloc(pointer, size);
+}
+}
+#else
+void* operator new(std::size_t size)
+{
+    ++threadAllocations;
+    if (void* pointer = std::malloc(size ? size : 1)) {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t) noexcept
+{
+    std::free(pointer);
+}
+#endif
+
+class HotPathBenchmark : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void contextualSuggestions_data();
+    void contextualSuggestions();
+    void contextualSuggestionsAllocations_data() { contextualSuggestions_data(); }
+    void contextualSuggestionsAllocations();
+
+    void isCommandValid_data();
+    void isCommandValid();
+    void isCommandValidAllocations_data() { isCommandValid_data(); }
+    void isCommandValidAllocations();
+
+    void parseCommandWithArgs_data();
+    void parseCommandWithArgs();
+    void parseCommandWithArgsAllocations_data() { parseCommandWithArgs_data(); }
+    void parseCommandWithArgsAllocations();
+
+    void formatServerResponse_data();
+    void formatServerResponse();
+    void formatServerResponseAllocations_data() { formatServerResponse_data(); }
+    void formatServerResponseAllocations();
+
+    void countTokens_data();
+    void countTokens();
+    void countTokensAllocations_data() { countTokens_data(); }
+    void countTokensAllocations();
+
+private:
+    template <typename Function>
+    static double allocationsPerCall(Function&& function);
+
+    ServerManager* serverManager = nullptr;
+    CommandManager* commandManager = nullptr;
+    qint64 sink = 0; // Keeps results observable so calls are not optimised away
+
+    static const int REGISTRY_SIZE;
+    static const int ALLOCATION_SAMPLES;
+};
+
+const int HotPathBenchmark::REGISTRY_SIZE = 2000; // Commands added on top of the built-in ones
+const int HotPathBenchmark::ALLOCATION_SAMPLES = 100;
+
+template <typename Function>
+double HotPathBenchmark::allocationsPerCall(Function&& function)
+{
+    function(); // Lazily built indexes and static data are not part of the steady state
+
+    quint64 before = allocationCount();
+    for (int i = 0; i < ALLOCATION_SAMPLES; ++i) {
+        function();
+    }
+    return double(allocationCount() - before) / ALLOCATION_SAMPLES;
+}
+
+void HotPathBenchmark::initTestCase()
+{
+    // The parsing paths log every call; measure them, not the console
+    QLoggingCategory::setFilterRules("*.debug=false");
+
+    // A registry the size a plugin ecosystem would produce
+    static const QStringList verbs = {
+        "translate", "expand", "shorten", "simplify", "format", "outline", "classify", "extract",
+        "annotate", "proofread", "rank", "cite", "explain", "critique", "title", "tag"
+    };
+    static const QStringList objects = {
+        "paragraph", "sentence", "document", "section", "heading", "list", "table", "quote",
+        "code", "email", "tweet", "abstract", "letter", "report", "note", "essay"
+    };
+    static const QStringList options = {
+        "formal", "casual", "short", "long", "bullet", "numbered", "english", "french",
+        "german", "spanish", "technical", "plain", "academic", "friendly", "strict", "loose"
+    };
+
+    for (int i = 0; i < REGISTRY_SIZE; ++i) {
+        CommandInfo info;
+        info.name = QString("%1-%2-%3").arg(verbs[i % verbs.size()], objects[(i / verbs.size()) % objects.size()])
+                        .arg(i / (verbs.size() * objects.size()));
+        info.description = QString("Generated command %1").arg(i);
+        for (int j = 0; j < 4 + i % 12; ++j) {
+            info.arguments.append(options[(i + j) % options.size()]);
+        }
+        info.usage = info.name + " <" + info.arguments.join("|") + ">";
+        commandRegistry::registerCommand(info);
+    }
+
+    serverManager = new ServerManager(this);
+    commandManager = new CommandManager(serverManager, this);
+}
+
+void HotPathBenchmark::contextualSuggestions_data()
+{
+    QTest::addColumn<QString>("input");
+
+    QTest::newRow("empty") << QString();
+    QTest::newRow("one letter") << QString("s");
+    QTest::newRow("prefix") << QString("summ");
+    QTest::newRow("crowded prefix") << QString("tra");
+    QTest::newRow("generated command") << QString("explain-table-");
+    QTest::newRow("no match") << QString("zzzz");
+    QTest::newRow("argument") << QString("tone fo");
+    QTest::newRow("generated argument") << QString("classify-code-0 te");
+    QTest::newRow("long input") << QString("rewrite ") + QString("word ").repeated(200);
+}
+
+void HotPathBenchmark::contextualSuggestions()
+{
+    QFETCH(QString, input);
+
+    QBENCHMARK {
+        sink += commandRegistry::getContextualSuggestions(input).size();
+    }
+}
+
+void HotPathBenchmark::contextualSuggestionsAllocations()
+{
+    QFETCH(QString, input);
+
+    QTest::setBenchmarkResult(allocationsPerCall([&]() {
+        sink += commandRegistry::getContextualSuggestions(input).size();
+    }), QTest::Events);
+}
+
+void HotPathBenchmark::isCommandValid_data()
+{
+    QTest::addColumn<QString>("command");
+
+    QTest::newRow("exact") << QString("summarise");
+    QTest::newRow("with argument") << QString("summarise 30");
+    QTest::newRow("mixed case") << QString("Keywords");
+    QTest::newRow("unknown") << QString("summarize-everything");
+    QTest::newRow("long argument list") << QString("rewrite ") + QString("formally and concisely ").repeated(100);
+    QTest::newRow("many numbers") << QString("summarise ") + QString("25 ").repeated(200);
+}
+
+void HotPathBenchmark::isCommandValid()
+{
+    QFETCH(QString, command);
+
+    QBENCHMARK {
+        sink += commandManager->isCommandValid(command);
+    }
+}
+
+void HotPathBenchmark::isCommandValidAllocations()
+{
+    QFETCH(QString, command);
+
+    QTest::setBenchmarkResult(allocationsPerCall([&]() {
+        sink += commandManager->isCommandValid(command);
+    }), QTest::Events);
+}
+
+void HotPathBenchmark::parseCommandWithArgs_data()
+{
+    isCommandValid_data();
+}
+
+void HotPathBenchmark::parseCommandWithArgs()
+{
+    QFETCH(QString, command);
+
+    QBENCHMARK {
+        QString baseCommand;
+        QJsonObject args;
+        sink += commandManager->parseCommandWithArgs(command, baseCommand, args) + args.size();
+    }
+}
+
+void HotPathBenchmark::parseCommandWithArgsAllocations()
+{
+    QFETCH(QString, command);
+
+    QTest::setBenchmarkResult(allocationsPerCall([&]() {
+        QString baseCommand;
+        QJsonObject args;
+        sink += commandManager->parseCommandWithArgs(command, baseCommand, args) + args.size();
+    }), QTest::Events);
+}
+
+void HotPathBenchmark::formatServerResponse_data()
+{
+    QTest::addColumn<QString>("command");
+    QTest::addColumn<QJsonObject>("response");
+
+    const QString sentence = "The committee reviewed the proposal and agreed to fund the second phase. ";
+
+    QJsonObject performance;
+    performance["total_time"] = 2.41;
+    performance["tokenization_time"] = 0.02;
+    performance["generation_time"] = 2.31;
+    performance["decoding_time"] = 0.08;
+
+    QJsonObject summary;
+    summary["summary"] = sentence.repeated(8);
+    summary["original_length"] = 2400;
+    summary["summary_length"] = 96;
+    summary["compression_ratio"] = 0.04;
+    summary["performance"] = performance;
+    QTest::newRow("summary 600 B") << QString("summarise") << summary;
+
+    summary["summary"] = sentence.repeated(110);
+    QTest::newRow("summary 8 KB") << QString("summarise") << summary;
+
+    // Map-reduce run over a long document: every segment time is listed
+    QJsonArray segmentTimes;
+    for (int i = 0; i < 64; ++i) {
+        segmentTimes.append(i % 5 == 0 ? QJsonValue() : QJsonValue(0.4 + i * 0.01));
+    }
+    QJsonObject mapReducePerformance = performance;
+    mapReducePerformance["segment_times"] = segmentTimes;
+    QJsonObject mapReduce;
+    mapReduce["segments"] = 64;
+    mapReduce["reduce_input_words"] = 6200;
+    mapReduce["levels"] = 2;
+    summary["performance"] = mapReducePerformance;
+    summary["map_reduce"] = mapReduce;
+    summary["chunks"] = 64;
+    summary["chunks_reprocessed"] = 3;
+    QTest::newRow("map-reduce summary") << QString("summarise") << summary;
+
+    QJsonArray keywordList;
+    for (int i = 0; i < 200; ++i) {
+        keywordList.append(QString("keyword%1").arg(i));
+    }
+    QJsonObject keywords;
+    keywords["keywords"] = keywordList;
+    QTest::newRow("200 keywords") << QString("keywords") << keywords;
+
+    QJsonObject rewrite;
+    rewrite["result"] = sentence.repeated(220);
+    QTest::newRow("rewrite 16 KB") << QString("rewrite") << rewrite;
+}
+
+void HotPathBenchmark::formatServerResponse()
+{
+    QFETCH(QString, command);
+    QFETCH(QJsonObject, response);
+
+    QBENCHMARK {
+        sink += commandManager->formatServerResponse(command, response).size();
+    }
+}
+
+void HotPathBenchmark::formatServerResponseAllocations()
+{
+    QFETCH(QString, command);
+    QFETCH(QJsonObject, response);
+
+    QTest::setBenchmarkResult(allocationsPerCall([&]() {
+        sink += commandManager->formatServerResponse(command, response).size();
+    }), QTest::Events);
+}
+
+void HotPathBenchmark::countTokens_data()
+{
+    QTest::addColumn<QString>("text");
+
+    const QString paragraph = "The committee's report, published on Tuesday, found that 42% of the "
+                              "projects had overrun their budgets by more than a year.\n\n";
+    QTest::newRow("sentence") << QString("Summarise this for me, please.");
+    QTest::newRow("paragraph") << paragraph;
+    QTest::newRow("long document") << paragraph.repeated(2000);
+    QTest::newRow("non-latin") << QString::fromUtf8("Привет, мир! 你好，世界。 naïve café ").repeated(100);
+}
+
+void HotPathBenchmark::countTokens()
+{
+    QFETCH(QString, text);
+    if (commandManager->countTokens(text) < 0) {
+        QSKIP("Tokenizer files not found");
+    }
+
+    QBENCHMARK {
+        sink += commandManager->countTokens(text);
+    }
+}
+
+void HotPathBenchmark::countTokensAllocations()
+{
+    QFETCH(QString, text);
+    if (commandManager->countTokens(text) < 0) {
+        QSKIP("Tokenizer files not found");
+    }
+
+    QTest::setBenchmarkResult(allocationsPerCall([&]() {
+        sink += commandManager->countTokens(text);
+    }), QTest::Events);
+}
+
+QTEST_GUILESS_MAIN(HotPathBenchmark)
+#include "hotpathbench.moc"
@@ -0,0 +1,578 @@
+// texdit_bench: drives CommandManager and ServerManager without the GUI.
+//
+// Replays a JSONL corpus against a running backend and reports throughput and
+// latency percentiles per command, plus the per-stage breakdown from the
+// Tracer. Results are written as JSON and can be compared against an earlier
+// run with --baseline, which makes the exit code usable as a regression gate.
+//
+// Corpus lines are JSON objects. The command is taken from "command" (or
+// rotated through --commands when absent) and the input text from "input",
+// "text", or "title" + "body" (so requests.jsonl can be replayed as is).
+//
+// Exit codes: 0 success, 1 regression against the baseline, 2 setup error.
+
+#include "commandmanager.h"
+#include "servermanager.h"
+#include "localsockettransport.h"
+#include "tracer.h"
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLoggingCategory>
+#include <QMap>
+#include <QTextStream>
+#include <QTimer>
+#include <QVector>
+#include <cmath>
+
+namespace {
+
+const int EXIT_REGRESSION = 1;
+const int EXIT_SETUP_ERROR = 2;
+
+struct CorpusEntry {
+    QString command;
+    QString input;
+};
+
+struct CommandStats {
+    LatencyHistogram latency;
+    qint64 ok = 0;
+    qint64 failed = 0;
+    qint64 totalNanoseconds = 0;
+};
+
+struct Config {
+    QString corpusPath;
+    QStringList commands;
+    bool openLoop = false;
+    int concurrency = 1;
+    double qps = 1.0;
+    int requests = 0;   // 0 = one pass over the corpus
+    double duration = 0; // Seconds; overrides requests when set
+    int warmup = 0;
+    int endpointConcurrency = 0; // 0 = the editor's defaults
+    bool cache = false;
+    QString ipcSocket;
+    int serverTimeout = 120;
+    QString outputPath;
+    QString baselinePath;
+    double maxRegression = 10.0; // Percent
+    QString label;
+};
+
+QTextStream& out()
+{
+    static QTextStream stream(stdout);
+    return stream;
+}
+
+QTextStream& err()
+{
+    static QTextStream stream(stderr);
+    return stream;
+}
+
+double toMilliseconds(qint64 nanoseconds)
+{
+    return nanoseconds / 1e6;
+}
+
+QString baseCommandOf(const QString& command)
+{
+    return command.section(' ', 0, 0, QString::SectionSkipEmpty);
+}
+
+bool loadCorpus(const Config& config, QVector<CorpusEntry>& corpus)
+{
+    QFile file(config.corpusPath);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        err() << "texdit_bench: cannot open corpus " << config.corpusPath << "\n";
+        return false;
+    }
+
+    int line = 0;
+    int rotation = 0;
+    while (!file.atEnd()) {
+        QByteArray raw = file.readLine().trimmed();
+        ++line;
+        if (raw.isEmpty()) {
+            continue;
+        }
+
+        QJsonParseError error;
+        QJsonObject object = QJsonDocument::fromJson(raw, &error).object();
+        if (error.error != QJsonParseError::NoError) {
+            err() << "texdit_bench: skipping line " << line << ": " << error.errorString() << "\n";
+            continue;
+        }
+
+        CorpusEntry entry;
+        entry.command = object.value("command").toString();
+        if (entry.command.isEmpty()) {
+            entry.command = config.commands[rotation++ % config.commands.size()];
+        }
+
+        entry.input = object.value("input").toString();
+        if (entry.input.isEmpty()) {
+            entry.input = object.value("text").toString();
+        }
+        if (entry.input.isEmpty()) {
+            QStringList parts = {object.value("title").toString(), object.value("body").toString()};
+            parts.removeAll(QString());
+            entry.input = parts.join("\n\n");
+        }
+        if (entry.input.trimmed().isEmpty()) {
+            continue;
+        }
+        corpus.append(entry);
+    }
+
+    if (corpus.isEmpty()) {
+        err() << "texdit_bench: corpus " << config.corpusPath << " has no usable entries\n";
+        return false;
+    }
+    return true;
+}
+
+QJsonObject statsToJson(const CommandStats& stats, double seconds)
+{
+    qint64 count = stats.latency.count();
+    QJsonObject object;
+    object["count"] = double(stats.ok + stats.failed);
+    object["ok"] = double(stats.ok);
+    object["failed"] = double(stats.failed);
+    object["throughput_rps"] = seconds > 0 ? stats.ok / seconds : 0.0;
+    object["mean_ms"] = count > 0 ? toMilliseconds(stats.totalNanoseconds / count) : 0.0;
+    object["p50_ms"] = toMilliseconds(stats.latency.percentile(50));
+    object["p90_ms"] = toMilliseconds(stats.latency.percentile(90));
+    object["p95_ms"] = toMilliseconds(stats.latency.percentile(95));
+    object["p99_ms"] = toMilliseconds(stats.latency.percentile(99));
+    object["max_ms"] = toMilliseconds(stats.latency.maximum());
+    return object;
+}
+
+class Bench
+{
+public:
+    Bench(const Config& config, const QVector<CorpusEntry>& corpus)
+        : config(config)
+        , corpus(corpus)
+        , commandManager(&serverManager)
+        , nextEntry(0)
+        , issued(0)
+        , outstanding(0)
+        , measuring(false)
+        , started(false)
+        , measureStart(0)
+        , measureEnd(0)
+    {
+        if (!config.ipcSocket.isEmpty()) {
+            serverManager.setTransport(new LocalSocketTransport(config.ipcSocket));
+        }
+        commandManager.setResultCacheEnabled(config.cache);
+        commandManager.setMaxQueueSize(config.openLoop ? 4096 : qMax(32, config.concurrency));
+        if (config.endpointConcurrency > 0) {
+            for (const CorpusEntry& entry : corpus) {
+                commandManager.setEndpointConcurrency("/api/" + baseCommandOf(entry.command),
+                                                      config.endpointConcurrency);
+            }
+        }
+    }
+
+    int run()
+    {
+        QObject::connect(&serverManager, &ServerManager::statusChanged, &context, [this]() {
+            if (serverManager.isReady() && !started) {
+                started = true;
+                err() << "texdit_bench: server ready via " << serverManager.activeTransportName() << "\n";
+                startWarmup();
+            }
+        });
+        QTimer::singleShot(config.serverTimeout * 1000, &context, [this]() {
+            if (!started) {
+                err() << "texdit_bench: server not ready after " << config.serverTimeout << "s\n";
+                QCoreApplication::exit(EXIT_SETUP_ERROR);
+            }
+        });
+
+        serverManager.startHealthMonitoring();
+        return QCoreApplication::exec();
+    }
+
+private:
+    void startWarmup()
+    {
+        if (config.warmup <= 0) {
+            startMeasurement();
+            return;
+        }
+
+        // Warm-up runs closed loop and is excluded from every statistic
+        err() << "texdit_bench: warming up with " << config.warmup << " requests\n";
+        for (int i = 0; i < qMin(config.warmup, config.concurrency); ++i) {
+            issueWarmup();
+        }
+    }
+
+    void issueWarmup()
+    {
+        if (measuring) {
+            return;
+        }
+        if (issued >= config.warmup) {
+            if (outstanding == 0) {
+                startMeasurement();
+            }
+            return;
+        }
+
+        const CorpusEntry& entry = takeEntry();
+        ++issued;
+        ++outstanding;
+        commandManager.executeCommand(entry.command, entry.input, [this](CommandManager::CommandResult, const QString&) {
+            --outstanding;
+            QTimer::singleShot(0, &context, [this]() { issueWarmup(); });
+        });
+    }
+
+    void startMeasurement()
+    {
+        Tracer::instance()->clearMetrics();
+        issued = 0;
+        measuring = true;
+        measureStart = Tracer::now();
+
+        if (config.openLoop) {
+            err() << "texdit_bench: open loop at " << config.qps << " requests/s\n";
+            ticker.setTimerType(Qt::PreciseTimer);
+            ticker.setInterval(1);
+            QObject::connect(&ticker, &QTimer::timeout, &context, [this]() { tickOpenLoop(); });
+            ticker.start();
+            tickOpenLoop();
+        } else {
+            err() << "texdit_bench: closed loop with " << config.concurrency << " outstanding requests\n";
+            for (int i = 0; i < config.concurrency; ++i) {
+                issueClosedLoop();
+            }
+        }
+    }
+
+    bool moreToIssue() const
+    {
+        if (config.duration > 0) {
+            return Tracer::now() - measureStart < qint64(config.duration * 1e9);
+        }
+        return issued < config.requests;
+    }
+
+    void issueClosedLoop()
+    {
+        if (!moreToIssue()) {
+            finishIfDone();
+            return;
+        }
+        issue(Tracer::now(), [this]() {
+            QTimer::singleShot(0, &context, [this]() { issueClosedLoop(); });
+        });
+    }
+
+    void tickOpenLoop()
+    {
+        // Requests are due on a fixed schedule whatever the server's pace, and
+        // latency is measured from when each was due, so a stalled server
+        // cannot hide its backlog (coordinated omission)
+        const qint64 interval = qint64(1e9 / config.qps);
+        qint64 now = Tracer::now();
+        while (moreToIssue() && measureStart + issued * interval <= now) {
+            issue(measureStart + issued * interval, nullptr);
+        }
+        if (!moreToIssue()) {
+            ticker.stop();
+            finishIfDone();
+        }
+    }
+
+    void issue(qint64 intendedStart, std::function<void()> then)
+    {
+        const CorpusEntry& entry = takeEntry();
+        QString command = baseCommandOf(entry.command);
+        ++issued;
+        ++outstanding;
+
+        commandManager.executeCommand(entry.command, entry.input,
+                                      [this, command, intendedStart, then](CommandManager::CommandResult result, const QString&) {
+            qint64 latency = Tracer::now() - intendedStart;
+            --outstanding;
+            measureEnd = Tracer::now();
+
+            for (CommandStats* stats : {&perCommand[command], &overall}) {
+                if (result == CommandManager::Success) {
+                    stats->ok++;
+                    stats->latency.record(latency);
+                    stats->totalNanoseconds += latency;
+                } else {
+                    stats->failed++;
+                }
+            }
+
+            if (then) {
+                then();
+            } else {
+                finishIfDone();
+            }
+        });
+    }
+
+    const CorpusEntry& takeEntry()
+    {
+        return corpus.at(nextEntry++ % corpus.size());
+    }
+
+    void finishIfDone()
+    {
+        if (!measuring || outstanding > 0 || moreToIssue()) {
+            return;
+        }
+        measuring = false;
+        QTimer::singleShot(0, &context, [this]() { QCoreApplication::exit(report()); });
+    }
+
+    int report()
+    {
+        double seconds = (measureEnd - measureStart) / 1e9;
+        QJsonObject results = buildResults(seconds);
+        printTable(seconds);
+
+        if (!config.outputPath.isEmpty()) {
+            QFile file(config.outputPath);
+            if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+                err() << "texdit_bench: cannot write " << config.outputPath << "\n";
+                return EXIT_SETUP_ERROR;
+            }
+            file.write(QJsonDocument(results).toJson());
+            err() << "texdit_bench: results written to " << config.outputPath << "\n";
+        }
+
+        return config.baselinePath.isEmpty() ? 0 : compareWithBaseline(results);
+    }
+
+    QJsonObject buildResults(double seconds) const
+    {
+        QJsonObject configuration;
+        configuration["corpus"] = QFileInfo(config.corpusPath).fileName();
+        configuration["corpus_entries"] = corpus.size();
+        configuration["mode"] = config.openLoop ? "open" : "closed";
+        configuration["concurrency"] = config.concurrency;
+        configuration["qps"] = config.qps;
+        configuration["requests"] = config.requests;
+        configuration["duration_s"] = config.duration;
+        configuration["warmup"] = config.warmup;
+        configuration["endpoint_concurrency"] = config.endpointConcurrency;
+        configuration["cache"] = config.cache;
+        configuration["transport"] = serverManager.activeTransportName();
+
+        QJsonObject commands;
+        for (auto it = perCommand.constBegin(); it != perCommand.constEnd(); ++it) {
+            commands[it.key()] = statsToJson(it.value(), seconds);
+        }
+
+        QJsonObject stages;
+        for (const Tracer::StageSummary& summary : Tracer::instance()->summaries()) {
+            QJsonObject stage;
+            stage["count"] = double(summary.count);
+            stage["p50_ms"] = toMilliseconds(summary.p50);
+            stage["p95_ms"] = toMilliseconds(summary.p95);
+            stage["p99_ms"] = toMilliseconds(summary.p99);
+            stage["max_ms"] = toMilliseconds(summary.max);
+
+            QJsonObject command = stages.value(summary.command).toObject();
+            command[summary.stage] = stage;
+            stages[summary.command] = command;
+        }
+
+        QJsonObject results;
+        results["tool"] = "texdit_bench";
+        results["format"] = 1;
+        results["label"] = config.label;
+        results["timestamp"] = QDateTime::currentDateTime().toString(Qt::ISODate);
+        results["config"] = configuration;
+        results["duration_s"] = seconds;
+        results["overall"] = statsToJson(overall, seconds);
+        results["commands"] = commands;
+        results["stages"] = stages;
+        return results;
+    }
+
+    void printTable(double seconds) const
+    {
+        auto row = [seconds](const QString& name, const CommandStats& stats) {
+            QJsonObject s = statsToJson(stats, seconds);
+            return QString("%1 %2 %3 %4 %5 %6 %7 %8\n")
+                .arg(name, -12)
+                .arg(qint64(s["ok"].toDouble()), 7)
+                .arg(qint64(s["failed"].toDouble()), 7)
+                .arg(s["throughput_rps"].toDouble(), 9, 'f', 2)
+                .arg(s["p50_ms"].toDouble(), 10, 'f', 1)
+                .arg(s["p95_ms"].toDouble(), 10, 'f', 1)
+                .arg(s["p99_ms"].toDouble(), 10, 'f', 1)
+                .arg(s["max_ms"].toDouble(), 10, 'f', 1);
+        };
+
+        out() << QString("%1 %2 %3 %4 %5 %6 %7 %8\n")
+                     .arg("command", -12).arg("ok", 7).arg("failed", 7).arg("req/s", 9)
+                     .arg("p50 ms", 10).arg("p95 ms", 10).arg("p99 ms", 10).arg("max ms", 10);
+        for (auto it = perCommand.constBegin(); it != perCommand.constEnd(); ++it) {
+            out() << row(it.key(), it.value());
+        }
+        out() << row("(all)", overall);
+        out() << QString("%1 requests in %2 s\n").arg(overall.ok + overall.failed).arg(seconds, 0, 'f', 2);
+        out().flush();
+    }
+
+    int compareWithBaseline(const QJsonObject& results) const
+    {
+        QFile file(config.baselinePath);
+        if (!file.open(QIODevice::ReadOnly)) {
+            err() << "texdit_bench: cannot read baseline " << config.baselinePath << "\n";
+            return EXIT_SETUP_ERROR;
+        }
+        QJsonObject baseline = QJsonDocument::fromJson(file.readAll()).object();
+
+        // Latency may grow and throughput may shrink by at most maxRegression percent
+        const double tolerance = config.maxRegression / 100.0;
+        bool regressed = false;
+        auto compare = [&](const QString& name, const QJsonObject& now, const QJsonObject& before) {
+            for (const QString& key : {QString("p50_ms"), QString("p95_ms"), QString("p99_ms")}) {
+                double was = before.value(key).toDouble();
+                double is = now.value(key).toDouble();
+                if (was > 0 && is > was * (1.0 + tolerance)) {
+                    out() << QString("REGRESSION %1 %2: %3 -> %4 (+%5%)\n")
+                                 .arg(name, key).arg(was, 0, 'f', 1).arg(is, 0, 'f', 1)
+                                 .arg((is / was - 1.0) * 100.0, 0, 'f', 1);
+                    regressed = true;
+                }
+            }
+            double was = before.value("throughput_rps").toDouble();
+            double is = now.value("throughput_rps").toDouble();
+            if (was > 0 && is < was * (1.0 - tolerance)) {
+                out() << QString("REGRESSION %1 throughput_rps: %2 -> %3 (%4%)\n")
+                             .arg(name).arg(was, 0, 'f', 2).arg(is, 0, 'f', 2)
+                             .arg((is / was - 1.0) * 100.0, 0, 'f', 1);
+                regressed = true;
+            }
+        };
+
+        compare("(all)", results["overall"].toObject(), baseline["overall"].toObject());
+        QJsonObject commands = results["commands"].toObject();
+        QJsonObject baselineCommands = baseline["commands"].toObject();
+        for (const QString& command : commands.keys()) {
+            if (baselineCommands.contains(command)) {
+                compare(command, commands[command].toObject(), baselineCommands[command].toObject());
+            }
+        }
+
+        out() << (regressed ? "Regressions found against " : "No regressions against ") << config.baselinePath << "\n";
+        out().flush();
+        return regressed ? EXIT_REGRESSION : 0;
+    }
+
+    Config config;
+    const QVector<CorpusEntry> corpus;
+    QObject context; // Receiver for the bench's connections and timers
+    ServerManager serverManager;
+    CommandManager commandManager;
+    QTimer ticker;
+
+    int nextEntry;
+    int issued;
+    int outstanding;
+    bool measuring;
+    bool started;
+    qint64 measureStart;
+    qint64 measureEnd;
+    QMap<QString, CommandStats> perCommand;
+    CommandStats overall;
+};
+
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("texdit_bench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Replays a command corpus against the texdit backend and reports latency");
+    parser.addHelpOption();
+    QCommandLineOption corpusOption("corpus", "JSONL corpus to replay", "file");
+    QCommandLineOption commandsOption("commands", "Commands rotated through for entries without one", "list", "summarise,keywords");
+    QCommandLineOption modeOption("mode", "closed (fixed concurrency) or open (fixed request rate)", "mode", "closed");
+    QCommandLineOption concurrencyOption("concurrency", "Outstanding requests in closed-loop mode", "n", "1");
+    QCommandLineOption qpsOption("qps", "Request rate in open-loop mode", "rate", "1");
+    QCommandLineOption requestsOption("requests", "Measured requests (default: one pass over the corpus)", "n");
+    QCommandLineOption durationOption("duration", "Measure for this many seconds instead of a request count", "seconds");
+    QCommandLineOption warmupOption("warmup", "Unmeasured requests sent first", "n", "0");
+    QCommandLineOption endpointOption("endpoint-concurrency", "Per-endpoint request limit (default: the editor's)", "n", "0");
+    QCommandLineOption cacheOption("cache", "Allow answers from the result cache");
+    QCommandLineOption ipcOption("ipc-socket", "Send requests over the backend's local socket instead of HTTP", "name");
+    QCommandLineOption timeoutOption("server-timeout", "Seconds to wait for the backend to become ready", "seconds", "120");
+    QCommandLineOption outputOption("output", "Write JSON results to this file", "file");
+    QCommandLineOption baselineOption("baseline", "Earlier results to compare against", "file");
+    QCommandLineOption regressionOption("max-regression", "Allowed slowdown against the baseline", "percent", "10");
+    QCommandLineOption labelOption("label", "Name recorded in the results, e.g. a version", "name");
+    QCommandLineOption verboseOption("verbose", "Show debug output");
+    parser.addOptions({corpusOption, commandsOption, modeOption, concurrencyOption, qpsOption, requestsOption,
+                       durationOption, warmupOption, endpointOption, cacheOption, ipcOption, timeoutOption,
+                       outputOption, baselineOption, regressionOption, labelOption, verboseOption});
+    parser.process(app);
+
+    if (!parser.isSet(verboseOption)) {
+        QLoggingCategory::setFilterRules("*.debug=false");
+    }
+
+    Config config;
+    config.corpusPath = parser.value(corpusOption);
+    config.commands = parser.value(commandsOption).split(',', Qt::SkipEmptyParts);
+    config.openLoop = parser.value(modeOption) == "open";
+    config.concurrency = qMax(1, parser.value(concurrencyOption).toInt());
+    config.qps = parser.value(qpsOption).toDouble();
+    config.duration = parser.value(durationOption).toDouble();
+    config.warmup = qMax(0, parser.value(warmupOption).toInt());
+    config.endpointConcurrency = qMax(0, parser.value(endpointOption).toInt());
+    config.cache = parser.isSet(cacheOption);
+    config.ipcSocket = parser.value(ipcOption);
+    config.serverTimeout = qMax(1, parser.value(timeoutOption).toInt());
+    config.outputPath = parser.value(outputOption);
+    config.baselinePath = parser.value(baselineOption);
+    config.maxRegression = parser.value(regressionOption).toDouble();
+    config.label = parser.value(labelOption);
+
+    if (config.corpusPath.isEmpty() || config.commands.isEmpty()) {
+        err() << "texdit_bench: --corpus is required\n";
+        parser.showHelp(EXIT_SETUP_ERROR);
+    }
+    if (parser.value(modeOption) != "open" && parser.value(modeOption) != "closed") {
+        err() << "texdit_bench: --mode must be open or closed\n";
+        return EXIT_SETUP_ERROR;
+    }
+    if (config.openLoop && config.qps <= 0) {
+        err() << "texdit_bench: --qps must be positive\n";
+        return EXIT_SETUP_ERROR;
+    }
+
+    QVector<CorpusEntry> corpus;
+    if (!loadCorpus(config, corpus)) {
+        return EXIT_SETUP_ERROR;
+    }
+    config.requests = parser.isSet(requestsOption) ? qMax(1, parser.value(requestsOption).toInt()) : corpus.size();
+
+    Bench bench(config, corpus);
+    return bench.run();
+}
@@ -0,0 +1,394 @@
+#include "bpetokenizer.h"
+#include <QCoreApplication>
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QVarLengthArray>
+#include <algorithm>
+#include <climits>
+#include <iterator>
+
+const int BpeTokenizer::SPECIAL_TOKENS = 2; // <s> ... </s>
+const int BpeTokenizer::PIECE_CACHE_LIMIT = 100000; // Distinct words; far more than a long document uses
+
+namespace {
+const char* const MODEL_DIRECTORY = "models/distilbart-cnn-12-6";
+
+// GPT-2's reversible byte encoding: printable Latin-1 bytes stand for
+// themselves, the rest are moved to code points from 256 up
+struct ByteEncoding {
+    uint unicodeOf[256];
+    int byteOf[324]; // -1 for code points no byte maps to
+
+    ByteEncoding()
+    {
+        std::fill(std::begin(byteOf), std::end(byteOf), -1);
+        uint shifted = 256;
+        for (int b = 0; b < 256; ++b) {
+            bool printable = (b >= '!' && b <= '~') || (b >= 0xA1 && b <= 0xAC) || (b >= 0xAE && b <= 0xFF);
+            unicodeOf[b] = printable ? uint(b) : shifted++;
+            byteOf[unicodeOf[b]] = b;
+        }
+    }
+};
+
+const ByteEncoding& byteEncoding()
+{
+    static const ByteEncoding encoding;
+    return encoding;
+}
+
+// Raw bytes of a token as written in vocab.json and merges.txt
+bool decodeToken(const QString& token, QByteArray& bytes)
+{
+    const ByteEncoding& encoding = byteEncoding();
+    bytes.clear();
+    for (QChar c : token) {
+        ushort code = c.unicode();
+        if (code >= 324 || encoding.byteOf[code] < 0) {
+            return false;
+        }
+        bytes.append(char(encoding.byteOf[code]));
+    }
+    return true;
+}
+
+quint64 pairKey(int left, int right)
+{
+    return (quint64(quint32(left)) << 32) | quint32(right);
+}
+
+uint codePointAt(QStringView text, int i, int& width)
+{
+    QChar c = text[i];
+    if (c.isHighSurrogate() && i + 1 < text.size() && text[i + 1].isLowSurrogate()) {
+        width = 2;
+        return QChar::surrogateToUcs4(c, text[i + 1]);
+    }
+    width = 1;
+    return c.unicode();
+}
+
+enum CharClass { Space, Letter, Number, Other };
+
+CharClass classify(uint c)
+{
+    if (QChar::isSpace(c)) return Space;
+    if (QChar::isLetter(c)) return Letter;
+    if (QChar::isNumber(c)) return Number;
+    return Other;
+}
+
+// 's 't 're 've 'm 'll 'd, matched before anything else like in GPT-2
+int contractionLength(QStringView text, int i)
+{
+    if (i + 1 >= text.size()) {
+        return 0;
+    }
+    QChar next = text[i + 1];
+    if (next == 's' || next == 't' || next == 'm' || next == 'd') {
+        return 2;
+    }
+    if (i + 2 < text.size()) {
+        QChar after = text[i + 2];
+        if ((next == 'r' && after == 'e') || (next == 'v' && after == 'e') || (next == 'l' && after == 'l')) {
+            return 3;
+        }
+    }
+    return 0;
+}
+
+bool mapFile(QFile& file, QByteArray& contents)
+{
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    uchar* data = file.map(0, file.size());
+    if (!data) {
+        return false;
+    }
+    contents = QByteArray::fromRawData(reinterpret_cast<const char*>(data), int(file.size()));
+    return true;
+}
+}
+
+BpeTokenizer::BpeTokenizer()
+{
+    std::fill(std::begin(byteIds), std::end(byteIds), -1);
+}
+
+QString BpeTokenizer::findModelDirectory()
+{
+    QStringList candidates;
+    if (QCoreApplication::instance()) {
+        candidates << QCoreApplication::applicationDirPath() + "/" + MODEL_DIRECTORY;
+    }
+    candidates << QString("../../%1").arg(MODEL_DIRECTORY)  // Relative path from build directory
+               << QString("../%1").arg(MODEL_DIRECTORY)
+               << QString(MODEL_DIRECTORY);
+
+    for (const QString& directory : candidates) {
+        if (QFile::exists(directory + "/vocab.json") && QFile::exists(directory + "/merges.txt")) {
+            return QDir(directory).absolutePath();
+        }
+    }
+    return QString();
+}
+
+bool BpeTokenizer::load(const QString& directory)
+{
+    QElapsedTimer timer;
+    timer.start();
+    merges.clear();
+    pieceCache.clear();
+
+    // merges.txt is parsed line by line straight from its mapping; vocab.json
+    // is read whole, QJsonDocument copies it into its own form anyway.
+    // Only the merge table is kept.
+    QFile vocabFile(directory + "/vocab.json");
+    QFile mergesFile(directory + "/merges.txt");
+    QByteArray mergesData;
+    if (!vocabFile.open(QIODevice::ReadOnly) || !mapFile(mergesFile, mergesData)) {
+        qDebug() << "BpeTokenizer: ❌ Could not open the tokenizer files in" << directory;
+        return false;
+    }
+
+    QJsonParseError error;
+    const QJsonObject vocabObject = QJsonDocument::fromJson(vocabFile.readAll(), &error).object();
+    if (error.error != QJsonParseError::NoError) {
+        qDebug() << "BpeTokenizer: ❌ Invalid vocab.json:" << error.errorString();
+        return false;
+    }
+
+    QHash<QByteArray, int> vocab;
+    vocab.reserve(vocabObject.size());
+    QByteArray bytes;
+    for (auto it = vocabObject.begin(); it != vocabObject.end(); ++it) {
+        if (decodeToken(it.key(), bytes)) {
+            vocab.insert(bytes, it.value().toInt());
+        }
+    }
+
+    for (int b = 0; b < 256; ++b) {
+        byteIds[b] = vocab.value(QByteArray(1, char(b)), -1);
+        if (byteIds[b] < 0) {
+            qDebug() << "BpeTokenizer: ❌ vocab.json is not a byte-level vocabulary";
+            return false;
+        }
+    }
+
+    int rank = 0;
+    QByteArray left;
+    QByteArray right;
+    int pos = 0;
+    while (pos < mergesData.size()) {
+        int end = mergesData.indexOf('\n', pos);
+        if (end < 0) {
+            end = mergesData.size();
+        }
+        QByteArray line = QByteArray::fromRawData(mergesData.constData() + pos, end - pos).trimmed();
+        pos = end + 1;
+
+        int space = line.indexOf(' ');
+        if (line.startsWith("#version") || space <= 0) {
+            continue;
+        }
+        if (!decodeToken(QString::fromUtf8(line.left(space)), left)
+            || !decodeToken(QString::fromUtf8(line.mid(space + 1)), right)) {
+            continue;
+        }
+
+        auto leftId = vocab.constFind(left);
+        auto rightId = vocab.constFind(right);
+        auto mergedId = vocab.constFind(left + right);
+        if (leftId != vocab.constEnd() && rightId != vocab.constEnd() && mergedId != vocab.constEnd()) {
+            merges.insert(pairKey(*leftId, *rightId), {rank, *mergedId});
+        }
+        ++rank;
+    }
+
+    qDebug() << "BpeTokenizer: ✅ Loaded" << vocab.size() << "tokens and" << merges.size() << "merges in"
+             << timer.elapsed() << "ms";
+    return isLoaded();
+}
+
+template <typename Visitor>
+void BpeTokenizer::forEachPiece(QStringView text, Visitor&& visit) const
+{
+    // The GPT-2 pre-tokenizer pattern, hand-rolled:
+    // 's|'t|'re|'ve|'m|'ll|'d| ?\p{L}+| ?\p{N}+| ?[^\s\p{L}\p{N}]+|\s+(?!\S)|\s+
+    const int size = int(text.size());
+    int i = 0;
+    while (i < size) {
+        int width;
+        uint c = codePointAt(text, i, width);
+
+        if (c == '\'') {
+            int length = contractionLength(text, i);
+            if (length > 0) {
+                if (!visit(i, length)) return;
+                i += length;
+                continue;
+            }
+        }
+
+        int start = i;
+        CharClass kind = classify(c);
+        if (c == ' ' && i + 1 < size) {
+            int nextWidth;
+            CharClass next = classify(codePointAt(text, i + 1, nextWidth));
+            if (next != Space) {
+                // A single space belongs to the word after it
+                kind = next;
+                i += 1;
+                c = codePointAt(text, i, width);
+            }
+        }
+
+        if (kind != Space) {
+            do {
+                i += width;
+            } while (i < size && classify(c = codePointAt(text, i, width)) == kind);
+        } else {
+            int end = i;
+            while (end < size && classify(codePointAt(text, end, width)) == Space) {
+                end += width;
+            }
+            // Leave the last whitespace character for the word that follows
+            i = (end < size && end - i > 1) ? end - 1 : end;
+        }
+
+        if (!visit(start, i - start)) return;
+    }
+}
+
+QVector<int> BpeTokenizer::mergePiece(QStringView piece) const
+{
+    // UTF-8 bytes of the piece, one token each to start with
+    QVarLengthArray<int, 64> symbols;
+    for (int i = 0; i < piece.size();) {
+        int width;
+        uint c = codePointAt(piece, i, width);
+        if (QChar::isSurrogate(c)) {
+            c = QChar::ReplacementCharacter; // Lone surrogate
+        }
+        i += width;
+
+        if (c < 0x80) {
+            symbols.append(byteIds[c]);
+        } else if (c < 0x800) {
+            symbols.append(byteIds[0xC0 | (c >> 6)]);
+            symbols.append(byteIds[0x80 | (c & 0x3F)]);
+        } else if (c < 0x10000) {
+            symbols.append(byteIds[0xE0 | (c >> 12)]);
+            symbols.append(byteIds[0x80 | ((c >> 6) & 0x3F)]);
+            symbols.append(byteIds[0x80 | (c & 0x3F)]);
+        } else {
+            symbols.append(byteIds[0xF0 | (c >> 18)]);
+            symbols.append(byteIds[0x80 | ((c >> 12) & 0x3F)]);
+            symbols.append(byteIds[0x80 | ((c >> 6) & 0x3F)]);
+            symbols.append(byteIds[0x80 | (c & 0x3F)]);
+        }
+    }
+
+    // Repeatedly merge the lowest-ranked adjacent pair, every occurrence at once
+    while (symbols.size() > 1) {
+        int bestRank = INT_MAX;
+        quint64 bestPair = 0;
+        int mergedId = -1;
+        for (int k = 0; k + 1 < symbols.size(); ++k) {
+            auto it = merges.constFind(pairKey(symbols[k], symbols[k + 1]));
+            if (it != merges.constEnd() && it->rank < bestRank) {
+                bestRank = it->rank;
+                bestPair = it.key();
+                mergedId = it->id;
+            }
+        }
+        if (mergedId < 0) {
+            break;
+        }
+
+        int written = 0;
+        for (int k = 0; k < symbols.size(); ++k) {
+            if (k + 1 < symbols.size() && pairKey(symbols[k], symbols[k + 1]) == bestPair) {
+                symbols[written++] = mergedId;
+                ++k;
+            } else {
+                symbols[written++] = symbols[k];
+            }
+        }
+        symbols.resize(written);
+    }
+
+    return QVector<int>(symbols.begin(), symbols.end());
+}
+
+const QVector<int>& BpeTokenizer::pieceTokens(QStringView piece) const
+{
+    quint64 hash = qHash(piece);
+    auto it = pieceCache.find(hash);
+    if (it != pieceCache.end() && QStringView(it->text) == piece) {
+        return it->ids;
+    }
+
+    if (pieceCache.size() >= PIECE_CACHE_LIMIT) {
+        pieceCache.clear();
+    }
+    // A colliding piece simply replaces the cached one
+    CachedPiece& entry = pieceCache[hash];
+    entry.text = piece.toString();
+    entry.ids = mergePiece(piece);
+    return entry.ids;
+}
+
+QVector<int> BpeTokenizer::encode(QStringView text) const
+{
+    QVector<int> ids;
+    if (!isLoaded()) {
+        return ids;
+    }
+    forEachPiece(text, [&](int start, int length) {
+        ids += pieceTokens(text.mid(start, length));
+        return true;
+    });
+    return ids;
+}
+
+int BpeTokenizer::countTokens(QStringView text) const
+{
+    int count = 0;
+    if (!isLoaded()) {
+        return count;
+    }
+    forEachPiece(text, [&](int start, int length) {
+        count += pieceTokens(text.mid(start, length)).size();
+        return true;
+    });
+    return count;
+}
+
+int BpeTokenizer::prefixLength(QStringView text, int maxTokens) const
+{
+    if (!isLoaded()) {
+        return int(text.size());
+    }
+
+    int used = 0;
+    int fitted = 0;
+    forEachPiece(text, [&](int start, int length) {
+        int tokens = pieceTokens(text.mid(start, length)).size();
+        if (used + tokens > maxTokens) {
+            if (fitted == 0) {
+                fitted = qMax(1, int(qint64(length) * maxTokens / tokens));
+            }
+            return false;
+        }
+        used += tokens;
+        fitted = start + length;
+        return true;
+    });
+    return fitted;
+}
@@ -0,0 +1,61 @@
+#ifndef BPETOKENIZER_H
+#define BPETOKENIZER_H
+
+#include <QString>
+#include <QStringView>
+#include <QVector>
+#include <QHash>
+
+// Byte-level BPE tokenizer reading the same vocab.json and merges.txt as the
+// backend's Hugging Face tokenizer (GPT-2/BART style), so token counts and
+// chunk sizes can be checked before any text is sent. Text is split into
+// pieces like the GPT-2 pre-tokenizer, and each distinct piece is merged
+// once: later occurrences come from a cache keyed by the piece's hash.
+//
+// Counts exclude the <s> and </s> the model adds around every input; see
+// SPECIAL_TOKENS. Not thread-safe: the piece cache is shared.
+class BpeTokenizer
+{
+public:
+    BpeTokenizer();
+
+    // Reads vocab.json and merges.txt from the model directory
+    bool load(const QString& directory);
+    bool isLoaded() const { return !merges.isEmpty(); }
+
+    QVector<int> encode(QStringView text) const;
+    int countTokens(QStringView text) const;
+
+    // Length of the longest prefix of text that fits in maxTokens, cut
+    // between pieces (a single oversized piece is cut by characters)
+    int prefixLength(QStringView text, int maxTokens) const;
+
+    // The packaged model directory holding the tokenizer files, or empty
+    static QString findModelDirectory();
+
+    static const int SPECIAL_TOKENS;
+
+private:
+    struct Merge {
+        int rank;
+        int id; // Token the pair merges into
+    };
+
+    struct CachedPiece {
+        QString text;
+        QVector<int> ids;
+    };
+
+    template <typename Visitor>
+    void forEachPiece(QStringView text, Visitor&& visit) const;
+    const QVector<int>& pieceTokens(QStringView piece) const;
+    QVector<int> mergePiece(QStringView piece) const;
+
+    int byteIds[256];
+    QHash<quint64, Merge> merges; // Keyed by (left id << 32) | right id
+    mutable QHash<quint64, CachedPiece> pieceCache;
+
+    static const int PIECE_CACHE_LIMIT;
+};
+
+#endif // BPETOKENIZER_H
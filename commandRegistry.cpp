@@ -1,184 +1,261 @@
 #include "commandRegistry.h"
-#include <QDebug>
-
-QStringList commandRegistry::getAllCommands () {
-    return {
-        "summarise",
-        "tone",
-        "font",
-        "highlight",
-        "keywords",
-        "rephrase",
-        "rewrite"
-    };
-}
+#include <QVector>
+#include <QStringView>
+#include <algorithm>
+
+namespace {
+
+const int MAX_COMMAND_SUGGESTIONS = 3;  // Keep the popup clean while typing a name
+const int MAX_ARGUMENT_SUGGESTIONS = 8;
+
+struct IndexEntry {
+    QString key;        // Lower-case text matched against the input
+    QString completion; // Suggestion shown to the user
+    int rank;           // Definition order; lower ranks are suggested first
+};
+
+// Entries sorted by key, so all matches for a prefix are one contiguous range
+typedef QVector<IndexEntry> PrefixIndex;
+
+struct CommandSlot {
+    QString name;
+    PrefixIndex arguments;
+};
+
+struct Registry {
+    QMap<QString, CommandInfo> definitions;
+    QStringList commands; // Definition order
+    QStringList starterCommands;
 
-QMap<QString, CommandInfo> commandRegistry::getCommandDefinitions() {
-    static QMap<QString, CommandInfo> commands = {
+    bool indexDirty = true;
+    PrefixIndex commandIndex; // rank is also the slot in commandSlots
+    QVector<CommandSlot> commandSlots;
+};
+
+Registry createRegistry()
+{
+    Registry registry;
+    registry.starterCommands = {"summarise", "tone", "highlight"};
+
+    const QList<CommandInfo> builtins = {
         {
-            "summarise", 
-            {
-                "summarise",
-                "Summarize text with specified compression ratio",
-                {"<ratio>"},
-                "summarise <ratio> - ratio between 0.1 and 1.0 (e.g., summarise 0.3)"
-            }
+            "summarise",
+            "Summarize text with specified compression ratio",
+            {"<ratio>"},
+            "summarise <ratio> - ratio between 0.1 and 1.0 (e.g., summarise 0.3)",
+            {"10", "25", "50", "75"}
         },
         {
-            "tone", 
-            {
-                "tone",
-                "Change or analyze text tone",
-                {"formal", "casual", "playful"},
-                "tone <style> - changes text tone (formal, casual, playful)"
-            }
+            "tone",
+            "Change or analyze text tone",
+            {"formal", "casual", "playful"},
+            "tone <style> - changes text tone (formal, casual, playful)",
+            {"formal", "casual", "playful"}
         },
         {
-            "font", 
-            {
-                "font",
-                "Change font family of selected text",
-                {"<font-name>"},
-                "font <font-name> - changes font (e.g., font Arial, font Times)"
-            }
+            "font",
+            "Change font family of selected text",
+            {"<font-name>"},
+            "font <font-name> - changes font (e.g., font Arial, font Times)",
+            {"Arial", "Calibri", "Georgia", "Verdana"}
         },
         {
-            "highlight", 
-            {
-                "highlight",
-                "Highlight specific elements in text",
-                {"keywords", "grammar"},
-                "highlight <type> - highlights keywords or grammar issues"
-            }
+            "highlight",
+            "Highlight specific elements in text",
+            {"keywords", "grammar"},
+            "highlight <type> - highlights keywords or grammar issues",
+            {"keywords", "grammar"}
         },
         {
-            "keywords", 
-            {
-                "keywords",
-                "Extract key words and phrases from text",
-                {},
-                "keywords - extracts important keywords from selected text"
-            }
+            "keywords",
+            "Extract key words and phrases from text",
+            {},
+            "keywords - extracts important keywords from selected text",
+            {}
         },
         {
-            "rephrase", 
-            {
-                "rephrase",
-                "Rephrase text in different words",
-                {},
-                "rephrase - rewrites selected text with different phrasing"
-            }
+            "rephrase",
+            "Rephrase text in different words",
+            {},
+            "rephrase - rewrites selected text with different phrasing",
+            {}
         },
         {
-            "rewrite", 
-            {
-                "rewrite",
-                "Completely rewrite text with improved style",
-                {},
-                "rewrite - completely rewrites selected text for better clarity"
-            }
+            "rewrite",
+            "Completely rewrite text with improved style",
+            {},
+            "rewrite - completely rewrites selected text for better clarity",
+            {}
         }
     };
-    return commands;
+
+    for (const CommandInfo& info : builtins) {
+        registry.definitions.insert(info.name, info);
+        registry.commands << info.name;
+    }
+    return registry;
+}
+
+Registry& registry()
+{
+    static Registry instance = createRegistry();
+    return instance;
+}
+
+bool entryLess(const IndexEntry& a, const IndexEntry& b)
+{
+    return a.key < b.key;
+}
+
+bool keyBefore(const IndexEntry& entry, QStringView prefix)
+{
+    return QStringView(entry.key).compare(prefix, Qt::CaseInsensitive) < 0;
+}
+
+void buildIndex(Registry& registry)
+{
+    registry.commandIndex.clear();
+    registry.commandSlots.clear();
+    registry.commandIndex.reserve(registry.commands.size());
+    registry.commandSlots.reserve(registry.commands.size());
+
+    for (int slot = 0; slot < registry.commands.size(); ++slot) {
+        const CommandInfo& info = registry.definitions[registry.commands[slot]];
+        registry.commandIndex.append({info.name.toLower(), info.name, slot});
+
+        CommandSlot commandSlot;
+        commandSlot.name = info.name;
+        for (int i = 0; i < info.completions.size(); ++i) {
+            const QString& option = info.completions[i];
+            commandSlot.arguments.append({option.toLower(), info.name + " " + option, i});
+        }
+        std::sort(commandSlot.arguments.begin(), commandSlot.arguments.end(), entryLess);
+        registry.commandSlots.append(commandSlot);
+    }
+
+    std::sort(registry.commandIndex.begin(), registry.commandIndex.end(), entryLess);
+    registry.indexDirty = false;
+}
+
+const Registry& indexedRegistry()
+{
+    Registry& instance = registry();
+    if (instance.indexDirty) {
+        buildIndex(instance);
+    }
+    return instance;
+}
+
+// Appends the best-ranked completions for every key starting with prefix.
+// Candidates are ranked in a fixed buffer; the only allocation is the result.
+void collectMatches(const PrefixIndex& index, QStringView prefix, int limit, QStringList& out)
+{
+    const IndexEntry* best[MAX_ARGUMENT_SUGGESTIONS];
+    limit = qMin(limit, MAX_ARGUMENT_SUGGESTIONS);
+    int count = 0;
+
+    auto it = std::lower_bound(index.begin(), index.end(), prefix, keyBefore);
+    for (; it != index.end() && QStringView(it->key).startsWith(prefix, Qt::CaseInsensitive); ++it) {
+        if (count == limit && best[count - 1]->rank <= it->rank) {
+            continue;
+        }
+
+        int pos = count < limit ? count++ : count - 1;
+        while (pos > 0 && best[pos - 1]->rank > it->rank) {
+            best[pos] = best[pos - 1];
+            --pos;
+        }
+        best[pos] = &*it;
+    }
+
+    out.reserve(out.size() + count);
+    for (int i = 0; i < count; ++i) {
+        out << best[i]->completion;
+    }
+}
+
+const CommandSlot* findCommand(const Registry& registry, QStringView name)
+{
+    auto it = std::lower_bound(registry.commandIndex.begin(), registry.commandIndex.end(), name, keyBefore);
+    if (it != registry.commandIndex.end() && QStringView(it->key).compare(name, Qt::CaseInsensitive) == 0) {
+        return &registry.commandSlots[it->rank];
+    }
+    return nullptr;
+}
+
+} // namespace
+
+const QStringList& commandRegistry::getAllCommands () {
+    return registry().commands;
+}
+
+const QMap<QString, CommandInfo>& commandRegistry::getCommandDefinitions() {
+    return registry().definitions;
+}
+
+void commandRegistry::registerCommand(const CommandInfo& info) {
+    Registry& instance = registry();
+    if (!instance.definitions.contains(info.name)) {
+        instance.commands << info.name;
+    }
+    instance.definitions.insert(info.name, info);
+    instance.indexDirty = true;
 }
 
 QStringList commandRegistry::getCommandArguments(const QString& command) {
-    QMap<QString, CommandInfo> definitions = getCommandDefinitions();
-    if (definitions.contains(command)) {
-        return definitions[command].arguments;
+    const QMap<QString, CommandInfo>& definitions = registry().definitions;
+    auto it = definitions.constFind(command);
+    if (it != definitions.constEnd()) {
+        return it->arguments;
     }
     return {};
 }
 
 QString commandRegistry::getCommandUsage(const QString& command) {
-    QMap<QString, CommandInfo> definitions = getCommandDefinitions();
-    if (definitions.contains(command)) {
-        return definitions[command].usage;
+    const QMap<QString, CommandInfo>& definitions = registry().definitions;
+    auto it = definitions.constFind(command);
+    if (it != definitions.constEnd()) {
+        return it->usage;
     }
     return "";
 }
 
 QStringList commandRegistry::getContextualSuggestions(const QString& input) {
-    QString trimmedInput = input.trimmed();
+    const Registry& instance = indexedRegistry();
+    QStringView trimmedInput = QStringView(input).trimmed();
     QStringList suggestions;
-    
-    qDebug() << "CommandRegistry: Getting suggestions for input:" << trimmedInput;
-    
+
     if (trimmedInput.isEmpty()) {
         // Show only a few starter commands when empty
-        suggestions << "summarise" << "tone" << "highlight";
-        qDebug() << "CommandRegistry: Empty input, showing starter commands:" << suggestions;
-        return suggestions;
+        return instance.starterCommands;
     }
-    
-    // Split input to analyze command vs arguments
-    QStringList parts = trimmedInput.split(' ', Qt::KeepEmptyParts);
-    qDebug() << "CommandRegistry: Input parts:" << parts << "Count:" << parts.size();
-    
-    if (parts.size() == 1) {
+
+    int space = trimmedInput.indexOf(' ');
+    if (space < 0) {
         // User is typing a command name - show ONLY matching commands (like Minecraft)
-        QString partial = parts[0].toLower();
-        QStringList allCommands = getAllCommands();
-        
-        // Find all matching commands but keep them minimal
-        for (const QString& cmd : allCommands) {
-            if (cmd.startsWith(partial, Qt::CaseInsensitive)) {
-                suggestions << cmd;
-            }
-        }
-        
-        // Limit to 3 suggestions max for clean UI
-        if (suggestions.size() > 3) {
-            suggestions = suggestions.mid(0, 3);
-        }
-        
-        qDebug() << "CommandRegistry: Command suggestions:" << suggestions;
+        collectMatches(instance.commandIndex, trimmedInput, MAX_COMMAND_SUGGESTIONS, suggestions);
+        return suggestions;
+    }
+
+    // User has typed command + space - show argument completions for the word after it
+    QStringView commandName = trimmedInput.left(space);
+    QStringView currentArg = trimmedInput.mid(space + 1);
+    int argEnd = currentArg.indexOf(' ');
+    if (argEnd >= 0) {
+        currentArg = currentArg.left(argEnd);
+    }
+
+    const CommandSlot* slot = findCommand(instance, commandName);
+    if (!slot) {
+        return suggestions;
+    }
+
+    if (slot->arguments.isEmpty()) {
+        // For commands without arguments, just suggest the command itself
+        suggestions << slot->name;
     } else {
-        // User has typed command + space - show argument completions
-        QString commandName = parts[0].toLower();
-        QString currentArg = parts.size() > 1 ? parts[1] : "";
-        
-        qDebug() << "CommandRegistry: Command:" << commandName << "Current arg:" << currentArg;
-        
-        if (commandName == "summarise") {
-            // Show argument options that start with current input
-            QStringList options = {"10", "25", "50", "75"};
-            for (const QString& option : options) {
-                if (currentArg.isEmpty() || option.startsWith(currentArg)) {
-                    suggestions << commandName + " " + option;
-                }
-            }
-        } else if (commandName == "tone") {
-            QStringList options = {"formal", "casual", "playful"};
-            for (const QString& option : options) {
-                if (currentArg.isEmpty() || option.startsWith(currentArg, Qt::CaseInsensitive)) {
-                    suggestions << commandName + " " + option;
-                }
-            }
-        } else if (commandName == "font") {
-            QStringList options = {"Arial", "Calibri", "Georgia", "Verdana"};
-            for (const QString& option : options) {
-                if (currentArg.isEmpty() || option.startsWith(currentArg, Qt::CaseInsensitive)) {
-                    suggestions << commandName + " " + option;
-                }
-            }
-        } else if (commandName == "highlight") {
-            QStringList options = {"keywords", "grammar"};
-            for (const QString& option : options) {
-                if (currentArg.isEmpty() || option.startsWith(currentArg, Qt::CaseInsensitive)) {
-                    suggestions << commandName + " " + option;
-                }
-            }
-        } else {
-            // For commands without arguments, just suggest the command itself
-            QStringList allCommands = getAllCommands();
-            if (allCommands.contains(commandName)) {
-                suggestions << commandName;
-            }
-        }
-        
-        qDebug() << "CommandRegistry: Argument suggestions:" << suggestions;
+        collectMatches(slot->arguments, currentArg, MAX_ARGUMENT_SUGGESTIONS, suggestions);
     }
-    
+
     return suggestions;
-}
\ No newline at end of file
+}
@@ -9,17 +9,24 @@ struct CommandInfo {
     QString description;
     QStringList arguments;
     QString usage;
+    QStringList completions; // Argument values offered while typing, best first
 };
 
+// Command definitions plus a prefix index over command names and their
+// argument vocabularies. The index is built once from the definitions and
+// rebuilt lazily after registerCommand().
 class commandRegistry {
 
 public:
-    static QStringList getAllCommands();
-    static QMap<QString, CommandInfo> getCommandDefinitions();
+    static const QStringList& getAllCommands();
+    static const QMap<QString, CommandInfo>& getCommandDefinitions();
     static QStringList getCommandArguments(const QString& command);
     static QString getCommandUsage(const QString& command);
     static QStringList getContextualSuggestions(const QString& input);
 
+    // Adds a command, or replaces the one with the same name
+    static void registerCommand(const CommandInfo& info);
+
 };
 
 #endif // COMMANDREGISTRY_H
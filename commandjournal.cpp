@@ -0,0 +1,218 @@
+#include "commandjournal.h"
+#include <QCryptographicHash>
+#include <QJsonDocument>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QSet>
+#include <QDebug>
+
+const int CommandJournal::MAX_ENTRIES = 64; // Twice the scheduler's default queue; past it, held commands wait unjournalled
+
+CommandJournal::CommandJournal()
+    : nextId(1)
+{
+}
+
+bool CommandJournal::open(const QString& path)
+{
+    if (log.isOpen()) {
+        log.close();
+    }
+    lock.reset();
+    entries.clear();
+    directory = path;
+    if (path.isEmpty()) {
+        return false;
+    }
+
+    if (!QDir().mkpath(path + "/texts")) {
+        qWarning() << "CommandJournal: Could not create journal directory" << path;
+        directory.clear();
+        return false;
+    }
+
+    // Never stale by age: the editor holds it for its whole session. A lock
+    // left by a crashed editor is still taken over, its process is gone.
+    lock.reset(new QLockFile(path + "/journal.lock"));
+    lock->setStaleLockTime(0);
+    if (!lock->tryLock()) {
+        qWarning() << "CommandJournal: ❌" << path << "is in use by another editor - journal disabled";
+        lock.reset();
+        directory.clear();
+        return false;
+    }
+
+    // Replay the log; a line torn by a crash is skipped
+    QFile existing(logPath());
+    if (existing.open(QIODevice::ReadOnly)) {
+        while (!existing.atEnd()) {
+            QJsonObject record = QJsonDocument::fromJson(existing.readLine()).object();
+            quint64 id = quint64(record.value("id").toDouble());
+            if (id == 0) {
+                continue;
+            }
+            nextId = qMax(nextId, id + 1);
+            if (record.value("op").toString() == "done") {
+                entries.remove(id);
+                continue;
+            }
+
+            Entry entry;
+            entry.id = id;
+            entry.command = record.value("command").toString();
+            entry.textHash = record.value("text").toString();
+            entry.recorded = qint64(record.value("time").toDouble());
+            if (!entry.command.isEmpty() && QFile::exists(textPath(entry.textHash))) {
+                entries.insert(id, entry);
+            }
+        }
+    }
+
+    compact();
+    if (!log.isOpen()) {
+        qWarning() << "CommandJournal: Could not open" << logPath() << "- journal disabled";
+        lock.reset();
+        directory.clear();
+        return false;
+    }
+    qDebug() << "CommandJournal: Opened at" << path << "with" << entries.size() << "pending commands";
+    return true;
+}
+
+quint64 CommandJournal::append(const QString& command, const QString& text)
+{
+    if (!log.isOpen() || entries.size() >= MAX_ENTRIES) {
+        return 0;
+    }
+
+    // Snapshots are content-addressed, several commands on one text share it
+    Entry entry;
+    entry.id = nextId++;
+    entry.command = command;
+    entry.textHash = hashText(text);
+    entry.recorded = QDateTime::currentMSecsSinceEpoch();
+    QString snapshot = textPath(entry.textHash);
+    if (!QFile::exists(snapshot)) {
+        QSaveFile file(snapshot);
+        if (!file.open(QIODevice::WriteOnly) || file.write(text.toUtf8()) < 0 || !file.commit()) {
+            qWarning() << "CommandJournal: Could not write text snapshot" << snapshot;
+            return 0;
+        }
+    }
+
+    QJsonObject record;
+    record["op"] = "add";
+    record["id"] = double(entry.id);
+    record["command"] = entry.command;
+    record["text"] = entry.textHash;
+    record["time"] = double(entry.recorded);
+    if (!writeRecord(record)) {
+        return 0;
+    }
+    entries.insert(entry.id, entry);
+    return entry.id;
+}
+
+void CommandJournal::markDone(quint64 id)
+{
+    if (!entries.remove(id)) {
+        return;
+    }
+
+    if (entries.isEmpty()) {
+        compact(); // Nothing left to replay: start the log afresh
+        return;
+    }
+    QJsonObject record;
+    record["op"] = "done";
+    record["id"] = double(id);
+    writeRecord(record);
+}
+
+QVector<CommandJournal::Entry> CommandJournal::pending() const
+{
+    QVector<Entry> result;
+    result.reserve(entries.size());
+    for (const Entry& entry : entries) {
+        result.append(entry);
+    }
+    return result;
+}
+
+bool CommandJournal::readText(const Entry& entry, QString& text) const
+{
+    QFile file(textPath(entry.textHash));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    text = QString::fromUtf8(file.readAll());
+    return true;
+}
+
+QString CommandJournal::hashText(const QString& text)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(QByteArray::fromRawData(reinterpret_cast<const char*>(text.constData()),
+                                         text.size() * int(sizeof(QChar))));
+    return QString::fromLatin1(hash.result().toHex());
+}
+
+bool CommandJournal::writeRecord(const QJsonObject& record)
+{
+    // One line per record, flushed so a crash loses at most the line being written
+    QByteArray line = QJsonDocument(record).toJson(QJsonDocument::Compact);
+    line.append('\n');
+    if (log.write(line) != line.size() || !log.flush()) {
+        qWarning() << "CommandJournal: Could not append to" << logPath();
+        return false;
+    }
+    return true;
+}
+
+void CommandJournal::compact()
+{
+    if (log.isOpen()) {
+        log.close();
+    }
+
+    QSaveFile file(logPath());
+    if (file.open(QIODevice::WriteOnly)) {
+        for (const Entry& entry : entries) {
+            QJsonObject record;
+            record["op"] = "add";
+            record["id"] = double(entry.id);
+            record["command"] = entry.command;
+            record["text"] = entry.textHash;
+            record["time"] = double(entry.recorded);
+            file.write(QJsonDocument(record).toJson(QJsonDocument::Compact) + '\n');
+        }
+        file.commit();
+    }
+
+    // Drop the snapshots no pending command refers to
+    QSet<QString> referenced;
+    for (const Entry& entry : entries) {
+        referenced.insert(entry.textHash);
+    }
+    QDir texts(directory + "/texts");
+    for (const QFileInfo& info : texts.entryInfoList({"*.txt"}, QDir::Files)) {
+        if (!referenced.contains(info.completeBaseName())) {
+            QFile::remove(info.absoluteFilePath());
+        }
+    }
+
+    log.setFileName(logPath());
+    log.open(QIODevice::WriteOnly | QIODevice::Append);
+}
+
+QString CommandJournal::logPath() const
+{
+    return directory + "/journal.jsonl";
+}
+
+QString CommandJournal::textPath(const QString& hash) const
+{
+    return directory + "/texts/" + hash + ".txt";
+}
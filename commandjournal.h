@@ -0,0 +1,64 @@
+#ifndef COMMANDJOURNAL_H
+#define COMMANDJOURNAL_H
+
+#include <QString>
+#include <QMap>
+#include <QVector>
+#include <QFile>
+#include <QJsonObject>
+#include <QLockFile>
+#include <memory>
+
+// Append-only journal of server commands accepted while the backend was
+// unreachable, so they survive a backend or editor restart and can be
+// replayed once it is back. Each entry records the command and the hash of
+// the text it was run on; the text snapshot is stored once per hash next to
+// the log. Finished entries get a second "done" record, and the log is
+// rewritten without them whenever it is opened or runs empty.
+//
+// One editor owns a journal directory at a time, through a lock file in it;
+// other editors sharing the directory (e.g. with one daemon backend) get no
+// journal instead of replaying or compacting away each other's commands.
+class CommandJournal
+{
+public:
+    struct Entry {
+        quint64 id = 0;
+        QString command;
+        QString textHash;
+        qint64 recorded = 0; // ms since the epoch
+    };
+
+    CommandJournal();
+
+    // Reads the pending entries left in the directory; an empty path closes the
+    // journal. Fails while another running editor holds the directory.
+    bool open(const QString& directory);
+    bool isOpen() const { return log.isOpen(); }
+
+    // Returns the entry's id, or 0 when the journal is closed or full
+    quint64 append(const QString& command, const QString& text);
+    void markDone(quint64 id);
+
+    QVector<Entry> pending() const; // Oldest first
+    int pendingCount() const { return entries.size(); }
+    bool readText(const Entry& entry, QString& text) const;
+
+    static QString hashText(const QString& text);
+
+    static const int MAX_ENTRIES;
+
+private:
+    bool writeRecord(const QJsonObject& record);
+    void compact();
+    QString logPath() const;
+    QString textPath(const QString& hash) const;
+
+    QString directory;
+    std::unique_ptr<QLockFile> lock; // Held while open
+    QFile log; // Open for appending
+    QMap<quint64, Entry> entries; // Pending, by id
+    quint64 nextId;
+};
+
+#endif // COMMANDJOURNAL_H
@@ -1,21 +1,203 @@
 #include "commandmanager.h"
 #include "servermanager.h"
 #include "commandRegistry.h"
+#include "fuzzymatcher.h"
+#include "eventlog.h"
+#include "tracer.h"
+#include <QCoreApplication>
 #include <QDebug>
 #include <QJsonDocument>
 #include <QDateTime>
+#include <QStandardPaths>
+#include <QSaveFile>
+#include <QFile>
+#include <QDir>
+#include <QFileInfo>
+#include <QElapsedTimer>
+#include <QTimer>
+#include <QSet>
 #include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <memory>
+
+const QString CommandManager::LOCAL_ENDPOINT = "local";
+const QString CommandManager::COORDINATOR_ENDPOINT = "coordinator";
+const QString CommandManager::BATCH_ENDPOINT = "/api/batch";
+const QString CommandManager::REPLAY_ENDPOINT = "replay";
+const int CommandManager::REPLAY_BATCH_SIZE = 8; // Commands per replayed batch; one batch is sent at a time
+const int CommandManager::MAX_BATCH_SIZE = 8; // Server commands per batch, and batched commands running at once
+const int CommandManager::CHUNKING_THRESHOLD = 8000; // Characters; the backend rejects single requests over 10,000
+const int CommandManager::SEGMENT_TOKEN_BUDGET = 900; // Stays clear of DistilBART's 1024-token window
+const int CommandManager::CHARS_PER_TOKEN_ESTIMATE = 4; // Only without the tokenizer files
+const int CommandManager::MAX_REDUCE_DEPTH = 3;
+const int CommandManager::MIN_SUMMARY_WORDS = 10;
+const int CommandManager::MAX_SUGGESTIONS = 3; // Same cap as the registry's command suggestions
+const double CommandManager::FUZZY_SCORE_CUTOFF = 60.0; // fuzz.ratio score; "sumarise" vs "summarise" is 94
+const int CommandManager::LOCAL_FUZZY_CORPUS_LIMIT = 50000; // Scoring stays well under a millisecond below this
+const int CommandManager::DEFAULT_SUGGESTION_DEBOUNCE = 25; // Coalesces key repeat and fast typing bursts
+const int CommandManager::DEFAULT_DEADLINE = 30000;
+const int CommandManager::SPECULATIVE_COMMANDS = 2; // Summarise and keywords cover most sessions
+
+// State of one chunked pass over a text: the chunks still to send, the results
+// gathered so far and the per-chunk requests currently scheduled. Map-reduce
+// summarisation chains several passes under the same ticket.
+struct CommandManager::ChunkedRun {
+    Ticket ticket;
+    QString command;
+    QString baseCommand;
+    QJsonObject targetArgs;  // Arguments the user asked for
+    QJsonObject requestArgs; // Arguments sent with each chunk
+    QString scope;
+    int depth = 0;
+    QVector<DocumentModel::Chunk> chunks;
+    QVector<QJsonObject> results;
+    QVector<qint64> chunkTimes; // Milliseconds per chunk request, -1 when served from cache
+    QList<int> pending;
+    QSet<Ticket> activeChildren;
+    int remaining = 0;
+    int reprocessed = 0;
+    bool finished = false;
+    QElapsedTimer timer;
+    std::function<void(bool ok, const QJsonObject& response, const QString& error)> onDone;
+};
+
+// Server commands of one executeBatch() call, or commands held for the server
+// and replayed together. Every command keeps its own ticket; the parts are sent
+// as one /api/batch request once all the batch's tickets have started (or
+// dropped out).
+struct CommandManager::BatchRun {
+    struct Part {
+        Ticket ticket;
+        QString command;
+        QString baseCommand;
+        QJsonObject args;
+        QString text;
+        std::function<void(CommandResult, const QString&)> onComplete;
+    };
+    
+    QString endpoint; // Scheduler endpoint the batch's tickets wait on
+    QVector<Part> parts;
+    int members = 0;        // Tickets submitted to the batch
+    int unstarted = 0;      // Tickets submitted whose task has not run yet
+    bool submitting = true; // executeBatch() is still adding commands
+};
+
+static QString chunkCacheKey(const QString& baseCommand, const QJsonObject& args, const DocumentModel::Chunk& chunk,
+                             const QString& producer)
+{
+    return ResultCache::makeKey(baseCommand + "#chunk", args, chunk.hash, producer);
+}
+
+static int countWords(const QString& text)
+{
+    int words = 0;
+    bool inWord = false;
+    for (QChar c : text) {
+        if (c.isSpace()) {
+            inWord = false;
+        } else if (!inWord) {
+            inWord = true;
+            ++words;
+        }
+    }
+    return words;
+}
+
+static void appendSuggestions(QStringList& suggestions, const QStringList& extra, int limit)
+{
+    for (const QString& suggestion : extra) {
+        if (suggestions.size() >= limit) {
+            break;
+        }
+        if (!suggestions.contains(suggestion)) {
+            suggestions << suggestion;
+        }
+    }
+}
+
+// Number formatting for formatServerResponse() that appends straight to the
+// output instead of going through a temporary QString
+static void appendNumber(QString& out, qint64 value)
+{
+    char digits[24];
+    std::to_chars_result converted = std::to_chars(digits, digits + sizeof(digits), value);
+    out += QLatin1String(digits, int(converted.ptr - digits));
+}
+
+// Same text as QString::number(value, 'f', decimals)
+static void appendFixed(QString& out, double value, int decimals)
+{
+#if defined(__cpp_lib_to_chars)
+    char digits[64];
+    std::to_chars_result converted = std::to_chars(digits, digits + sizeof(digits), value,
+                                                   std::chars_format::fixed, decimals);
+    if (converted.ec == std::errc()) {
+        out += QLatin1String(digits, int(converted.ptr - digits));
+        return;
+    }
+#endif
+    out += QString::number(value, 'f', decimals);
+}
+
+static QJsonObject summariseArgs(double ratio)
+{
+    QJsonObject args;
+    args["ratio"] = ratio;
+    args["min_ratio"] = qMax(0.05, ratio * 0.9);
+    args["max_ratio"] = qMin(1.0, ratio * 1.1);
+    return args;
+}
 
 CommandManager::CommandManager(ServerManager* serverManager, QObject *parent)
     : QObject(parent)
     , server(serverManager)
-    , executionState(Idle)
+    , scheduler(new CommandScheduler(this))
+    , streamingEnabled(false)
+    , localFuzzyMatching(true)
+    , suggestionTimer(new QTimer(this))
+    , suggestionGeneration(0)
+    , suggestionSearch(0)
+    , resultCacheEnabled(true)
+    , requestCoalescing(true)
+    , speculativeExecution(false)
 {
+    static int instanceCount = 0;
+    requestIdPrefix = QString("%1-%2").arg(QCoreApplication::applicationPid()).arg(instanceCount++);
+
     initializeCommands();
     
+    // Token counts and chunk sizes are checked here, before anything is sent
+    QString modelDirectory = BpeTokenizer::findModelDirectory();
+    if (modelDirectory.isEmpty() || !tokenizer.load(modelDirectory)) {
+        qDebug() << "CommandManager: ❌ Tokenizer files not found, estimating" << CHARS_PER_TOKEN_ESTIMATE
+                 << "characters per token";
+    }
+    
+    suggestionTimer->setSingleShot(true);
+    suggestionTimer->setInterval(DEFAULT_SUGGESTION_DEBOUNCE);
+    connect(suggestionTimer, &QTimer::timeout, this, &CommandManager::flushPendingSuggestions);
+    
+    // Local commands never wait on each other. Summarise allows two requests so
+    // map-reduce segments overlap; the sampling endpoints run one at a time.
+    scheduler->setDefaultConcurrency(2);
+    scheduler->setEndpointConcurrency(LOCAL_ENDPOINT, 0);
+    scheduler->setEndpointConcurrency(COORDINATOR_ENDPOINT, 0);
+    // A batch's parts hold their slots until it is sent, so the limit is one full batch
+    scheduler->setEndpointConcurrency(BATCH_ENDPOINT, MAX_BATCH_SIZE);
+    scheduler->setEndpointConcurrency(REPLAY_ENDPOINT, REPLAY_BATCH_SIZE);
+    scheduler->setEndpointConcurrency("/api/summarise", 2);
+    scheduler->setEndpointConcurrency("/api/rephrase", 1);
+    scheduler->setEndpointConcurrency("/api/rewrite", 1);
+    
+    connect(scheduler, &CommandScheduler::stateChanged,
+            this, &CommandManager::handleSchedulerStateChange);
+    
     // Connect to server status changes
     connect(server, &ServerManager::statusChanged, 
             this, &CommandManager::handleServerStatusChange);
+    connect(server, &ServerManager::commandModelsChanged,
+            this, &CommandManager::handleServerStatusChange);
     
     // Update available commands based on current server status
     handleServerStatusChange();
@@ -32,35 +214,63 @@ void CommandManager::initializeCommands()
         "summarise",
         "Generate a summary of the input text. Usage: 'summarise' (20-30%) or 'summarise <percentage>' (e.g., 'summarise 50' for 45-55% range)",
         true,  // requires server
-        true   // requires input
+        true,  // requires input
+        true,  // streams partial output
+        true,  // cacheable
+        true,  // chunked for large documents
+        false, // shown next to the text
+        45000, // beam search over up to 1024 tokens
+        1024   // DistilBART's window
     };
     
     commands["tone"] = {
         "tone",
         "Analyze and adjust the tone of the text",
         true,  // requires server
-        true   // requires input
+        true,  // requires input
+        false, // no streaming
+        true,  // cacheable
+        false, // not chunked
+        false, // shown next to the text
+        5000   // no model involved
     };
     
     commands["keywords"] = {
         "keywords",
         "Extract key words and phrases from the text",
         true,  // requires server
-        true   // requires input
+        true,  // requires input
+        false, // no streaming
+        true,  // cacheable
+        true,  // chunked for large documents
+        false, // shown next to the text
+        5000   // no model involved
     };
     
     commands["rephrase"] = {
         "rephrase",
         "Rephrase the text while maintaining meaning",
         true,  // requires server
-        true   // requires input
+        true,  // requires input
+        false, // no streaming
+        false, // not cacheable
+        false, // not chunked
+        true,  // replaces the text it was run on
+        20000, // 4 beams, but only up to 512 tokens
+        512    // backend truncates longer input
     };
     
     commands["rewrite"] = {
         "rewrite",
         "Rewrite the text with improved clarity and structure",
         true,  // requires server
-        true   // requires input
+        true,  // requires input
+        false, // no streaming
+        false, // not cacheable
+        false, // not chunked
+        true,  // replaces the text it was run on
+        20000, // 4 beams, but only up to 512 tokens
+        512    // backend truncates longer input
     };
     
     // Add local commands that don't require server
@@ -85,17 +295,92 @@ void CommandManager::handleServerStatusChange()
     
     bool serverReady = server->isReady();
     
+    QStringList unusable;
     for (auto it = commands.begin(); it != commands.end(); ++it) {
         const CommandInfo& info = it.value();
         
-        // Add command if it doesn't require server, or if server is ready
-        if (!info.requiresServer || serverReady) {
+        // Add command if it doesn't require server, or if server is ready. The
+        // backend loads a command's model on first use, so a model it can't
+        // load (not installed, or failing) only takes out its own commands.
+        if (info.requiresServer && !server->commandModel(it.key()).isUsable()) {
+            unusable << it.key();
+        } else if (!info.requiresServer || serverReady) {
             availableCommands.append(it.key());
         }
     }
     
     qDebug() << "CommandManager: Available commands updated:" << availableCommands.size() 
              << "of" << commands.size() << "(server ready:" << serverReady << ")";
+    
+    // Commands whose model will not load would wait in the queue for nothing
+    for (const QString& command : unusable) {
+        int dropped = scheduler->cancelQueued(QString("/api/%1").arg(command));
+        if (dropped > 0) {
+            qDebug() << "CommandManager: ❌ Dropped" << dropped << command << "commands, its model is"
+                     << server->commandModel(command).state;
+        }
+    }
+    
+    // Server commands issued while the backend is still starting wait in the
+    // queue and are released once it connects. If it fails instead they are
+    // dropped rather than left waiting indefinitely, unless they are journalled.
+    QStringList endpoints = serverEndpoints();
+    for (const QString& endpoint : endpoints) {
+        scheduler->setEndpointPaused(endpoint, !serverReady);
+    }
+    
+    if (server->getStatus() == ServerManager::Error && !journal.isOpen()) {
+        int dropped = 0;
+        for (const QString& endpoint : endpoints) {
+            dropped += scheduler->cancelQueued(endpoint);
+        }
+        if (dropped > 0) {
+            qDebug() << "CommandManager: ❌ Dropped" << dropped << "commands waiting for the server";
+        }
+    }
+}
+
+QStringList CommandManager::serverEndpoints() const
+{
+    QStringList endpoints{COORDINATOR_ENDPOINT, BATCH_ENDPOINT, REPLAY_ENDPOINT};
+    for (auto it = commands.constBegin(); it != commands.constEnd(); ++it) {
+        if (it->requiresServer) {
+            endpoints << QString("/api/%1").arg(it.key());
+        }
+    }
+    return endpoints;
+}
+
+bool CommandManager::isCommandDeferred(const QString& command) const
+{
+    QString baseCommand;
+    QJsonObject args;
+    if (!parseCommandWithArgs(command, baseCommand, args)) {
+        return false;
+    }
+    return getCommandInfo(baseCommand).requiresServer && !availableCommands.contains(baseCommand)
+           && (server->getStatus() != ServerManager::Error || journal.isOpen())
+           && server->commandModel(baseCommand).isUsable();
+}
+
+int CommandManager::countTokens(const QString& text) const
+{
+    if (!tokenizer.isLoaded()) {
+        return -1;
+    }
+    return text.isEmpty() ? 0 : tokenizer.countTokens(text) + BpeTokenizer::SPECIAL_TOKENS;
+}
+
+int CommandManager::countTokens(const QString& text, int limit) const
+{
+    if (!tokenizer.isLoaded()) {
+        return -1;
+    }
+    // prefixLength() stops at the budget, so the work is bounded by limit
+    if (tokenizer.prefixLength(text, limit - BpeTokenizer::SPECIAL_TOKENS) < text.size()) {
+        return limit + 1;
+    }
+    return countTokens(text);
 }
 
 QStringList CommandManager::getAllCommands() const
@@ -110,7 +395,18 @@ QStringList CommandManager::getValidCommands() const
 
 CommandManager::CommandInfo CommandManager::getCommandInfo(const QString& command) const
 {
-    return commands.value(command, {"", "", false, false});
+    auto it = commands.constFind(command);
+    if (it != commands.constEnd()) {
+        return it.value();
+    }
+    
+    // A full command line such as "summarise 30"
+    QString baseCommand;
+    QJsonObject args;
+    if (command.contains(' ') && parseCommandWithArgs(command, baseCommand, args)) {
+        return commands.value(baseCommand, {"", "", false, false});
+    }
+    return {"", "", false, false};
 }
 
 bool CommandManager::isCommandValid(const QString& command) const
@@ -126,88 +422,748 @@ bool CommandManager::isCommandValid(const QString& command) const
     return parseCommandWithArgs(command, baseCommand, args) && commands.contains(baseCommand);
 }
 
-void CommandManager::executeCommand(const QString& command, const QString& inputText,
-                                   std::function<void(CommandResult, const QString&)> callback)
+CommandManager::ExecutionState CommandManager::getExecutionState() const
 {
-    qDebug() << "CommandManager: Executing command:" << command;
+    ExecutionState state;
+    state.queued = scheduler->queuedCount();
+    state.inFlight = scheduler->inFlightCount();
+    // Speculation and commands replayed from an earlier session run unseen
+    auto unseen = [this, &state](Ticket ticket) {
+        if (scheduler->isInFlight(ticket)) {
+            state.inFlight--;
+        } else if (scheduler->isQueued(ticket)) {
+            state.queued--;
+        }
+    };
+    for (auto it = speculativeTickets.cbegin(); it != speculativeTickets.cend(); ++it) {
+        unseen(it.key());
+    }
+    for (Ticket ticket : restoredTickets) {
+        unseen(ticket);
+    }
+    return state;
+}
+
+void CommandManager::handleSchedulerStateChange(int queued, int inFlight)
+{
+    Q_UNUSED(queued);
+    Q_UNUSED(inFlight);
+    emit executionStateChanged(getExecutionState());
+}
+
+void CommandManager::setEndpointConcurrency(const QString& endpoint, int limit)
+{
+    scheduler->setEndpointConcurrency(endpoint, limit);
+}
+
+void CommandManager::setMaxQueueSize(int size)
+{
+    scheduler->setMaxQueueSize(size);
+}
+
+void CommandManager::rejectCommand(const QString& command, CommandResult result, const QString& error,
+                                   const std::function<void(CommandResult, const QString&)>& callback)
+{
+    qDebug() << "CommandManager: ❌" << error;
+    if (callback) callback(result, error);
+    emit commandExecuted(0, command, result, error);
+}
+
+CommandManager::Ticket CommandManager::executeCommand(const QString& command, const QString& inputText,
+                                                      std::function<void(CommandResult, const QString&)> callback)
+{
+    return submitCommand(command, inputText, callback, nullptr);
+}
+
+QVector<CommandManager::Ticket> CommandManager::executeBatch(const QStringList& commandList, const QString& inputText,
+    std::function<void(const QString&, CommandResult, const QString&)> callback)
+{
+    qDebug() << "CommandManager: Executing batch of" << commandList.size() << "commands";
     
-    // Check if already executing
-    if (executionState == Executing) {
-        QString error = "Cannot execute command: another command is already running";
-        qDebug() << "CommandManager: ❌" << error;
-        if (callback) callback(ExecutionError, error);
-        emit commandExecuted(command, ExecutionError, error);
-        return;
+    auto batch = std::make_shared<BatchRun>();
+    batch->endpoint = BATCH_ENDPOINT;
+    
+    QVector<Ticket> tickets;
+    for (const QString& command : commandList) {
+        // A batch larger than the endpoint's slots would wait for itself forever
+        if (batch->members >= MAX_BATCH_SIZE) {
+            batch->submitting = false;
+            if (batch->unstarted == 0) {
+                sendBatch(batch);
+            }
+            batch = std::make_shared<BatchRun>();
+            batch->endpoint = BATCH_ENDPOINT;
+        }
+        
+        std::function<void(CommandResult, const QString&)> commandCallback;
+        if (callback) {
+            commandCallback = [callback, command](CommandResult result, const QString& output) {
+                callback(command, result, output);
+            };
+        }
+        tickets.append(submitCommand(command, inputText, commandCallback, batch));
     }
     
-    // Set execution state
-    executionState = Executing;
-    emit executionStateChanged(executionState);
+    batch->submitting = false;
+    if (batch->unstarted == 0) {
+        sendBatch(batch);
+    }
+    return tickets;
+}
+
+CommandManager::Ticket CommandManager::submitCommand(const QString& command, const QString& inputText,
+                                                     std::function<void(CommandResult, const QString&)> callback,
+                                                     const std::shared_ptr<BatchRun>& batch, quint64 restoredId)
+{
+    qDebug() << "CommandManager: Executing command:" << command;
     
     // Parse and validate command
+    qint64 parseStart = Tracer::now();
     QString baseCommand;
     QJsonObject args;
+    bool parsed = parseCommandWithArgs(command, baseCommand, args);
+    qint64 parseEnd = Tracer::now();
     
-    if (!parseCommandWithArgs(command, baseCommand, args)) {
-        QString error = QString("Unknown command: %1").arg(command);
-        qDebug() << "CommandManager: ❌" << error;
-        
-        // Reset execution state
-        executionState = Idle;
-        emit executionStateChanged(executionState);
-        
-        if (callback) callback(InvalidCommand, error);
-        emit commandExecuted(command, InvalidCommand, error);
-        return;
+    if (!parsed) {
+        rejectCommand(command, InvalidCommand, QString("Unknown command: %1").arg(command), callback);
+        return 0;
     }
     
     CommandInfo info = getCommandInfo(baseCommand);
     
-    // Check if base command is currently available
-    if (!availableCommands.contains(baseCommand)) {
-        QString error = QString("Command '%1' is not available (server required but not ready)").arg(baseCommand);
-        qDebug() << "CommandManager: ❌" << error;
-        
-        // Reset execution state
-        executionState = Idle;
-        emit executionStateChanged(executionState);
-        
-        if (callback) callback(ServerError, error);
-        emit commandExecuted(command, ServerError, error);
-        return;
+    // Check if base command is currently available; server commands are held
+    // in the queue while the backend is still starting up
+    bool deferred = isCommandDeferred(command);
+    if (!availableCommands.contains(baseCommand) && !deferred) {
+        ServerManager::CommandModel model = server->commandModel(baseCommand);
+        QString reason = model.isUsable() ? QString("server required but not ready")
+                         : model.state == "missing" ? QString("the %1 model is not installed").arg(model.model)
+                         : QString("the %1 model failed to load").arg(model.model);
+        rejectCommand(command, ServerError,
+                      QString("Command '%1' is not available (%2)").arg(baseCommand, reason), callback);
+        return 0;
     }
     
     // Validate input requirements
     if (info.requiresInput && inputText.trimmed().isEmpty()) {
-        QString error = QString("Command '%1' requires input text").arg(baseCommand);
-        qDebug() << "CommandManager: ❌" << error;
+        rejectCommand(command, ValidationError,
+                      QString("Command '%1' requires input text").arg(baseCommand), callback);
+        return 0;
+    }
+    
+    // Local commands skip ahead of anything waiting on the server
+    bool requiresServer = info.requiresServer;
+    QString endpoint = requiresServer ? QString("/api/%1").arg(baseCommand) : LOCAL_ENDPOINT;
+    CommandScheduler::Priority priority = requiresServer ? CommandScheduler::Normal : CommandScheduler::High;
+    QString resultName = requiresServer ? command : baseCommand;
+    
+    // Identical command, arguments and text: answer from the cache, no round trip
+    // Model output is only cached once /health has named the engine producing it
+    QString cacheKey;
+    bool cacheHit = false;
+    QString cachedOutput;
+    QString producer = resultProducer(baseCommand);
+    if (info.cacheable && resultCacheEnabled && (info.maxInputTokens == 0 || !producer.isEmpty())) {
+        cacheKey = ResultCache::makeKey(baseCommand, args, inputText, producer);
+        cacheHit = resultCache.lookup(cacheKey, cachedOutput);
         
-        // Reset execution state
-        executionState = Idle;
-        emit executionStateChanged(executionState);
+        const ResultCache::Stats& stats = resultCache.stats();
+        qDebug() << "CommandManager: Cache" << (cacheHit ? "hit" : "miss") << "for" << command
+                 << "(hits:" << stats.hits << "misses:" << stats.misses << "evictions:" << stats.evictions << ")";
         
-        if (callback) callback(ValidationError, error);
-        emit commandExecuted(command, ValidationError, error);
-        return;
+        if (cacheHit) {
+            endpoint = LOCAL_ENDPOINT;
+            priority = CommandScheduler::High;
+        }
     }
     
-    // Create a wrapper callback that resets execution state
-    auto wrappedCallback = [this, callback](CommandResult result, const QString& output) {
-        // Reset execution state when command completes
-        executionState = Idle;
-        emit executionStateChanged(executionState);
+    // A real command takes the backend back from speculation
+    if (requiresServer && !cacheHit && !speculativeTickets.isEmpty()) {
+        cancelSpeculation(cacheKey);
+    }
+    
+    // Large documents are split into chunks; the coordinating job must not hold
+    // the endpoint slot its own chunk requests need
+    bool chunked = !cacheHit && requiresServer && info.supportsChunking && needsChunking(baseCommand, inputText);
+    if (chunked) {
+        endpoint = COORDINATOR_ENDPOINT;
+    }
+    
+    // Input the backend would silently truncate is turned down before it is sent
+    if (!cacheHit && requiresServer && !chunked && info.maxInputTokens > 0 && tokenizer.isLoaded()
+        && tokenizer.prefixLength(inputText, info.maxInputTokens - BpeTokenizer::SPECIAL_TOKENS) < inputText.size()) {
+        rejectCommand(command, ValidationError,
+                      QString("Text is %L1 tokens, '%2' reads at most %L3; select a shorter passage")
+                          .arg(countTokens(inputText)).arg(baseCommand).arg(info.maxInputTokens),
+                      callback);
+        return 0;
+    }
+    
+    // Plain server requests of a batch go out together in one /api/batch call.
+    // So do the ones held for the server: a new replay batch starts once the
+    // current one is full or has begun to run.
+    std::shared_ptr<BatchRun> batchRun = !cacheHit && requiresServer && !chunked ? batch : nullptr;
+    if (!batchRun && deferred && !cacheHit && !chunked) {
+        if (!replayBatch || !replayBatch->parts.isEmpty() || replayBatch->unstarted >= REPLAY_BATCH_SIZE) {
+            replayBatch = std::make_shared<BatchRun>();
+            replayBatch->endpoint = REPLAY_ENDPOINT;
+            replayBatch->submitting = false;
+        }
+        batchRun = replayBatch;
+    }
+    if (batchRun) {
+        endpoint = batchRun->endpoint;
+        batchRun->members++;
+        batchRun->unstarted++;
+    }
+    
+    // Held commands are journalled so they outlive a backend or editor restart.
+    // Only cacheable ones: a replay after a restart has nobody to show its result to.
+    bool restored = restoredId != 0;
+    quint64 journalId = restored ? restoredId
+                        : deferred && !cacheHit && info.cacheable ? journal.append(command, inputText) : 0;
+    
+    // Set once the ticket is cancelled so a late server reply is dropped
+    auto cancelled = std::make_shared<bool>(false);
+    auto started = std::make_shared<bool>(false);
+    auto answered = std::make_shared<bool>(cacheHit); // Reply came from the cache
+    auto streamed = std::make_shared<bool>(false); // Greedy output, not what the cache should hold
+    qint64 submitTime = Tracer::now();
+    
+    auto task = [this, command, baseCommand, args, inputText, resultName, requiresServer, callback, cancelled, started,
+                 cacheKey, answered, streamed, cachedOutput, chunked, batchRun, journalId, restored,
+                 parseStart, parseEnd, submitTime]
+                (Ticket ticket, CommandScheduler::Completion done) {
+        *started = true;
+        if (restored) {
+            restoredTickets.insert(ticket); // The scheduler may start the task before submit() returns
+        }
+        QString traceId = requestId(ticket);
+        Tracer* tracer = Tracer::instance();
+        tracer->beginTrace(traceId, baseCommand, parseStart);
+        tracer->addSpan(traceId, "parse", parseStart, parseEnd);
+        tracer->addSpan(traceId, "queue_wait", submitTime, Tracer::now());
+        
+        auto onComplete = [this, ticket, resultName, callback, cancelled, done, cacheKey, answered, streamed,
+                           traceId, journalId, restored]
+                          (CommandResult result, const QString& output) {
+            serverRequests.remove(ticket);
+            restoredTickets.remove(ticket);
+            if (result == Success && !cacheKey.isEmpty() && !*answered && !*streamed) {
+                resultCache.insert(cacheKey, output);
+            }
+            if (journalId != 0) {
+                journal.markDone(journalId);
+            }
+            Tracer::instance()->finishTrace(traceId, result == Success);
+            if (!*cancelled && !restored) {
+                if (callback) callback(result, output);
+                emit commandExecuted(ticket, resultName, result, output);
+            }
+            done();
+        };
         
-        if (callback) callback(result, output);
+        // A speculative or identical request may have filled the cache while this one waited
+        QString latelyCached;
+        if (*answered) {
+            onComplete(Success, cachedOutput);
+        } else if (requiresServer && !cacheKey.isEmpty() && resultCache.contains(cacheKey)
+                   && resultCache.lookup(cacheKey, latelyCached)) {
+            *answered = true;
+            onComplete(Success, latelyCached);
+        } else if (chunked) {
+            executeChunkedCommand(ticket, command, baseCommand, args, inputText, onComplete);
+        } else if (joinInflightRequest(cacheKey, onComplete)) {
+            // An identical request is already on its way; its reply answers this one too
+            qDebug() << "CommandManager: Ticket" << ticket << "joined an identical request in flight";
+        } else if (batchRun) {
+            batchRun->parts.append({ticket, command, baseCommand, args, inputText,
+                                    trackInflightRequest(cacheKey, onComplete)});
+        } else if (requiresServer) {
+            *streamed = streamsReply(ticket, baseCommand);
+            executeServerCommand(ticket, command, inputText, trackInflightRequest(cacheKey, onComplete));
+        } else {
+            executeLocalCommand(baseCommand, inputText, onComplete);
+        }
+        
+        if (batchRun) {
+            batchPartStarted(batchRun);
+        }
+    };
+    
+    auto onCancel = [this, resultName, callback, cancelled, started, batchRun, cacheKey, journalId, restored]
+                    (Ticket ticket) {
+        *cancelled = true;
+        restoredTickets.remove(ticket);
+        if (journalId != 0) {
+            journal.markDone(journalId);
+        }
+        if (batchRun && !*started) {
+            // Cancelled while queued: the rest of the batch no longer waits for it
+            batchPartStarted(batchRun);
+        }
+        cancelChunkedRun(ticket);
+        if (inflightRequests.value(cacheKey).isEmpty()) {
+            // An aborted request never answers, so later identical commands must not wait on it
+            if (abortServerRequests(ticket) && !cacheKey.isEmpty()) {
+                inflightRequests.remove(cacheKey);
+            }
+        } else {
+            // Identical commands joined this one's request; they still need the reply
+            serverRequests.remove(ticket);
+        }
+        Tracer::instance()->finishTrace(requestId(ticket), false);
+        QString error = server->getStatus() == ServerManager::Error
+                        ? QString("Command cancelled: AI server unavailable")
+                        : QString("Command cancelled");
+        qDebug() << "CommandManager: Ticket" << ticket << "cancelled";
+        if (restored) {
+            return;
+        }
+        if (callback) callback(ExecutionError, error);
+        emit commandExecuted(ticket, resultName, ExecutionError, error);
+    };
+    
+    Ticket ticket = scheduler->submit(endpoint, priority, task, onCancel);
+    if (ticket == 0) {
+        if (batchRun) {
+            batchRun->members--;
+            batchRun->unstarted--;
+        }
+        if (journalId != 0) {
+            journal.markDone(journalId);
+        }
+        rejectCommand(command, ExecutionError,
+                      QString("Cannot execute command: queue is full (%1 pending)").arg(scheduler->queuedCount()),
+                      callback);
+    } else if (deferred) {
+        qDebug() << "CommandManager: Ticket" << ticket << "held until the server is ready"
+                 << (journalId != 0 ? "(journalled)" : "");
+    }
+    if (ticket != 0 && restored && isCommandPending(ticket)) {
+        restoredTickets.insert(ticket);
+    }
+    if (ticket != 0 && requiresServer && info.cacheable && !restored) {
+        recordCommandUse(command);
+    }
+    return ticket;
+}
+
+bool CommandManager::joinInflightRequest(const QString& cacheKey,
+                                         const std::function<void(CommandResult, const QString&)>& onComplete)
+{
+    if (!requestCoalescing || cacheKey.isEmpty()) {
+        return false;
+    }
+    
+    auto it = inflightRequests.find(cacheKey);
+    if (it == inflightRequests.end()) {
+        return false;
+    }
+    it->append(onComplete);
+    return true;
+}
+
+std::function<void(CommandManager::CommandResult, const QString&)>
+CommandManager::trackInflightRequest(const QString& cacheKey, std::function<void(CommandResult, const QString&)> onComplete)
+{
+    if (!requestCoalescing || cacheKey.isEmpty()) {
+        return onComplete;
+    }
+    
+    // Requests with the same key that start before the reply arrives wait for it
+    inflightRequests.insert(cacheKey, {});
+    return [this, cacheKey, onComplete](CommandResult result, const QString& output) {
+        const QVector<std::function<void(CommandResult, const QString&)>> joined = inflightRequests.take(cacheKey);
+        onComplete(result, output);
+        for (const auto& waiter : joined) {
+            waiter(result, output);
+        }
     };
+}
+
+void CommandManager::batchPartStarted(const std::shared_ptr<BatchRun>& batch)
+{
+    if (--batch->unstarted == 0 && !batch->submitting) {
+        sendBatch(batch);
+    }
+}
+
+void CommandManager::sendBatch(const std::shared_ptr<BatchRun>& batch)
+{
+    QVector<BatchRun::Part> parts;
+    parts.swap(batch->parts);
+    if (parts.isEmpty()) {
+        return;
+    }
+    if (parts.size() == 1) {
+        executeServerCommand(parts[0].ticket, parts[0].command, parts[0].text, parts[0].onComplete);
+        return;
+    }
     
-    // Route to appropriate execution method
-    if (info.requiresServer) {
-        executeServerCommand(command, inputText, wrappedCallback);
+    // The text is sent once, at the top level where transports can move it out
+    // of the JSON; replayed commands that ran on another version carry their own.
+    // The backend runs the parts one after the other, so their deadlines add up.
+    QJsonArray requests;
+    int deadline = 0;
+    for (const BatchRun::Part& part : parts) {
+        QJsonObject request;
+        request["endpoint"] = QString("/api/%1").arg(part.baseCommand);
+        request["args"] = part.args;
+        if (part.text != parts[0].text) {
+            request["text"] = part.text;
+        }
+        requests.append(request);
+        deadline += commandDeadline(part.baseCommand);
+    }
+    QJsonObject requestData;
+    requestData["text"] = parts[0].text;
+    requestData["requests"] = requests;
+    requestData["timestamp"] = QDateTime::currentSecsSinceEpoch();
+    requestData["deadline_ms"] = deadline;
+    
+    qDebug() << "CommandManager: Sending" << parts.size() << "commands as one batch request";
+    
+    // The network spans are recorded on the first command's trace
+    QString traceId = requestId(parts[0].ticket);
+    Tracer::Scope traceScope(traceId);
+    auto handle = std::make_shared<quint64>(0); // Set once sent; the request may fail before that
+    quint64 sent = server->makeRequest(
+        BATCH_ENDPOINT,
+        requestData,
+        [this, parts, handle](const QJsonObject& response) {
+            batchRequests.remove(*handle);
+            const QJsonArray results = response.value("results").toArray();
+            for (int i = 0; i < parts.size(); ++i) {
+                const BatchRun::Part& part = parts[i];
+                if (i >= results.size()) {
+                    part.onComplete(ServerError, "Server command failed: missing from the batch reply");
+                    continue;
+                }
+                
+                QJsonObject entry = results[i].toObject();
+                QJsonObject body = entry.value("body").toObject();
+                if (entry.value("status").toInt(500) < 400) {
+                    qDebug() << "CommandManager: ✅ Server command completed:" << part.command << "(batched)";
+                    part.onComplete(Success, formatServerResponse(part.baseCommand, body));
+                } else {
+                    QString errorMsg = QString("Server command failed: %1").arg(body.value("error").toString());
+                    qDebug() << "CommandManager: ❌" << errorMsg;
+                    part.onComplete(ServerError, errorMsg);
+                }
+            }
+        },
+        [this, parts, handle](const QString& error) {
+            batchRequests.remove(*handle);
+            // Backends predating /api/batch reject it; send the commands one by
+            // one then. Any other failure would only repeat itself N times.
+            int status = server->failureStatus();
+            if (status == 404 || status == 400) {
+                qDebug() << "CommandManager: Batch request rejected (" << error << "), sending" << parts.size()
+                         << "commands separately";
+                for (const BatchRun::Part& part : parts) {
+                    executeServerCommand(part.ticket, part.command, part.text, part.onComplete);
+                }
+                return;
+            }
+            QString errorMsg = QString("Server command failed: %1").arg(error);
+            qDebug() << "CommandManager: ❌" << errorMsg << "(batch of" << parts.size() << ")";
+            for (const BatchRun::Part& part : parts) {
+                part.onComplete(ServerError, errorMsg);
+            }
+        },
+        deadline
+    );
+    
+    // Cancelling one command leaves the batch running for the others
+    if (server->isRequestActive(sent)) {
+        *handle = sent;
+        batchRequests.insert(sent, {int(parts.size()), traceId});
+        for (const BatchRun::Part& part : parts) {
+            trackServerRequest(part.ticket, sent);
+        }
+    }
+}
+
+QString CommandManager::requestId(Ticket ticket) const
+{
+    return QString("%1-%2").arg(requestIdPrefix).arg(ticket);
+}
+
+bool CommandManager::cancelCommand(Ticket ticket)
+{
+    return scheduler->cancel(ticket);
+}
+
+int CommandManager::commandDeadline(const QString& baseCommand) const
+{
+    int deadline = commands.value(baseCommand).deadline;
+    return deadline > 0 ? deadline : DEFAULT_DEADLINE;
+}
+
+void CommandManager::trackServerRequest(Ticket ticket, quint64 handle)
+{
+    // Requests can fail synchronously, leaving nothing to abort
+    if (server->isRequestActive(handle)) {
+        serverRequests.insert(ticket, handle);
+    }
+}
+
+bool CommandManager::abortServerRequests(Ticket ticket)
+{
+    const QList<quint64> handles = serverRequests.values(ticket);
+    serverRequests.remove(ticket);
+    
+    bool aborted = false;
+    bool abortedOwn = false;
+    for (quint64 handle : handles) {
+        auto batch = batchRequests.find(handle);
+        if (batch == batchRequests.end()) {
+            abortedOwn |= server->abortRequest(handle);
+            continue;
+        }
+        if (--batch->liveParts > 0) {
+            continue; // Other commands still wait for the batch's reply
+        }
+        QString batchTraceId = batch->traceId;
+        batchRequests.erase(batch);
+        if (server->abortRequest(handle)) {
+            server->cancelOnServer(batchTraceId);
+            aborted = true;
+        }
+    }
+    // Chunk requests share the command's request ID, one cancel stops them all
+    if (abortedOwn) {
+        server->cancelOnServer(requestId(ticket));
+    }
+    return aborted || abortedOwn;
+}
+
+void CommandManager::setPersistentCacheEnabled(bool enabled)
+{
+    if (enabled) {
+        QString cacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+        resultCache.setPersistentDirectory(cacheDir + "/results");
     } else {
-        executeLocalCommand(baseCommand, inputText, wrappedCallback);
+        resultCache.setPersistentDirectory(QString());
+    }
+}
+
+void CommandManager::setJournalEnabled(bool enabled)
+{
+    if (!enabled) {
+        journal.open(QString());
+        return;
+    }
+    QString dataDir = QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation);
+    if (!journal.open(dataDir + "/journal")) {
+        return;
+    }
+    
+    // Commands left pending when the editor last closed: nobody waits for them
+    // any more, so they run again only to fill the result cache
+    int restored = 0;
+    for (const CommandJournal::Entry& entry : journal.pending()) {
+        if (scheduler->queuedCount() >= scheduler->getMaxQueueSize()) {
+            break; // The rest stay journalled for the next start
+        }
+        QString text;
+        QString baseCommand;
+        QJsonObject args;
+        if (!journal.readText(entry, text) || !parseCommandWithArgs(entry.command, baseCommand, args)
+            || (!availableCommands.contains(baseCommand) && !isCommandDeferred(entry.command))
+            || !commands.value(baseCommand).cacheable) {
+            qDebug() << "CommandManager: ❌ Dropping journalled command" << entry.command;
+            journal.markDone(entry.id);
+            continue;
+        }
+        if (submitCommand(entry.command, text, nullptr, nullptr, entry.id) != 0) {
+            restored++;
+        }
+    }
+    if (restored > 0) {
+        qDebug() << "CommandManager: Replaying" << restored << "journalled commands from the last session";
+        emit executionStateChanged(getExecutionState());
+    }
+}
+
+void CommandManager::setSpeculativeExecutionEnabled(bool enabled)
+{
+    speculativeExecution = enabled;
+    if (enabled) {
+        loadCommandHistory();
+    } else {
+        cancelSpeculation(QString());
+    }
+}
+
+bool CommandManager::canSpeculate() const
+{
+    // Spare capacity: nothing waiting for a backend worker, nothing of ours queued or running
+    const ServerManager::BackendLoad& load = server->backendLoad();
+    return speculativeExecution && resultCacheEnabled && server->isReady()
+        && (!load.isKnown() || load.queued == 0) && getExecutionState().isIdle();
+}
+
+int CommandManager::speculate(const QString& inputText)
+{
+    // Results for text that has since changed would never be asked for
+    cancelSpeculation(QString());
+    if (!canSpeculate() || inputText.trimmed().isEmpty()) {
+        return 0;
+    }
+    
+    int started = 0;
+    for (const QString& command : predictedCommands()) {
+        QString baseCommand;
+        QJsonObject args;
+        if (!parseCommandWithArgs(command, baseCommand, args) || !availableCommands.contains(baseCommand)) {
+            continue;
+        }
+        // Chunked runs and oversized input cost too much to spend on a guess
+        CommandInfo info = getCommandInfo(baseCommand);
+        if (needsChunking(baseCommand, inputText)
+            || (info.maxInputTokens > 0 && tokenizer.isLoaded()
+                && tokenizer.prefixLength(inputText, info.maxInputTokens - BpeTokenizer::SPECIAL_TOKENS) < inputText.size())) {
+            continue;
+        }
+        QString producer = resultProducer(baseCommand);
+        if (info.maxInputTokens > 0 && producer.isEmpty()) {
+            continue; // Not cacheable until /health names the engine
+        }
+        QString cacheKey = ResultCache::makeKey(baseCommand, args, inputText, producer);
+        if (resultCache.contains(cacheKey) || inflightRequests.contains(cacheKey)) {
+            continue;
+        }
+        
+        auto task = [this, command, baseCommand, inputText, cacheKey](Ticket ticket, CommandScheduler::Completion done) {
+            // Registered here as well: the scheduler may start the task before submit() returns
+            speculativeTickets.insert(ticket, cacheKey);
+            QString traceId = requestId(ticket);
+            Tracer::instance()->beginTrace(traceId, baseCommand + " (speculative)", Tracer::now());
+            
+            auto onComplete = [this, ticket, cacheKey, traceId, done](CommandResult result, const QString& output) {
+                serverRequests.remove(ticket);
+                speculativeTickets.remove(ticket);
+                if (result == Success) {
+                    resultCache.insert(cacheKey, output);
+                }
+                Tracer::instance()->finishTrace(traceId, result == Success);
+                done();
+            };
+            executeServerCommand(ticket, command, inputText, trackInflightRequest(cacheKey, onComplete));
+        };
+        
+        auto onCancel = [this, cacheKey](Ticket ticket) {
+            speculativeTickets.remove(ticket);
+            if (inflightRequests.value(cacheKey).isEmpty()) {
+                if (abortServerRequests(ticket)) {
+                    inflightRequests.remove(cacheKey);
+                }
+            } else {
+                serverRequests.remove(ticket);
+            }
+            Tracer::instance()->finishTrace(requestId(ticket), false);
+            qDebug() << "CommandManager: Speculative ticket" << ticket << "cancelled";
+        };
+        
+        Ticket ticket = scheduler->submit(QString("/api/%1").arg(baseCommand), CommandScheduler::Low, task, onCancel);
+        if (ticket == 0) {
+            break;
+        }
+        speculativeTickets.insert(ticket, cacheKey);
+        started++;
+        qDebug() << "CommandManager: Speculatively running" << command << "as ticket" << ticket;
+    }
+    
+    if (started > 0) {
+        // The scheduler announced the new tickets before they were known to be speculative
+        emit executionStateChanged(getExecutionState());
+    }
+    return started;
+}
+
+QStringList CommandManager::predictedCommands() const
+{
+    QStringList ranked = commandHistory.keys();
+    std::sort(ranked.begin(), ranked.end(), [this](const QString& a, const QString& b) {
+        int countA = commandHistory.value(a);
+        int countB = commandHistory.value(b);
+        return countA != countB ? countA > countB : a < b;
+    });
+    for (const char* fallback : {"summarise", "keywords"}) {
+        if (!ranked.contains(QLatin1String(fallback))) {
+            ranked.append(QLatin1String(fallback));
+        }
+    }
+    return ranked.mid(0, SPECULATIVE_COMMANDS);
+}
+
+void CommandManager::cancelSpeculation(const QString& keepKey)
+{
+    const QList<Ticket> tickets = speculativeTickets.keys();
+    for (Ticket ticket : tickets) {
+        // A request already on its way answers the real command that matches it,
+        // and any commands that joined it
+        QString cacheKey = speculativeTickets.value(ticket);
+        if (scheduler->isInFlight(ticket)
+            && ((!keepKey.isEmpty() && cacheKey == keepKey) || !inflightRequests.value(cacheKey).isEmpty())) {
+            continue;
+        }
+        scheduler->cancel(ticket);
     }
 }
 
+void CommandManager::recordCommandUse(const QString& command)
+{
+    commandHistory[command.simplified()]++;
+    if (speculativeExecution) {
+        saveCommandHistory();
+    }
+}
+
+QString CommandManager::commandHistoryPath() const
+{
+    return QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + "/command_history.json";
+}
+
+void CommandManager::loadCommandHistory()
+{
+    QFile file(commandHistoryPath());
+    if (!file.open(QIODevice::ReadOnly)) {
+        return;
+    }
+    
+    const QJsonObject counts = QJsonDocument::fromJson(file.readAll()).object();
+    for (auto it = counts.constBegin(); it != counts.constEnd(); ++it) {
+        commandHistory[it.key()] += it.value().toInt();
+    }
+    qDebug() << "CommandManager: Loaded usage of" << commandHistory.size() << "commands";
+}
+
+void CommandManager::saveCommandHistory() const
+{
+    QJsonObject counts;
+    for (auto it = commandHistory.constBegin(); it != commandHistory.constEnd(); ++it) {
+        counts[it.key()] = it.value();
+    }
+    
+    QString path = commandHistoryPath();
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "CommandManager: Could not write command history" << path;
+        return;
+    }
+    file.write(QJsonDocument(counts).toJson(QJsonDocument::Compact));
+    file.commit();
+}
+
+bool CommandManager::isCommandPending(Ticket ticket) const
+{
+    return scheduler->isQueued(ticket) || scheduler->isInFlight(ticket);
+}
+
 void CommandManager::executeLocalCommand(const QString& command, const QString& inputText,
                                        std::function<void(CommandResult, const QString&)> callback)
 {
@@ -238,11 +1194,10 @@ void CommandManager::executeLocalCommand(const QString& command, const QString&
     
     qDebug() << "CommandManager: ✅ Local command completed:" << command;
     if (callback) callback(Success, result);
-    emit commandExecuted(command, Success, result);
 }
 
-void CommandManager::executeServerCommand(const QString& command, const QString& inputText,
-                                        std::function<void(CommandResult, const QString&)> callback)
+void CommandManager::executeServerCommand(Ticket ticket, const QString& command, const QString& inputText,
+                                          std::function<void(CommandResult, const QString&)> callback)
 {
     qDebug() << "CommandManager: Executing server command:" << command;
     
@@ -254,34 +1209,520 @@ void CommandManager::executeServerCommand(const QString& command, const QString&
         QString error = QString("Invalid command format: %1").arg(command);
         qDebug() << "CommandManager: ❌" << error;
         if (callback) callback(ValidationError, error);
-        emit commandExecuted(command, ValidationError, error);
         return;
     }
     
     // Add common fields
+    int deadline = commandDeadline(baseCommand);
     requestData["text"] = inputText;
     requestData["timestamp"] = QDateTime::currentSecsSinceEpoch();
+    requestData["deadline_ms"] = deadline;
+    
+    auto onSuccess = [this, command, baseCommand, callback](const QJsonObject& response) {
+        // Success callback - format response appropriately
+        QString result = formatServerResponse(baseCommand, response);
+        
+        qDebug() << "CommandManager: ✅ Server command completed:" << command;
+        if (callback) callback(Success, result);
+    };
+    
+    auto onError = [command, callback](const QString& error) {
+        // Error callback
+        QString errorMsg = QString("Server command failed: %1").arg(error);
+        qDebug() << "CommandManager: ❌" << errorMsg;
+        if (callback) callback(ServerError, errorMsg);
+    };
+    
+    QString endpoint = QString("/api/%1").arg(baseCommand);
+    Tracer::Scope traceScope(requestId(ticket));
+    
+    if (streamsReply(ticket, baseCommand)) {
+        // Forward partial output as it is generated
+        trackServerRequest(ticket, server->makeStreamingRequest(
+            endpoint,
+            requestData,
+            [this, ticket, command](const QJsonObject& chunk) {
+                emit commandProgress(ticket, command, chunk.value("text").toString());
+            },
+            onSuccess,
+            onError,
+            deadline
+        ));
+        return;
+    }
     
     // Make server request
-    server->makeRequest(
-        QString("/api/%1").arg(baseCommand),
-        requestData,
-        [=](const QJsonObject& response) {
-            // Success callback - format response appropriately
-            QString result = formatServerResponse(baseCommand, response);
+    trackServerRequest(ticket, server->makeRequest(endpoint, requestData, onSuccess, onError, deadline));
+}
+
+QString CommandManager::chunkResultKey(const QString& baseCommand, const QJsonObject& args,
+                                      const DocumentModel::Chunk& chunk) const
+{
+    // Same rule as whole results in submitCommand(): model output waits until
+    // /health has named the engine, so nothing is keyed without one
+    CommandInfo info = commands.value(baseCommand);
+    QString producer = resultProducer(baseCommand);
+    if (!resultCacheEnabled || !info.cacheable || (info.maxInputTokens > 0 && producer.isEmpty())) {
+        return QString();
+    }
+    return chunkCacheKey(baseCommand, args, chunk, producer);
+}
+
+QString CommandManager::resultProducer(const QString& baseCommand) const
+{
+    // Rule-based commands answer the same on any backend; model output differs
+    // between models and engines (int8 is not pytorch), so it is cached apart
+    QString engine = server->backendEngine();
+    if (commands.value(baseCommand).maxInputTokens == 0 || engine.isEmpty()) {
+        return QString();
+    }
+    return server->commandModel(baseCommand).model + "@" + engine;
+}
+
+bool CommandManager::streamsReply(Ticket ticket, const QString& baseCommand) const
+{
+    return streamingEnabled && getCommandInfo(baseCommand).supportsStreaming && !speculativeTickets.contains(ticket)
+        && !restoredTickets.contains(ticket);
+}
+
+bool CommandManager::needsChunking(const QString& baseCommand, const QString& text) const
+{
+    if (text.size() > CHUNKING_THRESHOLD) {
+        return true;
+    }
+    // Summaries beyond one model window would be truncated, so they are map-reduced.
+    // prefixLength stops at the budget instead of counting the whole text.
+    if (baseCommand == "summarise") {
+        if (tokenizer.isLoaded()) {
+            return tokenizer.prefixLength(text, SEGMENT_TOKEN_BUDGET - BpeTokenizer::SPECIAL_TOKENS) < text.size();
+        }
+        return text.size() > SEGMENT_TOKEN_BUDGET * CHARS_PER_TOKEN_ESTIMATE;
+    }
+    return false;
+}
+
+void CommandManager::executeChunkedCommand(Ticket ticket, const QString& command, const QString& baseCommand,
+                                           const QJsonObject& args, const QString& inputText,
+                                           std::function<void(CommandResult, const QString&)> callback)
+{
+    QElapsedTimer totalTimer;
+    totalTimer.start();
+    
+    startChunkedRun(ticket, command, baseCommand, args, inputText, 0,
+        [this, baseCommand, callback, totalTimer](bool ok, const QJsonObject& response, const QString& error) {
+            if (!ok) {
+                QString errorMsg = QString("Server command failed: %1").arg(error);
+                qDebug() << "CommandManager: ❌" << errorMsg;
+                if (callback) callback(ServerError, errorMsg);
+                return;
+            }
             
-            qDebug() << "CommandManager: ✅ Server command completed:" << command;
-            if (callback) callback(Success, result);
-            emit commandExecuted(command, Success, result);
-        },
-        [=](const QString& error) {
-            // Error callback
-            QString errorMsg = QString("Server command failed: %1").arg(error);
-            qDebug() << "CommandManager: ❌" << errorMsg;
-            if (callback) callback(ServerError, errorMsg);
-            emit commandExecuted(command, ServerError, errorMsg);
+            QJsonObject result = response;
+            QJsonObject perf = result["performance"].toObject();
+            perf["total_time"] = totalTimer.elapsed() / 1000.0;
+            result["performance"] = perf;
+            
+            if (callback) callback(Success, formatServerResponse(baseCommand, result));
+        });
+}
+
+void CommandManager::startChunkedRun(Ticket ticket, const QString& command, const QString& baseCommand,
+                                     const QJsonObject& targetArgs, const QString& text, int depth,
+                                     std::function<void(bool, const QJsonObject&, const QString&)> onDone)
+{
+    DocumentModel& model = documentModels[baseCommand];
+    
+    auto run = std::make_shared<ChunkedRun>();
+    run->ticket = ticket;
+    run->command = command;
+    run->baseCommand = baseCommand;
+    run->targetArgs = targetArgs;
+    run->requestArgs = targetArgs;
+    run->depth = depth;
+    run->onDone = onDone;
+    run->timer.start();
+    
+    if (baseCommand == "summarise") {
+        // Segments are sized to fit one model window. They are summarised less
+        // aggressively than the target so the reduce step has material to work with.
+        if (tokenizer.isLoaded()) {
+            int maxTokens = SEGMENT_TOKEN_BUDGET - BpeTokenizer::SPECIAL_TOKENS;
+            model.setTokenizer(&tokenizer);
+            model.setChunkLimits(maxTokens / 3, maxTokens);
+        } else {
+            int maxChars = SEGMENT_TOKEN_BUDGET * CHARS_PER_TOKEN_ESTIMATE;
+            model.setChunkLimits(maxChars / 3, maxChars);
         }
-    );
+        
+        double target = targetArgs.value("ratio").toDouble(0.25);
+        double mapRatio = qBound(target, std::sqrt(target), 0.6);
+        run->requestArgs = summariseArgs(mapRatio);
+    }
+    
+    model.update(text);
+    run->scope = ResultCache::makeKey(baseCommand, run->requestArgs, QString(), resultProducer(baseCommand));
+    run->chunks = model.chunks();
+    run->results.resize(run->chunks.size());
+    run->chunkTimes.fill(-1, run->chunks.size());
+    run->remaining = run->chunks.size();
+    
+    int dirtyCount = model.dirtyChunks(run->scope).size();
+    
+    // Unchanged chunks come straight from the cache, only the rest go to the server
+    for (int i = 0; i < run->chunks.size(); ++i) {
+        QString cached;
+        QString chunkKey = chunkResultKey(baseCommand, run->requestArgs, run->chunks[i]);
+        int words = countWords(run->chunks[i].text);
+        if (baseCommand == "summarise" && words < MIN_SUMMARY_WORDS) {
+            // Too short for the model to summarise (the backend rejects it), keep as is
+            QJsonObject passthrough;
+            passthrough["summary"] = run->chunks[i].text;
+            passthrough["original_length"] = words;
+            passthrough["summary_length"] = words;
+            run->results[i] = passthrough;
+            run->remaining--;
+        } else if (!chunkKey.isEmpty() && resultCache.lookup(chunkKey, cached)) {
+            run->results[i] = QJsonDocument::fromJson(cached.toUtf8()).object();
+            model.markProcessed(run->scope, run->chunks[i]);
+            run->remaining--;
+        } else {
+            run->pending.append(i);
+        }
+    }
+    run->reprocessed = run->pending.size();
+    
+    qDebug() << "CommandManager: Chunked" << command << "(depth" << depth << ") -" << run->chunks.size() << "chunks,"
+             << dirtyCount << "changed since last run," << run->reprocessed << "to process";
+    
+    chunkedRuns.insert(ticket, run);
+    emit commandStageProgress(ticket, command, depth == 0 ? "map" : QString("map (level %1)").arg(depth + 1),
+                              run->chunks.size() - run->remaining, run->chunks.size());
+    
+    if (run->pending.isEmpty()) {
+        completeChunkedRun(run);
+    } else {
+        submitNextChunks(run);
+    }
+}
+
+void CommandManager::submitNextChunks(const std::shared_ptr<ChunkedRun>& run)
+{
+    QString endpoint = QString("/api/%1").arg(run->baseCommand);
+    
+    // Keep only a window of chunk requests in the scheduler so long documents
+    // don't flood the queue; the endpoint limit still bounds what runs at once
+    int window = scheduler->endpointConcurrency(endpoint);
+    if (window <= 0) {
+        window = 4;
+    }
+    // A saturated shared backend gets one segment at a time from this editor,
+    // so other editors' commands don't queue behind a whole document
+    if (server->backendLoad().isBusy()) {
+        window = 1;
+    }
+    
+    while (!run->finished && !run->pending.isEmpty() && run->activeChildren.size() < window) {
+        int index = run->pending.takeFirst();
+        
+        auto task = [this, run, index, endpoint](Ticket childTicket, CommandScheduler::Completion done) {
+            if (run->finished) {
+                done();
+                return;
+            }
+            
+            int deadline = commandDeadline(run->baseCommand);
+            QJsonObject requestData = run->requestArgs;
+            requestData["text"] = run->chunks[index].text;
+            requestData["timestamp"] = QDateTime::currentSecsSinceEpoch();
+            requestData["deadline_ms"] = deadline;
+            
+            QElapsedTimer requestTimer;
+            requestTimer.start();
+            
+            Tracer::Scope traceScope(requestId(run->ticket));
+            trackServerRequest(run->ticket, server->makeRequest(
+                endpoint,
+                requestData,
+                [this, run, index, childTicket, done, requestTimer](const QJsonObject& response) {
+                    run->activeChildren.remove(childTicket);
+                    if (!run->finished) {
+                        const DocumentModel::Chunk& chunk = run->chunks[index];
+                        run->results[index] = response;
+                        run->chunkTimes[index] = requestTimer.elapsed();
+                        QString chunkKey = chunkResultKey(run->baseCommand, run->requestArgs, chunk);
+                        if (!chunkKey.isEmpty()) {
+                            resultCache.insert(chunkKey,
+                                               QString::fromUtf8(QJsonDocument(response).toJson(QJsonDocument::Compact)));
+                        }
+                        documentModels[run->baseCommand].markProcessed(run->scope, chunk);
+                        run->remaining--;
+                        
+                        qDebug() << "CommandManager: Segment" << index + 1 << "of" << run->chunks.size()
+                                 << "done in" << run->chunkTimes[index] << "ms";
+                        emit commandStageProgress(run->ticket, run->command, "map",
+                                                  run->chunks.size() - run->remaining, run->chunks.size());
+                    }
+                    done();
+                    
+                    if (!run->finished) {
+                        if (run->remaining == 0) {
+                            completeChunkedRun(run);
+                        } else {
+                            submitNextChunks(run);
+                        }
+                    }
+                },
+                [this, run, index, childTicket, done](const QString& error) {
+                    run->activeChildren.remove(childTicket);
+                    if (!run->finished) {
+                        failChunkedRun(run, QString("Chunk %1 of %2 failed: %3")
+                                       .arg(index + 1).arg(run->chunks.size()).arg(error));
+                    }
+                    done();
+                },
+                deadline
+            ));
+        };
+        
+        Ticket child = scheduler->submit(endpoint, CommandScheduler::Normal, task);
+        if (child == 0) {
+            failChunkedRun(run, "Cannot process document: queue is full");
+            return;
+        }
+        
+        // The request may already have failed synchronously
+        if (scheduler->isQueued(child) || scheduler->isInFlight(child)) {
+            run->activeChildren.insert(child);
+        }
+    }
+}
+
+void CommandManager::failChunkedRun(const std::shared_ptr<ChunkedRun>& run, const QString& error)
+{
+    if (run->finished) {
+        return;
+    }
+    
+    // The other chunks' results would be thrown away
+    cancelChunkedRun(run->ticket);
+    abortServerRequests(run->ticket);
+    if (run->onDone) run->onDone(false, QJsonObject(), error);
+}
+
+void CommandManager::completeChunkedRun(const std::shared_ptr<ChunkedRun>& run)
+{
+    QJsonObject merged = mergeChunkResults(run->baseCommand, run->results);
+    merged["chunks"] = run->chunks.size();
+    merged["chunks_reprocessed"] = run->reprocessed;
+    
+    QJsonArray segmentTimes;
+    for (qint64 ms : run->chunkTimes) {
+        segmentTimes.append(ms < 0 ? QJsonValue() : QJsonValue(ms / 1000.0));
+    }
+    QJsonObject perf = merged["performance"].toObject();
+    perf["segment_times"] = segmentTimes;
+    merged["performance"] = perf;
+    
+    qDebug() << "CommandManager: Chunk pass done for" << run->command
+             << "(" << run->reprocessed << "of" << run->chunks.size() << "chunks processed in"
+             << run->timer.elapsed() << "ms)";
+    
+    if (run->baseCommand == "summarise" && run->chunks.size() > 1) {
+        reduceSummaries(run, merged);
+        return;
+    }
+    
+    run->finished = true;
+    chunkedRuns.remove(run->ticket);
+    if (run->onDone) run->onDone(true, merged, QString());
+}
+
+void CommandManager::reduceSummaries(const std::shared_ptr<ChunkedRun>& run, const QJsonObject& mapped)
+{
+    QString partials = mapped["summary"].toString();
+    
+    // Scale the reduce step so map and reduce together hit the requested ratio
+    double target = run->targetArgs.value("ratio").toDouble(0.25);
+    double mapRatio = run->requestArgs.value("ratio").toDouble(target);
+    QJsonObject reduceArgs = summariseArgs(qBound(0.05, target / mapRatio, 0.95));
+    
+    // Folds the reduce response into the map statistics and finishes the run
+    auto finishWith = [this, run, mapped](const QJsonObject& reduced) {
+        QJsonObject result = reduced;
+        result["original_length"] = mapped["original_length"];
+        result["chunks"] = mapped["chunks"];
+        result["chunks_reprocessed"] = mapped["chunks_reprocessed"];
+        
+        int originalLength = mapped["original_length"].toInt();
+        int summaryLength = reduced["summary_length"].toInt();
+        result["compression_ratio"] = originalLength > 0 ? double(summaryLength) / originalLength : 0.0;
+        
+        QJsonObject mapPerf = mapped["performance"].toObject();
+        QJsonObject reducePerf = reduced["performance"].toObject();
+        QJsonObject perf = reducePerf;
+        for (const QString& key : {QStringLiteral("tokenization_time"), QStringLiteral("generation_time"),
+                                   QStringLiteral("decoding_time")}) {
+            perf[key] = mapPerf[key].toDouble() + reducePerf[key].toDouble();
+        }
+        perf["segment_times"] = mapPerf["segment_times"];
+        perf["reduce_time"] = reducePerf.contains("reduce_time") ? reducePerf["reduce_time"] : reducePerf["total_time"];
+        result["performance"] = perf;
+        
+        QJsonObject mapReduce;
+        mapReduce["segments"] = mapped["chunks"];
+        mapReduce["reduce_input_words"] = mapped["summary_length"];
+        mapReduce["levels"] = reduced.value("map_reduce").toObject().value("levels").toInt(0) + 1;
+        result["map_reduce"] = mapReduce;
+        
+        run->finished = true;
+        if (run->onDone) run->onDone(true, result, QString());
+    };
+    
+    if (needsChunking(run->baseCommand, partials) && run->depth < MAX_REDUCE_DEPTH) {
+        // The partial summaries still exceed one window, map-reduce them again
+        run->finished = true;
+        startChunkedRun(run->ticket, run->command, run->baseCommand, reduceArgs, partials, run->depth + 1,
+            [run, finishWith](bool ok, const QJsonObject& reduced, const QString& error) {
+                if (ok) {
+                    finishWith(reduced);
+                } else if (run->onDone) {
+                    run->onDone(false, QJsonObject(), error);
+                }
+            });
+        return;
+    }
+    
+    emit commandStageProgress(run->ticket, run->command, "reduce", 0, 1);
+    
+    QString endpoint = QString("/api/%1").arg(run->baseCommand);
+    auto task = [this, run, endpoint, reduceArgs, partials, finishWith](Ticket childTicket, CommandScheduler::Completion done) {
+        if (run->finished) {
+            done();
+            return;
+        }
+        
+        int deadline = commandDeadline(run->baseCommand);
+        QJsonObject requestData = reduceArgs;
+        requestData["text"] = partials;
+        requestData["timestamp"] = QDateTime::currentSecsSinceEpoch();
+        requestData["deadline_ms"] = deadline;
+        
+        Tracer::Scope traceScope(requestId(run->ticket));
+        trackServerRequest(run->ticket, server->makeRequest(
+            endpoint,
+            requestData,
+            [this, run, childTicket, done, finishWith](const QJsonObject& response) {
+                run->activeChildren.remove(childTicket);
+                if (!run->finished) {
+                    chunkedRuns.remove(run->ticket);
+                    emit commandStageProgress(run->ticket, run->command, "reduce", 1, 1);
+                    finishWith(response);
+                }
+                done();
+            },
+            [this, run, childTicket, done](const QString& error) {
+                run->activeChildren.remove(childTicket);
+                if (!run->finished) {
+                    failChunkedRun(run, QString("Reduce step failed: %1").arg(error));
+                }
+                done();
+            },
+            deadline
+        ));
+    };
+    
+    Ticket child = scheduler->submit(endpoint, CommandScheduler::Normal, task);
+    if (child == 0) {
+        failChunkedRun(run, "Cannot process document: queue is full");
+    } else if (scheduler->isQueued(child) || scheduler->isInFlight(child)) {
+        run->activeChildren.insert(child);
+    }
+}
+
+void CommandManager::cancelChunkedRun(Ticket ticket)
+{
+    std::shared_ptr<ChunkedRun> run = chunkedRuns.take(ticket);
+    if (!run) {
+        return;
+    }
+    
+    run->finished = true;
+    const QSet<Ticket> children = run->activeChildren;
+    run->activeChildren.clear();
+    for (Ticket child : children) {
+        scheduler->cancel(child);
+    }
+}
+
+QJsonObject CommandManager::mergeChunkResults(const QString& baseCommand, const QVector<QJsonObject>& results) const
+{
+    QJsonObject merged;
+    
+    if (baseCommand == "summarise") {
+        QStringList summaries;
+        int originalLength = 0;
+        int summaryLength = 0;
+        double tokenizationTime = 0;
+        double generationTime = 0;
+        double decodingTime = 0;
+        QString engine;
+        
+        for (const QJsonObject& result : results) {
+            summaries.append(result["summary"].toString());
+            originalLength += result["original_length"].toInt();
+            summaryLength += result["summary_length"].toInt();
+            
+            QJsonObject perf = result["performance"].toObject();
+            tokenizationTime += perf["tokenization_time"].toDouble();
+            generationTime += perf["generation_time"].toDouble();
+            decodingTime += perf["decoding_time"].toDouble();
+            if (engine.isEmpty()) {
+                engine = perf["engine"].toString(); // Passthrough segments have none
+            }
+        }
+        
+        QJsonObject perf;
+        perf["tokenization_time"] = tokenizationTime;
+        perf["generation_time"] = generationTime;
+        perf["decoding_time"] = decodingTime;
+        if (!engine.isEmpty()) {
+            perf["engine"] = engine;
+        }
+        
+        merged["summary"] = summaries.join("\n\n");
+        merged["original_length"] = originalLength;
+        merged["summary_length"] = summaryLength;
+        merged["compression_ratio"] = originalLength > 0 ? double(summaryLength) / originalLength : 0.0;
+        merged["performance"] = perf;
+    } else if (baseCommand == "keywords") {
+        // Sum frequencies across chunks and keep the overall top 10
+        QHash<QString, int> frequencies;
+        for (const QJsonObject& result : results) {
+            QJsonObject chunkFrequencies = result["keyword_frequencies"].toObject();
+            for (auto it = chunkFrequencies.begin(); it != chunkFrequencies.end(); ++it) {
+                frequencies[it.key()] += it.value().toInt();
+            }
+        }
+        
+        QList<QPair<QString, int>> ranked;
+        for (auto it = frequencies.begin(); it != frequencies.end(); ++it) {
+            ranked.append(qMakePair(it.key(), it.value()));
+        }
+        std::sort(ranked.begin(), ranked.end(), [](const QPair<QString, int>& a, const QPair<QString, int>& b) {
+            return a.second != b.second ? a.second > b.second : a.first < b.first;
+        });
+        
+        QJsonArray keywords;
+        QJsonObject keywordFrequencies;
+        for (int i = 0; i < ranked.size() && i < 10; ++i) {
+            keywords.append(ranked[i].first);
+            keywordFrequencies[ranked[i].first] = ranked[i].second;
+        }
+        merged["keywords"] = keywords;
+        merged["keyword_frequencies"] = keywordFrequencies;
+    }
+    
+    return merged;
 }
 
 bool CommandManager::parseCommandWithArgs(const QString& command, QString& baseCommand, QJsonObject& args) const
@@ -350,47 +1791,110 @@ bool CommandManager::parseCommandWithArgs(const QString& command, QString& baseC
 
 QString CommandManager::formatServerResponse(const QString& command, const QJsonObject& response) const
 {
-    if (command == "summarise") {
+    // The output is written into one preallocated buffer. Keys and fixed text
+    // are literals and numbers are formatted in place, so the only other
+    // allocations are the strings copied out of the response.
+    QString result;
+    
+    if (command == QLatin1String("summarise")) {
         // Handle summarise-specific response format
-        if (response.contains("error")) {
-            return QString("Error: %1").arg(response["error"].toString());
-        }
-        
-        QString summary = response["summary"].toString();
-        int originalLength = response["original_length"].toInt();
-        int summaryLength = response["summary_length"].toInt();
-        double compressionRatio = response["compression_ratio"].toDouble();
-        
-        // Extract performance data if available
-        QString performanceInfo;
-        if (response.contains("performance")) {
-            QJsonObject perf = response["performance"].toObject();
-            double totalTime = perf["total_time"].toDouble();
-            double tokenizationTime = perf["tokenization_time"].toDouble();
-            double generationTime = perf["generation_time"].toDouble();
-            double decodingTime = perf["decoding_time"].toDouble();
+        if (response.contains(QLatin1String("error"))) {
+            result = QStringLiteral("Error: ");
+            result += response.value(QLatin1String("error")).toString();
+            return result;
+        }
+        
+        const QString summary = response.value(QLatin1String("summary")).toString();
+        const QJsonObject perf = response.value(QLatin1String("performance")).toObject();
+        const QJsonArray segmentTimes = perf.value(QLatin1String("segment_times")).toArray();
+        result.reserve(summary.size() + 512 + segmentTimes.size() * 8);
+        
+        result += summary;
+        result += QStringLiteral("\n\n📊 Summary Stats:\n• Original: ");
+        appendNumber(result, response.value(QLatin1String("original_length")).toInt());
+        result += QStringLiteral(" words\n• Summary: ");
+        appendNumber(result, response.value(QLatin1String("summary_length")).toInt());
+        result += QStringLiteral(" words (");
+        appendFixed(result, response.value(QLatin1String("compression_ratio")).toDouble() * 100, 1);
+        result += QStringLiteral("%)\n• Quality: High-precision summary with intelligent length control");
+        if (response.contains(QLatin1String("chunks"))) {
+            result += QStringLiteral("\n• Processed in ");
+            appendNumber(result, response.value(QLatin1String("chunks")).toInt());
+            result += QStringLiteral(" chunks (");
+            appendNumber(result, response.value(QLatin1String("chunks_reprocessed")).toInt());
+            result += QStringLiteral(" re-processed)");
+        }
+        if (response.contains(QLatin1String("map_reduce"))) {
+            const QJsonObject mapReduce = response.value(QLatin1String("map_reduce")).toObject();
+            result += QStringLiteral("\n• Map-reduce: ");
+            appendNumber(result, mapReduce.value(QLatin1String("segments")).toInt());
+            result += QStringLiteral(" segments, reduced from ");
+            appendNumber(result, mapReduce.value(QLatin1String("reduce_input_words")).toInt());
+            result += QStringLiteral(" words over ");
+            appendNumber(result, mapReduce.value(QLatin1String("levels")).toInt());
+            result += QStringLiteral(" level(s)");
             
-            performanceInfo = QString("\n\n⚡ Performance Metrics (DistilBART-CNN-12-6):\n");
-            performanceInfo += QString("• Total time: %1s\n").arg(QString::number(totalTime, 'f', 2));
-            performanceInfo += QString("• Tokenization: %1s\n").arg(QString::number(tokenizationTime, 'f', 2));
-            performanceInfo += QString("• Generation: %1s\n").arg(QString::number(generationTime, 'f', 2));
-            performanceInfo += QString("• Decoding: %1s").arg(QString::number(decodingTime, 'f', 2));
+            if (!segmentTimes.isEmpty()) {
+                result += QStringLiteral("\n• Segment times: ");
+                for (int i = 0; i < segmentTimes.size(); ++i) {
+                    if (i > 0) {
+                        result += QLatin1String(", ");
+                    }
+                    const QJsonValue time = segmentTimes[i];
+                    if (time.isNull()) {
+                        result += QLatin1String("cached");
+                    } else {
+                        appendFixed(result, time.toDouble(), 2);
+                        result += QLatin1Char('s');
+                    }
+                }
+            }
+        }
+        if (response.contains(QLatin1String("performance"))) {
+            result += QStringLiteral("\n\n⚡ Performance Metrics (DistilBART-CNN-12-6):\n• Total time: ");
+            appendFixed(result, perf.value(QLatin1String("total_time")).toDouble(), 2);
+            result += QStringLiteral("s\n• Tokenization: ");
+            appendFixed(result, perf.value(QLatin1String("tokenization_time")).toDouble(), 2);
+            result += QStringLiteral("s\n• Generation: ");
+            appendFixed(result, perf.value(QLatin1String("generation_time")).toDouble(), 2);
+            result += QStringLiteral("s\n• Decoding: ");
+            appendFixed(result, perf.value(QLatin1String("decoding_time")).toDouble(), 2);
+            result += QLatin1Char('s');
+            const QString engine = perf.value(QLatin1String("engine")).toString();
+            if (!engine.isEmpty()) {
+                result += QStringLiteral("\n• Engine: ");
+                result += engine;
+            }
         }
         
-        QString result = summary;
-        result += QString("\n\n📊 Summary Stats:\n");
-        result += QString("• Original: %1 words\n").arg(originalLength);
-        result += QString("• Summary: %1 words (%2%)\n").arg(summaryLength).arg(QString::number(compressionRatio * 100, 'f', 1));
-        result += QString("• Quality: High-precision summary with intelligent length control");
-        result += performanceInfo;
+        return result;
+    }
+    
+    if (command == QLatin1String("keywords") && response.contains(QLatin1String("keywords"))) {
+        const QJsonArray keywords = response.value(QLatin1String("keywords")).toArray();
+        result.reserve(64 + keywords.size() * 16);
         
+        result += QStringLiteral("🔑 Keywords: ");
+        for (int i = 0; i < keywords.size(); ++i) {
+            if (i > 0) {
+                result += QLatin1String(", ");
+            }
+            result += keywords[i].toString();
+        }
+        if (response.contains(QLatin1String("chunks"))) {
+            result += QStringLiteral("\n• Processed in ");
+            appendNumber(result, response.value(QLatin1String("chunks")).toInt());
+            result += QStringLiteral(" chunks (");
+            appendNumber(result, response.value(QLatin1String("chunks_reprocessed")).toInt());
+            result += QStringLiteral(" re-processed)");
+        }
         return result;
     }
     
-    // Default handling for other commands
-    QString result = response.value("result").toString();
+    // Default handling for other commands: the backend's text as is, no copy
+    result = response.value(QLatin1String("result")).toString();
     if (result.isEmpty()) {
-        result = response.value("output").toString();
+        result = response.value(QLatin1String("output")).toString();
     }
     if (result.isEmpty()) {
         result = QString("Command '%1' executed successfully").arg(command);
@@ -399,54 +1903,111 @@ QString CommandManager::formatServerResponse(const QString& command, const QJson
     return result;
 }
 
+void CommandManager::requestSuggestions(const QString& query)
+{
+    // Whatever was requested before is stale from now on
+    cancelPendingSuggestions();
+    pendingSuggestionQuery = query;
+    suggestionTimer->start();
+}
+
+void CommandManager::cancelPendingSuggestions()
+{
+    suggestionTimer->stop();
+    pendingSuggestionQuery.clear();
+    ++suggestionGeneration;
+    
+    if (suggestionSearch != 0) {
+        server->abortRequest(suggestionSearch);
+        suggestionSearch = 0;
+    }
+}
+
+void CommandManager::setSuggestionDebounceInterval(int msec)
+{
+    suggestionTimer->setInterval(qMax(0, msec));
+}
+
+int CommandManager::suggestionDebounceInterval() const
+{
+    return suggestionTimer->interval();
+}
+
+void CommandManager::flushPendingSuggestions()
+{
+    QString query = pendingSuggestionQuery;
+    pendingSuggestionQuery.clear();
+    getSuggestions(query, nullptr);
+}
+
 void CommandManager::getSuggestions(const QString& query,
                                    std::function<void(const QStringList&)> callback)
 {
-    // Use the new contextual suggestion system
-    QStringList suggestions = commandRegistry::getContextualSuggestions(query);
-    
-    qDebug() << "CommandManager: Contextual suggestions for" << query << ":" << suggestions;
+    // A newer lookup supersedes any server search still running for an older one
+    if (suggestionSearch != 0) {
+        server->abortRequest(suggestionSearch);
+        suggestionSearch = 0;
+    }
+    quint64 generation = ++suggestionGeneration;
     
-    // Always call the callback with our suggestions
-    if (callback) callback(suggestions);
-    emit suggestionsAvailable(query, suggestions);
+    // Prefix matches from the registry come first
+    QStringList suggestions = commandRegistry::getContextualSuggestions(query);
     
-    // If server is ready and we're looking for command matches (not arguments), 
-    // also try server-based fuzzy search for enhanced results
+    // While a command name is being typed, top up with near misses so typos
+    // still find their command
     QString trimmedQuery = query.trimmed();
-    QStringList parts = trimmedQuery.split(' ', Qt::SkipEmptyParts);
+    bool typingCommandName = !trimmedQuery.isEmpty() && !trimmedQuery.contains(' ');
+    const QStringList& allCommands = commandRegistry::getAllCommands();
     
-    if (server->isReady() && parts.size() == 1 && !trimmedQuery.isEmpty()) {
-        QJsonObject requestData;
-        requestData["query"] = query;
-        
-        QJsonArray choices;
-        QStringList allCommands = commandRegistry::getAllCommands();
-        for (const QString& cmd : allCommands) {
-            choices.append(cmd);
-        }
-        requestData["choices"] = choices;
-        
-        server->makeRequest(
-            "/api/search",
-            requestData,
-            [=](const QJsonObject& response) {
-                QStringList serverSuggestions;
-                QJsonArray results = response["results"].toArray();
-                for (const QJsonValue& value : results) {
-                    serverSuggestions.append(value.toString());
-                }
-                
-                if (!serverSuggestions.isEmpty() && serverSuggestions != suggestions) {
-                    qDebug() << "CommandManager: Server enhanced suggestions:" << serverSuggestions;
-                    // Emit server suggestions if they're different/better
-                    emit suggestionsAvailable(query, serverSuggestions);
-                }
-            },
-            [=](const QString& error) {
-                qDebug() << "CommandManager: Server search failed:" << error;
-                // Already provided local suggestions above
+    if (typingCommandName && suggestions.size() < MAX_SUGGESTIONS) {
+        if (localFuzzyMatching && allCommands.size() <= LOCAL_FUZZY_CORPUS_LIMIT) {
+            // Command names are lower case; match the way the server's default processor would
+            QStringList fuzzyMatches;
+            for (const FuzzyMatcher::Match& match : FuzzyMatcher::extract(trimmedQuery.toLower(), allCommands,
+                                                                          MAX_SUGGESTIONS, FUZZY_SCORE_CUTOFF)) {
+                fuzzyMatches << allCommands[match.index];
             }
-        );
+            appendSuggestions(suggestions, fuzzyMatches, MAX_SUGGESTIONS);
+        } else if (server->isReady()) {
+            QJsonObject requestData;
+            requestData["query"] = trimmedQuery.toLower();
+            requestData["choices"] = QJsonArray::fromStringList(allCommands);
+            requestData["limit"] = MAX_SUGGESTIONS;
+            requestData["score_cutoff"] = FUZZY_SCORE_CUTOFF;
+            
+            QStringList localSuggestions = suggestions;
+            suggestionSearch = server->makeRequest(
+                "/api/search",
+                requestData,
+                [=](const QJsonObject& response) {
+                    if (generation != suggestionGeneration) {
+                        return; // Superseded while the reply was being delivered
+                    }
+                    suggestionSearch = 0;
+                    
+                    QStringList serverSuggestions = localSuggestions;
+                    QStringList results;
+                    for (const QJsonValue& value : response["results"].toArray()) {
+                        results << value.toString();
+                    }
+                    appendSuggestions(serverSuggestions, results, MAX_SUGGESTIONS);
+                    
+                    if (serverSuggestions != localSuggestions) {
+                        LOG_DEBUG("suggestions", "Server enhanced suggestions: " + serverSuggestions.join(", "));
+                        emit suggestionsAvailable(query, serverSuggestions);
+                    }
+                },
+                [=](const QString& error) {
+                    if (generation == suggestionGeneration) {
+                        suggestionSearch = 0;
+                    }
+                    qDebug() << "CommandManager: Server search failed:" << error;
+                    // Already provided local suggestions
+                }
+            );
+        }
     }
+    
+    if (callback) callback(suggestions);
+    emit suggestionsAvailable(query, suggestions);
 }
@@ -4,11 +4,19 @@
 #include <QObject>
 #include <QString>
 #include <QStringList>
+#include <QSet>
 #include <QJsonObject>
 #include <QJsonArray>
 #include <functional>
+#include "commandscheduler.h"
+#include "resultcache.h"
+#include "commandjournal.h"
+#include "documentmodel.h"
+#include "bpetokenizer.h"
+#include <memory>
 
 class ServerManager;
+class QTimer;
 
 class CommandManager : public QObject
 {
@@ -23,9 +31,12 @@ public:
         ExecutionError
     };
 
-    enum ExecutionState {
-        Idle,
-        Executing
+    typedef CommandScheduler::Ticket Ticket;
+
+    struct ExecutionState {
+        int queued = 0;   // Accepted but waiting for a free slot
+        int inFlight = 0; // Currently running
+        bool isIdle() const { return queued == 0 && inFlight == 0; }
     };
 
     struct CommandInfo {
@@ -33,6 +44,12 @@ public:
         QString description;
         bool requiresServer;
         bool requiresInput;
+        bool supportsStreaming = false; // Backend can send partial output as NDJSON
+        bool cacheable = false;         // Deterministic output, safe to serve from the result cache
+        bool supportsChunking = false;  // Large inputs can be processed chunk by chunk and merged
+        bool replacesInput = false;     // Output stands in for the text it was run on, not next to it
+        int deadline = 0;               // Milliseconds the backend may spend per request, 0 for DEFAULT_DEADLINE
+        int maxInputTokens = 0;         // Model window the input is truncated to, 0 if no model reads it
     };
 
     explicit CommandManager(ServerManager* serverManager, QObject *parent = nullptr);
@@ -40,44 +57,220 @@ public:
     // Command registry
     QStringList getAllCommands() const;
     QStringList getValidCommands() const; // Only commands that can currently run
-    CommandInfo getCommandInfo(const QString& command) const;
+    CommandInfo getCommandInfo(const QString& command) const; // Name or full command line
     bool isCommandValid(const QString& command) const;
+    // True for server commands that would be queued until the backend finishes
+    // starting, or comes back while the session journal is enabled
+    bool isCommandDeferred(const QString& command) const;
+    
+    // Model tokens in text, <s> and </s> included; -1 without the tokenizer files
+    int countTokens(const QString& text) const;
+    // Stops counting past limit and returns limit + 1 for longer text
+    int countTokens(const QString& text, int limit) const;
+    // True if the command would be split into chunks (for summaries: beyond one model window)
+    bool needsChunking(const QString& baseCommand, const QString& text) const;
     
     // Execution state
-    ExecutionState getExecutionState() const { return executionState; }
-    bool isExecuting() const { return executionState == Executing; }
+    ExecutionState getExecutionState() const;
+    bool isExecuting() const { return !getExecutionState().isIdle(); }
+    
+    // Command execution - returns a ticket usable with cancelCommand(), or 0 if rejected
+    Ticket executeCommand(const QString& command, const QString& inputText = "",
+                          std::function<void(CommandResult, const QString&)> callback = nullptr);
+    // Runs several commands on the same text. Server commands that need a round
+    // trip are sent as one /api/batch request, so the text is serialised and
+    // tokenised once; each command still gets its own ticket (0 if rejected)
+    // and commandExecuted signal. Longer lists are split into several batches.
+    QVector<Ticket> executeBatch(const QStringList& commands, const QString& inputText,
+                                 std::function<void(const QString&, CommandResult, const QString&)> callback = nullptr);
+    // Drops the command if queued; if running, its requests are aborted and the
+    // backend is told to stop generating
+    bool cancelCommand(Ticket ticket);
+    // Request ID under which the ticket's spans are traced and sent to the backend
+    QString requestId(Ticket ticket) const;
+    bool isCommandPending(Ticket ticket) const;
+    
+    // Scheduling configuration
+    void setEndpointConcurrency(const QString& endpoint, int limit);
+    void setMaxQueueSize(int size);
     
-    // Command execution
-    void executeCommand(const QString& command, const QString& inputText = "",
-                       std::function<void(CommandResult, const QString&)> callback = nullptr);
+    // Streaming, off by default: partial output of streamable commands is
+    // reported through commandProgress. Streamed summaries are decoded greedily
+    // instead of with beam search, so they are not cached.
+    void setStreamingEnabled(bool enabled) { streamingEnabled = enabled; }
+    bool isStreamingEnabled() const { return streamingEnabled; }
     
-    // Suggestions
+    // Result cache for deterministic server commands
+    void setResultCacheEnabled(bool enabled) { resultCacheEnabled = enabled; }
+    bool isResultCacheEnabled() const { return resultCacheEnabled; }
+    void setPersistentCacheEnabled(bool enabled);
+    // Identical cacheable requests started while one is in flight share its reply
+    void setRequestCoalescingEnabled(bool enabled) { requestCoalescing = enabled; }
+    bool isRequestCoalescingEnabled() const { return requestCoalescing; }
+    const ResultCache::Stats& cacheStats() const { return resultCache.stats(); }
+    
+    // Session journal, off by default (the editor's --journal): server commands
+    // held while the backend is unreachable are recorded on disk with their
+    // text and replayed in batches once it is back, instead of being dropped
+    // when it fails. Ones still pending when the editor closed are replayed
+    // into the result cache at the next start.
+    void setJournalEnabled(bool enabled);
+    bool isJournalEnabled() const { return journal.isOpen(); }
+    int journalledCommands() const { return journal.pendingCount(); }
+    
+    // Speculative execution, off by default: once the editor is idle after a
+    // large edit, the commands this user runs most are computed into the result
+    // cache at low priority. Any real server command cancels them, except one
+    // sending the very same request, which joins it instead.
+    void setSpeculativeExecutionEnabled(bool enabled);
+    bool isSpeculativeExecutionEnabled() const { return speculativeExecution; }
+    // Enabled, the backend is ready with spare capacity and nothing else is running
+    bool canSpeculate() const;
+    // Returns the number of commands started; speculation on older text is dropped
+    int speculate(const QString& inputText);
+    // Most used cacheable server commands, summarise and keywords before there is a history
+    QStringList predictedCommands() const;
+    
+    // Suggestions. Near-miss command names are found with the in-process fuzzy
+    // matcher; the server's /api/search is only used when it is disabled or the
+    // corpus is too large to score locally.
     void getSuggestions(const QString& query,
                        std::function<void(const QStringList&)> callback);
+    void setLocalFuzzyMatchingEnabled(bool enabled) { localFuzzyMatching = enabled; }
+    bool isLocalFuzzyMatchingEnabled() const { return localFuzzyMatching; }
+    
+    // Debounced variant for per-keystroke use: only the last query within the
+    // debounce window is looked up, and results for superseded queries are
+    // dropped (outstanding server searches are aborted)
+    void requestSuggestions(const QString& query);
+    void cancelPendingSuggestions();
+    void setSuggestionDebounceInterval(int msec);
+    int suggestionDebounceInterval() const;
 
 signals:
-    void commandExecuted(const QString& command, CommandResult result, const QString& output);
-    void executionStateChanged(ExecutionState state);
+    void commandExecuted(CommandManager::Ticket ticket, const QString& command, CommandResult result, const QString& output);
+    void commandProgress(CommandManager::Ticket ticket, const QString& command, const QString& partialOutput);
+    void commandStageProgress(CommandManager::Ticket ticket, const QString& command, const QString& stage,
+                              int completed, int total);
+    void executionStateChanged(const CommandManager::ExecutionState& state);
     void suggestionsAvailable(const QString& query, const QStringList& suggestions);
 
 private slots:
     void handleServerStatusChange();
+    void handleSchedulerStateChange(int queued, int inFlight);
+    void flushPendingSuggestions();
 
 private:
+    friend class HotPathBenchmark; // bench/hotpathbench.cpp times the parsing and formatting helpers
+    
     void initializeCommands();
+    QStringList serverEndpoints() const;
+    void rejectCommand(const QString& command, CommandResult result, const QString& error,
+                       const std::function<void(CommandResult, const QString&)>& callback);
     void executeLocalCommand(const QString& command, const QString& inputText,
                            std::function<void(CommandResult, const QString&)> callback);
-    void executeServerCommand(const QString& command, const QString& inputText,
-                            std::function<void(CommandResult, const QString&)> callback);
+    void executeServerCommand(Ticket ticket, const QString& command, const QString& inputText,
+                              std::function<void(CommandResult, const QString&)> callback);
+    bool streamsReply(Ticket ticket, const QString& baseCommand) const;
+    
+    // Batching and coalescing of server requests
+    struct BatchRun;
+    // restoredId: the journal entry being replayed from an earlier session
+    Ticket submitCommand(const QString& command, const QString& inputText,
+                         std::function<void(CommandResult, const QString&)> callback,
+                         const std::shared_ptr<BatchRun>& batch, quint64 restoredId = 0);
+    void batchPartStarted(const std::shared_ptr<BatchRun>& batch);
+    void sendBatch(const std::shared_ptr<BatchRun>& batch);
+    bool joinInflightRequest(const QString& cacheKey, const std::function<void(CommandResult, const QString&)>& onComplete);
+    std::function<void(CommandResult, const QString&)> trackInflightRequest(
+        const QString& cacheKey, std::function<void(CommandResult, const QString&)> onComplete);
+    
+    // Speculative execution
+    void cancelSpeculation(const QString& keepKey);
+    void recordCommandUse(const QString& command);
+    void loadCommandHistory();
+    void saveCommandHistory() const;
+    QString commandHistoryPath() const;
+    
+    // Chunked execution of large documents
+    struct ChunkedRun;
+    QString resultProducer(const QString& baseCommand) const;
+    // Cache key of a chunk's result, empty when it must not be cached
+    QString chunkResultKey(const QString& baseCommand, const QJsonObject& args, const DocumentModel::Chunk& chunk) const;
+    void executeChunkedCommand(Ticket ticket, const QString& command, const QString& baseCommand,
+                               const QJsonObject& args, const QString& inputText,
+                               std::function<void(CommandResult, const QString&)> callback);
+    void startChunkedRun(Ticket ticket, const QString& command, const QString& baseCommand,
+                         const QJsonObject& targetArgs, const QString& text, int depth,
+                         std::function<void(bool, const QJsonObject&, const QString&)> onDone);
+    void submitNextChunks(const std::shared_ptr<ChunkedRun>& run);
+    void failChunkedRun(const std::shared_ptr<ChunkedRun>& run, const QString& error);
+    void completeChunkedRun(const std::shared_ptr<ChunkedRun>& run);
+    void reduceSummaries(const std::shared_ptr<ChunkedRun>& run, const QJsonObject& mapped);
+    void cancelChunkedRun(Ticket ticket);
+    
+    // Deadlines and cancellation of the requests sent for a command
+    int commandDeadline(const QString& baseCommand) const;
+    void trackServerRequest(Ticket ticket, quint64 handle);
+    bool abortServerRequests(Ticket ticket); // True if any were still running
+    QJsonObject mergeChunkResults(const QString& baseCommand, const QVector<QJsonObject>& results) const;
     
     // Command parsing helpers
     bool parseCommandWithArgs(const QString& command, QString& baseCommand, QJsonObject& args) const;
     QString formatServerResponse(const QString& command, const QJsonObject& response) const;
     
     ServerManager* server;
+    CommandScheduler* scheduler;
     QMap<QString, CommandInfo> commands;
     QStringList availableCommands;
-    ExecutionState executionState;
+    bool streamingEnabled;
+    bool localFuzzyMatching;
+    QTimer* suggestionTimer;
+    QString pendingSuggestionQuery;
+    quint64 suggestionGeneration; // Bumped whenever earlier suggestions become stale
+    quint64 suggestionSearch; // ServerManager::RequestHandle of the running /api/search, or 0
+    ResultCache resultCache;
+    BpeTokenizer tokenizer; // Same vocabulary as the backend's model
+    bool resultCacheEnabled;
+    bool requestCoalescing;
+    // Cache key of each server request in flight, with the commands waiting on its reply
+    QHash<QString, QVector<std::function<void(CommandResult, const QString&)>>> inflightRequests;
+    QHash<QString, DocumentModel> documentModels; // One per chunked command
+    QHash<Ticket, std::shared_ptr<ChunkedRun>> chunkedRuns;
+    QMultiHash<Ticket, quint64> serverRequests; // ServerManager::RequestHandles by the command they serve
+    // /api/batch requests in flight, by handle: aborted once none of their commands wants the reply
+    struct BatchRequest {
+        int liveParts;
+        QString traceId; // Request ID the backend knows the whole batch by
+    };
+    QHash<quint64, BatchRequest> batchRequests;
+    QString requestIdPrefix; // Unique per process and CommandManager
+    bool speculativeExecution;
+    QHash<QString, int> commandHistory; // Times each cacheable server command was run, kept between sessions
+    QHash<Ticket, QString> speculativeTickets; // Cache key each speculation fills
+    CommandJournal journal;
+    std::shared_ptr<BatchRun> replayBatch; // Batch the next held command joins
+    QSet<Ticket> restoredTickets; // Journal entries of an earlier session, run unseen
+    
+    static const QString LOCAL_ENDPOINT;
+    static const QString COORDINATOR_ENDPOINT;
+    static const QString BATCH_ENDPOINT;
+    static const QString REPLAY_ENDPOINT;
+    static const int REPLAY_BATCH_SIZE;
+    static const int MAX_BATCH_SIZE;
+    static const int CHUNKING_THRESHOLD;
+    static const int SEGMENT_TOKEN_BUDGET;
+    static const int CHARS_PER_TOKEN_ESTIMATE;
+    static const int MAX_REDUCE_DEPTH;
+    static const int MIN_SUMMARY_WORDS;
+    static const int MAX_SUGGESTIONS;
+    static const double FUZZY_SCORE_CUTOFF;
+    static const int LOCAL_FUZZY_CORPUS_LIMIT;
+    static const int DEFAULT_SUGGESTION_DEBOUNCE;
+    static const int DEFAULT_DEADLINE;
+    static const int SPECULATIVE_COMMANDS;
 };
 
+Q_DECLARE_METATYPE(CommandManager::ExecutionState)
+
 #endif // COMMANDMANAGER_H
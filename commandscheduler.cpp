@@ -0,0 +1,198 @@
+#include "commandscheduler.h"
+#include <QDebug>
+#include <QPointer>
+
+const int CommandScheduler::DEFAULT_MAX_QUEUE_SIZE = 32;
+const int CommandScheduler::DEFAULT_CONCURRENCY = 1;
+
+CommandScheduler::CommandScheduler(QObject *parent)
+    : QObject(parent)
+    , nextTicket(1)
+    , defaultConcurrency(DEFAULT_CONCURRENCY)
+    , maxQueueSize(DEFAULT_MAX_QUEUE_SIZE)
+    , dispatching(false)
+    , dispatchRequested(false)
+{
+}
+
+CommandScheduler::Ticket CommandScheduler::submit(const QString& endpoint, Priority priority,
+                                                  Task task, CancelHandler onCancel)
+{
+    if (queue.size() >= maxQueueSize) {
+        qDebug() << "CommandScheduler: ❌ Queue full (" << queue.size() << "jobs), rejecting" << endpoint;
+        return 0;
+    }
+
+    Job job{nextTicket++, endpoint, priority, std::move(task), std::move(onCancel)};
+
+    // Keep the queue ordered by priority, FIFO within the same priority
+    int insertAt = queue.size();
+    while (insertAt > 0 && queue[insertAt - 1].priority > priority) {
+        --insertAt;
+    }
+    Ticket ticket = job.ticket;
+    queue.insert(insertAt, std::move(job));
+
+    qDebug() << "CommandScheduler: Queued ticket" << ticket << "for" << endpoint
+             << "(priority" << priority << ", position" << insertAt << ")";
+
+    notifyStateChanged();
+    dispatch();
+    return ticket;
+}
+
+bool CommandScheduler::cancel(Ticket ticket)
+{
+    for (int i = 0; i < queue.size(); ++i) {
+        if (queue[i].ticket == ticket) {
+            Job job = queue.takeAt(i);
+            qDebug() << "CommandScheduler: Cancelled queued ticket" << ticket;
+            notifyStateChanged();
+            if (job.onCancel) job.onCancel(ticket);
+            return true;
+        }
+    }
+
+    auto it = inFlight.find(ticket);
+    if (it != inFlight.end()) {
+        // Release the slot now; the job's late completion is ignored in finish()
+        CancelHandler onCancel = it->onCancel;
+        qDebug() << "CommandScheduler: Cancelled in-flight ticket" << ticket;
+        finish(ticket);
+        if (onCancel) onCancel(ticket);
+        return true;
+    }
+
+    return false;
+}
+
+void CommandScheduler::setEndpointConcurrency(const QString& endpoint, int limit)
+{
+    concurrencyLimits[endpoint] = limit;
+    dispatch();
+}
+
+int CommandScheduler::endpointConcurrency(const QString& endpoint) const
+{
+    return concurrencyLimits.value(endpoint, defaultConcurrency);
+}
+
+void CommandScheduler::setEndpointPaused(const QString& endpoint, bool paused)
+{
+    if (paused == pausedEndpoints.contains(endpoint)) {
+        return;
+    }
+    
+    if (paused) {
+        pausedEndpoints.insert(endpoint);
+    } else {
+        pausedEndpoints.remove(endpoint);
+        dispatch();
+    }
+}
+
+int CommandScheduler::cancelQueued(const QString& endpoint)
+{
+    QList<Job> cancelled;
+    for (int i = queue.size() - 1; i >= 0; --i) {
+        if (queue[i].endpoint == endpoint) {
+            cancelled.prepend(queue.takeAt(i));
+        }
+    }
+    if (cancelled.isEmpty()) {
+        return 0;
+    }
+    
+    qDebug() << "CommandScheduler: Cancelled" << cancelled.size() << "queued jobs for" << endpoint;
+    notifyStateChanged();
+    for (const Job& job : cancelled) {
+        if (job.onCancel) job.onCancel(job.ticket);
+    }
+    return cancelled.size();
+}
+
+bool CommandScheduler::isQueued(Ticket ticket) const
+{
+    for (const Job& job : queue) {
+        if (job.ticket == ticket) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool CommandScheduler::hasCapacity(const QString& endpoint) const
+{
+    if (pausedEndpoints.contains(endpoint)) {
+        return false;
+    }
+    
+    int limit = endpointConcurrency(endpoint);
+    return limit <= 0 || inFlightPerEndpoint.value(endpoint, 0) < limit;
+}
+
+void CommandScheduler::dispatch()
+{
+    // Tasks may complete synchronously and re-enter dispatch through finish();
+    // collapse those calls into another pass of the outer loop instead.
+    if (dispatching) {
+        dispatchRequested = true;
+        return;
+    }
+
+    dispatching = true;
+    do {
+        dispatchRequested = false;
+
+        for (int i = 0; i < queue.size(); ++i) {
+            if (!hasCapacity(queue[i].endpoint)) {
+                continue;
+            }
+
+            Job job = queue.takeAt(i);
+            inFlight.insert(job.ticket, RunningJob{job.endpoint, job.onCancel});
+            inFlightPerEndpoint[job.endpoint]++;
+            notifyStateChanged();
+
+            qDebug() << "CommandScheduler: Starting ticket" << job.ticket << "on" << job.endpoint
+                     << "(" << inFlightPerEndpoint[job.endpoint] << "/" << endpointConcurrency(job.endpoint) << ")";
+
+            QPointer<CommandScheduler> self(this);
+            Ticket ticket = job.ticket;
+            job.task(ticket, [self, ticket]() {
+                if (self) {
+                    self->finish(ticket);
+                }
+            });
+
+            // The queue may have changed underneath us, rescan from the front
+            dispatchRequested = true;
+            break;
+        }
+    } while (dispatchRequested);
+    dispatching = false;
+}
+
+void CommandScheduler::finish(Ticket ticket)
+{
+    auto it = inFlight.find(ticket);
+    if (it == inFlight.end()) {
+        return; // Already cancelled or finished
+    }
+
+    QString endpoint = it->endpoint;
+    inFlight.erase(it);
+    if (--inFlightPerEndpoint[endpoint] <= 0) {
+        inFlightPerEndpoint.remove(endpoint);
+    }
+
+    qDebug() << "CommandScheduler: Finished ticket" << ticket << "on" << endpoint;
+
+    notifyStateChanged();
+    dispatch();
+}
+
+void CommandScheduler::notifyStateChanged()
+{
+    emit stateChanged(queue.size(), inFlight.size());
+}
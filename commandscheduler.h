@@ -0,0 +1,95 @@
+#ifndef COMMANDSCHEDULER_H
+#define COMMANDSCHEDULER_H
+
+#include <QObject>
+#include <QString>
+#include <QList>
+#include <QHash>
+#include <QMap>
+#include <QSet>
+#include <functional>
+
+// Bounded, priority-ordered job queue with a concurrency limit per endpoint.
+// Jobs are started in priority order (FIFO within a priority) as soon as
+// their endpoint has a free slot; each job reports completion through the
+// Completion callback it is handed when started.
+class CommandScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    typedef quint64 Ticket;
+    typedef std::function<void()> Completion;
+    typedef std::function<void(Ticket ticket, Completion done)> Task;
+    typedef std::function<void(Ticket ticket)> CancelHandler;
+
+    enum Priority {
+        High,    // Local commands (help, clear)
+        Normal,  // Interactive server commands
+        Low      // Background work
+    };
+
+    explicit CommandScheduler(QObject *parent = nullptr);
+
+    // Returns 0 if the queue is full
+    Ticket submit(const QString& endpoint, Priority priority, Task task,
+                  CancelHandler onCancel = nullptr);
+    bool cancel(Ticket ticket);
+
+    // Concurrency configuration (limit <= 0 means unbounded)
+    void setEndpointConcurrency(const QString& endpoint, int limit);
+    int endpointConcurrency(const QString& endpoint) const;
+    void setDefaultConcurrency(int limit) { defaultConcurrency = limit; }
+    void setMaxQueueSize(int size) { maxQueueSize = size; }
+    int getMaxQueueSize() const { return maxQueueSize; }
+    
+    // Jobs for a paused endpoint stay queued until it is resumed
+    void setEndpointPaused(const QString& endpoint, bool paused);
+    bool isEndpointPaused(const QString& endpoint) const { return pausedEndpoints.contains(endpoint); }
+    int cancelQueued(const QString& endpoint); // Returns the number of jobs cancelled
+
+    // State
+    int queuedCount() const { return queue.size(); }
+    int inFlightCount() const { return inFlight.size(); }
+    bool isQueued(Ticket ticket) const;
+    bool isInFlight(Ticket ticket) const { return inFlight.contains(ticket); }
+
+signals:
+    void stateChanged(int queued, int inFlight);
+
+private:
+    struct Job {
+        Ticket ticket;
+        QString endpoint;
+        Priority priority;
+        Task task;
+        CancelHandler onCancel;
+    };
+
+    struct RunningJob {
+        QString endpoint;
+        CancelHandler onCancel;
+    };
+
+    bool hasCapacity(const QString& endpoint) const;
+    void dispatch();
+    void finish(Ticket ticket);
+    void notifyStateChanged();
+
+    QList<Job> queue;
+    QHash<Ticket, RunningJob> inFlight;
+    QHash<QString, int> inFlightPerEndpoint;
+    QMap<QString, int> concurrencyLimits;
+    QSet<QString> pausedEndpoints;
+
+    Ticket nextTicket;
+    int defaultConcurrency;
+    int maxQueueSize;
+    bool dispatching;
+    bool dispatchRequested;
+
+    static const int DEFAULT_MAX_QUEUE_SIZE;
+    static const int DEFAULT_CONCURRENCY;
+};
+
+#endif // COMMANDSCHEDULER_H
@@ -0,0 +1,239 @@
+#include "documentmodel.h"
+#include "bpetokenizer.h"
+#include <QCryptographicHash>
+#include <QDebug>
+
+const int DocumentModel::DEFAULT_MIN_CHUNK_LENGTH = 1500;
+const int DocumentModel::DEFAULT_MAX_CHUNK_LENGTH = 4000;
+const uint DocumentModel::BOUNDARY_MODULUS = 4; // On average a boundary every 4th paragraph
+
+DocumentModel::DocumentModel()
+    : nextId(1)
+    , minLength(DEFAULT_MIN_CHUNK_LENGTH)
+    , maxLength(DEFAULT_MAX_CHUNK_LENGTH)
+    , sizeTokenizer(nullptr)
+{
+}
+
+void DocumentModel::setChunkLimits(int newMinLength, int newMaxLength)
+{
+    maxLength = qMax(1, newMaxLength);
+    minLength = qBound(0, newMinLength, maxLength);
+}
+
+QString DocumentModel::hashText(const QString& text)
+{
+    QByteArray raw = QByteArray::fromRawData(reinterpret_cast<const char*>(text.constData()),
+                                             text.size() * int(sizeof(QChar)));
+    return QString::fromLatin1(QCryptographicHash::hash(raw, QCryptographicHash::Sha1).toHex());
+}
+
+void DocumentModel::update(const QString& text)
+{
+    // IDs of the previous version, by content, so unchanged chunks keep theirs
+    QHash<QString, QList<quint64>> previousIds;
+    for (const Chunk& chunk : currentChunks) {
+        previousIds[chunk.hash].append(chunk.id);
+    }
+
+    QVector<Paragraph> paragraphs = splitParagraphs(text);
+
+    // Group paragraphs into chunks between minLength and maxLength, closing a
+    // chunk after a paragraph whose content hash marks a boundary
+    QVector<Paragraph> spans;
+    int chunkStart = -1;
+    int chunkEnd = -1;
+    int chunkSize = 0;
+    for (const Paragraph& paragraph : paragraphs) {
+        int paragraphEnd = paragraph.start + paragraph.length;
+        int gap = chunkStart < 0 ? 0 : measure(text, chunkEnd, paragraph.start - chunkEnd);
+
+        if (chunkStart < 0) {
+            chunkStart = paragraph.start;
+            chunkSize = 0;
+        } else if (chunkSize + gap + paragraph.size > maxLength) {
+            spans.append({chunkStart, chunkEnd - chunkStart, chunkSize});
+            chunkStart = paragraph.start;
+            chunkSize = 0;
+            gap = 0;
+        }
+        chunkEnd = paragraphEnd;
+        chunkSize += gap + paragraph.size;
+
+        if (chunkSize >= minLength && isBoundary(text, paragraph)) {
+            spans.append({chunkStart, chunkEnd - chunkStart, chunkSize});
+            chunkStart = -1;
+        }
+    }
+
+    if (chunkStart >= 0) {
+        // Fold a short tail into the previous chunk when it fits
+        int gap = spans.isEmpty() ? 0 : measure(text, spans.last().start + spans.last().length,
+                                                chunkStart - spans.last().start - spans.last().length);
+        if (!spans.isEmpty() && chunkSize < minLength
+            && spans.last().size + gap + chunkSize <= maxLength) {
+            spans.last().length = chunkEnd - spans.last().start;
+            spans.last().size += gap + chunkSize;
+        } else {
+            spans.append({chunkStart, chunkEnd - chunkStart, chunkSize});
+        }
+    }
+
+    QVector<Chunk> newChunks;
+    newChunks.reserve(spans.size());
+    for (const Paragraph& span : spans) {
+        Chunk chunk;
+        chunk.start = span.start;
+        chunk.text = text.mid(span.start, span.length);
+        chunk.hash = hashText(chunk.text);
+
+        auto it = previousIds.find(chunk.hash);
+        if (it != previousIds.end() && !it->isEmpty()) {
+            chunk.id = it->takeFirst();
+        } else {
+            chunk.id = nextId++;
+        }
+        newChunks.append(chunk);
+    }
+
+    currentChunks = newChunks;
+    qDebug() << "DocumentModel: Split" << text.size() << "characters into" << currentChunks.size() << "chunks";
+}
+
+QVector<int> DocumentModel::dirtyChunks(const QString& scope) const
+{
+    QVector<int> dirty;
+    const QSet<QString> processed = processedByScope.value(scope);
+    for (int i = 0; i < currentChunks.size(); ++i) {
+        if (!processed.contains(currentChunks[i].hash)) {
+            dirty.append(i);
+        }
+    }
+    return dirty;
+}
+
+void DocumentModel::markProcessed(const QString& scope, const Chunk& chunk)
+{
+    processedByScope[scope].insert(chunk.hash);
+}
+
+QVector<DocumentModel::Paragraph> DocumentModel::splitParagraphs(const QString& text) const
+{
+    QVector<Paragraph> paragraphs;
+    const int size = text.size();
+    int pos = 0;
+
+    while (pos < size) {
+        // Skip blank lines between paragraphs
+        while (pos < size && text[pos].isSpace()) {
+            ++pos;
+        }
+        if (pos >= size) {
+            break;
+        }
+
+        int start = pos;
+        int end = size;
+
+        // A paragraph ends at a line break followed by a whitespace-only line
+        while (pos < size) {
+            int newline = text.indexOf('\n', pos);
+            if (newline < 0) {
+                pos = size;
+                break;
+            }
+
+            int next = newline + 1;
+            while (next < size && text[next] != '\n' && text[next].isSpace()) {
+                ++next;
+            }
+            pos = newline + 1;
+            if (next >= size || text[next] == '\n') {
+                end = newline;
+                break;
+            }
+        }
+
+        while (end > start && text[end - 1].isSpace()) {
+            --end;
+        }
+
+        Paragraph paragraph{start, end - start, measure(text, start, end - start)};
+        if (paragraph.size > maxLength) {
+            splitOversized(text, paragraph, paragraphs);
+        } else {
+            paragraphs.append(paragraph);
+        }
+    }
+
+    return paragraphs;
+}
+
+void DocumentModel::splitOversized(const QString& text, Paragraph paragraph, QVector<Paragraph>& out) const
+{
+    int pos = paragraph.start;
+    const int end = paragraph.start + paragraph.length;
+
+    while (pos < end) {
+        int limit = pos + fittingLength(text, pos, end - pos);
+        if (limit >= end) {
+            break;
+        }
+        int cut = -1;
+
+        // Prefer the last sentence end, then the last whitespace, inside the limit
+        // (but not within the first half of a minimum-size chunk)
+        int earliest = pos + int(qint64(limit - pos) * minLength / (2 * maxLength));
+        for (int i = limit - 1; i > earliest; --i) {
+            QChar c = text[i];
+            if ((c == '.' || c == '!' || c == '?') && text[i + 1].isSpace()) {
+                cut = i + 1;
+                break;
+            }
+        }
+        if (cut < 0) {
+            for (int i = limit - 1; i > pos; --i) {
+                if (text[i].isSpace()) {
+                    cut = i;
+                    break;
+                }
+            }
+        }
+        if (cut < 0) {
+            cut = limit;
+        }
+
+        out.append({pos, cut - pos, measure(text, pos, cut - pos)});
+        pos = cut;
+        while (pos < end && text[pos].isSpace()) {
+            ++pos;
+        }
+    }
+
+    if (pos < end) {
+        out.append({pos, end - pos, measure(text, pos, end - pos)});
+    }
+}
+
+int DocumentModel::measure(const QString& text, int start, int length) const
+{
+    if (!sizeTokenizer) {
+        return length;
+    }
+    return sizeTokenizer->countTokens(QStringView(text).mid(start, length));
+}
+
+int DocumentModel::fittingLength(const QString& text, int start, int length) const
+{
+    if (!sizeTokenizer) {
+        return qMin(length, maxLength);
+    }
+    return sizeTokenizer->prefixLength(QStringView(text).mid(start, length), maxLength);
+}
+
+bool DocumentModel::isBoundary(const QString& text, const Paragraph& paragraph) const
+{
+    // Fixed seed: boundaries must not depend on the per-process hash seed
+    const QChar* data = text.constData() + paragraph.start;
+    return qHashBits(data, paragraph.length * sizeof(QChar), 0) % BOUNDARY_MODULUS == 0;
+}
@@ -0,0 +1,72 @@
+#ifndef DOCUMENTMODEL_H
+#define DOCUMENTMODEL_H
+
+#include <QString>
+#include <QVector>
+#include <QHash>
+#include <QSet>
+
+// Splits editor text into paragraph-aligned chunks with stable IDs and
+// content hashes, and remembers which chunk contents each command scope has
+// already processed. Chunk boundaries are content-defined (they depend on
+// the paragraphs themselves, not on absolute offsets), so an edit only
+// changes the chunks it touches.
+//
+// Chunk sizes are measured in characters, or in model tokens once a
+// tokenizer is set.
+class BpeTokenizer;
+
+class DocumentModel
+{
+public:
+    struct Chunk {
+        quint64 id;   // Stays the same while the chunk's content is unchanged
+        QString hash; // SHA-1 of the chunk text
+        int start;    // Offset into the document
+        QString text;
+    };
+
+    DocumentModel();
+
+    void update(const QString& text);
+    const QVector<Chunk>& chunks() const { return currentChunks; }
+
+    // Dirty tracking per scope (a command together with its arguments)
+    QVector<int> dirtyChunks(const QString& scope) const;
+    void markProcessed(const QString& scope, const Chunk& chunk);
+    void forgetScope(const QString& scope) { processedByScope.remove(scope); }
+
+    // Chunk size bounds, in characters or in tokens with a tokenizer set
+    void setChunkLimits(int minLength, int maxLength);
+    int minChunkLength() const { return minLength; }
+    int maxChunkLength() const { return maxLength; }
+    void setTokenizer(const BpeTokenizer* tokenizer) { sizeTokenizer = tokenizer; }
+
+    static QString hashText(const QString& text);
+
+private:
+    struct Paragraph {
+        int start;
+        int length;
+        int size; // In the unit of the chunk limits
+    };
+
+    QVector<Paragraph> splitParagraphs(const QString& text) const;
+    void splitOversized(const QString& text, Paragraph paragraph, QVector<Paragraph>& out) const;
+    bool isBoundary(const QString& text, const Paragraph& paragraph) const;
+    int measure(const QString& text, int start, int length) const;
+    int fittingLength(const QString& text, int start, int length) const; // Characters that fit in maxLength
+
+    QVector<Chunk> currentChunks;
+    QHash<QString, QSet<QString>> processedByScope;
+    quint64 nextId;
+    int minLength;
+    int maxLength;
+    const BpeTokenizer* sizeTokenizer;
+
+    static const int DEFAULT_MIN_CHUNK_LENGTH;
+    static const int DEFAULT_MAX_CHUNK_LENGTH;
+    static const uint BOUNDARY_MODULUS;
+};
+
+#endif // DOCUMENTMODEL_H
@@ -0,0 +1,274 @@
+#include "eventlog.h"
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QFile>
+#include <QTextStream>
+#include <QThread>
+#include <QTimer>
+#include <QDebug>
+#include <cstdint>
+
+const int EventLog::QUEUE_CAPACITY = 4096; // Power of two; entries logged between flushes
+const int EventLog::HISTORY_SIZE = 2000;
+const int EventLog::FLUSH_INTERVAL = 100; // Milliseconds
+
+namespace {
+EventLog* globalLog = nullptr;
+QtMessageHandler previousMessageHandler = nullptr;
+bool capturingQtMessages = false;
+
+void forwardQtMessage(QtMsgType type, const QMessageLogContext& context, const QString& message)
+{
+    if (globalLog) {
+        EventLog::Level level = EventLog::Debug;
+        switch (type) {
+            case QtDebugMsg: level = EventLog::Debug; break;
+            case QtInfoMsg: level = EventLog::Info; break;
+            case QtWarningMsg: level = EventLog::Warning; break;
+            case QtCriticalMsg:
+            case QtFatalMsg: level = EventLog::Error; break;
+        }
+        globalLog->log(level, "qt", message);
+    }
+    if (previousMessageHandler) {
+        previousMessageHandler(type, context, message);
+    }
+}
+}
+
+// Lives on the sink thread; batches arrive as queued calls
+class LogFileWriter : public QObject
+{
+public:
+    bool open(const QString& path)
+    {
+        file.setFileName(path);
+        return file.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text);
+    }
+
+    void write(const QVector<EventLog::Entry>& entries)
+    {
+        QTextStream out(&file);
+        for (const EventLog::Entry& entry : entries) {
+            out << EventLog::formatForFile(entry) << '\n';
+        }
+        out.flush();
+    }
+
+private:
+    QFile file;
+};
+
+EventLog* EventLog::instance()
+{
+    if (!globalLog) {
+        globalLog = new EventLog(QCoreApplication::instance());
+    }
+    return globalLog;
+}
+
+EventLog::EventLog(QObject *parent)
+    : QObject(parent)
+    , cells(new Cell[QUEUE_CAPACITY])
+    , cellMask(QUEUE_CAPACITY - 1)
+    , enqueuePosition(0)
+    , dequeuePosition(0)
+    , dropped(0)
+    , flushPending(false)
+    , historyStart(0)
+    , nextSequence(1)
+    , flushTimer(new QTimer(this))
+    , fileThread(nullptr)
+    , fileWriter(nullptr)
+{
+    for (int i = 0; i < QUEUE_CAPACITY; ++i) {
+        cells[i].sequence.store(size_t(i), std::memory_order_relaxed);
+    }
+    history.reserve(HISTORY_SIZE);
+
+    flushTimer->setSingleShot(true);
+    flushTimer->setInterval(FLUSH_INTERVAL);
+    connect(flushTimer, &QTimer::timeout, this, &EventLog::flush);
+}
+
+EventLog::~EventLog()
+{
+    if (capturingQtMessages) {
+        qInstallMessageHandler(previousMessageHandler);
+        capturingQtMessages = false;
+    }
+    flush();
+    closeFileSink();
+    if (globalLog == this) {
+        globalLog = nullptr;
+    }
+}
+
+void EventLog::log(Level level, const QString& category, const QString& message)
+{
+    Entry entry;
+    entry.timestamp = QDateTime::currentMSecsSinceEpoch();
+    entry.level = level;
+    entry.category = category;
+    entry.message = message;
+
+    if (!tryPush(std::move(entry))) {
+        // Flushes are far more frequent than QUEUE_CAPACITY entries; only a
+        // runaway producer gets here
+        dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // One queued wake-up per flush window, however many entries arrive
+    if (!flushPending.exchange(true, std::memory_order_acq_rel)) {
+        QMetaObject::invokeMethod(this, [this]() { scheduleFlush(); }, Qt::QueuedConnection);
+    }
+}
+
+bool EventLog::tryPush(Entry&& entry)
+{
+    size_t position = enqueuePosition.load(std::memory_order_relaxed);
+    for (;;) {
+        Cell& cell = cells[position & cellMask];
+        size_t sequence = cell.sequence.load(std::memory_order_acquire);
+        intptr_t difference = intptr_t(sequence) - intptr_t(position);
+        if (difference == 0) {
+            if (enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                cell.entry = std::move(entry);
+                cell.sequence.store(position + 1, std::memory_order_release);
+                return true;
+            }
+        } else if (difference < 0) {
+            return false; // Full
+        } else {
+            position = enqueuePosition.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+bool EventLog::tryPop(Entry& entry)
+{
+    Cell& cell = cells[dequeuePosition & cellMask];
+    size_t sequence = cell.sequence.load(std::memory_order_acquire);
+    if (intptr_t(sequence) - intptr_t(dequeuePosition + 1) < 0) {
+        return false; // Empty, or the producer is still writing this cell
+    }
+
+    entry = std::move(cell.entry);
+    cell.entry = Entry();
+    cell.sequence.store(dequeuePosition + QUEUE_CAPACITY, std::memory_order_release);
+    ++dequeuePosition;
+    return true;
+}
+
+void EventLog::scheduleFlush()
+{
+    if (!flushTimer->isActive()) {
+        flushTimer->start();
+    }
+}
+
+void EventLog::flush()
+{
+    // Cleared before draining so entries logged from here on schedule another flush
+    flushPending.store(false, std::memory_order_release);
+
+    QVector<Entry> batch;
+    Entry entry;
+    while (tryPop(entry)) {
+        entry.sequence = nextSequence++;
+        batch.append(entry);
+
+        if (history.size() < HISTORY_SIZE) {
+            history.append(std::move(entry));
+        } else {
+            history[historyStart] = std::move(entry);
+            historyStart = (historyStart + 1) % HISTORY_SIZE;
+        }
+    }
+
+    if (batch.isEmpty()) {
+        return;
+    }
+
+    if (fileWriter) {
+        LogFileWriter* writer = fileWriter;
+        QMetaObject::invokeMethod(writer, [writer, batch]() { writer->write(batch); }, Qt::QueuedConnection);
+    }
+
+    emit flushed(lastSequence());
+}
+
+QVector<EventLog::Entry> EventLog::entriesSince(quint64 sequence, Level minimumLevel) const
+{
+    QVector<Entry> entries;
+    for (int i = 0; i < history.size(); ++i) {
+        const Entry& entry = history[(historyStart + i) % history.size()];
+        if (entry.sequence > sequence && entry.level >= minimumLevel) {
+            entries.append(entry);
+        }
+    }
+    return entries;
+}
+
+bool EventLog::setFileSink(const QString& path)
+{
+    closeFileSink();
+
+    LogFileWriter* writer = new LogFileWriter();
+    if (!writer->open(path)) {
+        qWarning() << "EventLog: ❌ Cannot open log file" << path;
+        delete writer;
+        return false;
+    }
+
+    fileThread = new QThread(this);
+    fileThread->setObjectName("EventLog file sink");
+    writer->moveToThread(fileThread);
+    fileThread->start(QThread::LowPriority);
+    fileWriter = writer;
+
+    qDebug() << "EventLog: ✅ Writing log to" << path;
+    return true;
+}
+
+void EventLog::closeFileSink()
+{
+    if (!fileThread) {
+        return;
+    }
+
+    // Queued calls run in order, so once this returns every batch is written
+    QMetaObject::invokeMethod(fileWriter, []() {}, Qt::BlockingQueuedConnection);
+    fileThread->quit();
+    fileThread->wait();
+    delete fileWriter;
+    fileWriter = nullptr;
+    delete fileThread;
+    fileThread = nullptr;
+}
+
+void EventLog::captureQtMessages()
+{
+    if (!capturingQtMessages) {
+        previousMessageHandler = qInstallMessageHandler(forwardQtMessage);
+        capturingQtMessages = true;
+    }
+}
+
+QString EventLog::levelName(Level level)
+{
+    switch (level) {
+        case Debug: return "DEBUG";
+        case Info: return "INFO";
+        case Warning: return "WARN";
+        case Error: return "ERROR";
+    }
+    return QString();
+}
+
+QString EventLog::formatForFile(const Entry& entry)
+{
+    return QString("%1 %2 [%3] %4")
+        .arg(QDateTime::fromMSecsSinceEpoch(entry.timestamp).toString(Qt::ISODateWithMs),
+             levelName(entry.level), entry.category, entry.message);
+}
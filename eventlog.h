@@ -0,0 +1,121 @@
+#ifndef EVENTLOG_H
+#define EVENTLOG_H
+
+#include <QObject>
+#include <QString>
+#include <QVector>
+#include <atomic>
+#include <memory>
+
+class QTimer;
+class QThread;
+
+// Entries below this level are compiled out: neither the message nor its
+// arguments are evaluated. Override with -DTEXDIT_MIN_LOG_LEVEL=<0..3>.
+#ifndef TEXDIT_MIN_LOG_LEVEL
+#ifdef QT_NO_DEBUG
+#define TEXDIT_MIN_LOG_LEVEL 1 // Info
+#else
+#define TEXDIT_MIN_LOG_LEVEL 0 // Debug
+#endif
+#endif
+
+#define TEXDIT_LOG(level, category, message) \
+    do { \
+        if (int(level) >= TEXDIT_MIN_LOG_LEVEL) { \
+            EventLog::instance()->log(level, category, message); \
+        } \
+    } while (0)
+
+#define LOG_DEBUG(category, message) TEXDIT_LOG(EventLog::Debug, category, message)
+#define LOG_INFO(category, message) TEXDIT_LOG(EventLog::Info, category, message)
+#define LOG_WARNING(category, message) TEXDIT_LOG(EventLog::Warning, category, message)
+#define LOG_ERROR(category, message) TEXDIT_LOG(EventLog::Error, category, message)
+
+class LogFileWriter;
+
+// Application event log. log() may be called from any thread and only
+// pushes a structured entry onto a bounded lock-free queue; the queue is
+// drained on the GUI thread in batches, at most once per FLUSH_INTERVAL,
+// into a fixed-size history and the optional file sink (written on its own
+// thread). Views render from the history when flushed() fires.
+//
+// The instance must first be created on the GUI thread.
+class EventLog : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Level {
+        Debug,
+        Info,
+        Warning,
+        Error
+    };
+
+    struct Entry {
+        quint64 sequence = 0; // Assigned when flushed, increases by one per entry
+        qint64 timestamp = 0; // Milliseconds since the epoch
+        Level level = Info;
+        QString category;
+        QString message;
+    };
+
+    static EventLog* instance();
+
+    void log(Level level, const QString& category, const QString& message);
+
+    // History, GUI thread only. Entries older than HISTORY_SIZE are discarded.
+    QVector<Entry> entriesSince(quint64 sequence, Level minimumLevel = Debug) const;
+    quint64 lastSequence() const { return nextSequence - 1; }
+    quint64 droppedCount() const { return dropped.load(std::memory_order_relaxed); }
+
+    // Appends every flushed entry to a file, written off the GUI thread
+    bool setFileSink(const QString& path);
+    void closeFileSink();
+
+    // Routes qDebug()/qWarning() output into the log as well as to the console
+    void captureQtMessages();
+
+    static QString levelName(Level level);
+    static QString formatForFile(const Entry& entry);
+
+    static const int QUEUE_CAPACITY;
+    static const int HISTORY_SIZE;
+    static const int FLUSH_INTERVAL;
+
+signals:
+    void flushed(quint64 lastSequence);
+
+private:
+    explicit EventLog(QObject *parent = nullptr);
+    ~EventLog();
+
+    bool tryPush(Entry&& entry);
+    bool tryPop(Entry& entry);
+    void scheduleFlush();
+    void flush();
+
+    // Bounded multi-producer queue (Vyukov): each cell's sequence tells
+    // producers and the consumer whose turn it is to use it
+    struct Cell {
+        std::atomic<size_t> sequence;
+        Entry entry;
+    };
+    std::unique_ptr<Cell[]> cells;
+    size_t cellMask;
+    std::atomic<size_t> enqueuePosition;
+    size_t dequeuePosition; // Consumer (GUI thread) only
+    std::atomic<quint64> dropped;
+    std::atomic<bool> flushPending;
+
+    QVector<Entry> history; // Ring of HISTORY_SIZE entries
+    int historyStart;
+    quint64 nextSequence;
+    QTimer* flushTimer;
+
+    QThread* fileThread;
+    LogFileWriter* fileWriter;
+};
+
+#endif // EVENTLOG_H
@@ -0,0 +1,138 @@
+#include "fuzzymatcher.h"
+#include <algorithm>
+
+namespace {
+const int ASCII_RANGE = 128;
+const int WORD_BITS = 64;
+
+int popcount(quint64 value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_popcountll(value);
+#else
+    int count = 0;
+    while (value) {
+        value &= value - 1;
+        ++count;
+    }
+    return count;
+#endif
+}
+}
+
+FuzzyMatcher::FuzzyMatcher(QStringView query)
+    : length(int(query.size()))
+    , blocks(qMax(1, (int(query.size()) + WORD_BITS - 1) / WORD_BITS))
+    , asciiMasks(ASCII_RANGE * blocks, 0)
+    , zeroMask(blocks, 0)
+{
+    // Bit i of a character's mask is set where the query has that character
+    for (int i = 0; i < length; ++i) {
+        ushort c = query[i].unicode();
+        quint64 bit = quint64(1) << (i % WORD_BITS);
+        if (c < ASCII_RANGE) {
+            asciiMasks[c * blocks + i / WORD_BITS] |= bit;
+        } else {
+            QVector<quint64>& masks = otherMasks[c];
+            if (masks.isEmpty()) {
+                masks.fill(0, blocks);
+            }
+            masks[i / WORD_BITS] |= bit;
+        }
+    }
+}
+
+const quint64* FuzzyMatcher::masksFor(QChar c) const
+{
+    ushort code = c.unicode();
+    if (code < ASCII_RANGE) {
+        return asciiMasks.constData() + code * blocks;
+    }
+
+    auto it = otherMasks.constFind(code);
+    return it != otherMasks.constEnd() ? it->constData() : zeroMask.constData();
+}
+
+int FuzzyMatcher::lcsLength(QStringView text) const
+{
+    // Hyyrö's bit-vector LCS: S starts all ones, and after the whole text the
+    // number of cleared bits within the query length is the LCS length.
+    // Stack storage covers queries up to 256 characters, longer ones use the heap.
+    quint64 stackRow[4];
+    QVector<quint64> heapRow;
+    quint64* row = stackRow;
+    if (blocks > 4) {
+        heapRow.fill(~quint64(0), blocks);
+        row = heapRow.data();
+    } else {
+        std::fill(stackRow, stackRow + blocks, ~quint64(0));
+    }
+
+    for (QChar c : text) {
+        const quint64* masks = masksFor(c);
+        quint64 carry = 0;
+        for (int b = 0; b < blocks; ++b) {
+            quint64 s = row[b];
+            quint64 u = s & masks[b];
+            quint64 sum = s + u + carry;
+            carry = (sum < s || (carry && sum == s)) ? 1 : 0;
+            row[b] = sum | (s - u);
+        }
+    }
+
+    int lcs = 0;
+    for (int b = 0; b < blocks; ++b) {
+        quint64 cleared = ~row[b];
+        int bitsInBlock = qMin(WORD_BITS, length - b * WORD_BITS);
+        if (bitsInBlock < WORD_BITS) {
+            cleared &= (quint64(1) << bitsInBlock) - 1;
+        }
+        lcs += popcount(cleared);
+    }
+    return lcs;
+}
+
+double FuzzyMatcher::score(QStringView text) const
+{
+    int total = length + int(text.size());
+    if (total == 0) {
+        return 100.0; // Two empty strings are identical
+    }
+    if (length == 0) {
+        return 0.0;
+    }
+    return 100.0 * 2.0 * lcsLength(text) / total;
+}
+
+double FuzzyMatcher::ratio(QStringView a, QStringView b)
+{
+    // The shorter string as pattern keeps the block count down
+    return a.size() <= b.size() ? FuzzyMatcher(a).score(b) : FuzzyMatcher(b).score(a);
+}
+
+QVector<FuzzyMatcher::Match> FuzzyMatcher::extract(QStringView query, const QStringList& choices,
+                                                   int limit, double scoreCutoff)
+{
+    FuzzyMatcher matcher(query);
+    QVector<Match> matches;
+    matches.reserve(choices.size());
+
+    for (int i = 0; i < choices.size(); ++i) {
+        double value = matcher.score(choices[i]);
+        if (value >= scoreCutoff) {
+            matches.append({i, value});
+        }
+    }
+
+    auto better = [](const Match& a, const Match& b) {
+        return a.score > b.score || (a.score == b.score && a.index < b.index);
+    };
+
+    if (limit >= 0 && limit < matches.size()) {
+        std::partial_sort(matches.begin(), matches.begin() + limit, matches.end(), better);
+        matches.resize(limit);
+    } else {
+        std::sort(matches.begin(), matches.end(), better);
+    }
+    return matches;
+}
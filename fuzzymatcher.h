@@ -0,0 +1,45 @@
+#ifndef FUZZYMATCHER_H
+#define FUZZYMATCHER_H
+
+#include <QString>
+#include <QStringList>
+#include <QStringView>
+#include <QVector>
+#include <QHash>
+
+// In-process equivalent of rapidfuzz's fuzz.ratio, the scorer behind the
+// backend's /api/search: 100 * 2 * LCS(a, b) / (len(a) + len(b)), computed
+// with a bit-parallel LCS kernel (64 pattern characters per machine word).
+// The query's match masks are built once and reused for every choice.
+class FuzzyMatcher
+{
+public:
+    struct Match {
+        int index; // Position in the choices list
+        double score;
+    };
+
+    explicit FuzzyMatcher(QStringView query);
+
+    // Similarity between the query and text in [0, 100]
+    double score(QStringView text) const;
+
+    static double ratio(QStringView a, QStringView b);
+
+    // Like rapidfuzz process.extract: best matches first, ties in
+    // choice order, scores below scoreCutoff dropped
+    static QVector<Match> extract(QStringView query, const QStringList& choices,
+                                  int limit, double scoreCutoff = 0);
+
+private:
+    int lcsLength(QStringView text) const;
+    const quint64* masksFor(QChar c) const;
+
+    int length;
+    int blocks;
+    QVector<quint64> asciiMasks; // 128 characters x blocks
+    QHash<ushort, QVector<quint64>> otherMasks;
+    QVector<quint64> zeroMask;
+};
+
+#endif // FUZZYMATCHER_H
@@ -0,0 +1,516 @@
+#include "largetextedit.h"
+#include <QApplication>
+#include <QClipboard>
+#include <QKeyEvent>
+#include <QMouseEvent>
+#include <QPainter>
+#include <QScrollBar>
+#include <QTextOption>
+
+const int LargeTextEdit::MARGIN = 4;
+const int LargeTextEdit::LAYOUT_CACHE_LIMIT = 512; // Several screens of lines
+
+LargeTextEdit::LargeTextEdit(QWidget *parent)
+    : QAbstractScrollArea(parent)
+    , cursor(0)
+    , anchor(0)
+    , preferredColumn(-1)
+    , layoutRevision(0)
+{
+    setFocusPolicy(Qt::StrongFocus);
+    setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+    viewport()->setCursor(Qt::IBeamCursor);
+    verticalScrollBar()->setSingleStep(1);
+    updateScrollBars();
+}
+
+void LargeTextEdit::setPlainText(const QString& text)
+{
+    int removed = buffer.length();
+    buffer.setText(text);
+    cursor = 0;
+    anchor = 0;
+    preferredColumn = -1;
+    invalidateLayouts();
+    updateScrollBars();
+    verticalScrollBar()->setValue(0);
+    viewport()->update();
+    emit contentsChange(0, removed, int(text.size()));
+    emit textChanged();
+    emit selectionChanged();
+}
+
+void LargeTextEdit::insertText(int position, const QString& text)
+{
+    if (text.isEmpty()) {
+        return;
+    }
+    position = qBound(0, position, buffer.length());
+    int firstLine = buffer.lineAt(position);
+    buffer.insert(position, text);
+    invalidateLayouts(firstLine, 0, int(text.count(QLatin1Char('\n'))));
+
+    // Like QTextCursor: positions after the insertion move, the ones at it stay
+    int length = int(text.size());
+    if (cursor > position) cursor += length;
+    if (anchor > position) anchor += length;
+
+    updateScrollBars();
+    viewport()->update();
+    emit contentsChange(position, 0, length);
+    emit textChanged();
+}
+
+void LargeTextEdit::removeText(int position, int length)
+{
+    position = qBound(0, position, buffer.length());
+    length = qBound(0, length, buffer.length() - position);
+    if (length == 0) {
+        return;
+    }
+    bool hadSelection = hasSelection();
+    int firstLine = buffer.lineAt(position);
+    int removedLines = buffer.lineAt(position + length) - firstLine;
+    buffer.remove(position, length);
+    invalidateLayouts(firstLine, removedLines, 0);
+
+    auto adjust = [position, length](int& offset) {
+        if (offset > position + length) {
+            offset -= length;
+        } else if (offset > position) {
+            offset = position;
+        }
+    };
+    adjust(cursor);
+    adjust(anchor);
+
+    updateScrollBars();
+    viewport()->update();
+    emit contentsChange(position, length, 0);
+    emit textChanged();
+    if (hadSelection != hasSelection()) {
+        emit selectionChanged();
+    }
+}
+
+void LargeTextEdit::appendText(const QString& text)
+{
+    bool following = isLineVisible(buffer.lineCount() - 1);
+    insertText(buffer.length(), text);
+    if (following) {
+        verticalScrollBar()->setValue(verticalScrollBar()->maximum());
+    }
+}
+
+void LargeTextEdit::setCursorPosition(int position, bool keepAnchor)
+{
+    bool hadSelection = hasSelection();
+    cursor = qBound(0, position, buffer.length());
+    if (!keepAnchor) {
+        anchor = cursor;
+    }
+    ensureVisible(cursor);
+    viewport()->update();
+    if (hadSelection || hasSelection()) {
+        emit selectionChanged();
+    }
+}
+
+void LargeTextEdit::selectAll()
+{
+    anchor = 0;
+    cursor = buffer.length();
+    viewport()->update();
+    emit selectionChanged();
+}
+
+void LargeTextEdit::replaceSelection(const QString& text)
+{
+    int start = selectionStart();
+    bool hadSelection = hasSelection();
+    int firstLine = buffer.lineAt(start);
+    int removedLines = buffer.lineAt(selectionEnd()) - firstLine;
+    int removed = selectionEnd() - start;
+    buffer.remove(start, removed);
+    buffer.insert(start, text);
+    invalidateLayouts(firstLine, removedLines, int(text.count(QLatin1Char('\n'))));
+    cursor = anchor = start + int(text.size());
+    preferredColumn = -1;
+
+    updateScrollBars();
+    ensureVisible(cursor);
+    viewport()->update();
+    emit contentsChange(start, removed, int(text.size()));
+    emit textChanged();
+    if (hadSelection) {
+        emit selectionChanged();
+    }
+}
+
+void LargeTextEdit::invalidateLayouts()
+{
+    layoutCache.clear();
+    layoutRevision = buffer.revision();
+}
+
+void LargeTextEdit::invalidateLayouts(int firstLine, int removedLines, int addedLines)
+{
+    // Lines above the edit keep their layouts, and so do the ones below it under their new numbers
+    QHash<int, std::shared_ptr<QTextLayout>> kept;
+    kept.reserve(layoutCache.size());
+    const int shift = addedLines - removedLines;
+    for (auto it = layoutCache.cbegin(); it != layoutCache.cend(); ++it) {
+        if (it.key() < firstLine) {
+            kept.insert(it.key(), it.value());
+        } else if (it.key() > firstLine + removedLines) {
+            kept.insert(it.key() + shift, it.value());
+        }
+    }
+    layoutCache.swap(kept);
+    layoutRevision = buffer.revision();
+}
+
+int LargeTextEdit::wrapWidth() const
+{
+    return qMax(10, viewport()->width() - 2 * MARGIN);
+}
+
+std::shared_ptr<QTextLayout> LargeTextEdit::layoutFor(int line) const
+{
+    if (layoutRevision != buffer.revision()) {
+        layoutCache.clear(); // Changed behind the edit functions' back
+        layoutRevision = buffer.revision();
+    }
+    auto cached = layoutCache.constFind(line);
+    if (cached != layoutCache.constEnd()) {
+        return cached.value();
+    }
+
+    auto layout = std::make_shared<QTextLayout>(buffer.line(line), font());
+    QTextOption option;
+    option.setWrapMode(QTextOption::WrapAtWordBoundaryOrAnywhere);
+    layout->setTextOption(option);
+    layout->setCacheEnabled(true);
+
+    layout->beginLayout();
+    qreal height = 0;
+    const int width = wrapWidth();
+    for (;;) {
+        QTextLine textLine = layout->createLine();
+        if (!textLine.isValid()) {
+            break;
+        }
+        textLine.setLineWidth(width);
+        textLine.setPosition(QPointF(0, height));
+        height += textLine.height();
+    }
+    layout->endLayout();
+
+    if (layoutCache.size() >= LAYOUT_CACHE_LIMIT) {
+        layoutCache.clear();
+    }
+    layoutCache.insert(line, layout);
+    return layout;
+}
+
+qreal LargeTextEdit::lineHeight(int line) const
+{
+    return qMax<qreal>(fontMetrics().lineSpacing(), layoutFor(line)->boundingRect().height());
+}
+
+int LargeTextEdit::firstLineShowing(int lastLine) const
+{
+    qreal height = 0;
+    for (int line = lastLine; line >= 0; --line) {
+        height += lineHeight(line);
+        if (height > viewport()->height()) {
+            return qMin(line + 1, lastLine);
+        }
+    }
+    return 0;
+}
+
+bool LargeTextEdit::isLineVisible(int line) const
+{
+    int top = verticalScrollBar()->value();
+    if (line < top) {
+        return false;
+    }
+    qreal bottom = 0;
+    for (int i = top; i <= line; ++i) {
+        bottom += lineHeight(i);
+        if (bottom > viewport()->height()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void LargeTextEdit::ensureVisible(int position)
+{
+    int line = buffer.lineAt(position);
+    if (line < verticalScrollBar()->value()) {
+        verticalScrollBar()->setValue(line);
+    } else if (!isLineVisible(line)) {
+        verticalScrollBar()->setValue(firstLineShowing(line));
+    }
+}
+
+void LargeTextEdit::updateScrollBars()
+{
+    // The last page ends with the last line instead of scrolling past it
+    int lastLine = buffer.lineCount() - 1;
+    verticalScrollBar()->setRange(0, firstLineShowing(lastLine));
+    verticalScrollBar()->setPageStep(qMax(1, viewport()->height() / qMax(1, fontMetrics().lineSpacing())));
+}
+
+int LargeTextEdit::positionAt(const QPoint& point) const
+{
+    int line = verticalScrollBar()->value();
+    qreal y = 0;
+    while (line < buffer.lineCount() - 1) {
+        qreal height = lineHeight(line);
+        if (point.y() < y + height) {
+            break;
+        }
+        y += height;
+        ++line;
+    }
+
+    auto layout = layoutFor(line);
+    qreal localY = point.y() - y;
+    for (int i = 0; i < layout->lineCount(); ++i) {
+        QTextLine textLine = layout->lineAt(i);
+        if (localY < textLine.y() + textLine.height() || i == layout->lineCount() - 1) {
+            return buffer.lineStart(line) + textLine.xToCursor(point.x() - MARGIN);
+        }
+    }
+    return buffer.lineStart(line);
+}
+
+void LargeTextEdit::paintEvent(QPaintEvent *event)
+{
+    QPainter painter(viewport());
+    painter.fillRect(event->rect(), palette().base());
+    painter.setPen(palette().text().color());
+
+    const int selectionFrom = selectionStart();
+    const int selectionTo = selectionEnd();
+    const qreal height = viewport()->height();
+    qreal y = 0;
+
+    // Only the lines that fit on screen are laid out
+    for (int line = verticalScrollBar()->value(); line < buffer.lineCount() && y < height; ++line) {
+        auto layout = layoutFor(line);
+        int start = buffer.lineStart(line);
+        int length = buffer.lineLength(line);
+
+        QVector<QTextLayout::FormatRange> selections;
+        if (hasSelection() && selectionFrom <= start + length && selectionTo > start) {
+            QTextLayout::FormatRange range;
+            range.start = qMax(selectionFrom, start) - start;
+            range.length = qMin(selectionTo, start + length) - start - range.start;
+            range.format.setBackground(palette().highlight());
+            range.format.setForeground(palette().highlightedText());
+            selections.append(range);
+        }
+
+        QPointF origin(MARGIN, y);
+        layout->draw(&painter, origin, selections);
+        if (hasFocus() && cursor >= start && cursor <= start + length) {
+            layout->drawCursor(&painter, origin, cursor - start, 1);
+        }
+        y += lineHeight(line);
+    }
+}
+
+void LargeTextEdit::resizeEvent(QResizeEvent *event)
+{
+    QAbstractScrollArea::resizeEvent(event);
+    invalidateLayouts();
+    updateScrollBars();
+}
+
+void LargeTextEdit::scrollContentsBy(int dx, int dy)
+{
+    Q_UNUSED(dx);
+    Q_UNUSED(dy);
+    viewport()->update();
+}
+
+void LargeTextEdit::focusInEvent(QFocusEvent *event)
+{
+    QAbstractScrollArea::focusInEvent(event);
+    viewport()->update();
+}
+
+void LargeTextEdit::focusOutEvent(QFocusEvent *event)
+{
+    QAbstractScrollArea::focusOutEvent(event);
+    viewport()->update();
+}
+
+void LargeTextEdit::keyPressEvent(QKeyEvent *event)
+{
+    QClipboard* clipboard = QApplication::clipboard();
+
+    if (event == QKeySequence::Copy || event == QKeySequence::Cut) {
+        if (hasSelection()) {
+            clipboard->setText(selectedText());
+            if (event == QKeySequence::Cut) {
+                replaceSelection(QString());
+            }
+        }
+        return;
+    }
+    if (event == QKeySequence::Paste) {
+        replaceSelection(clipboard->text());
+        return;
+    }
+    if (event == QKeySequence::SelectAll) {
+        selectAll();
+        return;
+    }
+
+    // Vertical moves keep the column the cursor started from
+    auto moveLines = [this](int delta, bool keepAnchor) {
+        int line = buffer.lineAt(cursor);
+        if (preferredColumn < 0) {
+            preferredColumn = cursor - buffer.lineStart(line);
+        }
+        int column = preferredColumn;
+        int target = qBound(0, line + delta, buffer.lineCount() - 1);
+        setCursorPosition(buffer.lineStart(target) + qMin(column, buffer.lineLength(target)), keepAnchor);
+        preferredColumn = column;
+    };
+    const int page = verticalScrollBar()->pageStep();
+    const int line = buffer.lineAt(cursor);
+    const int lineEnd = buffer.lineStart(line) + buffer.lineLength(line);
+
+    if (event == QKeySequence::MoveToNextLine || event == QKeySequence::SelectNextLine) {
+        moveLines(1, event == QKeySequence::SelectNextLine);
+        return;
+    }
+    if (event == QKeySequence::MoveToPreviousLine || event == QKeySequence::SelectPreviousLine) {
+        moveLines(-1, event == QKeySequence::SelectPreviousLine);
+        return;
+    }
+    if (event == QKeySequence::MoveToNextPage || event == QKeySequence::SelectNextPage) {
+        verticalScrollBar()->setValue(verticalScrollBar()->value() + page);
+        moveLines(page, event == QKeySequence::SelectNextPage);
+        return;
+    }
+    if (event == QKeySequence::MoveToPreviousPage || event == QKeySequence::SelectPreviousPage) {
+        verticalScrollBar()->setValue(verticalScrollBar()->value() - page);
+        moveLines(-page, event == QKeySequence::SelectPreviousPage);
+        return;
+    }
+
+    preferredColumn = -1;
+    if (event == QKeySequence::MoveToNextChar || event == QKeySequence::SelectNextChar) {
+        bool select = event == QKeySequence::SelectNextChar;
+        setCursorPosition(!select && hasSelection() ? selectionEnd() : cursor + 1, select);
+        return;
+    }
+    if (event == QKeySequence::MoveToPreviousChar || event == QKeySequence::SelectPreviousChar) {
+        bool select = event == QKeySequence::SelectPreviousChar;
+        setCursorPosition(!select && hasSelection() ? selectionStart() : cursor - 1, select);
+        return;
+    }
+    if (event == QKeySequence::MoveToStartOfLine || event == QKeySequence::SelectStartOfLine
+            || event == QKeySequence::MoveToStartOfBlock || event == QKeySequence::SelectStartOfBlock) {
+        setCursorPosition(buffer.lineStart(line),
+                          event == QKeySequence::SelectStartOfLine || event == QKeySequence::SelectStartOfBlock);
+        return;
+    }
+    if (event == QKeySequence::MoveToEndOfLine || event == QKeySequence::SelectEndOfLine
+            || event == QKeySequence::MoveToEndOfBlock || event == QKeySequence::SelectEndOfBlock) {
+        setCursorPosition(lineEnd, event == QKeySequence::SelectEndOfLine || event == QKeySequence::SelectEndOfBlock);
+        return;
+    }
+    if (event == QKeySequence::MoveToStartOfDocument || event == QKeySequence::SelectStartOfDocument) {
+        setCursorPosition(0, event == QKeySequence::SelectStartOfDocument);
+        return;
+    }
+    if (event == QKeySequence::MoveToEndOfDocument || event == QKeySequence::SelectEndOfDocument) {
+        setCursorPosition(buffer.length(), event == QKeySequence::SelectEndOfDocument);
+        return;
+    }
+
+    switch (event->key()) {
+        case Qt::Key_Backspace:
+            if (!hasSelection() && cursor > 0) {
+                // Surrogate pairs go together
+                anchor = cursor - (cursor > 1 && buffer.at(cursor - 1).isLowSurrogate() ? 2 : 1);
+            }
+            replaceSelection(QString());
+            return;
+        case Qt::Key_Delete:
+            if (!hasSelection() && cursor < buffer.length()) {
+                anchor = cursor + (buffer.at(cursor).isHighSurrogate() ? 2 : 1);
+            }
+            replaceSelection(QString());
+            return;
+        case Qt::Key_Return:
+        case Qt::Key_Enter:
+            replaceSelection(QStringLiteral("\n"));
+            return;
+        default:
+            break;
+    }
+
+    QString text = event->text();
+    if (!text.isEmpty() && (text.at(0).isPrint() || text.at(0) == QLatin1Char('\t'))) {
+        replaceSelection(text);
+        return;
+    }
+    QAbstractScrollArea::keyPressEvent(event);
+}
+
+void LargeTextEdit::mousePressEvent(QMouseEvent *event)
+{
+    if (event->button() != Qt::LeftButton) {
+        QAbstractScrollArea::mousePressEvent(event);
+        return;
+    }
+    preferredColumn = -1;
+    setCursorPosition(positionAt(event->pos()), event->modifiers().testFlag(Qt::ShiftModifier));
+}
+
+void LargeTextEdit::mouseMoveEvent(QMouseEvent *event)
+{
+    if (!(event->buttons() & Qt::LeftButton)) {
+        return;
+    }
+
+    // Dragging past the edges scrolls a line at a time
+    if (event->pos().y() < 0) {
+        verticalScrollBar()->setValue(verticalScrollBar()->value() - 1);
+    } else if (event->pos().y() > viewport()->height()) {
+        verticalScrollBar()->setValue(verticalScrollBar()->value() + 1);
+    }
+    setCursorPosition(positionAt(event->pos()), true);
+}
+
+void LargeTextEdit::mouseDoubleClickEvent(QMouseEvent *event)
+{
+    if (event->button() != Qt::LeftButton) {
+        return;
+    }
+
+    // Select the word under the pointer, within its line
+    int position = positionAt(event->pos());
+    int line = buffer.lineAt(position);
+    int lineStart = buffer.lineStart(line);
+    int lineEnd = lineStart + buffer.lineLength(line);
+    int start = position;
+    while (start > lineStart && buffer.at(start - 1).isLetterOrNumber()) {
+        --start;
+    }
+    int end = position;
+    while (end < lineEnd && buffer.at(end).isLetterOrNumber()) {
+        ++end;
+    }
+    anchor = start;
+    setCursorPosition(end, true);
+}
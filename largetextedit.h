@@ -0,0 +1,88 @@
+#ifndef LARGETEXTEDIT_H
+#define LARGETEXTEDIT_H
+
+#include <QAbstractScrollArea>
+#include <QHash>
+#include <QTextLayout>
+#include <memory>
+#include "piecetable.h"
+
+// Plain-text editor for multi-megabyte documents. The text lives in a
+// PieceTable and only the lines in the viewport are laid out (wrapped to the
+// viewport width); the vertical scroll bar counts lines, so nothing depends
+// on the height of the whole document. Appending or inserting text leaves
+// the rest of the document untouched.
+//
+// Editing covers typing, deletion, the clipboard and mouse/keyboard
+// selection; there is no undo and no rich text.
+class LargeTextEdit : public QAbstractScrollArea
+{
+    Q_OBJECT
+
+public:
+    explicit LargeTextEdit(QWidget *parent = nullptr);
+
+    PieceTable& document() { return buffer; }
+    const PieceTable& document() const { return buffer; }
+
+    void setPlainText(const QString& text); // Shares the string, no copy
+    void clear() { setPlainText(QString()); }
+
+    // Edits through these keep the view and selection consistent
+    void insertText(int position, const QString& text);
+    void removeText(int position, int length);
+    void appendText(const QString& text); // Keeps following the end if it was visible
+
+    int cursorPosition() const { return cursor; }
+    void setCursorPosition(int position, bool keepAnchor = false);
+    bool hasSelection() const { return cursor != anchor; }
+    int selectionStart() const { return qMin(cursor, anchor); }
+    int selectionEnd() const { return qMax(cursor, anchor); }
+    QString selectedText() const { return buffer.text(selectionStart(), selectionEnd() - selectionStart()); }
+    void selectAll();
+
+    void ensureVisible(int position);
+
+signals:
+    void textChanged();
+    void contentsChange(int position, int charsRemoved, int charsAdded); // As QTextDocument's, before textChanged()
+    void selectionChanged();
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
+    void keyPressEvent(QKeyEvent *event) override;
+    void mousePressEvent(QMouseEvent *event) override;
+    void mouseMoveEvent(QMouseEvent *event) override;
+    void mouseDoubleClickEvent(QMouseEvent *event) override;
+    void focusInEvent(QFocusEvent *event) override;
+    void focusOutEvent(QFocusEvent *event) override;
+    void scrollContentsBy(int dx, int dy) override;
+
+private:
+    std::shared_ptr<QTextLayout> layoutFor(int line) const;
+    qreal lineHeight(int line) const;
+    int positionAt(const QPoint& point) const;
+    int firstLineShowing(int lastLine) const; // Top line that puts lastLine at the bottom
+    bool isLineVisible(int line) const;
+    void replaceSelection(const QString& text);
+    void updateScrollBars();
+    void invalidateLayouts();
+    void invalidateLayouts(int firstLine, int removedLines, int addedLines); // After an edit
+    int wrapWidth() const;
+
+    PieceTable buffer;
+    int cursor;
+    int anchor;
+    int preferredColumn; // Kept while moving up and down, -1 when unset
+
+    // Layouts of recently painted lines, by line number. An edit drops the
+    // ones of the lines it touched and renumbers those below; a resize drops all.
+    mutable QHash<int, std::shared_ptr<QTextLayout>> layoutCache;
+    mutable quint64 layoutRevision;
+
+    static const int MARGIN;
+    static const int LAYOUT_CACHE_LIMIT;
+};
+
+#endif // LARGETEXTEDIT_H
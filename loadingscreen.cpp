@@ -1,16 +1,27 @@
 #include "loadingscreen.h"
 #include "servermanager.h"
+#include "localsockettransport.h"
+#include "backenddaemon.h"
 #include <QApplication>
 #include <QScreen>
 #include <QDebug>
 #include <QPointer>
 #include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
 
 // Static server process definition
 QProcess* LoadingScreen::globalServerProcess = nullptr;
+QPointer<LoadingScreen> LoadingScreen::activeScreen;
+const int LoadingScreen::STATUS_FALLBACK_TIMEOUT = 20000; // Old backends print no status lines
+bool LoadingScreen::daemonMode = false;
+int LoadingScreen::daemonIdleTimeout = BackendDaemon::DEFAULT_IDLE_TIMEOUT;
+QString LoadingScreen::serverSocket;
+QString LoadingScreen::inferenceEngine;
 
 LoadingScreen::LoadingScreen(QWidget *parent)
     : QWidget(parent)
+    , healthMonitoringStarted(false)
     , animationStep(0)
 {
     setupUI();
@@ -49,12 +60,20 @@ LoadingScreen::LoadingScreen(QWidget *parent)
         }
     });
     
+    // Load progress of an already running server that we didn't launch shows up through /health
+    connect(serverManager, &ServerManager::loadProgress, this, &LoadingScreen::onBackendStatus);
+    
+    statusFallbackTimer = new QTimer(this);
+    statusFallbackTimer->setSingleShot(true);
+    connect(statusFallbackTimer, &QTimer::timeout, this, &LoadingScreen::beginHealthMonitoring);
+    
     // Start the server first, then begin health checking
     qDebug() << "LoadingScreen: Starting Python server...";
     
-    // Use QPointer for safe timer callback for server initialization
+    // Use QPointer for safe timer callback for server initialization; start
+    // as soon as the event loop runs so the window gets painted first
     QPointer<LoadingScreen> selfInit(this);
-    QTimer::singleShot(1000, [selfInit]() {
+    QTimer::singleShot(0, [selfInit]() {
         if (selfInit) {
             selfInit->initializeServer();
         }
@@ -80,19 +99,22 @@ QProcess* LoadingScreen::getServerProcess()
     return globalServerProcess;
 }
 
-void LoadingScreen::startServerProcess()
+void LoadingScreen::setDaemonMode(bool enabled, int idleTimeout)
 {
-    if (globalServerProcess && globalServerProcess->state() == QProcess::Running) {
-        qDebug() << "LoadingScreen: Server process already running";
-        return;
-    }
-    
-    if (!globalServerProcess) {
-        globalServerProcess = new QProcess();
+    daemonMode = enabled;
+    daemonIdleTimeout = idleTimeout;
+}
+
+QString LoadingScreen::serverSocketName()
+{
+    if (serverSocket.isEmpty()) {
+        return daemonMode ? BackendDaemon::socketPath() : LocalSocketTransport::defaultServerName();
     }
-    
-    qDebug() << "LoadingScreen: Starting global server process";
-    
+    return serverSocket;
+}
+
+QString LoadingScreen::findServerScript()
+{
     // Try different paths for the server script
     QStringList serverPaths = {
         "d:/texdit/backend/server.py",  // Absolute path
@@ -101,34 +123,142 @@ void LoadingScreen::startServerProcess()
         "backend/server.py"             // Direct relative path
     };
     
-    QString serverPath;
     for (const QString& path : serverPaths) {
         if (QFile::exists(path)) {
-            serverPath = path;
-            qDebug() << "LoadingScreen: Found server at:" << serverPath;
-            break;
+            qDebug() << "LoadingScreen: Found server at:" << path;
+            return path;
         }
     }
     
-    if (serverPath.isEmpty()) {
-        qDebug() << "LoadingScreen: ❌ Could not find server.py in any expected location";
+    qDebug() << "LoadingScreen: ❌ Could not find server.py in any expected location";
+    return QString();
+}
+
+void LoadingScreen::startServerProcess()
+{
+    if (daemonMode) {
+        BackendDaemon::Lock lock;
+        if (BackendDaemon::readLock(lock)) {
+            // Already loaded by another editor; health checks find it on the usual port
+            qDebug() << "LoadingScreen: ✅ Using running backend daemon (pid" << lock.pid << ")";
+            serverSocket = lock.ipcSocket;
+            return;
+        }
+        
+        QString serverPath = findServerScript();
+        if (!serverPath.isEmpty()) {
+            startDaemonProcess(serverPath);
+        }
         return;
     }
     
-    globalServerProcess->start("python", QStringList() << serverPath);
+    if (globalServerProcess && globalServerProcess->state() == QProcess::Running) {
+        qDebug() << "LoadingScreen: Server process already running";
+        return;
+    }
+
+    if (!globalServerProcess) {
+        globalServerProcess = new QProcess();
+        
+        QObject::connect(globalServerProcess, &QProcess::readyReadStandardOutput, []() {
+            handleServerOutput(globalServerProcess->readAllStandardOutput());
+        });
+        
+        QObject::connect(globalServerProcess, &QProcess::readyReadStandardError, []() {
+            qDebug() << "Server error:" << globalServerProcess->readAllStandardError();
+        });
+        
+        QObject::connect(globalServerProcess, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished), 
+                         [](int exitCode, QProcess::ExitStatus exitStatus) {
+            qDebug() << "Server process finished with exit code:" << exitCode << "status:" << exitStatus;
+            
+            // Another server may already hold the port; look for it instead of waiting
+            if (activeScreen) {
+                activeScreen->beginHealthMonitoring();
+            }
+        });
+    }
     
-    QObject::connect(globalServerProcess, &QProcess::readyReadStandardOutput, []() {
-        qDebug() << "Server output:" << globalServerProcess->readAllStandardOutput();
-    });
+    qDebug() << "LoadingScreen: Starting global server process";
     
-    QObject::connect(globalServerProcess, &QProcess::readyReadStandardError, []() {
-        qDebug() << "Server error:" << globalServerProcess->readAllStandardError();
-    });
+    QString serverPath = findServerScript();
+    if (serverPath.isEmpty()) {
+        return;
+    }
     
-    QObject::connect(globalServerProcess, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished), 
-                     [](int exitCode, QProcess::ExitStatus exitStatus) {
-        qDebug() << "Server process finished with exit code:" << exitCode << "status:" << exitStatus;
-    });
+    QProcessEnvironment environment = QProcessEnvironment::systemEnvironment();
+    if (!inferenceEngine.isEmpty()) {
+        environment.insert("TEXDIT_ENGINE", inferenceEngine);
+    }
+#ifndef Q_OS_WIN
+    // Ask the backend to also listen on a local socket for the binary transport
+    environment.insert("TEXDIT_IPC_SOCKET", serverSocketName());
+#endif
+    globalServerProcess->setProcessEnvironment(environment);
+    
+    globalServerProcess->start("python", QStringList() << serverPath);
+}
+
+bool LoadingScreen::startDaemonProcess(const QString& serverPath)
+{
+    QProcessEnvironment environment = QProcessEnvironment::systemEnvironment();
+    environment.insert("TEXDIT_LOCKFILE", BackendDaemon::lockFilePath());
+    environment.insert("TEXDIT_IDLE_TIMEOUT", QString::number(daemonIdleTimeout));
+    if (!inferenceEngine.isEmpty()) {
+        environment.insert("TEXDIT_ENGINE", inferenceEngine);
+    }
+#ifndef Q_OS_WIN
+    serverSocket = BackendDaemon::socketPath();
+    environment.insert("TEXDIT_IPC_SOCKET", serverSocket);
+#endif
+    
+    // Detached so the daemon survives this editor; its status lines go to a
+    // log file and load progress is read from /health instead
+    QProcess launcher;
+    launcher.setProgram("python");
+    launcher.setArguments(QStringList() << serverPath << "--daemon");
+    launcher.setProcessEnvironment(environment);
+    launcher.setStandardOutputFile(BackendDaemon::logFilePath(), QIODevice::Append);
+    launcher.setStandardErrorFile(BackendDaemon::logFilePath(), QIODevice::Append);
+    
+    qint64 pid = 0;
+    if (!launcher.startDetached(&pid)) {
+        qDebug() << "LoadingScreen: ❌ Failed to launch backend daemon:" << launcher.errorString();
+        return false;
+    }
+    
+    qDebug() << "LoadingScreen: Started backend daemon, pid" << pid << "- log:" << BackendDaemon::logFilePath();
+    return true;
+}
+
+void LoadingScreen::handleServerOutput(const QByteArray& output)
+{
+    // Status lines may be split across reads; keep the unfinished tail
+    static QByteArray pending;
+    pending.append(output);
+    
+    int newline;
+    while ((newline = pending.indexOf('\n')) >= 0) {
+        QByteArray line = pending.left(newline).trimmed();
+        pending.remove(0, newline + 1);
+        
+        static const QByteArray statusPrefix = "TEXDIT_STATUS ";
+        if (!line.startsWith(statusPrefix)) {
+            if (!line.isEmpty()) {
+                qDebug() << "Server output:" << line;
+            }
+            continue;
+        }
+        
+        QJsonObject status = QJsonDocument::fromJson(line.mid(statusPrefix.size())).object();
+        qDebug() << "LoadingScreen: Backend status" << status.value("stage").toString()
+                 << status.value("progress").toDouble();
+        if (activeScreen) {
+            activeScreen->onBackendStatus(status.value("stage").toString(),
+                                          status.value("message").toString(),
+                                          status.value("progress").toDouble());
+        }
+    }
 }
 
 void LoadingScreen::stopServerProcess()
@@ -150,41 +280,57 @@ void LoadingScreen::stopServerProcess()
 
 void LoadingScreen::initializeServer()
 {
+    activeScreen = this;
+    healthMonitoringStarted = false;
+    
     // Try to start server if not already running externally
     startServerProcess();
     
-    // Show progress during startup wait
     statusLabel->setText("Server starting, loading AI models...");
-    progressBar->setRange(0, 8); // 8 seconds progress
+    progressBar->setRange(0, 100);
     progressBar->setValue(0);
     
-    // Use QPointer for safe object access in timer callbacks
-    QPointer<LoadingScreen> self(this);
+    if (!globalServerProcess || globalServerProcess->state() == QProcess::NotRunning) {
+        // Nothing was launched; an external server may already be running
+        beginHealthMonitoring();
+        return;
+    }
     
-    // Update progress every second
-    QTimer *progressTimer = new QTimer(this);
-    connect(progressTimer, &QTimer::timeout, [self, progressTimer]() {
-        if (!self) return; // Object was destroyed
-        int currentValue = self->progressBar->value();
-        if (currentValue < self->progressBar->maximum()) {
-            self->progressBar->setValue(currentValue + 1);
-        } else {
-            progressTimer->stop();
-            progressTimer->deleteLater();
-        }
-    });
-    progressTimer->start(1000);
-    
-    // Use QTimer with parent for safer cleanup
-    QTimer *healthTimer = new QTimer(this);
-    healthTimer->setSingleShot(true);
-    connect(healthTimer, &QTimer::timeout, [self]() {
-        if (!self) return; // Object was destroyed
-        self->statusLabel->setText("Server started, checking health...");
-        self->progressBar->setRange(0, 0); // Back to indeterminate for health checks
-        self->serverManager->startHealthMonitoring();
-    });
-    healthTimer->start(8000);
+    // The backend reports "serving" once Flask is about to listen, which is when
+    // polling starts; this only fires for backends that never report
+    statusFallbackTimer->start(STATUS_FALLBACK_TIMEOUT);
+}
+
+void LoadingScreen::beginHealthMonitoring()
+{
+    if (healthMonitoringStarted) {
+        return;
+    }
+    healthMonitoringStarted = true;
+    statusFallbackTimer->stop();
+    serverManager->startHealthMonitoring();
+}
+
+void LoadingScreen::onBackendStatus(const QString& stage, const QString& message, double progress)
+{
+    // Real load stages replace the canned loading texts
+    animationTimer->stop();
+    if (!message.isEmpty()) {
+        statusLabel->setText(message);
+    }
+    progressBar->setRange(0, 100);
+    progressBar->setValue(qRound(progress * 100));
+    
+    if (stage == "serving") {
+        beginHealthMonitoring();
+    } else if (stage == "ready") {
+        // Don't wait for the next poll
+        beginHealthMonitoring();
+        serverManager->checkHealthNow();
+    } else if (stage == "failed") {
+        qDebug() << "LoadingScreen: ❌ Backend failed to load its model:" << message;
+        showRetryOption();
+    }
 }
 
 void LoadingScreen::setupUI()
@@ -342,13 +488,8 @@ void LoadingScreen::onServerStatusChanged(int status)
             progressBar->setRange(0, 100);
             progressBar->setValue(100);
             
-            // Brief delay before emitting ready signal using QPointer for safety
-            QPointer<LoadingScreen> self(this);
-            QTimer::singleShot(1000, [self]() {
-                if (self) {
-                    emit self->serverReady();
-                }
-            });
+            statusFallbackTimer->stop();
+            emit serverReady();
             break;
         }
             
@@ -27,6 +27,17 @@ public:
     static QProcess* getServerProcess();
     static void startServerProcess();
     static void stopServerProcess();
+    
+    // Daemon mode shares one backend between all editors: a running daemon is
+    // reused, otherwise one is launched detached and outlives this editor by
+    // idleTimeout seconds (0 keeps it running)
+    static void setDaemonMode(bool enabled, int idleTimeout);
+    static bool isDaemonMode() { return daemonMode; }
+    static QString serverSocketName(); // IPC socket of the backend in use
+    
+    // Inference engine for backends this editor launches (pytorch, int8, onnx,
+    // onnx-int8); empty leaves the backend's default. A running daemon keeps its own.
+    static void setInferenceEngine(const QString& engine) { inferenceEngine = engine; }
 
 signals:
     void serverReady();
@@ -34,12 +45,17 @@ signals:
 
 private slots:
     void onServerStatusChanged(int status);
+    void onBackendStatus(const QString& stage, const QString& message, double progress);
     void onRetryClicked();
     void updateLoadingText();
 
 private:
     void setupUI();
     void initializeServer();
+    void beginHealthMonitoring();
+    static void handleServerOutput(const QByteArray& output);
+    static QString findServerScript();
+    static bool startDaemonProcess(const QString& serverPath);
     void showRetryOption();
     void hideRetryOption();
     
@@ -53,6 +69,8 @@ private:
     QPushButton *skipButton;
     
     QTimer *animationTimer;
+    QTimer *statusFallbackTimer; // Polls anyway if the backend never reports in
+    bool healthMonitoringStarted;
     ServerManager *serverManager;
     
     int animationStep;
@@ -60,6 +78,12 @@ private:
     
     // Static server process
     static QProcess *globalServerProcess;
+    static QPointer<LoadingScreen> activeScreen; // Receives the process's status lines
+    static const int STATUS_FALLBACK_TIMEOUT;
+    static bool daemonMode;
+    static int daemonIdleTimeout;
+    static QString serverSocket;
+    static QString inferenceEngine;
 };
 
 #endif // LOADINGSCREEN_H
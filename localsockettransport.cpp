@@ -0,0 +1,296 @@
+#include "localsockettransport.h"
+#include "backenddaemon.h"
+#include "tracer.h"
+#include <QCoreApplication>
+#include <QStandardPaths>
+#include <QDir>
+#include <QJsonDocument>
+#include <QJsonArray>
+#include <QtEndian>
+#include <QDebug>
+
+const int LocalSocketTransport::REQUEST_TIMEOUT = 30000; // For callers that give no timeout
+const int LocalSocketTransport::RECONNECT_INTERVAL = 5000;
+const int LocalSocketTransport::RING_THRESHOLD = 64 * 1024; // Bytes of UTF-16 text
+
+namespace {
+// u32 request id, u8 kind, u32 header length
+const int FRAME_HEADER_SIZE = 9;
+}
+
+LocalSocketTransport::LocalSocketTransport(const QString& serverName, QObject *parent)
+    : ServerTransport(parent)
+    , socket(new QLocalSocket(this))
+    , serverName(serverName)
+    , nextRequestId(1)
+    , timeoutTimer(new QTimer(this))
+{
+    // Each transport maps its own ring so editors sharing a daemon never share one
+    static int instanceCount = 0;
+    ringPath = QString("%1.%2-%3.ring").arg(serverName).arg(QCoreApplication::applicationPid()).arg(instanceCount++);
+
+    connect(socket, &QLocalSocket::connected, this, &LocalSocketTransport::onConnected);
+    connect(socket, &QLocalSocket::disconnected, this, &LocalSocketTransport::onDisconnected);
+    connect(socket, &QLocalSocket::readyRead, this, &LocalSocketTransport::onReadyRead);
+    connect(socket, &QLocalSocket::errorOccurred, this, [this](QLocalSocket::LocalSocketError) {
+        qDebug() << "LocalSocketTransport: ❌ Socket error:" << socket->errorString();
+    });
+
+    timeoutTimer->setInterval(1000);
+    connect(timeoutTimer, &QTimer::timeout, this, &LocalSocketTransport::checkTimeouts);
+}
+
+LocalSocketTransport::~LocalSocketTransport()
+{
+    // Callers may already be gone; drop outstanding requests silently
+    pending.clear();
+    disconnect(socket, nullptr, this, nullptr);
+    socket->abort();
+    ring.close();
+}
+
+QString LocalSocketTransport::defaultServerName()
+{
+    QString dir = QStandardPaths::writableLocation(QStandardPaths::RuntimeLocation);
+    if (dir.isEmpty()) {
+        dir = QDir::tempPath();
+    }
+    return QString("%1/texdit-%2.sock").arg(dir).arg(QCoreApplication::applicationPid());
+}
+
+bool LocalSocketTransport::isAvailable() const
+{
+    return socket->state() == QLocalSocket::ConnectedState;
+}
+
+void LocalSocketTransport::open()
+{
+    if (socket->state() != QLocalSocket::UnconnectedState) {
+        return;
+    }
+
+    // The backend may not offer IPC at all; don't hammer it
+    if (lastAttempt.isValid() && lastAttempt.elapsed() < RECONNECT_INTERVAL) {
+        return;
+    }
+    lastAttempt.start();
+
+    qDebug() << "LocalSocketTransport: Connecting to" << serverName;
+    socket->connectToServer(serverName);
+}
+
+void LocalSocketTransport::close()
+{
+    socket->abort();
+    failAll("IPC transport closed");
+    ring.close();
+}
+
+void LocalSocketTransport::onConnected()
+{
+    qDebug() << "LocalSocketTransport: ✅ Connected to" << serverName;
+
+    if (ring.isOpen() || ring.open(ringPath)) {
+        ring.reset();
+        QJsonObject hello;
+        hello["ring"] = ring.path();
+        hello["ring_size"] = double(ring.size());
+        hello["encoding"] = SharedTextRing::encoding();
+        hello["client"] = BackendDaemon::clientId(); // Keeps a shared daemon alive while connected
+        writeFrame(0, HelloFrame, hello);
+    }
+
+    timeoutTimer->start();
+    emit availabilityChanged(true);
+}
+
+void LocalSocketTransport::onDisconnected()
+{
+    qDebug() << "LocalSocketTransport: Disconnected from" << serverName;
+    timeoutTimer->stop();
+    readBuffer.clear();
+    failAll("IPC connection lost");
+    emit availabilityChanged(false);
+}
+
+LocalSocketTransport::RequestId LocalSocketTransport::send(const QString& endpoint, const QJsonObject& data,
+                                                            bool stream, int timeout, const Handlers& handlers)
+{
+    if (!isAvailable()) {
+        if (handlers.onError) {
+            handlers.onError("IPC transport not connected", 0);
+        }
+        return 0;
+    }
+
+    quint32 requestId = nextRequestId++;
+    QJsonObject body = data;
+    QJsonObject header;
+    header["endpoint"] = endpoint;
+    QString traceId = Tracer::currentRequestId();
+    if (!traceId.isEmpty()) {
+        header["request_id"] = traceId;
+    }
+    QByteArray payload;
+
+    // Keep the document out of the JSON body so it is never escaped or re-parsed
+    if (body.contains("text")) {
+        QString text = body.take("text").toString();
+        qint64 offset = -1;
+        if (text.size() * int(sizeof(QChar)) >= RING_THRESHOLD) {
+            offset = ring.write(requestId, text);
+        }
+
+        if (offset >= 0) {
+            header["ring"] = QJsonArray{double(offset), double(text.size() * int(sizeof(QChar)))};
+        } else {
+            payload = text.toUtf8();
+            header["text_length"] = payload.size();
+        }
+    }
+
+    if (stream) {
+        body["stream"] = true;
+    }
+    header["data"] = body;
+
+    PendingRequest request;
+    request.handlers = handlers;
+    request.lastActivity.start();
+    request.timeout = timeout > 0 ? timeout : REQUEST_TIMEOUT;
+    pending.insert(requestId, request);
+
+    writeFrame(requestId, RequestFrame, header, payload);
+    return requestId;
+}
+
+void LocalSocketTransport::abort(RequestId id)
+{
+    // The region is reused straight away: should the backend read it after a
+    // later request overwrote it, only the aborted request's unused reply suffers
+    if (pending.remove(id)) {
+        ring.release(id);
+    }
+}
+
+void LocalSocketTransport::writeFrame(quint32 requestId, FrameKind kind, const QJsonObject& header,
+                                      const QByteArray& payload)
+{
+    QByteArray headerData = QJsonDocument(header).toJson(QJsonDocument::Compact);
+
+    QByteArray prefix(4 + FRAME_HEADER_SIZE, Qt::Uninitialized);
+    uchar* out = reinterpret_cast<uchar*>(prefix.data());
+    qToBigEndian<quint32>(quint32(FRAME_HEADER_SIZE + headerData.size() + payload.size()), out);
+    qToBigEndian<quint32>(requestId, out + 4);
+    out[8] = kind;
+    qToBigEndian<quint32>(quint32(headerData.size()), out + 9);
+
+    // Written piecewise so the payload is not copied into an intermediate frame buffer
+    socket->write(prefix);
+    socket->write(headerData);
+    if (!payload.isEmpty()) {
+        socket->write(payload);
+    }
+}
+
+void LocalSocketTransport::onReadyRead()
+{
+    readBuffer.append(socket->readAll());
+
+    while (readBuffer.size() >= 4) {
+        quint32 length = qFromBigEndian<quint32>(reinterpret_cast<const uchar*>(readBuffer.constData()));
+        if (readBuffer.size() < 4 + qint64(length)) {
+            return; // Wait for the rest of the frame
+        }
+
+        handleFrame(readBuffer.mid(4, int(length)));
+        readBuffer.remove(0, 4 + int(length));
+    }
+}
+
+void LocalSocketTransport::handleFrame(const QByteArray& frame)
+{
+    if (frame.size() < FRAME_HEADER_SIZE) {
+        qWarning() << "LocalSocketTransport: Dropping truncated frame";
+        return;
+    }
+
+    const uchar* in = reinterpret_cast<const uchar*>(frame.constData());
+    quint32 requestId = qFromBigEndian<quint32>(in);
+    FrameKind kind = FrameKind(in[4]);
+    quint32 headerLength = qFromBigEndian<quint32>(in + 5);
+
+    auto it = pending.find(requestId);
+    if (it == pending.end()) {
+        return; // Timed out or failed already
+    }
+
+    QJsonParseError parseError;
+    QJsonDocument doc = QJsonDocument::fromJson(frame.mid(FRAME_HEADER_SIZE, int(headerLength)), &parseError);
+    if (parseError.error != QJsonParseError::NoError || !doc.isObject()) {
+        Handlers handlers = it->handlers;
+        pending.erase(it);
+        ring.release(requestId);
+        if (handlers.onError) {
+            handlers.onError(QString("Invalid response frame: %1").arg(parseError.errorString()), 0);
+        }
+        return;
+    }
+
+    if (kind == ChunkFrame) {
+        it->lastActivity.start();
+        if (it->handlers.onChunk) {
+            it->handlers.onChunk(doc.object());
+        }
+        return;
+    }
+
+    Handlers handlers = it->handlers;
+    pending.erase(it);
+    ring.release(requestId);
+
+    if (kind == DoneFrame) {
+        if (handlers.onSuccess) {
+            handlers.onSuccess(doc.object());
+        }
+    } else if (handlers.onError) {
+        // Backends predating "status" in error frames only reject unknown endpoints outright
+        QString error = doc.object().value("error").toString("Request failed");
+        int status = doc.object().value("status").toInt(error.startsWith("Unknown endpoint") ? 404 : 500);
+        handlers.onError(error, status);
+    }
+}
+
+void LocalSocketTransport::checkTimeouts()
+{
+    QList<quint32> expired;
+    for (auto it = pending.constBegin(); it != pending.constEnd(); ++it) {
+        if (it->lastActivity.elapsed() > it->timeout) {
+            expired.append(it.key());
+        }
+    }
+
+    // The backend reads ring text as soon as a request arrives, so an expired
+    // request's region is safe to reuse
+    for (quint32 requestId : expired) {
+        Handlers handlers = pending.take(requestId).handlers;
+        ring.release(requestId);
+        qWarning() << "LocalSocketTransport: Request" << requestId << "timed out";
+        if (handlers.onError) {
+            handlers.onError("Request timed out", TimedOut);
+        }
+    }
+}
+
+void LocalSocketTransport::failAll(const QString& error)
+{
+    QHash<quint32, PendingRequest> failed;
+    failed.swap(pending);
+    ring.reset();
+
+    for (const PendingRequest& request : failed) {
+        if (request.handlers.onError) {
+            request.handlers.onError(error, 0);
+        }
+    }
+}
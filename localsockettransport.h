@@ -0,0 +1,76 @@
+#ifndef LOCALSOCKETTRANSPORT_H
+#define LOCALSOCKETTRANSPORT_H
+
+#include "servertransport.h"
+#include "sharedtextring.h"
+#include <QLocalSocket>
+#include <QElapsedTimer>
+#include <QTimer>
+#include <QHash>
+
+// Talks to the backend over a local socket with length-prefixed binary
+// frames (see backend/ipc_server.py for the layout). The request body is
+// compact JSON, but the document text travels beside it: inline as UTF-8,
+// or through a shared ring buffer once it is large enough that copying it
+// through the socket would cost more than the mapping.
+class LocalSocketTransport : public ServerTransport
+{
+    Q_OBJECT
+
+public:
+    explicit LocalSocketTransport(const QString& serverName, QObject *parent = nullptr);
+    ~LocalSocketTransport();
+
+    // Socket path the editor hands to the backend process it launches
+    static QString defaultServerName();
+
+    QString name() const override { return "local-socket"; }
+    bool isAvailable() const override;
+    void open() override;
+    void close() override;
+    RequestId send(const QString& endpoint, const QJsonObject& data, bool stream, int timeout,
+                   const Handlers& handlers) override;
+    void abort(RequestId id) override;
+
+private slots:
+    void onConnected();
+    void onDisconnected();
+    void onReadyRead();
+    void checkTimeouts();
+
+private:
+    enum FrameKind : quint8 {
+        HelloFrame = 0,
+        RequestFrame = 1,
+        ChunkFrame = 2,
+        DoneFrame = 3,
+        ErrorFrame = 4
+    };
+
+    struct PendingRequest {
+        Handlers handlers;
+        QElapsedTimer lastActivity;
+        int timeout; // Milliseconds
+    };
+
+    void writeFrame(quint32 requestId, FrameKind kind, const QJsonObject& header,
+                    const QByteArray& payload = QByteArray());
+    void handleFrame(const QByteArray& frame);
+    void failAll(const QString& error);
+
+    QLocalSocket* socket;
+    QString serverName;
+    QByteArray readBuffer;
+    quint32 nextRequestId;
+    QHash<quint32, PendingRequest> pending;
+    SharedTextRing ring;
+    QString ringPath;
+    QTimer* timeoutTimer;
+    QElapsedTimer lastAttempt;
+
+    static const int REQUEST_TIMEOUT;
+    static const int RECONNECT_INTERVAL;
+    static const int RING_THRESHOLD;
+};
+
+#endif // LOCALSOCKETTRANSPORT_H
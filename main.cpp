@@ -1,17 +1,74 @@
 #include "mainwindow.h"
 #include "loadingscreen.h"
+#include "backenddaemon.h"
+#include "eventlog.h"
 
 #include <QApplication>
+#include <QCommandLineParser>
 
 int main(int argc, char *argv[])
 {
     QApplication a(argc, argv);
     
-    // Ensure server cleanup on application exit
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption waitOption("wait-for-server",
+                                  "Show the loading screen until the AI server is ready instead of opening the editor immediately");
+    parser.addOption(waitOption);
+    QCommandLineOption privateServerOption("private-server",
+                                           "Run a backend for this editor only instead of sharing the backend daemon");
+    parser.addOption(privateServerOption);
+    QCommandLineOption idleTimeoutOption("server-idle-timeout",
+                                         "Seconds the shared backend keeps running after the last editor exits (0 = never exit)",
+                                         "seconds", QString::number(BackendDaemon::DEFAULT_IDLE_TIMEOUT));
+    parser.addOption(idleTimeoutOption);
+    QCommandLineOption engineOption("server-engine",
+                                    "Inference engine for a backend this editor starts: pytorch, int8, onnx or onnx-int8",
+                                    "engine");
+    parser.addOption(engineOption);
+    QCommandLineOption speculateOption("speculate",
+                                       "Compute the commands you run most in the background while the editor is idle");
+    parser.addOption(speculateOption);
+    QCommandLineOption streamOption("stream",
+                                    "Show summaries as they are generated (greedy decoding: quicker first words, "
+                                    "less polished than the default beam search)");
+    parser.addOption(streamOption);
+    QCommandLineOption journalOption("journal",
+                                     "Keep AI commands run while the backend is down on disk and run them once it is back");
+    parser.addOption(journalOption);
+    QCommandLineOption logFileOption("log-file", "Also write the event log, including console output, to a file", "path");
+    parser.addOption(logFileOption);
+    parser.process(a);
+    
+    // Created here so its flush timer lives on the GUI thread
+    EventLog* eventLog = EventLog::instance();
+    if (parser.isSet(logFileOption) && eventLog->setFileSink(parser.value(logFileOption))) {
+        eventLog->captureQtMessages();
+    }
+    
+    // One warm backend serves every open editor unless asked otherwise
+    LoadingScreen::setDaemonMode(!parser.isSet(privateServerOption), parser.value(idleTimeoutOption).toInt());
+    LoadingScreen::setInferenceEngine(parser.value(engineOption));
+    MainWindow::setSpeculativeExecution(parser.isSet(speculateOption));
+    MainWindow::setStreaming(parser.isSet(streamOption));
+    MainWindow::setJournal(parser.isSet(journalOption));
+    
+    // Ensure server cleanup on application exit; a shared daemon is left running
     QObject::connect(&a, &QApplication::aboutToQuit, []() {
         LoadingScreen::stopServerProcess();
     });
     
+    if (!parser.isSet(waitOption)) {
+        // The editor is usable right away; the backend loads its models in
+        // parallel and server commands are queued until it is ready
+        LoadingScreen::startServerProcess();
+        
+        MainWindow *mainWindow = new MainWindow();
+        mainWindow->setFixedSize(1000, 900);
+        mainWindow->show();
+        return a.exec();
+    }
+    
     // Create loading screen first
     LoadingScreen *loadingScreen = new LoadingScreen();
     loadingScreen->show();
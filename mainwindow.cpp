@@ -1,6 +1,11 @@
 #include "mainwindow.h"
 #include "servermanager.h"
 #include "commandmanager.h"
+#include "localsockettransport.h"
+#include "loadingscreen.h"
+#include "eventlog.h"
+#include "tracer.h"
+#include "largetextedit.h"
 #include <QDebug>
 #include <QClipboard>
 #include <QGuiApplication>
@@ -8,18 +13,47 @@
 #include <QTimer>
 #include <QDateTime>
 #include <QMouseEvent>
+#include <QScrollBar>
+#include <QStyle>
+#include <QFileDialog>
+#include <QFileInfo>
+#include <QFile>
+#include <QTextBlock>
+#include <algorithm>
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
     , suggestionsVisible(false)
+    , applyingSuggestion(false)
     , commandExecuting(false)
+    , largeDocumentMode(false)
     , debugTabVisible(false)
     , workingAnimationTimer(new QTimer(this))
     , workingAnimationState(0)
+    , renderedLogSequence(0)
+    , metricsRefreshTimer(new QTimer(this))
+    , metricsDirty(false)
+    , tokenCountTimer(new QTimer(this))
+    , countedRevision(0)
+    , countedStart(0)
+    , countedEnd(-1)
+    , speculationTimer(new QTimer(this))
+    , editedSinceSpeculation(0)
+    , statusTone(StatusNeutral)
 {
     // Initialize managers first
     serverManager = new ServerManager(this);
+#ifndef Q_OS_WIN
+    // The backend only listens on Unix domain sockets; Windows stays on HTTP.
+    // A shared daemon's socket is announced in its lockfile.
+    serverManager->setTransport(new LocalSocketTransport(LoadingScreen::serverSocketName()));
+#endif
     commandManager = new CommandManager(serverManager, this);
+    commandManager->setPersistentCacheEnabled(true);
+    commandManager->setJournalEnabled(journal);
+    commandManager->setSpeculativeExecutionEnabled(speculativeExecution);
+    commandManager->setStreamingEnabled(streaming);
+    resultRenderer = new ResultRenderer(this);
     
     // Setup UI
     setupUI();
@@ -30,7 +64,8 @@ MainWindow::MainWindow(QWidget *parent)
     workingAnimationTimer->setInterval(500); // 500ms between dots
     connect(workingAnimationTimer, &QTimer::timeout, this, &MainWindow::updateWorkingAnimation);
     
-    // Start health monitoring since server should already be running
+    // The backend is started alongside the window (or before it, with the
+    // loading screen); server commands are queued until it reports ready
     QTimer::singleShot(1000, this, [this]() {
         if (serverManager) {
             serverManager->startHealthMonitoring();
@@ -41,6 +76,15 @@ MainWindow::MainWindow(QWidget *parent)
     logDebugEvent("Application: TexDit initialized successfully");
 }
 
+const int MainWindow::LARGE_DOCUMENT_THRESHOLD = 1 << 20; // Characters
+const int MainWindow::SPECULATION_IDLE_INTERVAL = 1500; // ms; long enough that the user has stopped editing
+const int MainWindow::SPECULATION_MIN_EDIT = 200; // Characters inserted or removed; a paste or a few sentences
+const int MainWindow::TOKEN_COUNT_LIMIT = 4096; // Tokens; four model windows, past it the label says "over"
+const int MainWindow::TOKEN_COUNT_CHARACTERS = 32768; // Characters of the scope copied for the count
+bool MainWindow::speculativeExecution = false;
+bool MainWindow::streaming = false;
+bool MainWindow::journal = false;
+
 MainWindow::~MainWindow()
 {
     // Managers will be cleaned up automatically by Qt parent-child relationship
@@ -58,14 +102,19 @@ void MainWindow::setupUI()
     // Create tab widget
     tabWidget = new QTabWidget(this);
     
-    // Create main text input area (Main tab)
+    // Create main text input area (Main tab); multi-megabyte documents are
+    // shown in the virtualized editor instead
+    editorStack = new QStackedWidget(this);
     input = new QTextEdit(this);
     input->setPlaceholderText("Enter text here...");
+    largeInput = new LargeTextEdit(this);
+    editorStack->addWidget(input);
+    editorStack->addWidget(largeInput);
     
     // Set clipboard content if available
     QClipboard *clipboard = QGuiApplication::clipboard();
     if (!clipboard->text().isEmpty()) {
-        input->setText(clipboard->text());
+        setEditorText(clipboard->text());
     }
     
     // Create debug log area (Debug tab)
@@ -80,15 +129,32 @@ void MainWindow::setupUI()
         "}"
     );
     debugLog->setPlainText("Debug log initialized...\n");
+    debugLog->document()->setMaximumBlockCount(EventLog::HISTORY_SIZE);
     
     // Add tabs
-    tabWidget->addTab(input, "Editor");
+    tabWidget->addTab(editorStack, "Editor");
     tabWidget->addTab(debugLog, "Debug");
     
     // Hide debug tab initially
     tabWidget->removeTab(1);
     debugTabVisible = false;
     
+    // Per-command latency percentiles (Metrics tab)
+    metricsPanel = new QWidget(this);
+    QVBoxLayout* metricsLayout = new QVBoxLayout(metricsPanel);
+    metricsLayout->setContentsMargins(0, 0, 0, 0);
+    metricsView = new QTextBrowser(metricsPanel);
+    metricsView->setHtml("<p>No commands traced yet.</p>");
+    exportTraceButton = new QPushButton("Export Chrome Trace...", metricsPanel);
+    exportMetricsButton = new QPushButton("Export JSON...", metricsPanel);
+    QHBoxLayout* exportLayout = new QHBoxLayout();
+    exportLayout->addStretch();
+    exportLayout->addWidget(exportTraceButton);
+    exportLayout->addWidget(exportMetricsButton);
+    metricsLayout->addWidget(metricsView, 1);
+    metricsLayout->addLayout(exportLayout);
+    tabWidget->addTab(metricsPanel, "Metrics");
+    
     // Create command input area with execute button
     QHBoxLayout* commandLayout = new QHBoxLayout();
     
@@ -104,20 +170,53 @@ void MainWindow::setupUI()
     commandLayout->addWidget(executeButton, 0);
     commandLayout->setSpacing(5);
     
-    // Create status label
+    // Feedback states are selected by a property, so the style sheet is parsed once
+    command->setStyleSheet(
+        "QLineEdit[feedback=\"success\"] {"
+        "    border: 2px solid #27ae60;"
+        "    background-color: #d5f4e6;"
+        "    color: #155724;"
+        "}"
+        "QLineEdit[feedback=\"error\"] {"
+        "    border: 2px solid #e74c3c;"
+        "    background-color: #f8d7da;"
+        "    color: #721c24;"
+        "}"
+    );
+    
+    // Create status label; its colour comes from the palette, not the style sheet
     statusLabel = new QLabel("Ready", this);
     statusLabel->setStyleSheet(
         "QLabel {"
-        "    color: #7f8c8d;"
         "    font-size: 12px;"
         "    padding: 5px;"
         "}"
     );
+    const QColor toneColors[STATUS_TONE_COUNT] = {
+        QColor("#7f8c8d"), // Neutral
+        QColor("#27ae60"), // Success
+        QColor("#e74c3c"), // Error
+        QColor(Qt::blue),  // Working
+        QColor(Qt::darkGreen) // Idle after commands finished
+    };
+    for (int tone = 0; tone < STATUS_TONE_COUNT; ++tone) {
+        statusPalettes[tone] = statusLabel->palette();
+        statusPalettes[tone].setColor(QPalette::WindowText, toneColors[tone]);
+    }
+    statusLabel->setPalette(statusPalettes[StatusNeutral]);
+    
+    tokenCountLabel = new QLabel(this);
+    tokenCountLabel->setStyleSheet(statusLabel->styleSheet());
+    tokenCountLabel->setPalette(statusPalettes[StatusNeutral]);
+    tokenCountLabel->setToolTip("Model tokens in the selection, paragraph or document commands run on");
+    QHBoxLayout* statusLayout = new QHBoxLayout();
+    statusLayout->addWidget(statusLabel, 1);
+    statusLayout->addWidget(tokenCountLabel, 0);
     
     // Add widgets to main layout
     layout->addWidget(tabWidget, 8);       // Tab widget (80% of space)
     layout->addLayout(commandLayout, 0);   // Command input (fixed height)
-    layout->addWidget(statusLabel, 0);     // Status (fixed height)
+    layout->addLayout(statusLayout, 0);    // Status (fixed height)
     
     setCentralWidget(centralWidget);
     
@@ -130,6 +229,21 @@ void MainWindow::setupUI()
     toggleDebugTab->setShortcut(QKeySequence(Qt::CTRL | Qt::SHIFT | Qt::Key_D));
     addAction(toggleDebugTab);
     
+    openDocument = new QAction(tr("Open Document"), this);
+    openDocument->setShortcut(QKeySequence::Open);
+    addAction(openDocument);
+    
+    paragraphScope = new QAction(tr("Run Commands on Current Paragraph"), this);
+    paragraphScope->setShortcut(QKeySequence(Qt::CTRL | Qt::SHIFT | Qt::Key_P));
+    paragraphScope->setCheckable(true);
+    addAction(paragraphScope);
+    
+    // Only takes Esc from the other widgets while there is something to cancel
+    cancelCommands = new QAction(tr("Cancel Running Commands"), this);
+    cancelCommands->setShortcut(QKeySequence(Qt::Key_Escape));
+    cancelCommands->setEnabled(false);
+    addAction(cancelCommands);
+    
     qDebug() << "MainWindow: UI setup complete";
 }
 
@@ -143,13 +257,67 @@ void MainWindow::setupConnections()
     // Keyboard shortcut
     connect(goToCommandBox, &QAction::triggered, this, &MainWindow::onPressCtrlSlash);
     connect(toggleDebugTab, &QAction::triggered, this, &MainWindow::toggleDebugPanel);
+    connect(openDocument, &QAction::triggered, this, &MainWindow::openDocumentFile);
+    connect(paragraphScope, &QAction::toggled, this, &MainWindow::toggleParagraphScope);
+    connect(cancelCommands, &QAction::triggered, this, &MainWindow::cancelRunningCommands);
     
     // Manager connections
     connect(serverManager, &ServerManager::statusChanged, this, &MainWindow::onServerStatusChanged);
+    connect(serverManager, &ServerManager::loadProgress, this, &MainWindow::onServerLoadProgress);
     connect(commandManager, &CommandManager::commandExecuted, this, &MainWindow::onCommandExecuted);
+    connect(commandManager, &CommandManager::commandProgress, this, &MainWindow::onCommandProgress);
+    connect(commandManager, &CommandManager::commandStageProgress, this, &MainWindow::onCommandStageProgress);
+    connect(resultRenderer, &ResultRenderer::resultReady, this, &MainWindow::onResultReady);
     connect(commandManager, &CommandManager::suggestionsAvailable, this, &MainWindow::onSuggestionsReceived);
     connect(commandManager, &CommandManager::executionStateChanged, this, &MainWindow::onCommandExecutionStateChanged);
     
+    // Log entries arrive in batches and are only rendered while the Debug tab is showing
+    connect(EventLog::instance(), &EventLog::flushed, this, &MainWindow::renderDebugLog);
+    connect(tabWidget, &QTabWidget::currentChanged, this, &MainWindow::renderDebugLog);
+    
+    // Metrics are re-rendered at most twice a second, and only while showing
+    metricsRefreshTimer->setSingleShot(true);
+    metricsRefreshTimer->setInterval(500);
+    connect(metricsRefreshTimer, &QTimer::timeout, this, &MainWindow::renderMetrics);
+    connect(Tracer::instance(), &Tracer::traceFinished, this, [this]() {
+        metricsDirty = true;
+        if (!metricsRefreshTimer->isActive()) {
+            metricsRefreshTimer->start();
+        }
+    });
+    connect(tabWidget, &QTabWidget::currentChanged, this, &MainWindow::renderMetrics);
+    connect(exportTraceButton, &QPushButton::clicked, this, &MainWindow::exportChromeTrace);
+    connect(exportMetricsButton, &QPushButton::clicked, this, &MainWindow::exportMetrics);
+    
+    // The token count follows edits and the command scope
+    tokenCountTimer->setSingleShot(true);
+    tokenCountTimer->setInterval(300);
+    connect(tokenCountTimer, &QTimer::timeout, this, &MainWindow::updateTokenCount);
+    auto scheduleTokenCount = [this]() { tokenCountTimer->start(); };
+    connect(input, &QTextEdit::textChanged, this, scheduleTokenCount);
+    connect(input, &QTextEdit::cursorPositionChanged, this, scheduleTokenCount);
+    connect(largeInput, &LargeTextEdit::textChanged, this, scheduleTokenCount);
+    connect(largeInput, &LargeTextEdit::selectionChanged, this, scheduleTokenCount);
+    connect(paragraphScope, &QAction::toggled, this, scheduleTokenCount);
+    tokenCountTimer->start();
+    
+    // Likely commands are computed ahead once a large edit settles; the
+    // clipboard text the editor opens with counts as one
+    speculationTimer->setSingleShot(true);
+    speculationTimer->setInterval(SPECULATION_IDLE_INTERVAL);
+    connect(speculationTimer, &QTimer::timeout, this, &MainWindow::speculateOnIdle);
+    if (commandManager->isSpeculativeExecutionEnabled()) {
+        // Counts both directions, so rewriting text in place adds up too
+        auto countEdit = [this](int, int charsRemoved, int charsAdded) {
+            editedSinceSpeculation += charsRemoved + charsAdded;
+            speculationTimer->start();
+        };
+        connect(input->document(), &QTextDocument::contentsChange, this, countEdit);
+        connect(largeInput, &LargeTextEdit::contentsChange, this, countEdit);
+        editedSinceSpeculation = editorLength();
+        speculationTimer->start();
+    }
+    
     // Install event filter for advanced input handling
     command->installEventFilter(this);
     
@@ -160,7 +328,7 @@ void MainWindow::setupSuggestions()
 {
     // Create suggestions popup
     suggestions = new QListView(this);
-    suggestions_popup = new QStringListModel(this);
+    suggestions_popup = new QStandardItemModel(this);
     
     suggestions->setModel(suggestions_popup);
     suggestions->setWindowFlags(Qt::ToolTip);
@@ -200,20 +368,23 @@ void MainWindow::onPressCtrlSlash()
 
 void MainWindow::commandTextEdited()
 {
+    // Writing a chosen suggestion into the box must not reopen the popup
+    if (applyingSuggestion) {
+        return;
+    }
+    
     QString text = command->text().trimmed();
-    qDebug() << "MainWindow: Command text changed to:" << text;
     
     if (text.isEmpty()) {
+        commandManager->cancelPendingSuggestions();
         hideSuggestions();
         return;
     }
     
     // Always get suggestions for any non-empty input
-    // Don't hide suggestions based on isCommandValid check - let the user see arguments
-    commandManager->getSuggestions(text, [this](const QStringList& suggestions) {
-        // This callback will be called when suggestions are ready
-        // The onSuggestionsReceived slot will handle the actual display
-    });
+    // Don't hide suggestions based on isCommandValid check - let the user see arguments.
+    // Results arrive through onSuggestionsReceived once typing pauses.
+    commandManager->requestSuggestions(text);
 }
 
 void MainWindow::executeCommand()
@@ -229,32 +400,94 @@ void MainWindow::executeCommand()
     qDebug() << "MainWindow: Executing command:" << commandText;
     logDebugEvent(QString("Action: Execute pressed - '%1'").arg(commandText));
     
-    // Record start time for performance tracking
-    commandStartTime = QDateTime::currentDateTime();
+    // Record start time for performance tracking; stages are traced by CommandManager
+    commandStartTime.start();
     
     // Hide suggestions
+    commandManager->cancelPendingSuggestions();
     hideSuggestions();
     
     // Show execution feedback
     updateServerStatus(QString("Executing '%1'...").arg(commandText));
     
-    // Get input text
-    QString inputText = input->toPlainText();
+    // Several commands separated by ';' run as one batch on the same text
+    QStringList commandList;
+    for (const QString& part : commandText.split(';', Qt::SkipEmptyParts)) {
+        if (!part.trimmed().isEmpty()) {
+            commandList << part.trimmed();
+        }
+    }
+    if (commandList.isEmpty()) {
+        updateServerStatus("Please enter a command", true);
+        return;
+    }
     
-    // Execute command through command manager
-    commandManager->executeCommand(commandText, inputText, [this](int result, const QString& output) {
-        // This callback will be called when command execution is complete
-        // The onCommandExecuted slot will handle the actual result processing
+    // Server commands only get the selection (or the current paragraph) when
+    // there is one, and their results go next to it instead of at the end
+    int start = 0;
+    int end = editorLength();
+    bool needsServer = std::any_of(commandList.begin(), commandList.end(), [this](const QString& name) {
+        return commandManager->getCommandInfo(name).requiresServer;
     });
+    bool scoped = needsServer && commandScope(start, end);
+    QString inputText = editorText(start, end);
+    
+    if (scoped) {
+        for (int i = 0; i < commandList.size(); ++i) {
+            if (commandManager->getCommandInfo(commandList[i]).requiresServer) {
+                submittingTargets.insert(i, {commandList[i], createRange(start, end, false)});
+            }
+        }
+        logDebugEvent(QString("Action: '%1' runs on %2 of %3 characters")
+                      .arg(commandText).arg(end - start).arg(editorLength()));
+    }
+    
+    // Execute through the command manager; commands are queued if others are still running
+    QVector<CommandManager::Ticket> tickets;
+    if (commandList.size() > 1) {
+        tickets = commandManager->executeBatch(commandList, inputText);
+    } else {
+        tickets.append(commandManager->executeCommand(commandList.first(), inputText, [this](int result, const QString& output) {
+            // This callback will be called when command execution is complete
+            // The onCommandExecuted slot will handle the actual result processing
+        }));
+    }
+    
+    // Local commands complete synchronously, only track tickets that are still pending
+    for (int i = 0; i < tickets.size(); ++i) {
+        CommandManager::Ticket ticket = tickets[i];
+        const QString& name = commandList[i];
+        if (ticket == 0 || !commandManager->isCommandPending(ticket)) {
+            continue;
+        }
+        
+        commandStartTimes.insert(ticket, commandStartTime);
+        auto target = submittingTargets.find(i);
+        if (target != submittingTargets.end()) {
+            commandTargets.insert(ticket, target->second);
+            submittingTargets.erase(target);
+        }
+        logDebugEvent(QString("Action: '%1' scheduled as ticket %2").arg(name).arg(ticket));
+        if (commandManager->isCommandDeferred(name)) {
+            logDebugEvent(QString("Action: Ticket %1 waits for the AI server to finish loading").arg(ticket));
+        }
+    }
+    
+    // Whatever is left belongs to commands that already completed or were rejected
+    for (const auto& target : submittingTargets) {
+        releaseRange(target.second);
+    }
+    submittingTargets.clear();
 }
 
-void MainWindow::onCommandExecuted(const QString& command, int result, const QString& output)
+void MainWindow::onCommandExecuted(CommandManager::Ticket ticket, const QString& command, int result, const QString& output)
 {
     CommandManager::CommandResult cmdResult = static_cast<CommandManager::CommandResult>(result);
     bool success = (cmdResult == CommandManager::Success);
     
     // Calculate execution time
-    qint64 executionTimeMs = commandStartTime.msecsTo(QDateTime::currentDateTime());
+    qint64 executionTimeMs = commandStartTimes.value(ticket, commandStartTime).elapsed();
+    commandStartTimes.remove(ticket);
     double executionTimeSecs = executionTimeMs / 1000.0;
     
     qDebug() << "MainWindow: Command" << command << "completed with result:" << result;
@@ -275,27 +508,459 @@ void MainWindow::onCommandExecuted(const QString& command, int result, const QSt
     
     showCommandFeedback(command, success, output);
     
+    DocumentRange target;
+    bool hasTarget = takeCommandTarget(ticket, command, target);
+    
+    if (!success && streamViews.contains(ticket)) {
+        // Drop the partial output of a failed stream
+        replaceRange(streamViews.take(ticket), QString());
+    }
+    
     if (success) {
         // Handle successful command execution
         if (command == "clear") {
-            input->clear();
+            setEditorText(QString());
         } else if (command == "help") {
             // Show help in a message or separate area
-            input->append("\n\n--- Help ---\n" + output);
+            appendToEditor({"\n\n--- Help ---\n", output});
         } else {
-            // For AI commands, show result
-            input->append("\n\n--- " + command.toUpper() + " Result ---\n" + output);
+            // For AI commands, the result is prepared off the GUI thread and spliced in by onResultReady
+            ResultRenderer::Job job;
+            job.ticket = ticket;
+            job.command = command;
+            job.output = output;
+            if (hasTarget) {
+                if (commandManager->getCommandInfo(command).replacesInput) {
+                    job.original = editorText(rangeStart(target), rangeEnd(target));
+                }
+                renderTargets.insert(ticket, target);
+                hasTarget = false;
+            }
+            resultRenderer->submit(std::move(job));
         }
         
-        // Clear command after successful execution
-        QTimer::singleShot(1500, this, &MainWindow::clearCommand);
+        // Clear command after successful execution, unless the user is already typing the next one
+        QTimer::singleShot(1500, this, [this, command]() {
+            if (this->command->text().trimmed() == command) {
+                clearCommand();
+            }
+        });
+    }
+    
+    if (hasTarget) {
+        releaseRange(target);
+    }
+}
+
+void MainWindow::onCommandProgress(CommandManager::Ticket ticket, const QString& command, const QString& partialOutput)
+{
+    if (partialOutput.isEmpty()) {
+        return;
+    }
+    
+    auto it = streamViews.find(ticket);
+    if (it == streamViews.end()) {
+        // First chunk: open the result section below the command's target, or
+        // at the end of the document
+        const DocumentRange* target = commandTarget(ticket, command);
+        int position = target ? annotationPosition(*target) : editorLength();
+        it = streamViews.insert(ticket, createRange(position, position, true));
+        insertIntoEditor(position, {resultHeader(command)});
+        logDebugEvent(QString("Stream: first output for '%1' after %2 ms")
+                      .arg(command)
+                      .arg(commandStartTimes.value(ticket, commandStartTime).elapsed()));
+    }
+    
+    insertIntoEditor(rangeEnd(*it), {partialOutput});
+}
+
+void MainWindow::onCommandStageProgress(CommandManager::Ticket ticket, const QString& command, const QString& stage,
+                                        int completed, int total)
+{
+    stageText = QString("%1: %2 %3/%4").arg(command, stage).arg(completed).arg(total);
+    if (commandExecuting) {
+        statusLabel->setText(workingStatusText());
+    }
+    
+    if (completed == total) {
+        logDebugEvent(QString("Progress: '%1' %2 stage complete (%3 parts, ticket %4)")
+                      .arg(command, stage).arg(total).arg(ticket));
+    }
+}
+
+QString MainWindow::resultHeader(const QString& commandName) const
+{
+    return "\n\n--- " + commandName.toUpper() + " Result ---\n";
+}
+
+void MainWindow::onResultReady(const ResultRenderer::Result& result)
+{
+    // Inserting the result completes the command's trace
+    CommandManager::Ticket ticket = result.job.ticket;
+    Tracer::ScopedSpan renderSpan(ticket != 0 ? commandManager->requestId(ticket) : QString(), "render");
+    
+    auto it = renderTargets.find(ticket);
+    if (it == renderTargets.end()) {
+        insertResult(result, nullptr);
+        return;
+    }
+    DocumentRange target = it.value();
+    renderTargets.erase(it);
+    insertResult(result, &target);
+}
+
+void MainWindow::insertResult(const ResultRenderer::Result& result, const DocumentRange* target)
+{
+    const QString& commandName = result.job.command;
+    const QString& output = result.job.output;
+    auto stream = streamViews.find(result.job.ticket);
+    if (target && commandManager->getCommandInfo(commandName).replacesInput) {
+        // Rewrites take the place of the text they were run on
+        if (stream != streamViews.end()) {
+            replaceRange(*stream, QString());
+            streamViews.erase(stream);
+        }
+        int start = rangeStart(*target);
+        int end = rangeEnd(*target);
+        if (editorText(start, end) == result.job.original) {
+            // Only the part that changed is replaced, so the rest keeps its layout
+            replaceText(start + result.commonPrefix, end - result.commonSuffix, result.replacement());
+            releaseRange(*target);
+        } else {
+            replaceRange(*target, output); // Edited while the result was prepared
+        }
+        return;
+    }
+    
+    // Header and output are inserted separately, so the output is copied
+    // only once, into the document
+    QStringList section{resultHeader(commandName), output};
+    if (stream != streamViews.end()) {
+        // Replace the streamed text in place with the final, cleaned-up result
+        int position = rangeStart(*stream);
+        replaceRange(*stream, QString());
+        streamViews.erase(stream);
+        if (position < editorLength()) {
+            section << "\n";
+        }
+        insertIntoEditor(position, section);
+    } else if (target) {
+        // Annotate the target: the result goes below its last paragraph
+        int position = annotationPosition(*target);
+        if (position < editorLength()) {
+            section << "\n";
+        }
+        insertIntoEditor(position, section);
+    } else {
+        appendToEditor(section);
+    }
+    
+    if (target) {
+        releaseRange(*target);
+    }
+}
+
+MainWindow::DocumentRange* MainWindow::commandTarget(CommandManager::Ticket ticket, const QString& commandName)
+{
+    auto it = commandTargets.find(ticket);
+    if (it != commandTargets.end()) {
+        return &it.value();
+    }
+    int index = submittingTarget(commandName);
+    return index >= 0 ? &submittingTargets[index].second : nullptr;
+}
+
+bool MainWindow::takeCommandTarget(CommandManager::Ticket ticket, const QString& commandName, DocumentRange& target)
+{
+    if (commandTargets.contains(ticket)) {
+        target = commandTargets.take(ticket);
+        return true;
+    }
+    int index = submittingTarget(commandName);
+    if (index >= 0) {
+        target = submittingTargets.take(index).second;
+        return true;
+    }
+    return false;
+}
+
+int MainWindow::submittingTarget(const QString& commandName) const
+{
+    // Commands are submitted in order, so of several identical ones the first
+    // still unclaimed is the one completing
+    for (auto it = submittingTargets.cbegin(); it != submittingTargets.cend(); ++it) {
+        if (it->first == commandName) {
+            return it.key();
+        }
+    }
+    return -1;
+}
+
+int MainWindow::annotationPosition(const DocumentRange& target) const
+{
+    // End of the line the target ends on; a target that ends with a line
+    // break ends on the line before it
+    int start = rangeStart(target);
+    int end = rangeEnd(target);
+    if (largeDocumentMode) {
+        const PieceTable& document = largeInput->document();
+        int line = document.lineAt(end);
+        if (end > start && line > 0 && end == document.lineStart(line)) {
+            --line;
+        }
+        return document.lineStart(line) + document.lineLength(line);
+    }
+    
+    QTextBlock block = input->document()->findBlock(end);
+    if (end > start && block.position() == end && block.previous().isValid()) {
+        block = block.previous();
+    }
+    return block.position() + block.length() - 1;
+}
+
+void MainWindow::setEditorText(const QString& text)
+{
+    dropRanges();
+    countedEnd = -1; // The other editor's revisions aren't comparable
+    largeDocumentMode = text.size() > LARGE_DOCUMENT_THRESHOLD;
+    if (largeDocumentMode) {
+        input->clear();
+        largeInput->setPlainText(text);
+        editorStack->setCurrentWidget(largeInput);
+    } else {
+        largeInput->clear();
+        input->setPlainText(text);
+        editorStack->setCurrentWidget(input);
+    }
+}
+
+QString MainWindow::editorText(int start, int end) const
+{
+    if (largeDocumentMode) {
+        // Copies only the range; an unedited document is shared, not copied
+        return largeInput->document().text(start, end - start);
+    }
+    if (start == 0 && end == editorLength()) {
+        return input->toPlainText();
+    }
+    
+    QTextCursor range(input->document());
+    range.setPosition(start);
+    range.setPosition(end, QTextCursor::KeepAnchor);
+    // Same text toPlainText() would give for the range
+    QString text = range.selectedText();
+    text.replace(QChar::ParagraphSeparator, QLatin1Char('\n'));
+    text.replace(QChar::LineSeparator, QLatin1Char('\n'));
+    text.replace(QChar::Nbsp, QLatin1Char(' '));
+    return text;
+}
+
+int MainWindow::editorLength() const
+{
+    return largeDocumentMode ? largeInput->document().length() : input->document()->characterCount() - 1;
+}
+
+bool MainWindow::commandScope(int& start, int& end) const
+{
+    if (largeDocumentMode) {
+        if (largeInput->hasSelection()) {
+            start = largeInput->selectionStart();
+            end = largeInput->selectionEnd();
+            return true;
+        }
+        if (paragraphScope->isChecked()) {
+            const PieceTable& document = largeInput->document();
+            int line = document.lineAt(largeInput->cursorPosition());
+            start = document.lineStart(line);
+            end = start + document.lineLength(line);
+            return true;
+        }
+        return false;
+    }
+    
+    QTextCursor cursor = input->textCursor();
+    if (cursor.hasSelection()) {
+        start = cursor.selectionStart();
+        end = cursor.selectionEnd();
+        return true;
+    }
+    if (paragraphScope->isChecked()) {
+        QTextBlock block = cursor.block();
+        start = block.position();
+        end = start + block.length() - 1; // Without the paragraph break
+        return true;
+    }
+    return false;
+}
+
+void MainWindow::insertIntoEditor(int position, const QStringList& parts)
+{
+    if (largeDocumentMode) {
+        for (const QString& part : parts) {
+            largeInput->insertText(position, part);
+            position += part.size();
+        }
+        return;
+    }
+    
+    QTextCursor cursor(input->document());
+    cursor.setPosition(position);
+    cursor.beginEditBlock();
+    for (const QString& part : parts) {
+        cursor.insertText(part);
+    }
+    cursor.endEditBlock();
+}
+
+void MainWindow::appendToEditor(const QStringList& parts)
+{
+    // A new paragraph, like QTextEdit::append(), but always plain text
+    bool empty = editorLength() == 0;
+    if (largeDocumentMode) {
+        if (!empty) {
+            largeInput->appendText("\n");
+        }
+        for (const QString& part : parts) {
+            largeInput->appendText(part);
+        }
+        return;
+    }
+    
+    QScrollBar* scrollBar = input->verticalScrollBar();
+    bool atBottom = scrollBar->value() == scrollBar->maximum();
+    QTextCursor cursor(input->document());
+    cursor.movePosition(QTextCursor::End);
+    cursor.beginEditBlock();
+    if (!empty) {
+        cursor.insertBlock();
+    }
+    for (const QString& part : parts) {
+        cursor.insertText(part);
     }
+    cursor.endEditBlock();
+    if (atBottom) {
+        scrollBar->setValue(scrollBar->maximum());
+    }
+}
+
+MainWindow::DocumentRange MainWindow::createRange(int start, int end, bool growAtEnd)
+{
+    DocumentRange range;
+    if (largeDocumentMode) {
+        PieceTable& document = largeInput->document();
+        range.beginMark = document.createMark(start, PieceTable::StayBefore);
+        range.endMark = document.createMark(end, growAtEnd ? PieceTable::MoveAfter : PieceTable::StayBefore);
+        return range;
+    }
+    
+    // Text inserted at the start goes inside the range
+    range.begin = QTextCursor(input->document());
+    range.begin.setPosition(start);
+    range.begin.setKeepPositionOnInsert(true);
+    range.end = QTextCursor(input->document());
+    range.end.setPosition(end);
+    range.end.setKeepPositionOnInsert(!growAtEnd);
+    return range;
+}
+
+int MainWindow::rangeStart(const DocumentRange& range) const
+{
+    return largeDocumentMode ? largeInput->document().markPosition(range.beginMark) : range.begin.position();
+}
+
+int MainWindow::rangeEnd(const DocumentRange& range) const
+{
+    return largeDocumentMode ? largeInput->document().markPosition(range.endMark) : range.end.position();
+}
+
+void MainWindow::replaceRange(const DocumentRange& range, const QString& text)
+{
+    replaceText(rangeStart(range), rangeEnd(range), text);
+    releaseRange(range);
+}
+
+void MainWindow::replaceText(int start, int end, const QString& text)
+{
+    if (largeDocumentMode) {
+        largeInput->removeText(start, end - start);
+        largeInput->insertText(start, text);
+        return;
+    }
+    
+    QTextCursor cursor(input->document());
+    cursor.setPosition(start);
+    cursor.setPosition(end, QTextCursor::KeepAnchor);
+    if (text.isEmpty()) {
+        cursor.removeSelectedText();
+    } else {
+        cursor.insertText(text);
+    }
+}
+
+void MainWindow::releaseRange(const DocumentRange& range)
+{
+    // Cursors go with the range; marks have to be removed from the piece table
+    if (largeDocumentMode) {
+        largeInput->document().removeMark(range.beginMark);
+        largeInput->document().removeMark(range.endMark);
+    }
+}
+
+void MainWindow::dropRanges()
+{
+    for (const DocumentRange& range : streamViews) {
+        releaseRange(range);
+    }
+    for (const DocumentRange& range : commandTargets) {
+        releaseRange(range);
+    }
+    for (const auto& target : submittingTargets) {
+        releaseRange(target.second);
+    }
+    for (const DocumentRange& range : renderTargets) {
+        releaseRange(range);
+    }
+    streamViews.clear();
+    commandTargets.clear();
+    submittingTargets.clear();
+    renderTargets.clear();
+}
+
+void MainWindow::openDocumentFile()
+{
+    QString path = QFileDialog::getOpenFileName(this, "Open Document", QString(),
+                                                "Text files (*.txt *.md *.log);;All files (*)");
+    if (path.isEmpty()) {
+        return;
+    }
+    
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        updateServerStatus(QString("Could not open %1").arg(path), true);
+        return;
+    }
+    
+    QElapsedTimer timer;
+    timer.start();
+    QString text = QString::fromUtf8(file.readAll());
+    if (text.contains(QLatin1Char('\r'))) {
+        text.replace(QLatin1String("\r\n"), QLatin1String("\n"));
+    }
+    setEditorText(text);
+    
+    QString name = QFileInfo(path).fileName();
+    logDebugEvent(QString("Action: Opened %1 (%2 characters%3) in %4 ms")
+                  .arg(name).arg(text.size())
+                  .arg(largeDocumentMode ? QString(", large document mode") : QString())
+                  .arg(timer.elapsed()));
+    updateServerStatus(QString("Opened %1").arg(name));
 }
 
 void MainWindow::onSuggestionsReceived(const QString& query, const QStringList& suggestions)
 {
-    // Only show suggestions if the query still matches current input
-    if (command->text().trimmed() == query && !suggestions.isEmpty()) {
+    // CommandManager drops results for superseded queries, so these are current
+    Q_UNUSED(query);
+    if (!suggestions.isEmpty()) {
         displaySuggestions(suggestions);
     }
 }
@@ -315,11 +980,15 @@ void MainWindow::onServerStatusChanged(int status)
             statusName = "Connecting";
             break;
         case ServerManager::Connected:
+            serverLoadText.clear();
             updateServerStatus("Server connected - All features available");
             statusName = "Connected";
             break;
         case ServerManager::Error:
-            updateServerStatus("Server error - Local commands only", true);
+            serverLoadText.clear();
+            updateServerStatus(commandManager->isJournalEnabled()
+                               ? QString("Server error - AI commands are saved and run on reconnect")
+                               : QString("Server error - Local commands only"), true);
             statusName = "Error";
             break;
     }
@@ -328,6 +997,20 @@ void MainWindow::onServerStatusChanged(int status)
     qDebug() << "MainWindow: Server status changed to:" << status;
 }
 
+void MainWindow::onServerLoadProgress(const QString& stage, const QString& message, double progress)
+{
+    serverLoadText = QString("%1 (%2%)").arg(message.isEmpty() ? QString("Loading AI models") : message)
+                                        .arg(qRound(progress * 100));
+    
+    // Running commands keep the status line; the load stage shows in their text
+    if (commandExecuting) {
+        statusLabel->setText(workingStatusText());
+    } else {
+        updateServerStatus(serverLoadText + " - Local commands available");
+    }
+    logDebugEvent(QString("Action: Server loading (%1) %2").arg(stage, serverLoadText));
+}
+
 void MainWindow::displaySuggestions(const QStringList& suggestionList)
 {
     if (suggestionList.isEmpty()) {
@@ -335,11 +1018,20 @@ void MainWindow::displaySuggestions(const QStringList& suggestionList)
         return;
     }
     
-    qDebug() << "MainWindow: Displaying" << suggestionList.size() << "suggestions";
+    LOG_DEBUG("suggestions", QString("Displaying %1 suggestions").arg(suggestionList.size()));
     
     // For Minecraft-style suggestions, limit to maximum 4 items
     QStringList limitedSuggestions = suggestionList.mid(0, 4);
-    suggestions_popup->setStringList(limitedSuggestions);
+    suggestions_popup->clear();
+    for (const QString& suggestion : limitedSuggestions) {
+        QStandardItem* item = new QStandardItem(suggestion);
+        // Greyed out: still selectable, but queued until the server is ready
+        if (commandManager->isCommandDeferred(suggestion)) {
+            item->setForeground(suggestions->palette().brush(QPalette::Disabled, QPalette::Text));
+            item->setToolTip("Runs once the AI server has finished loading");
+        }
+        suggestions_popup->appendRow(item);
+    }
     
     // Position suggestions below command input
     int cursorPos = command->cursorPosition();
@@ -368,7 +1060,7 @@ void MainWindow::displaySuggestions(const QStringList& suggestionList)
     suggestions->show();
     suggestionsVisible = true;
     
-    qDebug() << "MainWindow: Compact suggestions popup shown at:" << globalCaretPos;
+    LOG_DEBUG("suggestions", QString("Popup shown at %1,%2").arg(globalCaretPos.x()).arg(globalCaretPos.y()));
 }
 
 void MainWindow::hideSuggestions()
@@ -376,7 +1068,7 @@ void MainWindow::hideSuggestions()
     if (suggestionsVisible) {
         suggestions->hide();
         suggestionsVisible = false;
-        qDebug() << "MainWindow: Suggestions hidden";
+        LOG_DEBUG("suggestions", "Popup hidden");
     }
 }
 
@@ -402,21 +1094,15 @@ void MainWindow::selectSuggestion(int index)
     QModelIndex modelIndex = suggestions_popup->index(index, 0);
     QString selectedText = modelIndex.data(Qt::DisplayRole).toString();
     
-    // Hide suggestions first
+    // Hide suggestions first, and drop any lookup still pending for the typed prefix
     hideSuggestions();
+    commandManager->cancelPendingSuggestions();
     
-    // Temporarily disconnect textChanged to prevent retriggering suggestions
-    disconnect(command, &QLineEdit::textChanged, this, &MainWindow::commandTextEdited);
-    
+    // textChanged fires synchronously from setText; suppress the lookup it would trigger
+    applyingSuggestion = true;
     command->setText(selectedText);
     command->setCursorPosition(selectedText.length());
-    
-    // Reconnect after a brief delay
-    QTimer::singleShot(50, this, [this]() {
-        if (command) {
-            connect(command, &QLineEdit::textChanged, this, &MainWindow::commandTextEdited);
-        }
-    });
+    applyingSuggestion = false;
     
     qDebug() << "MainWindow: Selected suggestion applied:" << selectedText;
 }
@@ -424,64 +1110,48 @@ void MainWindow::selectSuggestion(int index)
 void MainWindow::updateServerStatus(const QString& message, bool isError)
 {
     statusLabel->setText(message);
-    
-    if (isError) {
-        statusLabel->setStyleSheet(
-            "QLabel {"
-            "    color: #e74c3c;"
-            "    font-size: 12px;"
-            "    padding: 5px;"
-            "}"
-        );
-    } else {
-        statusLabel->setStyleSheet(
-            "QLabel {"
-            "    color: #27ae60;"
-            "    font-size: 12px;"
-            "    padding: 5px;"
-            "}"
-        );
-    }
+    setStatusTone(isError ? StatusError : StatusSuccess);
     
     // Auto-clear status after 5 seconds for non-error messages
     if (!isError) {
         QTimer::singleShot(5000, this, [this, message]() {
             if (statusLabel && statusLabel->text() == message) { // Only clear if message hasn't changed
                 statusLabel->setText("Ready");
-                statusLabel->setStyleSheet(
-                    "QLabel {"
-                    "    color: #7f8c8d;"
-                    "    font-size: 12px;"
-                    "    padding: 5px;"
-                    "}"
-                );
+                setStatusTone(StatusNeutral);
             }
         });
     }
 }
 
+void MainWindow::setStatusTone(StatusTone tone)
+{
+    if (tone != statusTone) {
+        statusTone = tone;
+        statusLabel->setPalette(statusPalettes[tone]);
+    }
+}
+
+void MainWindow::setCommandFeedback(const char* state)
+{
+    if (command->property("feedback").toByteArray() == state) {
+        return;
+    }
+    // Re-polishing applies the matching rule of the style sheet set up once in setupUI
+    command->setProperty("feedback", QByteArray(state));
+    command->style()->unpolish(command);
+    command->style()->polish(command);
+}
+
 void MainWindow::showCommandFeedback(const QString& commandName, bool success, const QString& message)
 {
     QString feedback;
     
     if (success) {
         feedback = QString("✅ '%1' executed successfully").arg(commandName);
-        command->setStyleSheet(
-            "QLineEdit {"
-            "    border: 2px solid #27ae60;"
-            "    background-color: #d5f4e6;"
-            "    color: #155724;"
-            "}"
-        );
+        setCommandFeedback("success");
     } else {
         feedback = QString("❌ '%1' failed: %2").arg(commandName, message);
-        command->setStyleSheet(
-            "QLineEdit {"
-            "    border: 2px solid #e74c3c;"
-            "    background-color: #f8d7da;"
-            "    color: #721c24;"
-            "}"
-        );
+        setCommandFeedback("error");
     }
     
     updateServerStatus(feedback, !success);
@@ -489,7 +1159,7 @@ void MainWindow::showCommandFeedback(const QString& commandName, bool success, c
     // Reset command styling after feedback period
     QTimer::singleShot(2000, this, [this]() {
         if (command) {
-            command->setStyleSheet("");
+            setCommandFeedback("");
         }
     });
 }
@@ -497,7 +1167,7 @@ void MainWindow::showCommandFeedback(const QString& commandName, bool success, c
 void MainWindow::clearCommand()
 {
     command->clear();
-    command->setStyleSheet("");
+    setCommandFeedback("");
 }
 
 bool MainWindow::eventFilter(QObject *obj, QEvent *event)
@@ -582,29 +1252,57 @@ bool MainWindow::eventFilter(QObject *obj, QEvent *event)
     return QMainWindow::eventFilter(obj, event);
 }
 
-void MainWindow::onCommandExecutionStateChanged(CommandManager::ExecutionState state)
+void MainWindow::onCommandExecutionStateChanged(const CommandManager::ExecutionState& state)
 {
-    bool executing = (state == CommandManager::ExecutionState::Executing);
+    bool executing = !state.isIdle();
+    bool wasExecuting = commandExecuting;
     commandExecuting = executing;
+    executionState = state;
+    cancelCommands->setEnabled(executing);
     
-    // Update UI state
-    command->setEnabled(!executing);
-    executeButton->setEnabled(!executing);
-    
+    // The command box stays enabled so further commands can be queued
     if (executing) {
-        // Start working animation
-        workingAnimationState = 0;
-        workingAnimationTimer->start();
-        statusLabel->setText("Working.");
-        statusLabel->setStyleSheet("color: blue;");
+        if (!wasExecuting) {
+            // Start working animation
+            workingAnimationState = 0;
+            workingAnimationTimer->start();
+            setStatusTone(StatusWorking);
+        }
+        statusLabel->setText(workingStatusText());
     } else {
         // Stop animation and clear status
         workingAnimationTimer->stop();
+        stageText.clear();
         statusLabel->setText("Ready");
-        statusLabel->setStyleSheet("color: green;");
+        setStatusTone(StatusIdle);
     }
     
-    qDebug() << "MainWindow: Command execution state changed to" << (executing ? "executing" : "idle");
+    qDebug() << "MainWindow: Command execution state changed to" << state.inFlight
+             << "in flight," << state.queued << "queued";
+}
+
+QString MainWindow::workingStatusText() const
+{
+    // Everything still running is waiting on the backend to come up
+    bool waitingForServer = executionState.inFlight == 0 && !serverLoadText.isEmpty();
+    QString workingText = waitingForServer ? "Waiting for AI server" : "Working";
+    for (int i = 0; i <= workingAnimationState; ++i) {
+        workingText += ".";
+    }
+    
+    if (executionState.inFlight + executionState.queued > 1) {
+        workingText += QString(" (%1 running, %2 queued)")
+                       .arg(executionState.inFlight)
+                       .arg(executionState.queued);
+    }
+    
+    if (!stageText.isEmpty()) {
+        workingText += " - " + stageText;
+    } else if (waitingForServer) {
+        workingText += " - " + serverLoadText;
+    }
+    
+    return workingText;
 }
 
 void MainWindow::updateWorkingAnimation()
@@ -614,13 +1312,7 @@ void MainWindow::updateWorkingAnimation()
     }
     
     workingAnimationState = (workingAnimationState + 1) % 3;
-    
-    QString workingText = "Working";
-    for (int i = 0; i <= workingAnimationState; ++i) {
-        workingText += ".";
-    }
-    
-    statusLabel->setText(workingText);
+    statusLabel->setText(workingStatusText());
 }
 
 void MainWindow::toggleDebugPanel()
@@ -640,15 +1332,179 @@ void MainWindow::toggleDebugPanel()
     }
 }
 
+void MainWindow::toggleParagraphScope(bool enabled)
+{
+    QString scope = enabled ? "selection or current paragraph" : "selection or whole document";
+    updateServerStatus(QString("Commands run on the %1").arg(scope));
+    logDebugEvent(QString("Action: Commands now run on the %1 (Ctrl+Shift+P)").arg(scope));
+}
+
+void MainWindow::cancelRunningCommands()
+{
+    // Esc closes the suggestion popup first, as it did before
+    if (suggestionsVisible) {
+        hideSuggestions();
+        return;
+    }
+    
+    // Cancelled tickets complete through onCommandExecuted, which cleans up after them
+    const QList<CommandManager::Ticket> tickets = commandStartTimes.keys();
+    int cancelled = 0;
+    for (CommandManager::Ticket ticket : tickets) {
+        cancelled += commandManager->cancelCommand(ticket);
+    }
+    updateServerStatus(QString("Cancelled %1 command%2").arg(cancelled).arg(cancelled == 1 ? "" : "s"));
+    logDebugEvent(QString("Action: Cancelled %1 pending commands (Esc)").arg(cancelled));
+}
+
 void MainWindow::logDebugEvent(const QString& message)
 {
-    QString timestamp = QDateTime::currentDateTime().toString("dd/MM/yy hh:mm:ss");
-    QString logEntry = QString("[%1] %2\n").arg(timestamp, message);
+    LOG_INFO("ui", message);
+}
+
+void MainWindow::renderMetrics()
+{
+    if (!metricsDirty || tabWidget->currentWidget() != metricsPanel) {
+        return;
+    }
+    metricsDirty = false;
+    
+    // Stages in the order a command passes through them
+    static const QStringList stageOrder = {
+        "parse", "queue_wait", "serialise", "network", "server_tokenise", "server_generate",
+        "server_decode", "deserialise", "render", Tracer::TOTAL_STAGE
+    };
+    
+    QList<Tracer::StageSummary> summaries = Tracer::instance()->summaries();
+    std::stable_sort(summaries.begin(), summaries.end(), [](const Tracer::StageSummary& a, const Tracer::StageSummary& b) {
+        if (a.command != b.command) {
+            return a.command < b.command;
+        }
+        return stageOrder.indexOf(a.stage) < stageOrder.indexOf(b.stage);
+    });
     
-    debugLog->append(logEntry);
+    auto ms = [](qint64 nanoseconds) { return QString::number(nanoseconds / 1e6, 'f', 2); };
+    QString html = "<table cellspacing='0' cellpadding='4' border='1'>"
+                   "<tr><th>Command</th><th>Stage</th><th>Count</th><th>p50 ms</th>"
+                   "<th>p95 ms</th><th>p99 ms</th><th>Max ms</th></tr>";
+    for (const Tracer::StageSummary& summary : summaries) {
+        bool total = summary.stage == Tracer::TOTAL_STAGE;
+        html += QString("<tr%1><td>%2</td><td>%3</td><td align='right'>%4</td><td align='right'>%5</td>"
+                        "<td align='right'>%6</td><td align='right'>%7</td><td align='right'>%8</td></tr>")
+                .arg(total ? " style='font-weight:bold'" : "", summary.command.toHtmlEscaped(),
+                     summary.stage.toHtmlEscaped(), QString::number(summary.count), ms(summary.p50),
+                     ms(summary.p95), ms(summary.p99), ms(summary.max));
+    }
+    html += "</table>";
+    metricsView->setHtml(summaries.isEmpty() ? QString("<p>No commands traced yet.</p>") : html);
+}
+
+void MainWindow::exportChromeTrace()
+{
+    QString path = QFileDialog::getSaveFileName(this, "Export Chrome Trace", "texdit-trace.json", "JSON (*.json)");
+    if (path.isEmpty()) {
+        return;
+    }
+    bool ok = Tracer::instance()->exportChromeTrace(path);
+    updateServerStatus(ok ? QString("Trace exported to %1").arg(path) : QString("Could not write %1").arg(path), !ok);
+}
+
+void MainWindow::exportMetrics()
+{
+    QString path = QFileDialog::getSaveFileName(this, "Export Metrics", "texdit-metrics.json", "JSON (*.json)");
+    if (path.isEmpty()) {
+        return;
+    }
+    bool ok = Tracer::instance()->exportJson(path);
+    updateServerStatus(ok ? QString("Metrics exported to %1").arg(path) : QString("Could not write %1").arg(path), !ok);
+}
+
+void MainWindow::updateTokenCount()
+{
+    int start = 0;
+    int end = editorLength();
+    bool scoped = commandScope(start, end);
+    quint64 revision = largeDocumentMode ? largeInput->document().revision() : quint64(input->document()->revision());
+    if (revision == countedRevision && start == countedStart && end == countedEnd) {
+        return; // Only the cursor moved
+    }
+    countedRevision = revision;
+    countedStart = start;
+    countedEnd = end;
+
+    // Runs on the GUI thread after every pause, so only a bounded prefix is
+    // copied and tokenised; a longer scope is over the limit in practice, as
+    // tokens average a few characters. The prefix is well past the chunk size,
+    // so it tells whether the scope is summarised in parts.
+    int counted = qMin(end - start, TOKEN_COUNT_CHARACTERS);
+    QString scopeText = editorText(start, start + counted);
+    int tokens = commandManager->countTokens(scopeText, TOKEN_COUNT_LIMIT);
+    if (tokens < 0) {
+        tokenCountLabel->clear(); // No tokenizer files
+        return;
+    }
+
+    QString text;
+    if (tokens > TOKEN_COUNT_LIMIT || counted < end - start) {
+        text = QString(scoped ? "Over %L1 tokens selected" : "Over %L1 tokens").arg(TOKEN_COUNT_LIMIT);
+    } else {
+        text = QString(scoped ? "%L1 tokens selected" : "%L1 tokens").arg(tokens);
+    }
+    if (commandManager->needsChunking("summarise", scopeText)) {
+        text += " (summarised in parts)";
+    }
+    tokenCountLabel->setText(text);
+}
+
+void MainWindow::speculateOnIdle()
+{
+    if (editedSinceSpeculation < SPECULATION_MIN_EDIT) {
+        return;
+    }
+    if (!commandManager->canSpeculate()) {
+        // Tried again until the backend is ready and has spare capacity
+        speculationTimer->start();
+        return;
+    }
     
-    // Auto-scroll to bottom
-    QTextCursor cursor = debugLog->textCursor();
+    // Same text the commands would be run on
+    int start = 0;
+    int end = editorLength();
+    commandScope(start, end);
+    editedSinceSpeculation = 0;
+    int started = commandManager->speculate(editorText(start, end));
+    if (started > 0) {
+        logDebugEvent(QString("Speculation: %1 predicted commands started on %2 characters")
+                      .arg(started).arg(end - start));
+    }
+}
+
+void MainWindow::renderDebugLog()
+{
+    // Nothing is formatted or laid out while the Debug tab is hidden
+    if (!debugTabVisible || tabWidget->currentWidget() != debugLog) {
+        return;
+    }
+    
+    EventLog* eventLog = EventLog::instance();
+    QVector<EventLog::Entry> entries = eventLog->entriesSince(renderedLogSequence, EventLog::Info);
+    renderedLogSequence = eventLog->lastSequence();
+    if (entries.isEmpty()) {
+        return;
+    }
+    
+    // One insertion per batch; the document keeps at most HISTORY_SIZE blocks
+    QString text;
+    for (const EventLog::Entry& entry : entries) {
+        QString timestamp = QDateTime::fromMSecsSinceEpoch(entry.timestamp).toString("dd/MM/yy hh:mm:ss");
+        QString message = entry.category == "ui" ? entry.message : entry.category + ": " + entry.message;
+        text += QString("\n[%1] %2").arg(timestamp, message);
+    }
+    
+    QTextCursor cursor(debugLog->document());
     cursor.movePosition(QTextCursor::End);
-    debugLog->setTextCursor(cursor);
+    cursor.insertText(text);
+    
+    // Auto-scroll to bottom
+    debugLog->verticalScrollBar()->setValue(debugLog->verticalScrollBar()->maximum());
 }
@@ -14,18 +14,27 @@
 #include <QGuiApplication>
 #include <QTextCursor>
 #include <QListView>
-#include <QStringListModel>
+#include <QStandardItemModel>
 #include <QKeyEvent>
 #include <QEvent>
 #include <QTimer>
 #include <QLabel>
 #include <QTabWidget>
+#include <QStackedWidget>
 #include <QTextBrowser>
 #include <QDateTime>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMap>
+#include <QPair>
+#include <QPalette>
 #include "commandmanager.h"
+#include "piecetable.h"
+#include "resultrenderer.h"
 
 // Forward declarations for our managers
 class ServerManager;
+class LargeTextEdit;
 
 class MainWindow : public QMainWindow
 {
@@ -34,34 +43,91 @@ class MainWindow : public QMainWindow
 public:
     MainWindow(QWidget *parent = nullptr);
     ~MainWindow();
+    
+    // Pre-compute likely commands while the editor is idle; applies to windows created afterwards
+    static void setSpeculativeExecution(bool enabled) { speculativeExecution = enabled; }
+    // Show summaries as they are generated, decoded greedily rather than with beam search
+    static void setStreaming(bool enabled) { streaming = enabled; }
+    // Keep server commands held during an outage on disk and replay them on reconnect
+    static void setJournal(bool enabled) { journal = enabled; }
 
 private:
     // UI Components
     QTabWidget* tabWidget;
+    QStackedWidget* editorStack;
     QTextEdit* input;
+    LargeTextEdit* largeInput; // Replaces input for documents over LARGE_DOCUMENT_THRESHOLD
     QTextBrowser* debugLog;
+    QWidget* metricsPanel;
+    QTextBrowser* metricsView;
+    QPushButton* exportTraceButton;
+    QPushButton* exportMetricsButton;
     QLineEdit* command;
     QPushButton* executeButton;
     QLabel* statusLabel;
+    QLabel* tokenCountLabel; // Tokens in the text commands would run on
     QAction* goToCommandBox;
     QAction* toggleDebugTab;
+    QAction* openDocument;
+    QAction* paragraphScope; // Checked: commands without a selection run on the current paragraph
+    QAction* cancelCommands; // Esc, enabled while commands are queued or running
     QVBoxLayout* layout;
     
     // Suggestion system
     QListView* suggestions;
-    QStringListModel* suggestions_popup;
+    QStandardItemModel* suggestions_popup;
     
     // Managers
     ServerManager* serverManager;
     CommandManager* commandManager;
+    ResultRenderer* resultRenderer; // Prepares results off the GUI thread
     
     // UI State
     bool suggestionsVisible;
+    bool applyingSuggestion; // Set while a chosen suggestion is written into the command box
     bool commandExecuting;
+    bool largeDocumentMode;
+    CommandManager::ExecutionState executionState;
+    QString stageText;
+    QString serverLoadText; // Backend start-up stage, empty once it is ready
+    quint64 renderedLogSequence; // Last EventLog entry shown in the Debug tab
     bool debugTabVisible;
     QTimer* workingAnimationTimer;
     int workingAnimationState;
-    QDateTime commandStartTime;
+    QElapsedTimer commandStartTime;
+    QHash<CommandManager::Ticket, QElapsedTimer> commandStartTimes;
+    QTimer* metricsRefreshTimer;
+    bool metricsDirty;
+    QTimer* tokenCountTimer; // Counts once typing pauses
+    quint64 countedRevision; // Document revision and scope of the shown count
+    int countedStart;
+    int countedEnd; // -1 when nothing was counted
+    QTimer* speculationTimer; // Fires once the editor has been idle for SPECULATION_IDLE_INTERVAL
+    int editedSinceSpeculation; // Characters inserted and removed since speculation last ran
+    
+    // Status label colours, built once; switching tone only swaps the palette
+    enum StatusTone { StatusNeutral, StatusSuccess, StatusError, StatusWorking, StatusIdle, STATUS_TONE_COUNT };
+    QPalette statusPalettes[STATUS_TONE_COUNT];
+    StatusTone statusTone;
+    
+    // Document range that moves with edits; in large document mode it is held
+    // by marks in the piece table
+    struct DocumentRange {
+        QTextCursor begin;
+        QTextCursor end;
+        PieceTable::Mark beginMark = 0;
+        PieceTable::Mark endMark = 0;
+    };
+    // Streamed results while they are still being generated
+    QHash<CommandManager::Ticket, DocumentRange> streamViews;
+    // Text a command was run on, when it was scoped to a selection or paragraph
+    QHash<CommandManager::Ticket, DocumentRange> commandTargets;
+    // Targets of the commands being submitted, by position in the command line
+    // and with the command, as they can complete before their ticket is known
+    QMap<int, QPair<QString, DocumentRange>> submittingTargets;
+    int submittingTarget(const QString& commandName) const;
+    // Targets of finished commands whose results are still being prepared
+    QHash<CommandManager::Ticket, DocumentRange> renderTargets;
 
 protected:
     bool eventFilter(QObject *obj, QEvent *event) override;
@@ -70,18 +136,32 @@ private slots:
     // UI Events
     void onPressCtrlSlash();
     void toggleDebugPanel();
+    void toggleParagraphScope(bool enabled);
+    void cancelRunningCommands();
+    void openDocumentFile();
     void commandTextEdited();
     void onSuggestionClicked(const QModelIndex &index);
     
     // Command System
     void executeCommand();
-    void onCommandExecuted(const QString& command, int result, const QString& output);
+    void onCommandExecuted(CommandManager::Ticket ticket, const QString& command, int result, const QString& output);
+    void onCommandProgress(CommandManager::Ticket ticket, const QString& command, const QString& partialOutput);
+    void onCommandStageProgress(CommandManager::Ticket ticket, const QString& command, const QString& stage,
+                                int completed, int total);
+    void onResultReady(const ResultRenderer::Result& result);
     void onSuggestionsReceived(const QString& query, const QStringList& suggestions);
-    void onCommandExecutionStateChanged(CommandManager::ExecutionState state);
+    void onCommandExecutionStateChanged(const CommandManager::ExecutionState& state);
     void updateWorkingAnimation();
+    void renderDebugLog();
+    void renderMetrics();
+    void exportChromeTrace();
+    void exportMetrics();
+    void updateTokenCount();
+    void speculateOnIdle();
     
     // Server Status
     void onServerStatusChanged(int status);
+    void onServerLoadProgress(const QString& stage, const QString& message, double progress);
 
 private:
     // UI Helpers
@@ -93,6 +173,41 @@ private:
     void hideSuggestions();
     void updateServerStatus(const QString& message, bool isError = false);
     void showCommandFeedback(const QString& commandName, bool success, const QString& message);
+    void setStatusTone(StatusTone tone);
+    void setCommandFeedback(const char* state); // "success", "error" or "" for none
+    QString workingStatusText() const;
+    QString resultHeader(const QString& commandName) const;
+    void insertResult(const ResultRenderer::Result& result, const DocumentRange* target);
+    DocumentRange* commandTarget(CommandManager::Ticket ticket, const QString& commandName);
+    bool takeCommandTarget(CommandManager::Ticket ticket, const QString& commandName, DocumentRange& target);
+    int annotationPosition(const DocumentRange& target) const;
+    
+    // Editor content; large texts switch the editor to the piece-table view
+    void setEditorText(const QString& text);
+    QString editorText(int start, int end) const;
+    int editorLength() const;
+    bool commandScope(int& start, int& end) const; // False when commands should see the whole document
+    // Parts are inserted one after the other instead of being joined first
+    void insertIntoEditor(int position, const QStringList& parts);
+    void appendToEditor(const QStringList& parts);
+    
+    // Ranges grow with text inserted at their end only when growAtEnd is set
+    DocumentRange createRange(int start, int end, bool growAtEnd);
+    int rangeStart(const DocumentRange& range) const;
+    int rangeEnd(const DocumentRange& range) const;
+    void replaceRange(const DocumentRange& range, const QString& text); // Also releases it
+    void replaceText(int start, int end, const QString& text);
+    void releaseRange(const DocumentRange& range);
+    void dropRanges();
+    
+    static const int LARGE_DOCUMENT_THRESHOLD;
+    static const int SPECULATION_IDLE_INTERVAL;
+    static const int SPECULATION_MIN_EDIT;
+    static const int TOKEN_COUNT_LIMIT;
+    static const int TOKEN_COUNT_CHARACTERS;
+    static bool speculativeExecution;
+    static bool streaming;
+    static bool journal;
     
     // Input handling
     void clearCommand();
@@ -0,0 +1,234 @@
+#include "piecetable.h"
+#include <algorithm>
+
+PieceTable::PieceTable()
+    : totalLength(0)
+    , currentRevision(0)
+    , nextMark(1)
+{
+    lineStarts.append(0);
+}
+
+void PieceTable::setText(const QString& text)
+{
+    original = text;
+    added.clear();
+    pieces.clear();
+    pieceOffsets.clear();
+    if (!original.isEmpty()) {
+        pieces.append({Original, 0, int(original.size())});
+        pieceOffsets.append(0);
+    }
+    totalLength = int(original.size());
+
+    // The only full scan of the text
+    lineStarts.clear();
+    lineStarts.append(0);
+    const QChar* data = original.constData();
+    for (int i = 0; i < totalLength; ++i) {
+        if (data[i] == QLatin1Char('\n')) {
+            lineStarts.append(i + 1);
+        }
+    }
+
+    for (MarkData& mark : marks) {
+        mark.position = 0;
+    }
+    ++currentRevision;
+}
+
+int PieceTable::pieceAt(int position) const
+{
+    auto it = std::upper_bound(pieceOffsets.constBegin(), pieceOffsets.constEnd(), position);
+    return int(it - pieceOffsets.constBegin()) - 1;
+}
+
+void PieceTable::updateOffsets(int fromPiece)
+{
+    pieceOffsets.resize(pieces.size());
+    int offset = fromPiece > 0 ? pieceOffsets[fromPiece - 1] + pieces[fromPiece - 1].length : 0;
+    for (int i = qMax(0, fromPiece); i < pieces.size(); ++i) {
+        pieceOffsets[i] = offset;
+        offset += pieces[i].length;
+    }
+}
+
+QChar PieceTable::at(int position) const
+{
+    if (position < 0 || position >= totalLength) {
+        return QChar();
+    }
+    int index = pieceAt(position);
+    const Piece& piece = pieces[index];
+    return buffer(piece.source).at(piece.start + position - pieceOffsets[index]);
+}
+
+QVector<QStringView> PieceTable::spans(int position, int length) const
+{
+    QVector<QStringView> result;
+    position = qBound(0, position, totalLength);
+    length = qBound(0, length, totalLength - position);
+    if (length == 0) {
+        return result;
+    }
+
+    int end = position + length;
+    for (int i = pieceAt(position); i < pieces.size() && pieceOffsets[i] < end; ++i) {
+        const Piece& piece = pieces[i];
+        int from = qMax(position, pieceOffsets[i]) - pieceOffsets[i];
+        int to = qMin(end, pieceOffsets[i] + piece.length) - pieceOffsets[i];
+        result.append(QStringView(buffer(piece.source)).mid(piece.start + from, to - from));
+    }
+    return result;
+}
+
+QString PieceTable::text(int position, int length) const
+{
+    // The whole loaded text, unedited: share it instead of copying
+    if (position == 0 && length == totalLength && pieces.size() == 1 && pieces[0].source == Original
+            && pieces[0].length == original.size()) {
+        return original;
+    }
+
+    QString result;
+    const QVector<QStringView> parts = spans(position, length);
+    result.reserve(length);
+    for (QStringView part : parts) {
+        result.append(part.data(), int(part.size()));
+    }
+    return result;
+}
+
+int PieceTable::lineAt(int position) const
+{
+    auto it = std::upper_bound(lineStarts.constBegin(), lineStarts.constEnd(), position);
+    return qMax(0, int(it - lineStarts.constBegin()) - 1);
+}
+
+int PieceTable::lineLength(int line) const
+{
+    int end = line + 1 < lineStarts.size() ? lineStarts[line + 1] - 1 : totalLength;
+    return end - lineStarts[line];
+}
+
+void PieceTable::insert(int position, const QString& text)
+{
+    if (text.isEmpty()) {
+        return;
+    }
+    position = qBound(0, position, totalLength);
+    const int length = int(text.size());
+    const int addedStart = int(added.size());
+    added.append(text);
+
+    int index = pieces.isEmpty() ? 0 : pieceAt(position);
+    bool atPieceStart = index >= pieces.size() || index < 0 || pieceOffsets[index] == position;
+    if (position == totalLength) {
+        index = pieces.size();
+        atPieceStart = true;
+    }
+
+    if (atPieceStart) {
+        // Typing continues the previous insertion: grow that piece
+        Piece* previous = index > 0 ? &pieces[index - 1] : nullptr;
+        if (previous && previous->source == Added && previous->start + previous->length == addedStart) {
+            previous->length += length;
+            updateOffsets(index);
+        } else {
+            pieces.insert(index, {Added, addedStart, length});
+            updateOffsets(index);
+        }
+    } else {
+        // Split the piece around the new text
+        Piece left = pieces[index];
+        int split = position - pieceOffsets[index];
+        Piece right = {left.source, left.start + split, left.length - split};
+        left.length = split;
+        pieces[index] = left;
+        pieces.insert(index + 1, {Added, addedStart, length});
+        pieces.insert(index + 2, right);
+        updateOffsets(index);
+    }
+    totalLength += length;
+
+    // Line index: shift the following lines, then add the new ones
+    int line = lineAt(position);
+    for (int i = line + 1; i < lineStarts.size(); ++i) {
+        lineStarts[i] += length;
+    }
+    QVector<int> newStarts;
+    for (int i = 0; i < length; ++i) {
+        if (text[i] == QLatin1Char('\n')) {
+            newStarts.append(position + i + 1);
+        }
+    }
+    if (!newStarts.isEmpty()) {
+        lineStarts.insert(line + 1, newStarts.size(), 0);
+        std::copy(newStarts.constBegin(), newStarts.constEnd(), lineStarts.begin() + line + 1);
+    }
+
+    for (MarkData& mark : marks) {
+        if (mark.position > position || (mark.position == position && mark.gravity == MoveAfter)) {
+            mark.position += length;
+        }
+    }
+    ++currentRevision;
+}
+
+void PieceTable::remove(int position, int length)
+{
+    position = qBound(0, position, totalLength);
+    length = qBound(0, length, totalLength - position);
+    if (length == 0) {
+        return;
+    }
+    const int end = position + length;
+
+    // Replace the pieces overlapping [position, end) with what is left of them
+    int first = pieceAt(position);
+    int last = pieceAt(end - 1);
+    QVector<Piece> remainder;
+    const Piece& head = pieces[first];
+    if (position > pieceOffsets[first]) {
+        remainder.append({head.source, head.start, position - pieceOffsets[first]});
+    }
+    const Piece& tail = pieces[last];
+    int tailEnd = pieceOffsets[last] + tail.length;
+    if (end < tailEnd) {
+        int cut = end - pieceOffsets[last];
+        remainder.append({tail.source, tail.start + cut, tail.length - cut});
+    }
+    pieces.remove(first, last - first + 1);
+    for (int i = 0; i < remainder.size(); ++i) {
+        pieces.insert(first + i, remainder[i]);
+    }
+    updateOffsets(first);
+    totalLength -= length;
+
+    // Line starts inside the removed range go, later ones move back
+    auto from = std::upper_bound(lineStarts.begin(), lineStarts.end(), position);
+    auto to = std::upper_bound(from, lineStarts.end(), end);
+    for (auto it = to; it != lineStarts.end(); ++it) {
+        *it -= length;
+    }
+    lineStarts.erase(from, to);
+
+    for (MarkData& mark : marks) {
+        if (mark.position > end) {
+            mark.position -= length;
+        } else if (mark.position > position) {
+            mark.position = position;
+        }
+    }
+    ++currentRevision;
+}
+
+PieceTable::Mark PieceTable::createMark(int position, Gravity gravity)
+{
+    Mark mark = nextMark++;
+    MarkData data;
+    data.position = qBound(0, position, totalLength);
+    data.gravity = gravity;
+    marks.insert(mark, data);
+    return mark;
+}
@@ -0,0 +1,91 @@
+#ifndef PIECETABLE_H
+#define PIECETABLE_H
+
+#include <QString>
+#include <QStringView>
+#include <QVector>
+#include <QHash>
+
+// Text buffer for very large documents. The loaded text is kept as one
+// immutable string and everything typed or inserted goes to an append-only
+// buffer; the document is a sequence of pieces referring into the two, so an
+// edit costs O(pieces + lines) no matter how big the text is and never copies
+// it. A line index is maintained alongside for viewport-only layout.
+//
+// Marks are positions that move with edits, like QTextCursor positions.
+class PieceTable
+{
+public:
+    enum Gravity {
+        StayBefore, // Text inserted at the mark goes after it
+        MoveAfter   // Text inserted at the mark goes before it
+    };
+
+    typedef int Mark;
+
+    PieceTable();
+
+    void setText(const QString& text); // Shares the string, no copy
+    void clear() { setText(QString()); }
+
+    int length() const { return totalLength; }
+    bool isEmpty() const { return totalLength == 0; }
+    quint64 revision() const { return currentRevision; } // Bumped on every change
+
+    // Copies of a range, with a single allocation
+    QString text() const { return text(0, totalLength); }
+    QString text(int position, int length) const;
+    QChar at(int position) const;
+
+    // The range as views into the buffers, without copying. Valid until the
+    // next change.
+    QVector<QStringView> spans(int position, int length) const;
+
+    void insert(int position, const QString& text);
+    void remove(int position, int length);
+    void append(const QString& text) { insert(totalLength, text); }
+
+    // Lines, split at '\n'; a document always has at least one
+    int lineCount() const { return lineStarts.size(); }
+    int lineAt(int position) const;
+    int lineStart(int line) const { return lineStarts[line]; }
+    int lineLength(int line) const; // Without the line break
+    QString line(int line) const { return text(lineStart(line), lineLength(line)); }
+
+    Mark createMark(int position, Gravity gravity = StayBefore);
+    int markPosition(Mark mark) const { return marks.value(mark).position; }
+    void removeMark(Mark mark) { marks.remove(mark); }
+
+private:
+    enum Source : quint8 {
+        Original,
+        Added
+    };
+
+    struct Piece {
+        Source source;
+        int start;
+        int length;
+    };
+
+    struct MarkData {
+        int position = 0;
+        Gravity gravity = StayBefore;
+    };
+
+    const QString& buffer(Source source) const { return source == Original ? original : added; }
+    int pieceAt(int position) const; // Index of the piece holding position
+    void updateOffsets(int fromPiece);
+
+    QString original;
+    QString added;
+    QVector<Piece> pieces;
+    QVector<int> pieceOffsets; // Document offset of each piece
+    QVector<int> lineStarts;
+    int totalLength;
+    quint64 currentRevision;
+    QHash<Mark, MarkData> marks;
+    Mark nextMark;
+};
+
+#endif // PIECETABLE_H
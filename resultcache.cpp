@@ -0,0 +1,178 @@
+#include "resultcache.h"
+#include <QCryptographicHash>
+#include <QJsonDocument>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QDebug>
+
+const int ResultCache::DEFAULT_CAPACITY = 64;
+const int ResultCache::MAX_DISK_ENTRIES = 512;
+
+ResultCache::ResultCache(int capacity)
+    : capacity(qMax(1, capacity))
+    , diskEntries(0)
+{
+}
+
+QString ResultCache::makeKey(const QString& baseCommand, const QJsonObject& args, const QString& text,
+                             const QString& producer)
+{
+    // QJsonObject keeps its keys sorted, so equal arguments always serialise the same way
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(baseCommand.toUtf8());
+    hash.addData(QByteArray(1, '\0'));
+    hash.addData(QJsonDocument(args).toJson(QJsonDocument::Compact));
+    hash.addData(QByteArray(1, '\0'));
+    hash.addData(producer.toUtf8());
+    hash.addData(QByteArray(1, '\0'));
+
+    // Hash the UTF-16 buffer directly instead of converting the whole document
+    hash.addData(QByteArray::fromRawData(reinterpret_cast<const char*>(text.constData()),
+                                         text.size() * int(sizeof(QChar))));
+
+    return QString::fromLatin1(hash.result().toHex());
+}
+
+bool ResultCache::lookup(const QString& key, QString& value)
+{
+    auto it = index.find(key);
+    if (it != index.end()) {
+        // Move to the front of the LRU list
+        entries.splice(entries.begin(), entries, it.value());
+        value = entries.front().second;
+        counters.hits++;
+        return true;
+    }
+
+    if (isPersistent() && readFromDisk(key, value)) {
+        insertInMemory(key, value);
+        counters.hits++;
+        counters.diskHits++;
+        return true;
+    }
+
+    counters.misses++;
+    return false;
+}
+
+bool ResultCache::contains(const QString& key) const
+{
+    return index.contains(key) || (isPersistent() && QFile::exists(diskPath(key)));
+}
+
+void ResultCache::insert(const QString& key, const QString& value)
+{
+    insertInMemory(key, value);
+
+    if (isPersistent()) {
+        writeToDisk(key, value);
+    }
+}
+
+void ResultCache::insertInMemory(const QString& key, const QString& value)
+{
+    auto it = index.find(key);
+    if (it != index.end()) {
+        it.value()->second = value;
+        entries.splice(entries.begin(), entries, it.value());
+        return;
+    }
+
+    entries.emplace_front(key, value);
+    index.insert(key, entries.begin());
+
+    while (index.size() > capacity) {
+        index.remove(entries.back().first);
+        entries.pop_back();
+        counters.evictions++;
+    }
+}
+
+void ResultCache::clear()
+{
+    entries.clear();
+    index.clear();
+    if (isPersistent()) {
+        pruneDisk(0);
+    }
+}
+
+void ResultCache::setCapacity(int newCapacity)
+{
+    capacity = qMax(1, newCapacity);
+    while (index.size() > capacity) {
+        index.remove(entries.back().first);
+        entries.pop_back();
+        counters.evictions++;
+    }
+}
+
+void ResultCache::setPersistentDirectory(const QString& path)
+{
+    persistentDirectory = path;
+    if (path.isEmpty()) {
+        return;
+    }
+
+    if (!QDir().mkpath(path)) {
+        qWarning() << "ResultCache: Could not create cache directory" << path << "- persistence disabled";
+        persistentDirectory.clear();
+        return;
+    }
+
+    diskEntries = QDir(path).entryList({"*.txt"}, QDir::Files).size();
+    pruneDisk(MAX_DISK_ENTRIES);
+    qDebug() << "ResultCache: Persistent tier enabled at" << path;
+}
+
+QString ResultCache::diskPath(const QString& key) const
+{
+    return persistentDirectory + "/" + key + ".txt";
+}
+
+bool ResultCache::readFromDisk(const QString& key, QString& value) const
+{
+    QFile file(diskPath(key));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    value = QString::fromUtf8(file.readAll());
+    return true;
+}
+
+void ResultCache::writeToDisk(const QString& key, const QString& value)
+{
+    // QSaveFile keeps readers from ever seeing a half-written entry
+    bool added = !QFile::exists(diskPath(key));
+    QSaveFile file(diskPath(key));
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "ResultCache: Could not write cache entry" << key;
+        return;
+    }
+
+    file.write(value.toUtf8());
+    if (file.commit()) {
+        counters.diskWrites++;
+        diskEntries += added ? 1 : 0;
+    }
+    
+    // Pruned to three quarters so the directory isn't listed on every write
+    if (diskEntries > MAX_DISK_ENTRIES) {
+        pruneDisk(MAX_DISK_ENTRIES * 3 / 4);
+    }
+}
+
+void ResultCache::pruneDisk(int keep)
+{
+    // Keep the newest entries, drop the rest
+    QDir dir(persistentDirectory);
+    QFileInfoList files = dir.entryInfoList({"*.txt"}, QDir::Files, QDir::Time);
+    for (int i = keep; i < files.size(); ++i) {
+        QFile::remove(files[i].absoluteFilePath());
+        counters.evictions++;
+    }
+    diskEntries = qMin(keep, int(files.size()));
+}
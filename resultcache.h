@@ -0,0 +1,70 @@
+#ifndef RESULTCACHE_H
+#define RESULTCACHE_H
+
+#include <QString>
+#include <QHash>
+#include <QJsonObject>
+#include <list>
+#include <utility>
+
+// Content-addressed cache of command results. Keys are derived from the
+// base command, its parsed arguments, the model and engine producing the
+// result and the input text, so an unchanged document run through the same
+// command never goes back to the server.
+// Entries live in an in-memory LRU and, optionally, in a directory on disk
+// that survives restarts.
+class ResultCache
+{
+public:
+    struct Stats {
+        quint64 hits = 0;
+        quint64 misses = 0;
+        quint64 evictions = 0;
+        quint64 diskHits = 0;
+        quint64 diskWrites = 0;
+    };
+
+    explicit ResultCache(int capacity = DEFAULT_CAPACITY);
+
+    // producer names the model and engine; empty for output that doesn't depend on them
+    static QString makeKey(const QString& baseCommand, const QJsonObject& args, const QString& text,
+                           const QString& producer = QString());
+
+    // Lookups update the LRU order and the hit/miss counters
+    bool lookup(const QString& key, QString& value);
+    bool contains(const QString& key) const;
+    void insert(const QString& key, const QString& value);
+    void clear(); // Both tiers
+
+    void setCapacity(int capacity);
+    int getCapacity() const { return capacity; }
+    int size() const { return index.size(); }
+
+    // Persistent tier; an empty path disables it
+    void setPersistentDirectory(const QString& path);
+    bool isPersistent() const { return !persistentDirectory.isEmpty(); }
+
+    const Stats& stats() const { return counters; }
+
+    static const int DEFAULT_CAPACITY;
+
+private:
+    typedef std::list<std::pair<QString, QString>> EntryList;
+
+    void insertInMemory(const QString& key, const QString& value);
+    bool readFromDisk(const QString& key, QString& value) const;
+    void writeToDisk(const QString& key, const QString& value);
+    void pruneDisk(int keep);
+    QString diskPath(const QString& key) const;
+
+    EntryList entries; // Most recently used first
+    QHash<QString, EntryList::iterator> index;
+    int capacity;
+    QString persistentDirectory;
+    int diskEntries; // Files in the persistent directory, counted when it is set
+    Stats counters;
+
+    static const int MAX_DISK_ENTRIES;
+};
+
+#endif // RESULTCACHE_H
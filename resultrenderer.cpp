@@ -0,0 +1,75 @@
+#include "resultrenderer.h"
+#include <QtConcurrent>
+
+const int ResultRenderer::BACKGROUND_THRESHOLD = 16 * 1024; // Characters of output and original together
+
+ResultRenderer::ResultRenderer(QObject *parent)
+    : QObject(parent)
+{
+}
+
+void ResultRenderer::submit(Job job)
+{
+    // Nothing ahead of it and little to do: no point in a round trip through the pool
+    if (pending.isEmpty() && job.output.size() + job.original.size() < BACKGROUND_THRESHOLD) {
+        emit resultReady(prepare(std::move(job)));
+        return;
+    }
+
+    auto watcher = new QFutureWatcher<Result>(this);
+    connect(watcher, &QFutureWatcher<Result>::finished, this, &ResultRenderer::deliverFinished);
+    pending.append(watcher);
+    watcher->setFuture(QtConcurrent::run([job = std::move(job)]() {
+        return prepare(job);
+    }));
+}
+
+void ResultRenderer::deliverFinished()
+{
+    // A result that finishes early waits for the ones submitted before it
+    while (!pending.isEmpty() && pending.first()->isFinished()) {
+        QFutureWatcher<Result>* watcher = pending.takeFirst();
+        Result result = watcher->result();
+        watcher->deleteLater();
+        emit resultReady(result);
+    }
+}
+
+ResultRenderer::Result ResultRenderer::prepare(Job job)
+{
+    Result result;
+    if (job.output.contains(QLatin1Char('\r'))) {
+        job.output.replace(QLatin1String("\r\n"), QLatin1String("\n"));
+        job.output.replace(QLatin1Char('\r'), QLatin1Char('\n'));
+    }
+    result.job = std::move(job);
+
+    const QString& output = result.job.output;
+    const QString& original = result.job.original;
+    if (original.isEmpty()) {
+        return result;
+    }
+
+    // Common prefix and suffix; the cut never falls inside a surrogate pair
+    const int shorter = qMin(output.size(), original.size());
+    int prefix = 0;
+    while (prefix < shorter && output[prefix] == original[prefix]) {
+        ++prefix;
+    }
+    if (prefix > 0 && prefix < shorter && output[prefix - 1].isHighSurrogate()) {
+        --prefix;
+    }
+
+    int suffix = 0;
+    while (suffix < shorter - prefix
+           && output[output.size() - 1 - suffix] == original[original.size() - 1 - suffix]) {
+        ++suffix;
+    }
+    if (suffix > 0 && suffix < shorter - prefix && output[output.size() - suffix].isLowSurrogate()) {
+        --suffix;
+    }
+
+    result.commonPrefix = prefix;
+    result.commonSuffix = suffix;
+    return result;
+}
@@ -0,0 +1,56 @@
+#ifndef RESULTRENDERER_H
+#define RESULTRENDERER_H
+
+#include <QObject>
+#include <QString>
+#include <QList>
+#include <QFutureWatcher>
+#include "commandmanager.h"
+
+// Prepares command results for the editor off the GUI thread: line endings
+// are normalised, and a rewrite is diffed against the text it replaces so
+// only the changed middle has to be spliced into the document. Short results
+// are prepared in place; longer ones go to the thread pool. Results are
+// handed back in the order they were submitted, so appended results keep the
+// order their commands finished in.
+class ResultRenderer : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Job {
+        CommandManager::Ticket ticket = 0;
+        QString command;
+        QString output;
+        QString original; // Text the output replaces, empty when it is inserted
+    };
+
+    struct Result {
+        Job job;
+        int commonPrefix = 0; // Characters the output shares with the original at the start
+        int commonSuffix = 0; // ...and at the end, not overlapping the prefix
+        QString replacement() const
+        {
+            return job.output.mid(commonPrefix, job.output.size() - commonPrefix - commonSuffix);
+        }
+    };
+
+    explicit ResultRenderer(QObject *parent = nullptr);
+
+    void submit(Job job);
+    int pendingCount() const { return pending.size(); }
+
+    static Result prepare(Job job);
+
+signals:
+    void resultReady(const ResultRenderer::Result& result);
+
+private:
+    void deliverFinished();
+
+    QList<QFutureWatcher<Result>*> pending; // In submission order
+
+    static const int BACKGROUND_THRESHOLD;
+};
+
+#endif // RESULTRENDERER_H
@@ -1,24 +1,50 @@
 #include "servermanager.h"
+#include "servertransport.h"
+#include "backenddaemon.h"
+#include "tracer.h"
 #include <QDebug>
+#include <QFutureWatcher>
 #include <QTimer>
+#include <QtConcurrent>
 #include <QNetworkRequest>
+#include <QRandomGenerator>
+#include <memory>
 
 const QString ServerManager::SERVER_BASE_URL = "http://127.0.0.1:5000";
-const int ServerManager::HEALTH_CHECK_INTERVAL = 1000; // 1 second for more responsive feedback
+const int ServerManager::HEALTH_CHECK_INTERVAL = 1000; // While connecting or loading, for responsive feedback
+const int ServerManager::IDLE_HEALTH_CHECK_INTERVAL = 15000; // Once connected, and only without other traffic; keep below the daemon's CLIENT_LEASE
+const int ServerManager::HEALTH_CHECK_TIMEOUT = 5000;
 const int ServerManager::REQUEST_TIMEOUT = 30000; // 30 seconds for AI model processing
-const int ServerManager::MAX_RETRY_ATTEMPTS = 15; // 15 attempts = 15 seconds total
+const int ServerManager::DEADLINE_GRACE = 2000;
+const int ServerManager::MAX_RETRY_ATTEMPTS = 15; // 15 attempts = 15 seconds for the backend to start
+const int ServerManager::BREAKER_FAILURE_THRESHOLD = 3;
+const int ServerManager::MIN_BACKOFF = 1000;
+const int ServerManager::MAX_BACKOFF = 30000;
+const double ServerManager::BACKOFF_JITTER = 0.2; // +-20%, so editors sharing a daemon don't probe in lockstep
+const int ServerManager::WARM_CONNECTION_COUNT = 2; // Matches the busiest endpoint's concurrency
+const int ServerManager::BACKGROUND_PARSE_THRESHOLD = 64 * 1024; // Bytes; smaller bodies parse in well under a frame
 
 ServerManager::ServerManager(QObject *parent)
     : QObject(parent)
     , currentStatus(Disconnected)
     , currentHealthCheck(nullptr)
     , consecutiveFailures(0)
+    , monitoring(false)
+    , everConnected(false)
+    , breaker(BreakerClosed)
+    , breakerOpenings(0)
+    , recheckRequested(false)
+    , http2Enabled(false) // The bundled Flask backend only speaks HTTP/1.1
+    , piggybackHealth(true)
+    , transport(nullptr)
+    , nextRequestHandle(1)
+    , currentFailureStatus(0)
 {
     setupNetworkManager();
     
-    // Setup health check timer
+    // Setup health check timer; every probe schedules the next one
     healthCheckTimer = new QTimer(this);
-    healthCheckTimer->setSingleShot(false);
+    healthCheckTimer->setSingleShot(true);
     connect(healthCheckTimer, &QTimer::timeout, this, &ServerManager::performHealthCheck);
     
     qDebug() << "ServerManager: Initialized";
@@ -51,6 +77,11 @@ void ServerManager::setStatus(ServerStatus status)
         
         if (status == Connected) {
             consecutiveFailures = 0;
+            everConnected = true;
+            warmConnections();
+            if (transport) {
+                transport->open();
+            }
             emit serverReady();
         }
     }
@@ -59,24 +90,96 @@ void ServerManager::setStatus(ServerStatus status)
 void ServerManager::startHealthMonitoring()
 {
     qDebug() << "ServerManager: Starting health monitoring";
+    monitoring = true;
+    breaker = BreakerClosed;
+    breakerOpenings = 0;
+    consecutiveFailures = 0;
     setStatus(Connecting);
     
-    // Perform immediate health check
+    // Perform immediate health check; its reply schedules the next one
     performHealthCheck();
-    
-    // Start periodic health checks
-    healthCheckTimer->start(HEALTH_CHECK_INTERVAL);
 }
 
 void ServerManager::stopHealthMonitoring()
 {
     qDebug() << "ServerManager: Stopping health monitoring";
+    monitoring = false;
     healthCheckTimer->stop();
     
     if (currentHealthCheck) {
-        currentHealthCheck->abort();
+        // Not a failure of the server, so don't let the reply handler count it
+        QNetworkReply* probe = currentHealthCheck;
         currentHealthCheck = nullptr;
+        probe->disconnect(this);
+        probe->abort();
+        probe->deleteLater();
+    }
+}
+
+void ServerManager::scheduleHealthCheck()
+{
+    if (monitoring) {
+        healthCheckTimer->start(nextProbeDelay());
+    }
+}
+
+int ServerManager::nextProbeDelay() const
+{
+    if (breaker == BreakerOpen) {
+        // Exponential backoff with jitter
+        int exponent = qBound(0, breakerOpenings - 1, 5);
+        double delay = qMin(double(MAX_BACKOFF), double(MIN_BACKOFF) * (1 << exponent));
+        double jitter = 1.0 + BACKOFF_JITTER * (2.0 * QRandomGenerator::global()->generateDouble() - 1.0);
+        return int(delay * jitter);
+    }
+    
+    if (currentStatus == Connected) {
+        // Replies to requests count as probes; check only once traffic stops
+        if (piggybackHealth && lastSuccessfulTraffic.isValid()) {
+            return int(qMax(qint64(HEALTH_CHECK_INTERVAL), IDLE_HEALTH_CHECK_INTERVAL - lastSuccessfulTraffic.elapsed()));
+        }
+        return IDLE_HEALTH_CHECK_INTERVAL;
+    }
+    return HEALTH_CHECK_INTERVAL;
+}
+
+void ServerManager::recordFailure(const QString& reason)
+{
+    consecutiveFailures++;
+    
+    if (breaker == BreakerHalfOpen) {
+        openBreaker(reason); // The trial failed
+    } else if (breaker == BreakerClosed
+               && consecutiveFailures >= (everConnected ? BREAKER_FAILURE_THRESHOLD : MAX_RETRY_ATTEMPTS)) {
+        openBreaker(reason);
+    }
+}
+
+void ServerManager::openBreaker(const QString& reason)
+{
+    bool wasClosed = breaker == BreakerClosed;
+    breaker = BreakerOpen;
+    breakerOpenings++;
+    
+    int delay = nextProbeDelay();
+    qDebug() << "ServerManager: ❌ Circuit open after" << consecutiveFailures << "failures, next trial in" << delay << "ms";
+    setStatus(Error);
+    if (wasClosed) {
+        emit serverError(QString("Server unreachable after %1 attempts: %2").arg(consecutiveFailures).arg(reason));
+    }
+    if (monitoring) {
+        healthCheckTimer->start(delay);
+    }
+}
+
+void ServerManager::checkHealthNow()
+{
+    // A probe already in flight may predate whatever prompted this call
+    if (currentHealthCheck && currentHealthCheck->isRunning()) {
+        recheckRequested = true;
+        return;
     }
+    performHealthCheck();
 }
 
 void ServerManager::performHealthCheck()
@@ -87,26 +190,26 @@ void ServerManager::performHealthCheck()
         return;
     }
     
-    QUrl url(SERVER_BASE_URL + "/health");
-    QNetworkRequest request(url);
-    request.setRawHeader("User-Agent", "TexEdit-ServerManager");
-    request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
+    // Recent successful traffic already proves the server is up; only probe when idle
+    if (piggybackHealth && currentStatus == Connected && lastSuccessfulTraffic.isValid()
+        && lastSuccessfulTraffic.elapsed() < IDLE_HEALTH_CHECK_INTERVAL) {
+        scheduleHealthCheck();
+        return;
+    }
     
-    // Set reasonable timeout
-    request.setTransferTimeout(5000);
+    if (breaker == BreakerOpen) {
+        breaker = BreakerHalfOpen;
+        qDebug() << "ServerManager: Circuit half-open, sending trial probe";
+    }
+    
+    QNetworkRequest request = buildRequest("/health");
+    request.setRawHeader("User-Agent", "TexEdit-ServerManager");
+    request.setTransferTimeout(HEALTH_CHECK_TIMEOUT);
     
     currentHealthCheck = networkManager->get(request);
     
     connect(currentHealthCheck, &QNetworkReply::finished, 
             this, &ServerManager::handleHealthCheckResponse);
-    
-    // Backup timeout in case transfer timeout doesn't work
-    QTimer::singleShot(6000, this, [this]() {
-        if (currentHealthCheck && currentHealthCheck->isRunning()) {
-            qDebug() << "ServerManager: Health check timeout, aborting";
-            currentHealthCheck->abort();
-        }
-    });
 }
 
 void ServerManager::handleHealthCheckResponse()
@@ -119,7 +222,39 @@ void ServerManager::handleHealthCheckResponse()
     
     if (error == QNetworkReply::NoError) {
         // Health check successful
-        consecutiveFailures = 0;
+        markTraffic();
+        breakerOpenings = 0;
+        if (breaker != BreakerClosed) {
+            breaker = BreakerClosed;
+            qDebug() << "ServerManager: ✅ Circuit closed";
+        }
+        
+        // Backends that load their model in the background report readiness;
+        // older ones don't, and are ready as soon as they answer
+        QJsonObject health = QJsonDocument::fromJson(currentHealthCheck->readAll()).object();
+        updateBackendLoad(health.value("load").toObject());
+        updateCommandModels(health.value("commands").toObject());
+        engine = health.value("engine").toString();
+        if (!health.value("ready").toBool(true)) {
+            setStatus(Connecting);
+            emit loadProgress(health.value("stage").toString(),
+                              health.value("stage_message").toString(),
+                              health.value("load_progress").toDouble());
+            currentHealthCheck->deleteLater();
+            currentHealthCheck = nullptr;
+            if (recheckRequested) {
+                recheckRequested = false;
+                performHealthCheck();
+            } else {
+                scheduleHealthCheck();
+            }
+            return;
+        }
+        
+        // Reconnect the alternative transport if the backend restarted underneath it
+        if (transport && !transport->isAvailable()) {
+            transport->open();
+        }
         
         if (currentStatus != Connected) {
             qDebug() << "ServerManager: ✅ Server is healthy and ready";
@@ -127,82 +262,549 @@ void ServerManager::handleHealthCheckResponse()
         }
     } else {
         // Health check failed
-        consecutiveFailures++;
-        qDebug() << "ServerManager: ❌ Health check failed:" << currentHealthCheck->errorString() 
+        QString reason = currentHealthCheck->errorString();
+        recordFailure(reason);
+        qDebug() << "ServerManager: ❌ Health check failed:" << reason
                  << "(consecutive failures:" << consecutiveFailures << ")";
         
-        if (consecutiveFailures >= MAX_RETRY_ATTEMPTS) {
-            setStatus(Error);
-            emit serverError(QString("Server unreachable after %1 attempts: %2")
-                           .arg(MAX_RETRY_ATTEMPTS)
-                           .arg(currentHealthCheck->errorString()));
-        } else {
+        if (breaker == BreakerClosed) {
             setStatus(Connecting);
         }
     }
     
     currentHealthCheck->deleteLater();
     currentHealthCheck = nullptr;
+    recheckRequested = false;
+    if (!healthCheckTimer->isActive()) {
+        scheduleHealthCheck();
+    }
 }
 
-void ServerManager::makeRequest(const QString& endpoint, const QJsonObject& data,
+QString ServerManager::unavailableMessage() const
+{
+    if (breaker != BreakerClosed) {
+        // Fail fast while the circuit is open instead of waiting for a timeout
+        int seconds = qMax(1, (healthCheckTimer->remainingTime() + 999) / 1000);
+        return QString("Server unavailable, retrying connection in %1 s").arg(seconds);
+    }
+    return "Server not available for requests";
+}
+
+ServerManager::RequestHandle ServerManager::makeRequest(const QString& endpoint, const QJsonObject& data,
                                std::function<void(const QJsonObject&)> onSuccess,
-                               std::function<void(const QString&)> onError)
+                               std::function<void(const QString&)> onError, int timeout)
 {
     if (currentStatus != Connected) {
-        QString errorMsg = "Server not available for requests";
+        QString errorMsg = unavailableMessage();
         qWarning() << "ServerManager:" << errorMsg;
         if (onError) {
             onError(errorMsg);
         }
-        return;
+        return 0;
     }
     
+    auto aborted = std::make_shared<bool>(false);
+    
+    // Spans are recorded against the command that issued this request, if any
+    QString traceId = Tracer::currentRequestId();
+    
+    if (transport && transport->isAvailable()) {
+        RequestHandle handle = trackRequest(nullptr, aborted);
+        qint64 sent = Tracer::now();
+        sendThroughTransport(handle, endpoint, data, false, timeout,
+                             {nullptr, [this, handle, aborted, onSuccess = std::move(onSuccess), traceId, sent]
+                                       (const QJsonObject& response) {
+            if (*aborted) return;
+            activeRequests.remove(handle);
+            markTraffic();
+            Tracer::instance()->addSpan(traceId, "network", sent, Tracer::now());
+            Tracer::instance()->addServerTimings(traceId, response.value(QLatin1String("performance")).toObject());
+            if (onSuccess) {
+                onSuccess(response);
+            }
+        }, [this, handle, aborted, traceId, onError = std::move(onError)](const QString& error, int status) {
+            if (*aborted) return;
+            activeRequests.remove(handle);
+            if (status == ServerTransport::TimedOut) {
+                cancelOnServer(traceId); // Gave up waiting, as with HTTP
+                status = 0;
+            }
+            reportFailure(onError, error, status);
+        }});
+        return handle;
+    }
+    
+    QNetworkRequest request = buildRequest(endpoint, timeout);
+    
+    qint64 serialiseStart = Tracer::now();
+    QJsonDocument doc(data);
+    QByteArray requestData = doc.toJson(QJsonDocument::Compact);
+    qint64 sent = Tracer::now();
+    Tracer::instance()->addSpan(traceId, "serialise", serialiseStart, sent);
+    
+    QNetworkReply* reply = networkManager->post(request, requestData);
+    RequestHandle handle = trackRequest(reply, aborted);
+    
+    // The callbacks are moved into the handler, not copied
+    connect(reply, &QNetworkReply::finished, this, [this, reply, handle, aborted, traceId, sent,
+                                                     onSuccess = std::move(onSuccess), onError = std::move(onError)]() {
+        if (*aborted) {
+            reply->deleteLater();
+            return;
+        }
+        
+        readLoadHeader(reply);
+        if (reply->error() == QNetworkReply::NoError) {
+            markTraffic();
+            
+            Tracer::instance()->addSpan(traceId, "network", sent, Tracer::now());
+            deliverJsonReply(reply->readAll(), handle, traceId, aborted, onSuccess, onError);
+        } else {
+            activeRequests.remove(handle);
+            // Gave up waiting: the backend may still be generating for nobody
+            if (reply->error() == QNetworkReply::OperationCanceledError || reply->error() == QNetworkReply::TimeoutError) {
+                cancelOnServer(traceId);
+            }
+            handleRequestFailure(reply, onError);
+        }
+        
+        reply->deleteLater();
+    });
+    
+    return handle;
+}
+
+QNetworkRequest ServerManager::buildRequest(const QString& endpoint, int timeout) const
+{
     QUrl url(SERVER_BASE_URL + endpoint);
     QNetworkRequest request(url);
     request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
     request.setRawHeader("User-Agent", "TexEdit-Client");
-    request.setTransferTimeout(REQUEST_TIMEOUT);
+    request.setRawHeader("X-Texdit-Client", BackendDaemon::clientId().toUtf8()); // Counts as a shared daemon client
     
-    QJsonDocument doc(data);
-    QByteArray requestData = doc.toJson();
+    // Lets backend logs be matched with the client's trace of the command
+    QString requestId = Tracer::currentRequestId();
+    if (!requestId.isEmpty()) {
+        request.setRawHeader("X-Request-ID", requestId.toUtf8());
+    }
+    request.setTransferTimeout(replyTimeout(timeout));
+    
+    // Requests share the pooled keep-alive connections opened by warmConnections()
+    request.setAttribute(QNetworkRequest::Http2AllowedAttribute, http2Enabled);
+#if QT_VERSION >= QT_VERSION_CHECK(6, 3, 0)
+    request.setAttribute(QNetworkRequest::Http2CleartextAllowedAttribute, http2Enabled);
+#endif
+    return request;
+}
+
+int ServerManager::replyTimeout(int timeout)
+{
+    return timeout > 0 ? timeout + DEADLINE_GRACE : REQUEST_TIMEOUT;
+}
+
+void ServerManager::sendThroughTransport(RequestHandle handle, const QString& endpoint, const QJsonObject& data,
+                                         bool stream, int timeout, const ServerTransport::Handlers& handlers)
+{
+    ServerTransport::RequestId id = transport->send(endpoint, data, stream, replyTimeout(timeout), handlers);
+    // Not tracked any more if it failed synchronously
+    auto it = activeRequests.find(handle);
+    if (it != activeRequests.end()) {
+        it->transportRequest = id;
+    }
+}
+
+void ServerManager::setTransport(ServerTransport* newTransport)
+{
+    if (transport) {
+        transport->deleteLater();
+        for (ActiveRequest& request : activeRequests) {
+            request.transportRequest = 0; // Its ids mean nothing to the new transport
+        }
+    }
+    
+    transport = newTransport;
+    if (!transport) {
+        return;
+    }
+    
+    transport->setParent(this);
+    connect(transport, &ServerTransport::availabilityChanged, this, [this](bool available) {
+        qDebug() << "ServerManager: Requests now use" << (available ? transport->name() : QString("http"));
+    });
+    
+    if (currentStatus == Connected) {
+        transport->open();
+    }
+}
+
+QString ServerManager::activeTransportName() const
+{
+    return transport && transport->isAvailable() ? transport->name() : QString("http");
+}
+
+void ServerManager::warmConnections()
+{
+    // Pre-open pooled connections so the first command skips the TCP handshake
+    QUrl url(SERVER_BASE_URL);
+    for (int i = 0; i < WARM_CONNECTION_COUNT; ++i) {
+        networkManager->connectToHost(url.host(), url.port(80));
+    }
+    qDebug() << "ServerManager: Warmed" << WARM_CONNECTION_COUNT << "connections to" << url.host() << url.port();
+}
+
+void ServerManager::updateBackendLoad(const QJsonObject& report)
+{
+    // Backends without an inference scheduler don't report load
+    if (!report.contains("queued")) {
+        return;
+    }
+    
+    BackendLoad updated;
+    updated.queued = report.value("queued").toInt();
+    updated.running = report.value("running").toInt();
+    updated.workers = report.value("workers").toInt();
+    updated.maxBatchSize = report.value("max_batch_size").toInt();
+    if (updated.queued == load.queued && updated.running == load.running
+        && updated.workers == load.workers && updated.maxBatchSize == load.maxBatchSize) {
+        return;
+    }
+    
+    if (updated.isBusy() != load.isBusy()) {
+        qDebug() << "ServerManager: Backend" << (updated.isBusy() ? "busy" : "no longer busy") << "-"
+                 << updated.queued << "queued," << updated.running << "running on" << updated.workers << "workers";
+    }
+    load = updated;
+    emit backendLoadChanged();
+}
+
+void ServerManager::updateCommandModels(const QJsonObject& report)
+{
+    QHash<QString, CommandModel> updated;
+    for (auto it = report.constBegin(); it != report.constEnd(); ++it) {
+        QJsonObject entry = it.value().toObject();
+        updated.insert(it.key(), {entry.value("model").toString(), entry.value("state").toString()});
+    }
+    if (updated == commandModels) {
+        return;
+    }
+    
+    for (auto it = updated.constBegin(); it != updated.constEnd(); ++it) {
+        if (commandModels.value(it.key()).state != it->state) {
+            qDebug() << "ServerManager: Model" << it->model << "for" << it.key() << "is" << it->state;
+        }
+    }
+    commandModels = updated;
+    emit commandModelsChanged();
+}
+
+void ServerManager::readLoadHeader(QNetworkReply* reply)
+{
+    QByteArray header = reply->rawHeader("X-Texdit-Load");
+    if (!header.isEmpty()) {
+        updateBackendLoad(QJsonDocument::fromJson(header).object());
+    }
+}
+
+void ServerManager::markTraffic()
+{
+    // Any reply proves the server is alive
+    lastSuccessfulTraffic.start();
+    consecutiveFailures = 0;
+}
+
+void ServerManager::handleRequestFailure(QNetworkReply* reply, const std::function<void(const QString&)>& onError)
+{
+    // Handle network error
+    QString errorMsg = QString("Network error: %1").arg(reply->errorString());
+    qWarning() << "ServerManager:" << errorMsg;
+    
+    // An HTTP error status still means the backend answered; only failures to
+    // reach it count towards opening the circuit
+    int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    if (status > 0) {
+        markTraffic();
+    } else {
+        recordFailure(reply->errorString());
+        if (breaker == BreakerClosed && monitoring) {
+            // Confirm now rather than at the next idle probe
+            lastSuccessfulTraffic.invalidate();
+            checkHealthNow();
+        }
+    }
+    
+    reportFailure(onError, errorMsg, status);
+}
+
+void ServerManager::reportFailure(const std::function<void(const QString&)>& onError, const QString& error, int status)
+{
+    if (!onError) {
+        return;
+    }
+    currentFailureStatus = status;
+    onError(error);
+    currentFailureStatus = 0;
+}
+
+ServerManager::RequestHandle ServerManager::makeStreamingRequest(const QString& endpoint, const QJsonObject& data,
+                                         std::function<void(const QJsonObject&)> onChunk,
+                                         std::function<void(const QJsonObject&)> onSuccess,
+                                         std::function<void(const QString&)> onError, int timeout)
+{
+    if (currentStatus != Connected) {
+        QString errorMsg = unavailableMessage();
+        qWarning() << "ServerManager:" << errorMsg;
+        if (onError) {
+            onError(errorMsg);
+        }
+        return 0;
+    }
+    
+    auto aborted = std::make_shared<bool>(false);
+    QString traceId = Tracer::currentRequestId();
+    
+    if (transport && transport->isAvailable()) {
+        RequestHandle handle = trackRequest(nullptr, aborted);
+        qint64 sent = Tracer::now();
+        sendThroughTransport(handle, endpoint, data, true, timeout, {[aborted, onChunk](const QJsonObject& chunk) {
+            if (!*aborted && onChunk) {
+                onChunk(chunk);
+            }
+        }, [this, handle, aborted, onSuccess, traceId, sent](const QJsonObject& response) {
+            if (*aborted) return;
+            activeRequests.remove(handle);
+            markTraffic();
+            Tracer::instance()->addSpan(traceId, "network", sent, Tracer::now());
+            Tracer::instance()->addServerTimings(traceId, response.value("performance").toObject());
+            if (onSuccess) {
+                onSuccess(response);
+            }
+        }, [this, handle, aborted, traceId, onError](const QString& error, int status) {
+            if (*aborted) return;
+            activeRequests.remove(handle);
+            if (status == ServerTransport::TimedOut) {
+                cancelOnServer(traceId);
+                status = 0;
+            }
+            reportFailure(onError, error, status);
+        }});
+        return handle;
+    }
+    
+    QNetworkRequest request = buildRequest(endpoint, timeout);
+    request.setRawHeader("Accept", "application/x-ndjson");
+    
+    QJsonObject payload = data;
+    payload["stream"] = true;
+    
+    qint64 serialiseStart = Tracer::now();
+    QByteArray requestData = QJsonDocument(payload).toJson(QJsonDocument::Compact);
+    qint64 sent = Tracer::now();
+    Tracer::instance()->addSpan(traceId, "serialise", serialiseStart, sent);
     
     QNetworkReply* reply = networkManager->post(request, requestData);
+    RequestHandle handle = trackRequest(reply, aborted);
     
-    connect(reply, &QNetworkReply::finished, this, [=]() {
-        if (reply->error() == QNetworkReply::NoError) {
-            // Parse successful response
-            QByteArray responseData = reply->readAll();
-            QJsonParseError parseError;
-            QJsonDocument responseDoc = QJsonDocument::fromJson(responseData, &parseError);
+    // Stream state shared between the readyRead and finished handlers
+    struct StreamState {
+        QByteArray pending;
+        QJsonObject finalResponse;
+        QString streamError;
+        bool completed = false;
+    };
+    auto state = std::make_shared<StreamState>();
+    
+    auto isStreaming = [reply]() {
+        return reply->header(QNetworkRequest::ContentTypeHeader).toString()
+               .startsWith("application/x-ndjson");
+    };
+    
+    auto processLine = [state, onChunk](const QByteArray& rawLine) {
+        QByteArray line = rawLine.trimmed();
+        if (line.isEmpty()) {
+            return;
+        }
+        
+        QJsonParseError parseError;
+        QJsonDocument lineDoc = QJsonDocument::fromJson(line, &parseError);
+        if (parseError.error != QJsonParseError::NoError || !lineDoc.isObject()) {
+            state->streamError = QString("Invalid stream chunk: %1").arg(parseError.errorString());
+            return;
+        }
+        
+        QJsonObject event = lineDoc.object();
+        QString type = event.value("type").toString();
+        if (type == "chunk") {
+            if (onChunk) {
+                onChunk(event);
+            }
+        } else if (type == "done") {
+            state->finalResponse = event;
+            state->completed = true;
+        } else if (type == "error") {
+            state->streamError = event.value("error").toString();
+        }
+    };
+    
+    connect(reply, &QNetworkReply::readyRead, this, [reply, state, aborted, isStreaming, processLine]() {
+        if (*aborted || !isStreaming()) {
+            return; // Buffered reply, parsed once finished
+        }
+        
+        state->pending.append(reply->readAll());
+        int newline;
+        while ((newline = state->pending.indexOf('\n')) >= 0) {
+            processLine(state->pending.left(newline));
+            state->pending.remove(0, newline + 1);
+        }
+    });
+    
+    connect(reply, &QNetworkReply::finished, this, [this, reply, handle, aborted, state, isStreaming, processLine, onSuccess, onError,
+                                                     traceId, sent]() {
+        if (*aborted) {
+            reply->deleteLater();
+            return;
+        }
+        
+        readLoadHeader(reply);
+        if (reply->error() != QNetworkReply::NoError) {
+            activeRequests.remove(handle);
+            if (reply->error() == QNetworkReply::OperationCanceledError || reply->error() == QNetworkReply::TimeoutError) {
+                cancelOnServer(traceId);
+            }
+            handleRequestFailure(reply, onError);
+            reply->deleteLater();
+            return;
+        }
+        
+        markTraffic();
+        
+        // Streamed replies are parsed as they arrive, so network covers the whole stream
+        Tracer::instance()->addSpan(traceId, "network", sent, Tracer::now());
+        
+        if (isStreaming()) {
+            activeRequests.remove(handle);
+            state->pending.append(reply->readAll());
+            processLine(state->pending);
+            state->pending.clear();
             
-            if (parseError.error == QJsonParseError::NoError && responseDoc.isObject()) {
+            if (state->completed) {
+                Tracer::instance()->addServerTimings(traceId, state->finalResponse.value("performance").toObject());
                 if (onSuccess) {
-                    onSuccess(responseDoc.object());
+                    onSuccess(state->finalResponse);
                 }
             } else {
-                QString errorMsg = QString("Invalid JSON response: %1").arg(parseError.errorString());
+                QString errorMsg = state->streamError.isEmpty()
+                                   ? QString("Stream ended before completion")
+                                   : state->streamError;
                 qWarning() << "ServerManager:" << errorMsg;
                 if (onError) {
                     onError(errorMsg);
                 }
             }
         } else {
-            // Handle network error
-            QString errorMsg = QString("Network error: %1").arg(reply->errorString());
-            qWarning() << "ServerManager:" << errorMsg;
-            
-            // If we get network errors, the server might be down
-            consecutiveFailures++;
-            if (consecutiveFailures >= MAX_RETRY_ATTEMPTS && currentStatus == Connected) {
-                setStatus(Error);
+            // Server answered with a regular JSON body
+            deliverJsonReply(reply->readAll(), handle, traceId, aborted, onSuccess, onError);
+        }
+        
+        reply->deleteLater();
+    });
+    
+    return handle;
+}
+
+void ServerManager::deliverJsonReply(const QByteArray& body, RequestHandle handle, const QString& traceId,
+                                     std::shared_ptr<bool> aborted,
+                                     std::function<void(const QJsonObject&)> onSuccess,
+                                     std::function<void(const QString&)> onError)
+{
+    struct Parsed {
+        QJsonDocument document;
+        QJsonParseError error;
+    };
+    
+    qint64 received = Tracer::now();
+    auto deliver = [this, handle, traceId, received, aborted, onSuccess = std::move(onSuccess), onError = std::move(onError)]
+                   (const Parsed& parsed) {
+        if (*aborted) {
+            return; // Aborted while it was being parsed
+        }
+        activeRequests.remove(handle);
+        Tracer::instance()->addSpan(traceId, "deserialise", received, Tracer::now());
+        
+        // The document shares the parsed data with every object handed on from here
+        if (parsed.error.error == QJsonParseError::NoError && parsed.document.isObject()) {
+            const QJsonObject response = parsed.document.object();
+            Tracer::instance()->addServerTimings(traceId, response.value(QLatin1String("performance")).toObject());
+            if (onSuccess) {
+                onSuccess(response);
             }
-            
+        } else {
+            QString errorMsg = QString("Invalid JSON response: %1").arg(parsed.error.errorString());
+            qWarning() << "ServerManager:" << errorMsg;
             if (onError) {
                 onError(errorMsg);
             }
         }
-        
-        reply->deleteLater();
+    };
+    
+    if (body.size() < BACKGROUND_PARSE_THRESHOLD) {
+        Parsed parsed;
+        parsed.document = QJsonDocument::fromJson(body, &parsed.error);
+        deliver(parsed);
+        return;
+    }
+    
+    // Big map-reduce and batch results would stall the editor for a few frames
+    auto watcher = new QFutureWatcher<Parsed>(this);
+    connect(watcher, &QFutureWatcher<Parsed>::finished, this, [watcher, deliver]() {
+        watcher->deleteLater();
+        deliver(watcher->result());
+    });
+    watcher->setFuture(QtConcurrent::run([body]() {
+        Parsed parsed;
+        parsed.document = QJsonDocument::fromJson(body, &parsed.error);
+        return parsed;
+    }));
+}
+
+ServerManager::RequestHandle ServerManager::trackRequest(QNetworkReply* reply, std::shared_ptr<bool> aborted)
+{
+    RequestHandle handle = nextRequestHandle++;
+    activeRequests.insert(handle, ActiveRequest{reply, std::move(aborted)});
+    return handle;
+}
+
+bool ServerManager::abortRequest(RequestHandle handle)
+{
+    auto it = activeRequests.find(handle);
+    if (it == activeRequests.end()) {
+        return false; // Already finished
+    }
+    
+    ActiveRequest request = it.value();
+    activeRequests.erase(it);
+    *request.aborted = true;
+    if (request.reply) {
+        request.reply->abort();
+    } else if (request.transportRequest != 0 && transport) {
+        transport->abort(request.transportRequest); // Frees its slot, the callbacks are dropped
+    }
+    
+    qDebug() << "ServerManager: Aborted request" << handle;
+    return true;
+}
+
+void ServerManager::cancelOnServer(const QString& requestId)
+{
+    if (requestId.isEmpty() || currentStatus != Connected) {
+        return;
+    }
+    
+    // Aborting the reply doesn't stop the model; this frees the backend for the next command
+    QJsonObject data;
+    data["request_id"] = requestId;
+    qDebug() << "ServerManager: Cancelling" << requestId << "on the server";
+    makeRequest("/api/cancel", data, nullptr, [requestId](const QString& error) {
+        qDebug() << "ServerManager: ❌ Cancel of" << requestId << "failed:" << error;
     });
 }
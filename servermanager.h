@@ -10,6 +10,11 @@
 #include <QJsonObject>
 #include <QJsonArray>
 #include <QUrl>
+#include <QElapsedTimer>
+#include <QPointer>
+#include <QHash>
+#include <memory>
+#include "servertransport.h"
 
 class ServerManager : public QObject
 {
@@ -23,24 +28,103 @@ public:
         Error
     };
 
+    // Identifies an outstanding request for abortRequest(); 0 means none
+    typedef quint64 RequestHandle;
+
+    // Circuit breaker over the backend connection. It opens after repeated
+    // connection failures; while open, requests fail immediately and probes
+    // back off exponentially. The next probe is a half-open trial that closes
+    // the breaker again if it succeeds.
+    enum BreakerState {
+        BreakerClosed,
+        BreakerOpen,
+        BreakerHalfOpen
+    };
+
+    // Load of the backend's inference queue, from /health and the
+    // X-Texdit-Load header of API replies; shared by every editor using it
+    struct BackendLoad {
+        int queued = -1; // Generations waiting for a worker, -1 until reported
+        int running = 0;
+        int workers = 0;
+        int maxBatchSize = 0;
+        bool isKnown() const { return queued >= 0; }
+        // A full batch is already waiting for every worker
+        bool isBusy() const { return isKnown() && queued >= qMax(1, workers) * qMax(1, maxBatchSize); }
+    };
+
+    // Model a command needs and its state, from /health. The backend loads
+    // models on first use, so only failed and missing ones can't be used.
+    struct CommandModel {
+        QString model; // Empty for commands without a model, and for older backends
+        QString state; // "unloaded", "loading", "ready", "failed" or "missing"
+        bool isUsable() const { return state != QLatin1String("failed") && state != QLatin1String("missing"); }
+        bool operator==(const CommandModel& other) const { return model == other.model && state == other.state; }
+    };
+
     explicit ServerManager(QObject *parent = nullptr);
     ~ServerManager();
 
     // Server status
     ServerStatus getStatus() const { return currentStatus; }
     bool isReady() const { return currentStatus == Connected; }
+    BreakerState breakerState() const { return breaker; }
+    const BackendLoad& backendLoad() const { return load; }
+    CommandModel commandModel(const QString& command) const { return commandModels.value(command); }
+    QString backendEngine() const { return engine; } // Inference engine from /health, empty until reported
+    
+    // Connection configuration
+    void setHttp2Enabled(bool enabled) { http2Enabled = enabled; }
+    bool isHttp2Enabled() const { return http2Enabled; }
+    void setPiggybackHealthEnabled(bool enabled) { piggybackHealth = enabled; }
+    bool isPiggybackHealthEnabled() const { return piggybackHealth; }
+    
+    // Alternative channel for API requests; HTTP is used whenever it is unavailable.
+    // The manager takes ownership.
+    void setTransport(ServerTransport* transport);
+    QString activeTransportName() const;
     
     // Server operations
     void startHealthMonitoring();
     void stopHealthMonitoring();
-    void makeRequest(const QString& endpoint, const QJsonObject& data, 
+    void checkHealthNow(); // E.g. when the backend reports it just became ready
+    // A timeout in milliseconds replaces REQUEST_TIMEOUT; the reply is given
+    // DEADLINE_GRACE on top of it to arrive after the backend's own deadline
+    RequestHandle makeRequest(const QString& endpoint, const QJsonObject& data, 
                     std::function<void(const QJsonObject&)> onSuccess,
-                    std::function<void(const QString&)> onError = nullptr);
+                    std::function<void(const QString&)> onError = nullptr,
+                    int timeout = 0);
+    
+    // Streaming request: the backend answers with NDJSON, each {"type": "chunk"}
+    // line is passed to onChunk as it arrives and the final {"type": "done"}
+    // line to onSuccess. Falls back to a buffered reply if the server doesn't stream.
+    RequestHandle makeStreamingRequest(const QString& endpoint, const QJsonObject& data,
+                              std::function<void(const QJsonObject&)> onChunk,
+                              std::function<void(const QJsonObject&)> onSuccess,
+                              std::function<void(const QString&)> onError = nullptr,
+                              int timeout = 0);
+    
+    // Aborts the network transfer if it is still running; none of the
+    // request's callbacks are invoked afterwards
+    bool abortRequest(RequestHandle handle);
+    bool isRequestActive(RequestHandle handle) const { return activeRequests.contains(handle); }
+    // While a request's onError runs: the HTTP status the backend answered it
+    // with, or 0 if the backend wasn't reached (outage, timeout, open circuit)
+    int failureStatus() const { return currentFailureStatus; }
+    
+    // Asks the backend to stop work on every request sent with this request
+    // ID (X-Request-ID / "request_id"); fire and forget
+    void cancelOnServer(const QString& requestId);
 
 signals:
     void statusChanged(ServerStatus status);
     void serverReady();
     void serverError(const QString& error);
+    void backendLoadChanged();
+    void commandModelsChanged();
+    
+    // The server is up but its model is still loading; progress is 0..1
+    void loadProgress(const QString& stage, const QString& message, double progress);
 
 private slots:
     void performHealthCheck();
@@ -48,7 +132,36 @@ private slots:
 
 private:
     void setStatus(ServerStatus status);
+    void scheduleHealthCheck();
+    int nextProbeDelay() const;
+    void recordFailure(const QString& reason);
+    void openBreaker(const QString& reason);
+    QString unavailableMessage() const;
     void setupNetworkManager();
+    QNetworkRequest buildRequest(const QString& endpoint, int timeout = 0) const;
+    static int replyTimeout(int timeout); // Milliseconds to wait for a reply, for HTTP and the transport
+    void sendThroughTransport(RequestHandle handle, const QString& endpoint, const QJsonObject& data,
+                              bool stream, int timeout, const ServerTransport::Handlers& handlers);
+    void warmConnections();
+    void markTraffic();
+    void updateBackendLoad(const QJsonObject& report);
+    void updateCommandModels(const QJsonObject& report);
+    void readLoadHeader(QNetworkReply* reply);
+    void handleRequestFailure(QNetworkReply* reply, const std::function<void(const QString&)>& onError);
+    void reportFailure(const std::function<void(const QString&)>& onError, const QString& error, int status);
+    // Parses a JSON reply body for onSuccess; large bodies are parsed on the thread pool.
+    // The request stays tracked, and abortable, until it is delivered.
+    void deliverJsonReply(const QByteArray& body, RequestHandle handle, const QString& traceId,
+                          std::shared_ptr<bool> aborted,
+                          std::function<void(const QJsonObject&)> onSuccess,
+                          std::function<void(const QString&)> onError);
+    
+    struct ActiveRequest {
+        QPointer<QNetworkReply> reply; // Null when sent through the transport
+        std::shared_ptr<bool> aborted;
+        ServerTransport::RequestId transportRequest = 0;
+    };
+    RequestHandle trackRequest(QNetworkReply* reply, std::shared_ptr<bool> aborted);
     
     QNetworkAccessManager* networkManager;
     QTimer* healthCheckTimer;
@@ -58,10 +171,34 @@ private:
     // Configuration
     static const QString SERVER_BASE_URL;
     static const int HEALTH_CHECK_INTERVAL;
+    static const int IDLE_HEALTH_CHECK_INTERVAL;
+    static const int HEALTH_CHECK_TIMEOUT;
     static const int REQUEST_TIMEOUT;
+    static const int DEADLINE_GRACE;
     static const int MAX_RETRY_ATTEMPTS;
+    static const int BREAKER_FAILURE_THRESHOLD;
+    static const int MIN_BACKOFF;
+    static const int MAX_BACKOFF;
+    static const double BACKOFF_JITTER;
+    static const int WARM_CONNECTION_COUNT;
+    static const int BACKGROUND_PARSE_THRESHOLD;
     
-    int consecutiveFailures;
+    int consecutiveFailures; // Connection failures of probes and requests, reset by any reply
+    bool monitoring;
+    bool everConnected; // Start-up gets MAX_RETRY_ATTEMPTS, later outages BREAKER_FAILURE_THRESHOLD
+    BreakerState breaker;
+    int breakerOpenings; // Since the last success; sets the backoff
+    BackendLoad load;
+    QHash<QString, CommandModel> commandModels;
+    QString engine;
+    bool recheckRequested; // checkHealthNow() arrived while a probe was already running
+    bool http2Enabled;
+    bool piggybackHealth;
+    QElapsedTimer lastSuccessfulTraffic; // Any successful reply proves the server is alive
+    ServerTransport* transport;
+    QHash<RequestHandle, ActiveRequest> activeRequests;
+    RequestHandle nextRequestHandle;
+    int currentFailureStatus;
 };
 
 #endif // SERVERMANAGER_H
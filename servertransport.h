@@ -0,0 +1,54 @@
+#ifndef SERVERTRANSPORT_H
+#define SERVERTRANSPORT_H
+
+#include <QObject>
+#include <QJsonObject>
+#include <QString>
+#include <functional>
+
+// A channel to the backend that can carry API requests instead of HTTP.
+// ServerManager routes requests through an installed transport while it is
+// available and falls back to HTTP otherwise; health checks always use HTTP.
+class ServerTransport : public QObject
+{
+    Q_OBJECT
+
+public:
+    // Identifies a sent request for abort(); 0 if it could not be sent
+    typedef quint32 RequestId;
+
+    // Error status of a request that got no reply within its timeout
+    enum { TimedOut = -1 };
+
+    struct Handlers {
+        std::function<void(const QJsonObject&)> onChunk; // Streamed requests only
+        std::function<void(const QJsonObject&)> onSuccess;
+        // status is what the backend answered with (HTTP codes), 0 if it wasn't
+        // reached and TimedOut if it didn't answer in time
+        std::function<void(const QString& error, int status)> onError;
+    };
+
+    explicit ServerTransport(QObject *parent = nullptr) : QObject(parent) {}
+    virtual ~ServerTransport() {}
+
+    virtual QString name() const = 0;
+    virtual bool isAvailable() const = 0;
+
+    // Connects if not already connected; a no-op while an attempt is pending
+    virtual void open() = 0;
+    virtual void close() = 0;
+
+    // data may carry the document as "text"; transports are free to move it
+    // outside the encoded request body. timeout is in milliseconds without a
+    // reply frame, as with QNetworkRequest's transfer timeout.
+    virtual RequestId send(const QString& endpoint, const QJsonObject& data, bool stream, int timeout,
+                           const Handlers& handlers) = 0;
+
+    // Forgets a request without calling its handlers and frees what it holds
+    virtual void abort(RequestId id) = 0;
+
+signals:
+    void availabilityChanged(bool available);
+};
+
+#endif // SERVERTRANSPORT_H
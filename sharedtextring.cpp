@@ -0,0 +1,127 @@
+#include "sharedtextring.h"
+#include <QDebug>
+#include <cstring>
+
+const qint64 SharedTextRing::DEFAULT_SIZE = 16 * 1024 * 1024; // Room for several book-length documents
+
+SharedTextRing::SharedTextRing(qint64 size)
+    : memory(nullptr)
+    , capacity(size)
+    , head(0)
+{
+}
+
+SharedTextRing::~SharedTextRing()
+{
+    close();
+}
+
+bool SharedTextRing::open(const QString& path)
+{
+    close();
+
+    file.setFileName(path);
+    if (!file.open(QIODevice::ReadWrite | QIODevice::Truncate)) {
+        qWarning() << "SharedTextRing: Could not create" << path << ":" << file.errorString();
+        return false;
+    }
+
+    // Owner-only, like the socket it travels alongside
+    file.setPermissions(QFileDevice::ReadOwner | QFileDevice::WriteOwner);
+
+    if (!file.resize(capacity) || !(memory = file.map(0, capacity))) {
+        qWarning() << "SharedTextRing: Could not map" << path << ":" << file.errorString();
+        file.close();
+        file.remove();
+        return false;
+    }
+
+    reset();
+    qDebug() << "SharedTextRing: Mapped" << capacity << "bytes at" << path;
+    return true;
+}
+
+void SharedTextRing::close()
+{
+    if (!isOpen()) {
+        return;
+    }
+
+    file.unmap(memory);
+    memory = nullptr;
+    file.close();
+    file.remove();
+    reset();
+}
+
+QString SharedTextRing::encoding()
+{
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+    return "utf-16-le";
+#else
+    return "utf-16-be";
+#endif
+}
+
+qint64 SharedTextRing::allocate(qint64 length) const
+{
+    if (length > capacity) {
+        return -1;
+    }
+    if (regions.isEmpty()) {
+        return 0;
+    }
+
+    qint64 tail = regions.first().offset;
+    if (head > tail) {
+        // Free space is after head and before tail; never split a region across the end
+        if (head + length <= capacity) {
+            return head;
+        }
+        return length <= tail ? 0 : -1;
+    }
+
+    // Wrapped: the only free space is between head and tail
+    return head + length <= tail ? head : -1;
+}
+
+qint64 SharedTextRing::write(quint32 owner, const QString& text)
+{
+    if (!isOpen()) {
+        return -1;
+    }
+
+    qint64 length = qint64(text.size()) * qint64(sizeof(QChar));
+    qint64 offset = allocate(length);
+    if (offset < 0) {
+        return -1;
+    }
+
+    std::memcpy(memory + offset, text.constData(), size_t(length));
+    regions.append({owner, offset, length, false});
+    head = offset + length;
+    return offset;
+}
+
+void SharedTextRing::release(quint32 owner)
+{
+    for (Region& region : regions) {
+        if (region.owner == owner) {
+            region.released = true;
+            break;
+        }
+    }
+
+    while (!regions.isEmpty() && regions.first().released) {
+        regions.removeFirst();
+    }
+    if (regions.isEmpty()) {
+        head = 0;
+    }
+}
+
+void SharedTextRing::reset()
+{
+    regions.clear();
+    head = 0;
+}
@@ -0,0 +1,53 @@
+#ifndef SHAREDTEXTRING_H
+#define SHAREDTEXTRING_H
+
+#include <QString>
+#include <QFile>
+#include <QList>
+
+// Ring buffer in a memory-mapped file shared with the backend process.
+// Large documents are copied into it as raw UTF-16 so only an offset and a
+// length travel over the socket. Regions are released when their request
+// completes; space is reclaimed from the oldest region forward.
+class SharedTextRing
+{
+public:
+    explicit SharedTextRing(qint64 size = DEFAULT_SIZE);
+    ~SharedTextRing();
+
+    bool open(const QString& path);
+    void close();
+    bool isOpen() const { return memory != nullptr; }
+
+    QString path() const { return file.fileName(); }
+    qint64 size() const { return capacity; }
+
+    // Name of the encoding the backend must use to decode ring contents
+    static QString encoding();
+
+    // Copies text into the ring on behalf of owner; returns the byte offset,
+    // or -1 when there is not enough free space
+    qint64 write(quint32 owner, const QString& text);
+    void release(quint32 owner);
+    void reset();
+
+    static const qint64 DEFAULT_SIZE;
+
+private:
+    struct Region {
+        quint32 owner;
+        qint64 offset;
+        qint64 length;
+        bool released;
+    };
+
+    qint64 allocate(qint64 length) const;
+
+    QFile file;
+    uchar* memory;
+    qint64 capacity;
+    qint64 head; // Next free byte after the newest region
+    QList<Region> regions; // Oldest first
+};
+
+#endif // SHAREDTEXTRING_H
@@ -0,0 +1,355 @@
+#include "tracer.h"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QDateTime>
+#include <QDebug>
+#include <QPair>
+#include <cmath>
+
+const int Tracer::MAX_TRACES = 500;
+const QString Tracer::TOTAL_STAGE = "total";
+
+namespace {
+const int BUCKETS_PER_OCTAVE = 8;
+const int OCTAVES = 40; // 1 µs up to about 12 days
+const qint64 BUCKET_BASE = 1000; // Nanoseconds
+
+QString currentId;
+
+QElapsedTimer& traceClock()
+{
+    static QElapsedTimer timer;
+    if (!timer.isValid()) {
+        timer.start();
+    }
+    return timer;
+}
+
+double toMilliseconds(qint64 nanoseconds)
+{
+    return nanoseconds / 1e6;
+}
+
+double toMicroseconds(qint64 nanoseconds)
+{
+    return nanoseconds / 1e3;
+}
+}
+
+LatencyHistogram::LatencyHistogram()
+    : buckets(BUCKETS_PER_OCTAVE * OCTAVES + 1, 0)
+    , total(0)
+    , largest(0)
+{
+}
+
+void LatencyHistogram::record(qint64 nanoseconds)
+{
+    int index = 0;
+    if (nanoseconds > BUCKET_BASE) {
+        index = int(std::log2(double(nanoseconds) / BUCKET_BASE) * BUCKETS_PER_OCTAVE) + 1;
+        index = qMin(index, int(buckets.size()) - 1);
+    }
+    buckets[index]++;
+    total++;
+    largest = qMax(largest, nanoseconds);
+}
+
+qint64 LatencyHistogram::percentile(double p) const
+{
+    if (total == 0) {
+        return 0;
+    }
+
+    qint64 rank = qMax<qint64>(1, qint64(std::ceil(p / 100.0 * total)));
+    qint64 seen = 0;
+    for (int i = 0; i < buckets.size(); ++i) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            qint64 upper = qint64(BUCKET_BASE * std::exp2(double(i) / BUCKETS_PER_OCTAVE));
+            return qMin(upper, largest);
+        }
+    }
+    return largest;
+}
+
+Tracer* Tracer::instance()
+{
+    static Tracer* tracer = new Tracer(QCoreApplication::instance());
+    return tracer;
+}
+
+Tracer::Tracer(QObject *parent)
+    : QObject(parent)
+{
+    traceClock();
+}
+
+qint64 Tracer::now()
+{
+    return traceClock().nsecsElapsed();
+}
+
+Tracer::Trace& Tracer::traceFor(const QString& requestId)
+{
+    auto it = traces.find(requestId);
+    if (it != traces.end()) {
+        return *it;
+    }
+
+    // Keep memory bounded: drop the oldest traces
+    while (traceOrder.size() >= MAX_TRACES) {
+        traces.remove(traceOrder.takeFirst());
+    }
+
+    traceOrder.append(requestId);
+    Trace& trace = traces[requestId];
+    trace.requestId = requestId;
+    trace.start = now();
+    return trace;
+}
+
+void Tracer::beginTrace(const QString& requestId, const QString& command, qint64 start)
+{
+    Trace& trace = traceFor(requestId);
+    trace.command = command;
+    trace.start = qMin(trace.start, start);
+}
+
+void Tracer::addSpan(const QString& requestId, const QString& name, qint64 start, qint64 end)
+{
+    if (requestId.isEmpty()) {
+        return;
+    }
+
+    Trace& trace = traceFor(requestId);
+    trace.spans.append({name, start, qMax<qint64>(0, end - start)});
+
+    // Spans of a finished trace go straight into the histograms
+    if (trace.finished && !trace.command.isEmpty()) {
+        record(trace.command, name, end - start);
+    }
+}
+
+void Tracer::finishTrace(const QString& requestId, bool ok)
+{
+    auto it = traces.find(requestId);
+    if (it == traces.end() || it->finished) {
+        return;
+    }
+
+    Trace& trace = *it;
+    trace.finished = true;
+    trace.ok = ok;
+    trace.end = now();
+
+    // Failed commands would skew the latency figures
+    if (ok && !trace.command.isEmpty()) {
+        for (const Span& span : trace.spans) {
+            record(trace.command, span.name, span.duration);
+        }
+        record(trace.command, TOTAL_STAGE, trace.end - trace.start);
+    }
+
+    emit traceFinished(requestId);
+}
+
+void Tracer::addServerTimings(const QString& requestId, const QJsonObject& performance)
+{
+    if (requestId.isEmpty() || performance.isEmpty()) {
+        return;
+    }
+
+    static const QList<QPair<QString, QString>> stages = {
+        {"tokenization_time", "server_tokenise"},
+        {"generation_time", "server_generate"},
+        {"decoding_time", "server_decode"}
+    };
+
+    QVector<QPair<QString, qint64>> timings;
+    qint64 serverTotal = 0;
+    for (const auto& stage : stages) {
+        if (performance.contains(stage.first)) {
+            qint64 duration = qint64(performance.value(stage.first).toDouble() * 1e9);
+            timings.append({stage.second, duration});
+            serverTotal += duration;
+        }
+    }
+    if (timings.isEmpty()) {
+        return;
+    }
+
+    // The backend's clock is not ours; centre its stages in the network span
+    Trace& trace = traceFor(requestId);
+    qint64 start = now() - serverTotal;
+    for (int i = trace.spans.size() - 1; i >= 0; --i) {
+        if (trace.spans[i].name == "network") {
+            start = trace.spans[i].start + qMax<qint64>(0, (trace.spans[i].duration - serverTotal) / 2);
+            break;
+        }
+    }
+
+    for (const auto& timing : timings) {
+        addSpan(requestId, timing.first, start, start + timing.second);
+        start += timing.second;
+    }
+}
+
+void Tracer::record(const QString& command, const QString& stage, qint64 duration)
+{
+    histograms[command][stage].record(duration);
+}
+
+QString Tracer::currentRequestId()
+{
+    return currentId;
+}
+
+Tracer::Scope::Scope(const QString& requestId)
+    : previous(currentId)
+{
+    currentId = requestId;
+}
+
+Tracer::Scope::~Scope()
+{
+    currentId = previous;
+}
+
+Tracer::ScopedSpan::ScopedSpan(const QString& requestId, const QString& name)
+    : requestId(requestId)
+    , name(name)
+    , start(Tracer::now())
+{
+}
+
+Tracer::ScopedSpan::~ScopedSpan()
+{
+    Tracer::instance()->addSpan(requestId, name, start, Tracer::now());
+}
+
+QList<Tracer::StageSummary> Tracer::summaries() const
+{
+    QList<StageSummary> result;
+    for (auto command = histograms.constBegin(); command != histograms.constEnd(); ++command) {
+        for (auto stage = command->constBegin(); stage != command->constEnd(); ++stage) {
+            const LatencyHistogram& histogram = stage.value();
+            result.append({command.key(), stage.key(), histogram.count(), histogram.percentile(50),
+                           histogram.percentile(95), histogram.percentile(99), histogram.maximum()});
+        }
+    }
+    return result;
+}
+
+void Tracer::clearMetrics()
+{
+    histograms.clear();
+}
+
+bool Tracer::exportChromeTrace(const QString& path) const
+{
+    // Chrome's trace event format: one complete ("X") event per span, each
+    // command on its own row, loadable in chrome://tracing or Perfetto
+    QJsonArray events;
+    qint64 pid = QCoreApplication::applicationPid();
+    int row = 0;
+    for (const QString& requestId : traceOrder) {
+        const Trace& trace = traces[requestId];
+        ++row;
+
+        QJsonObject args;
+        args["request_id"] = requestId;
+        args["ok"] = trace.ok;
+
+        QJsonObject root;
+        root["name"] = trace.command.isEmpty() ? requestId : trace.command;
+        root["cat"] = "command";
+        root["ph"] = "X";
+        root["ts"] = toMicroseconds(trace.start);
+        root["dur"] = toMicroseconds((trace.finished ? trace.end : now()) - trace.start);
+        root["pid"] = double(pid);
+        root["tid"] = row;
+        root["args"] = args;
+        events.append(root);
+
+        for (const Span& span : trace.spans) {
+            QJsonObject event;
+            event["name"] = span.name;
+            event["cat"] = "stage";
+            event["ph"] = "X";
+            event["ts"] = toMicroseconds(span.start);
+            event["dur"] = toMicroseconds(span.duration);
+            event["pid"] = double(pid);
+            event["tid"] = row;
+            events.append(event);
+        }
+    }
+
+    QJsonObject document;
+    document["traceEvents"] = events;
+    document["displayTimeUnit"] = "ms";
+
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "Tracer: ❌ Cannot write" << path;
+        return false;
+    }
+    file.write(QJsonDocument(document).toJson(QJsonDocument::Compact));
+    qDebug() << "Tracer: ✅ Exported" << traceOrder.size() << "traces to" << path;
+    return true;
+}
+
+bool Tracer::exportJson(const QString& path) const
+{
+    QJsonObject metrics;
+    for (const StageSummary& summary : summaries()) {
+        QJsonObject stage;
+        stage["count"] = double(summary.count);
+        stage["p50_ms"] = toMilliseconds(summary.p50);
+        stage["p95_ms"] = toMilliseconds(summary.p95);
+        stage["p99_ms"] = toMilliseconds(summary.p99);
+        stage["max_ms"] = toMilliseconds(summary.max);
+
+        QJsonObject command = metrics.value(summary.command).toObject();
+        command[summary.stage] = stage;
+        metrics[summary.command] = command;
+    }
+
+    QJsonArray traceList;
+    for (const QString& requestId : traceOrder) {
+        const Trace& trace = traces[requestId];
+        QJsonArray spans;
+        for (const Span& span : trace.spans) {
+            QJsonObject entry;
+            entry["name"] = span.name;
+            entry["start_ms"] = toMilliseconds(span.start - trace.start);
+            entry["duration_ms"] = toMilliseconds(span.duration);
+            spans.append(entry);
+        }
+
+        QJsonObject entry;
+        entry["request_id"] = requestId;
+        entry["command"] = trace.command;
+        entry["ok"] = trace.ok;
+        entry["finished"] = trace.finished;
+        entry["spans"] = spans;
+        traceList.append(entry);
+    }
+
+    QJsonObject document;
+    document["generated"] = QDateTime::currentDateTime().toString(Qt::ISODate);
+    document["metrics"] = metrics;
+    document["traces"] = traceList;
+
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "Tracer: ❌ Cannot write" << path;
+        return false;
+    }
+    file.write(QJsonDocument(document).toJson());
+    qDebug() << "Tracer: ✅ Exported metrics to" << path;
+    return true;
+}
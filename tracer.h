@@ -0,0 +1,124 @@
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QHash>
+#include <QMap>
+#include <QList>
+#include <QJsonObject>
+
+// Log-bucketed latency histogram: eight buckets per power of two from 1 µs,
+// so percentiles are accurate to about 9% in constant memory
+class LatencyHistogram
+{
+public:
+    LatencyHistogram();
+
+    void record(qint64 nanoseconds);
+    qint64 count() const { return total; }
+    qint64 percentile(double p) const; // Nanoseconds, upper bound of the bucket holding p
+    qint64 maximum() const { return largest; }
+
+private:
+    QVector<qint64> buckets;
+    qint64 total;
+    qint64 largest;
+};
+
+// Per-command request tracing. Every command gets a request ID that is sent
+// to the backend (X-Request-ID, or the IPC frame header) and collects spans
+// measured on one monotonic clock: parse, queue_wait, serialise, network,
+// the server's own tokenise/generate/decode times, deserialise and render.
+// Span durations feed a histogram per command and stage.
+//
+// GUI thread only.
+class Tracer : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Span {
+        QString name;
+        qint64 start = 0;    // Nanoseconds on the tracer's clock
+        qint64 duration = 0;
+    };
+
+    struct Trace {
+        QString requestId;
+        QString command;
+        qint64 start = 0;
+        qint64 end = 0;
+        bool finished = false;
+        bool ok = false;
+        QVector<Span> spans;
+    };
+
+    struct StageSummary {
+        QString command;
+        QString stage;
+        qint64 count;
+        qint64 p50, p95, p99, max; // Nanoseconds
+    };
+
+    static Tracer* instance();
+    static qint64 now(); // Monotonic nanoseconds since the tracer was created
+
+    // Spans may be added before beginTrace() and after finishTrace() (for
+    // example render, which happens after the command completes)
+    void beginTrace(const QString& requestId, const QString& command, qint64 start);
+    void addSpan(const QString& requestId, const QString& name, qint64 start, qint64 end);
+    void finishTrace(const QString& requestId, bool ok);
+
+    // Places the backend's "performance" timings (seconds) inside the most
+    // recent network span of the trace
+    void addServerTimings(const QString& requestId, const QJsonObject& performance);
+
+    // Request being issued on this call stack, set with Scope
+    static QString currentRequestId();
+
+    class Scope {
+    public:
+        explicit Scope(const QString& requestId);
+        ~Scope();
+    private:
+        QString previous;
+    };
+
+    // Records [construction, destruction) as a span
+    class ScopedSpan {
+    public:
+        ScopedSpan(const QString& requestId, const QString& name);
+        ~ScopedSpan();
+    private:
+        QString requestId;
+        QString name;
+        qint64 start;
+    };
+
+    QList<StageSummary> summaries() const;
+    void clearMetrics(); // Empties the histograms, e.g. after a warm-up; traces are kept
+
+    bool exportChromeTrace(const QString& path) const;
+    bool exportJson(const QString& path) const;
+
+    static const int MAX_TRACES;
+    static const QString TOTAL_STAGE;
+
+signals:
+    void traceFinished(const QString& requestId);
+
+private:
+    explicit Tracer(QObject *parent = nullptr);
+
+    Trace& traceFor(const QString& requestId);
+    void record(const QString& command, const QString& stage, qint64 duration);
+
+    QHash<QString, Trace> traces;
+    QStringList traceOrder; // Oldest first, bounded by MAX_TRACES
+    QMap<QString, QMap<QString, LatencyHistogram>> histograms; // command -> stage
+};
+
+#endif // TRACER_H